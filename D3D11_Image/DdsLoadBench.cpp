@@ -0,0 +1,425 @@
+//-----------------------------------------------------------------------------
+// File: DdsLoadBench.cpp
+//
+// Headless test and benchmark for DdsLoader, not part of the application
+// build. Writes DDS files in memory with BuildDdsHeader and DdsStreamWriter,
+// covering every legacy pixel format the loader maps, DX10 formats, mip
+// chains, arrays, cubemaps and cube arrays, and parses them back: each
+// subresource has to point at its own bytes with the right pitches. Every
+// file cut short anywhere has to be rejected. Then headers are mutated at
+// random, byte by byte and field by field with values around the limits, and
+// whatever ParseDds accepts has to stay inside the buffer and describe
+// consistent subresources. Finally the parse rate is timed.
+//
+//   g++ -std=c++14 -O2 -I. DdsLoadBench.cpp DdsLoader.cpp ../D3D11_Screenshot/DdsWriter.cpp
+//       ../D3D11_ScreenCapture/MappedFile.cpp -pthread -o ddsloadbench
+//   ./ddsloadbench [mutations] [seed]
+//
+// Built with -O1 -g -fsanitize=address,undefined instead, every read of the
+// header and of the subresources it accepts is checked against the file.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "DdsLoader.h"
+#include "../D3D11_Screenshot/DdsWriter.h"
+#include "../D3D11_Screenshot/DxgiFormat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct TextureCase
+    {
+        uint32_t               dxgiFormat;
+        uint32_t               width, height, mipLevels, arraySize;
+        bool                   cubemap;
+        const DDS_PIXELFORMAT* legacyFormat;    // nullptr writes the DX10 extension
+    };
+
+    struct DdsBytes
+    {
+        TextureCase          tc;
+        std::vector<uint8_t> file;
+        std::vector<size_t>  offsets;   // of each subresource, in DDS order
+    };
+
+    uint8_t Pattern(size_t i, uint32_t subresource)
+    {
+        return uint8_t((i * 31 + subresource * 97 + (i >> 8)) % 253);
+    }
+
+    // The file as ScreenGrab11 streams it
+    bool WriteDds(const TextureCase& tc, DdsBytes& dds)
+    {
+        const DxgiFormatInfo format = GetDxgiFormatInfo(tc.dxgiFormat);
+        const DxgiSurfaceSize top = GetDxgiSurfaceSize(format, tc.width, tc.height);
+
+        DdsTextureDesc desc = {};
+        desc.width = tc.width;
+        desc.height = tc.height;
+        desc.mipLevels = tc.mipLevels;
+        desc.arraySize = tc.arraySize;
+        desc.dxgiFormat = tc.dxgiFormat;
+        desc.cubemap = tc.cubemap;
+        desc.compressed = format.layout == DxgiLayout::Block4x4;
+        desc.rowBytes = size_t(top.rowBytes);
+        desc.rowCount = size_t(top.rowCount);
+        desc.legacyFormat = tc.legacyFormat;
+
+        uint8_t header[DDS_MAX_HEADER_SIZE];
+        const size_t headerSize = BuildDdsHeader(desc, header);
+        if (!headerSize)
+            return false;
+
+        dds.tc = tc;
+        dds.file.clear();
+        dds.offsets.clear();
+        DdsStreamWriter writer([&dds](const uint8_t* data, size_t size) {
+            dds.file.insert(dds.file.end(), data, data + size);
+            return true;
+        }, 4096);
+        bool ok = writer.Write(header, headerSize);
+
+        size_t offset = headerSize;
+        std::vector<uint8_t> pixels;
+        for (uint32_t item = 0; item < tc.arraySize; ++item)
+        {
+            for (uint32_t level = 0; level < tc.mipLevels; ++level)
+            {
+                const DxgiSurfaceSize size = GetDxgiSurfaceSize(format, std::max(1u, tc.width >> level),
+                                                                std::max(1u, tc.height >> level));
+                pixels.resize(size_t(size.totalBytes));
+                for (size_t i = 0; i < pixels.size(); ++i)
+                    pixels[i] = Pattern(i, uint32_t(dds.offsets.size()));
+                ok = ok && writer.WriteRows(pixels.data(), size_t(size.rowBytes), size_t(size.rowBytes), size_t(size.rowCount));
+                dds.offsets.push_back(offset);
+                offset += pixels.size();
+            }
+        }
+        return writer.Finish() && ok && dds.file.size() == offset;
+    }
+
+    // What a parse of an unmodified file has to give back
+    bool RoundTrips(const DdsBytes& dds, const DdsImage& image)
+    {
+        const TextureCase& tc = dds.tc;
+        if (image.width != tc.width || image.height != tc.height || image.mipLevels != tc.mipLevels ||
+            image.arraySize != tc.arraySize || image.cubemap != tc.cubemap || image.dxgiFormat != tc.dxgiFormat ||
+            image.subresources.size() != dds.offsets.size())
+        {
+            return false;
+        }
+
+        for (uint32_t item = 0; item < tc.arraySize; ++item)
+        {
+            for (uint32_t level = 0; level < tc.mipLevels; ++level)
+            {
+                const uint32_t index = level + item * tc.mipLevels;
+                const DdsSubresource& sub = image.subresources[index];
+                const DxgiSurfaceSize size = GetDxgiSurfaceSize(tc.dxgiFormat, std::max(1u, tc.width >> level),
+                                                                std::max(1u, tc.height >> level));
+                const uint8_t* bytes = static_cast<const uint8_t*>(sub.data);
+                if (bytes != dds.file.data() + dds.offsets[index] || sub.rowPitch != size.rowBytes ||
+                    sub.slicePitch != size.totalBytes)
+                {
+                    return false;
+                }
+                for (size_t i = 0; i < sub.slicePitch; ++i)
+                {
+                    if (bytes[i] != Pattern(i, index))
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // What any accepted file has to satisfy, whatever its header says. Reads every
+    // byte it hands out, so the sanitizers see an overrun.
+    bool Consistent(const std::vector<uint8_t>& file, const DdsImage& image, uint64_t& checksum)
+    {
+        const DxgiFormatInfo format = GetDxgiFormatInfo(image.dxgiFormat);
+        uint32_t fullChain = 1;
+        while ((std::max(image.width, image.height) >> fullChain) > 0)
+            ++fullChain;
+
+        if (image.width == 0 || image.height == 0 || image.width > 16384 || image.height > 16384 ||
+            image.mipLevels == 0 || image.mipLevels > fullChain || image.arraySize == 0 || image.arraySize > 2048 ||
+            (image.cubemap && (image.arraySize % 6 != 0 || image.width != image.height)) ||
+            image.subresources.size() != size_t(image.mipLevels) * image.arraySize)
+        {
+            return false;
+        }
+
+        const uint8_t* end = file.data() + file.size();
+        const uint8_t* next = nullptr;
+        for (uint32_t item = 0; item < image.arraySize; ++item)
+        {
+            for (uint32_t level = 0; level < image.mipLevels; ++level)
+            {
+                const DdsSubresource& sub = image.subresources[level + size_t(item) * image.mipLevels];
+                const DxgiSurfaceSize size = GetDxgiSurfaceSize(format, std::max(1u, image.width >> level),
+                                                                std::max(1u, image.height >> level));
+                const uint8_t* bytes = static_cast<const uint8_t*>(sub.data);
+                if (size.totalBytes == 0 || sub.rowPitch != size.rowBytes || sub.slicePitch != size.totalBytes ||
+                    bytes < file.data() || uint64_t(end - bytes) < sub.slicePitch || (next && bytes != next))
+                {
+                    return false;
+                }
+                for (size_t i = 0; i < sub.slicePitch; ++i)
+                    checksum += bytes[i];
+                next = bytes + sub.slicePitch;
+            }
+        }
+        return true;
+    }
+
+    // Byte offsets of the header fields, counting the magic
+    const size_t HEADER = sizeof(uint32_t);
+    const size_t EXTENSION = HEADER + sizeof(DDS_HEADER);
+    const size_t FIELDS[] =
+    {
+        0,
+        HEADER + offsetof(DDS_HEADER, size),
+        HEADER + offsetof(DDS_HEADER, flags),
+        HEADER + offsetof(DDS_HEADER, height),
+        HEADER + offsetof(DDS_HEADER, width),
+        HEADER + offsetof(DDS_HEADER, depth),
+        HEADER + offsetof(DDS_HEADER, mipMapCount),
+        HEADER + offsetof(DDS_HEADER, ddspf) + offsetof(DDS_PIXELFORMAT, size),
+        HEADER + offsetof(DDS_HEADER, ddspf) + offsetof(DDS_PIXELFORMAT, flags),
+        HEADER + offsetof(DDS_HEADER, ddspf) + offsetof(DDS_PIXELFORMAT, fourCC),
+        HEADER + offsetof(DDS_HEADER, ddspf) + offsetof(DDS_PIXELFORMAT, RGBBitCount),
+        HEADER + offsetof(DDS_HEADER, ddspf) + offsetof(DDS_PIXELFORMAT, RBitMask),
+        HEADER + offsetof(DDS_HEADER, ddspf) + offsetof(DDS_PIXELFORMAT, ABitMask),
+        HEADER + offsetof(DDS_HEADER, caps),
+        HEADER + offsetof(DDS_HEADER, caps2),
+        EXTENSION + offsetof(DDS_HEADER_DXT10, dxgiFormat),
+        EXTENSION + offsetof(DDS_HEADER_DXT10, resourceDimension),
+        EXTENSION + offsetof(DDS_HEADER_DXT10, miscFlag),
+        EXTENSION + offsetof(DDS_HEADER_DXT10, arraySize),
+    };
+
+    // Values around the limits ParseDds enforces, and whatever else comes up
+    uint32_t FieldValue(std::mt19937& random)
+    {
+        static const uint32_t VALUES[] =
+        {
+            0, 1, 2, 3, 4, 5, 6, 7, 12, 15, 16, 17, 341, 342, 2048, 2049, 16384, 16385, 0x7fffffff, 0x80000000,
+            0xfffffffe, 0xffffffff, DDS_MAGIC, DDS_FOURCC, DDS_CUBEMAP_ALLFACES, 0x200, 0x00200000, 0x00800000,
+            MAKEFOURCC('D', 'X', '1', '0'), MAKEFOURCC('D', 'X', 'T', '1'), MAKEFOURCC('A', 'T', 'I', '2'), 113, 116,
+            98, 130, 132, 191,
+        };
+        if (random() % 4 == 0)
+            return random();
+        return VALUES[random() % (sizeof(VALUES) / sizeof(VALUES[0]))];
+    }
+
+    void Mutate(std::vector<uint8_t>& file, std::mt19937& random)
+    {
+        const int edits = 1 + random() % 4;
+        for (int edit = 0; edit < edits; ++edit)
+        {
+            switch (random() % 5)
+            {
+            case 0:
+            case 1:
+            {
+                const size_t at = FIELDS[random() % (sizeof(FIELDS) / sizeof(FIELDS[0]))];
+                if (at + sizeof(uint32_t) <= file.size())
+                {
+                    const uint32_t value = FieldValue(random);
+                    memcpy(&file[at], &value, sizeof(value));
+                }
+                break;
+            }
+            case 2:
+                if (!file.empty())
+                    file[random() % std::min<size_t>(file.size(), DDS_MAX_HEADER_SIZE)] = uint8_t(random());
+                break;
+            case 3:
+                if (!file.empty())
+                    file[random() % std::min<size_t>(file.size(), DDS_MAX_HEADER_SIZE)] ^= uint8_t(1 << (random() % 8));
+                break;
+            default:
+                // Cut short, or with junk after the end
+                if (random() % 2)
+                    file.resize(random() % (file.size() + 1));
+                else
+                    file.resize(file.size() + 1 + random() % 4096, uint8_t(random()));
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int mutations = argc > 1 ? std::max(0, atoi(argv[1])) : 50000;
+    const unsigned seed = argc > 2 ? unsigned(atoi(argv[2])) : 1;
+
+    static const TextureCase CASES[] =
+    {
+        // Every legacy format the loader maps, as a small full chain
+        { 28,  37, 21, 6, 1, false, &DDSPF_A8B8G8R8 },
+        { 35,  37, 21, 6, 1, false, &DDSPF_G16R16 },
+        { 49,  37, 21, 6, 1, false, &DDSPF_A8L8 },
+        { 56,  37, 21, 6, 1, false, &DDSPF_L16 },
+        { 61,  37, 21, 6, 1, false, &DDSPF_L8 },
+        { 65,  37, 21, 6, 1, false, &DDSPF_A8 },
+        { 71,  37, 21, 6, 1, false, &DDSPF_DXT1 },
+        { 74,  37, 21, 6, 1, false, &DDSPF_DXT3 },
+        { 77,  37, 21, 6, 1, false, &DDSPF_DXT5 },
+        { 80,  37, 21, 6, 1, false, &DDSPF_BC4_UNORM },
+        { 81,  37, 21, 6, 1, false, &DDSPF_BC4_SNORM },
+        { 83,  37, 21, 6, 1, false, &DDSPF_BC5_UNORM },
+        { 84,  37, 21, 6, 1, false, &DDSPF_BC5_SNORM },
+        { 85,  37, 21, 6, 1, false, &DDSPF_R5G6B5 },
+        { 86,  37, 21, 6, 1, false, &DDSPF_A1R5G5B5 },
+        { 51,  37, 21, 6, 1, false, &DDSPF_V8U8 },
+        { 31,  37, 21, 6, 1, false, &DDSPF_Q8W8V8U8 },
+        { 37,  37, 21, 6, 1, false, &DDSPF_V16U16 },
+        { 87,  37, 21, 6, 1, false, &DDSPF_A8R8G8B8 },
+        { 88,  37, 21, 6, 1, false, &DDSPF_X8R8G8B8 },
+        { 115, 37, 21, 6, 1, false, &DDSPF_A4R4G4B4 },
+
+        // Legacy cubes, and shapes that need the DX10 extension
+        { 87,  32, 32, 6, 6,  true,  &DDSPF_A8R8G8B8 },
+        { 71,  64, 64, 1, 6,  true,  &DDSPF_DXT1 },
+        { 87,  50, 30, 3, 4,  false, nullptr },
+        { 98,  36, 36, 6, 12, true,  nullptr },
+        { 95,  129, 65, 8, 2, false, nullptr },
+        { 2,   19, 7,  5, 1,  false, nullptr },
+        { 24,  64, 1,  7, 3,  false, nullptr },
+        { 29,  1, 1,   1, 1,  false, nullptr },
+        { 10,  512, 384, 10, 1, false, nullptr },
+    };
+
+    std::vector<DdsBytes> corpus;
+    bool allOk = true;
+    DdsImage image;
+    size_t truncations = 0;
+    for (const TextureCase& tc : CASES)
+    {
+        DdsBytes dds;
+        bool ok = WriteDds(tc, dds) && ParseDds(dds.file.data(), dds.file.size(), image) && RoundTrips(dds, image);
+
+        // Junk after the last subresource is ignored
+        std::vector<uint8_t> longer = dds.file;
+        longer.resize(longer.size() + 7, 0xcc);
+        ok = ok && ParseDds(longer.data(), longer.size(), image);
+
+        // Cut anywhere, down to nothing: every length on small files, around each
+        // subresource boundary and at random on large ones
+        std::vector<size_t> lengths;
+        if (dds.file.size() <= 65536)
+        {
+            for (size_t length = 0; length < dds.file.size(); ++length)
+                lengths.push_back(length);
+        }
+        else
+        {
+            std::mt19937 random(seed);
+            for (size_t length = 0; length <= DDS_MAX_HEADER_SIZE; ++length)
+                lengths.push_back(length);
+            for (size_t offset : dds.offsets)
+                lengths.insert(lengths.end(), { offset - 1, offset, offset + 1 });
+            lengths.push_back(dds.file.size() - 1);
+            for (int i = 0; i < 1000; ++i)
+                lengths.push_back(random() % dds.file.size());
+        }
+        for (size_t length : lengths)
+        {
+            // An exact-size copy, so any read past the end lands outside the allocation
+            std::vector<uint8_t> cut(dds.file.begin(), dds.file.begin() + length);
+            const bool accepted = ParseDds(cut.empty() ? nullptr : cut.data(), cut.size(), image);
+            ok = ok && !accepted && image.subresources.empty();
+            ++truncations;
+        }
+
+        printf("format %3u %4ux%-4u %2u levels %2u items %-7s %8zu bytes  %s\n", tc.dxgiFormat, tc.width, tc.height,
+               tc.mipLevels, tc.arraySize, tc.legacyFormat && tc.arraySize == (tc.cubemap ? 6u : 1u) ? "legacy" : "dx10",
+               dds.file.size(), ok ? "ok" : "MISMATCH");
+        allOk = allOk && ok;
+        corpus.push_back(std::move(dds));
+    }
+    printf("%zu truncated files rejected\n", truncations);
+
+    // The mapped path gives the same description
+    {
+        const DdsBytes& dds = corpus.back();
+        const char* path = "DdsLoadBench.dds";
+        FILE* file = fopen(path, "wb");
+        bool ok = file && fwrite(dds.file.data(), 1, dds.file.size(), file) == dds.file.size();
+        if (file)
+            ok = fclose(file) == 0 && ok;
+
+        DdsFile mapped;
+        ok = ok && mapped.Open(path) && mapped.Image().width == dds.tc.width &&
+             mapped.Image().subresources.size() == dds.offsets.size();
+        mapped.Close();
+        ok = ok && !mapped.Open("DdsLoadBench missing.dds") && mapped.Image().subresources.empty();
+        remove(path);
+        printf("DdsFile %s\n", ok ? "ok" : "MISMATCH");
+        allOk = allOk && ok;
+    }
+
+    // Mutated headers: accepted or not, never out of bounds
+    std::mt19937 random(seed);
+    size_t accepted = 0, inconsistent = 0;
+    uint64_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < mutations; ++i)
+    {
+        std::vector<uint8_t> file = corpus[random() % corpus.size()].file;
+        Mutate(file, random);
+        if (ParseDds(file.empty() ? nullptr : file.data(), file.size(), image))
+        {
+            ++accepted;
+            if (!Consistent(file, image, checksum))
+            {
+                if (inconsistent++ < 10)
+                    printf("mutation %d: %ux%u format %u, %u levels, %u items accepted inconsistently\n", i,
+                           image.width, image.height, image.dxgiFormat, image.mipLevels, image.arraySize);
+            }
+        }
+        else if (!image.subresources.empty() || image.width != 0)
+        {
+            ++inconsistent;
+        }
+    }
+    printf("%d mutated files in %.0f ms: %zu accepted, %zu inconsistent (checksum %llu)\n", mutations,
+           MillisecondsSince(start), accepted, inconsistent, (unsigned long long)checksum);
+    allOk = allOk && inconsistent == 0;
+
+    // Parse rate on the largest file, header validation and table only
+    const DdsBytes& largest = corpus.back();
+    const int parses = 200000;
+    size_t tables = 0;
+    const auto parseStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < parses; ++i)
+    {
+        ParseDds(largest.file.data(), largest.file.size(), image);
+        tables += image.subresources.size();
+    }
+    const double ms = MillisecondsSince(parseStart);
+    printf("%d parses of a %u level file: %.3f us each (%zu subresources)\n", parses, largest.tc.mipLevels,
+           ms * 1000.0 / parses, tables);
+
+    return allOk ? 0 : 1;
+}
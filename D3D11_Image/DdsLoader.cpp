@@ -0,0 +1,241 @@
+//-----------------------------------------------------------------------------
+// File: DdsLoader.cpp
+//
+// DDS header validation and the zero-copy subresource table.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "DdsLoader.h"
+#include "../D3D11_Screenshot/Dds.h"
+#include "../D3D11_Screenshot/DxgiFormat.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Direct3D 11 limits (D3D11_REQ_*)
+    const uint32_t MAX_DIMENSION = 16384;
+    const uint32_t MAX_ARRAY_SIZE = 2048;
+    const uint32_t MAX_MIP_LEVELS = 15;
+
+#define DDS_HEADER_FLAGS_VOLUME 0x00800000  // DDSD_DEPTH
+#define DDS_CUBEMAP             0x00000200  // DDSCAPS2_CUBEMAP
+#define DDS_VOLUME              0x00200000  // DDSCAPS2_VOLUME
+
+    // Formats a texture can be created in with initial data; packed, planar, depth,
+    // video and palettized formats are left out
+    bool IsLoadable(const DxgiFormatInfo& format)
+    {
+        switch (format.channels)
+        {
+        case DxgiChannels::None:
+        case DxgiChannels::DepthStencil:
+        case DxgiChannels::Yuv:
+        case DxgiChannels::Palette:
+            return false;
+        default:
+            return format.layout == DxgiLayout::Block4x4 || (format.layout == DxgiLayout::Linear && format.bitsPerPixel % 8 == 0);
+        }
+    }
+
+    bool SameFormat(const DDS_PIXELFORMAT& a, const DDS_PIXELFORMAT& b)
+    {
+        if (a.flags & DDS_FOURCC)
+            return (b.flags & DDS_FOURCC) && a.fourCC == b.fourCC;
+
+        return a.flags == b.flags && a.RGBBitCount == b.RGBBitCount && a.RBitMask == b.RBitMask &&
+               a.GBitMask == b.GBitMask && a.BBitMask == b.BBitMask && a.ABitMask == b.ABitMask;
+    }
+
+    // The legacy pixel formats SaveDDSTextureToFile writes, and a few common aliases
+    uint32_t LegacyFormat(const DDS_PIXELFORMAT& ddspf)
+    {
+        static const struct { const DDS_PIXELFORMAT* ddspf; uint32_t dxgiFormat; } LEGACY[] =
+        {
+            { &DDSPF_A8B8G8R8,  28 },   // R8G8B8A8_UNORM
+            { &DDSPF_G16R16,    35 },   // R16G16_UNORM
+            { &DDSPF_A8L8,      49 },   // R8G8_UNORM
+            { &DDSPF_L16,       56 },   // R16_UNORM
+            { &DDSPF_L8,        61 },   // R8_UNORM
+            { &DDSPF_A8,        65 },   // A8_UNORM
+            { &DDSPF_DXT1,      71 },   // BC1_UNORM
+            { &DDSPF_DXT3,      74 },   // BC2_UNORM
+            { &DDSPF_DXT5,      77 },   // BC3_UNORM
+            { &DDSPF_BC4_UNORM, 80 },   // BC4_UNORM
+            { &DDSPF_BC4_SNORM, 81 },   // BC4_SNORM
+            { &DDSPF_BC5_UNORM, 83 },   // BC5_UNORM
+            { &DDSPF_BC5_SNORM, 84 },   // BC5_SNORM
+            { &DDSPF_R5G6B5,    85 },   // B5G6R5_UNORM
+            { &DDSPF_A1R5G5B5,  86 },   // B5G5R5A1_UNORM
+            { &DDSPF_V8U8,      51 },   // R8G8_SNORM
+            { &DDSPF_Q8W8V8U8,  31 },   // R8G8B8A8_SNORM
+            { &DDSPF_V16U16,    37 },   // R16G16_SNORM
+            { &DDSPF_A8R8G8B8,  87 },   // B8G8R8A8_UNORM
+            { &DDSPF_X8R8G8B8,  88 },   // B8G8R8X8_UNORM
+            { &DDSPF_A4R4G4B4, 115 },   // B4G4R4A4_UNORM
+        };
+
+        for (const auto& legacy : LEGACY)
+        {
+            if (SameFormat(ddspf, *legacy.ddspf))
+                return legacy.dxgiFormat;
+        }
+
+        if (!(ddspf.flags & DDS_FOURCC))
+            return 0;
+
+        switch (ddspf.fourCC)
+        {
+        case MAKEFOURCC('A', 'T', 'I', '1'): return 80;    // BC4_UNORM
+        case MAKEFOURCC('A', 'T', 'I', '2'): return 83;    // BC5_UNORM
+        case MAKEFOURCC('D', 'X', 'T', '2'): return 74;    // BC2_UNORM, premultiplied
+        case MAKEFOURCC('D', 'X', 'T', '4'): return 77;    // BC3_UNORM, premultiplied
+
+            // Legacy D3DX formats using D3DFMT enum value as FourCC
+        case 116: return 2;     // D3DFMT_A32B32G32R32F
+        case 113: return 10;    // D3DFMT_A16B16G16R16F
+        case 36:  return 11;    // D3DFMT_A16B16G16R16
+        case 110: return 13;    // D3DFMT_Q16W16V16U16
+        case 115: return 16;    // D3DFMT_G32R32F
+        case 112: return 34;    // D3DFMT_G16R16F
+        case 114: return 41;    // D3DFMT_R32F
+        case 111: return 54;    // D3DFMT_R16F
+        default:  return 0;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Header validation and subresource layout
+//-----------------------------------------------------------------------------
+bool ParseDds(const uint8_t* data, size_t size, DdsImage& image)
+{
+    image = DdsImage();
+
+    uint32_t magic = 0;
+    DDS_HEADER header;
+    if (!data || size < sizeof(magic) + sizeof(header))
+        return false;
+
+    memcpy(&magic, data, sizeof(magic));
+    memcpy(&header, data + sizeof(magic), sizeof(header));
+    if (magic != DDS_MAGIC || header.size != sizeof(DDS_HEADER) || header.ddspf.size != sizeof(DDS_PIXELFORMAT))
+        return false;
+
+    if ((header.flags & DDS_HEADER_FLAGS_VOLUME) || (header.caps2 & DDS_VOLUME))
+        return false;
+
+    size_t offset = sizeof(magic) + sizeof(header);
+    uint32_t arraySize = 1;
+    bool cubemap = false;
+
+    if ((header.ddspf.flags & DDS_FOURCC) && header.ddspf.fourCC == DDSPF_DX10.fourCC)
+    {
+        DDS_HEADER_DXT10 ext;
+        if (size < offset + sizeof(ext))
+            return false;
+        memcpy(&ext, data + offset, sizeof(ext));
+        offset += sizeof(ext);
+
+        if (ext.resourceDimension != DDS_DIMENSION_TEXTURE2D || ext.arraySize == 0)
+            return false;
+
+        cubemap = (ext.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+        if (ext.arraySize > MAX_ARRAY_SIZE / (cubemap ? 6 : 1))
+            return false;
+
+        image.dxgiFormat = ext.dxgiFormat;
+        arraySize = ext.arraySize * (cubemap ? 6 : 1);
+    }
+    else
+    {
+        image.dxgiFormat = LegacyFormat(header.ddspf);
+
+        // Partial cubemaps can't be created as textures
+        if (header.caps2 & DDS_CUBEMAP)
+        {
+            if ((header.caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+                return false;
+            cubemap = true;
+            arraySize = 6;
+        }
+    }
+
+    const DxgiFormatInfo format = GetDxgiFormatInfo(image.dxgiFormat);
+    if (!IsLoadable(format))
+        return false;
+
+    if (header.width == 0 || header.height == 0 || header.width > MAX_DIMENSION || header.height > MAX_DIMENSION)
+        return false;
+
+    if (cubemap && header.width != header.height)
+        return false;
+
+    // A missing count means a single level; a chain can't continue below 1x1
+    uint32_t fullChain = 1;
+    while ((std::max(header.width, header.height) >> fullChain) > 0)
+        ++fullChain;
+    const uint32_t mipLevels = header.mipMapCount ? header.mipMapCount : 1;
+    if (mipLevels > fullChain || mipLevels > MAX_MIP_LEVELS)
+        return false;
+
+    image.width = header.width;
+    image.height = header.height;
+    image.mipLevels = mipLevels;
+    image.arraySize = arraySize;
+    image.cubemap = cubemap;
+    image.subresources.resize(size_t(mipLevels) * arraySize);
+
+    // Item-major: every level of item 0, then every level of item 1, ...
+    uint64_t remaining = size - offset;
+    const uint8_t* pixels = data + offset;
+    for (uint32_t item = 0; item < arraySize; ++item)
+    {
+        for (uint32_t level = 0; level < mipLevels; ++level)
+        {
+            const DxgiSurfaceSize surface = GetDxgiSurfaceSize(format, std::max(1u, header.width >> level),
+                                                               std::max(1u, header.height >> level));
+            const uint64_t rowPitch = surface.rowBytes;
+            const uint64_t slicePitch = surface.totalBytes;
+            if (slicePitch > remaining || slicePitch > UINT32_MAX)
+            {
+                image = DdsImage();
+                return false;
+            }
+
+            DdsSubresource& subresource = image.subresources[size_t(level) + size_t(item) * mipLevels];
+            subresource.data = pixels;
+            subresource.rowPitch = static_cast<uint32_t>(rowPitch);
+            subresource.slicePitch = static_cast<uint32_t>(slicePitch);
+
+            pixels += slicePitch;
+            remaining -= slicePitch;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Map the file and describe it in place
+//-----------------------------------------------------------------------------
+bool DdsFile::Open(const char* path)
+{
+    Close();
+
+    if (!m_file.Open(path) || !ParseDds(m_file.Data(), m_file.Size(), m_image))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void DdsFile::Close()
+{
+    m_image = DdsImage();
+    m_file.Close();
+}
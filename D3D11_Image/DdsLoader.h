@@ -0,0 +1,72 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: DdsLoader.h
+//
+// Loads 2D textures from DDS files without decoding or copying anything: the
+// file is memory-mapped, the header is validated, and the subresource table
+// points straight into the mapped bytes, ready to be passed to
+// CreateTexture2D as initial data. Covers full mip chains, texture arrays and
+// cubemaps in the uncompressed and BC formats that ScreenGrab11 writes.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../D3D11_ScreenCapture/MappedFile.h"
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+// Same layout as D3D11_SUBRESOURCE_DATA
+struct DdsSubresource
+{
+    const void* data;
+    uint32_t    rowPitch;
+    uint32_t    slicePitch;
+};
+
+struct DdsImage
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t arraySize;         // faces for cubemaps, six per cube
+    uint32_t dxgiFormat;
+    bool     cubemap;
+
+    // Indexed like D3D11CalcSubresource: mip + item * mipLevels
+    std::vector<DdsSubresource> subresources;
+};
+
+//-----------------------------------------------------------------------------
+// Class declarations
+//-----------------------------------------------------------------------------
+
+// Keeps the file mapped for as long as the subresources are used
+class DdsFile
+{
+public:
+    bool Open(const char* path);
+    void Close();
+
+    const DdsImage& Image() const { return m_image; }
+
+private:
+    MappedFile m_file;
+    DdsImage   m_image = {};
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Validates a whole DDS file in memory and fills `image` with pointers into it;
+// false for anything malformed, truncated or unsupported
+bool ParseDds(const uint8_t* data, size_t size, DdsImage& image);
@@ -0,0 +1,213 @@
+//-----------------------------------------------------------------------------
+// File: MipBench.cpp
+//
+// Headless benchmark for MipChain, not part of the application build. Builds
+// the chain of a synthetic frame with a translucent corner, at an odd size so
+// the three-tap filter is exercised, serially and on the pool. Both have to
+// match each other exactly and a double-precision reference that uses pow for
+// the sRGB curve to within one step. A flat colour has to come out unchanged
+// on every level.
+//
+//   g++ -std=c++14 -O2 -I. MipBench.cpp MipChain.cpp ../D3D11_Screenshot/Srgb.cpp
+//       ../D3D11_ScreenCapture/ThreadPool.cpp -pthread -o mipbench
+//   ./mipbench [width] [height] [runs]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "MipChain.h"
+#include "../D3D11_Screenshot/BenchImage.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    template <typename Build>
+    double BestOf(int runs, Build build)
+    {
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            build();
+            best = std::min(best, MillisecondsSince(start));
+        }
+        return best;
+    }
+
+    double ToLinear(uint8_t v)
+    {
+        const double srgb = v / 255.0;
+        return srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4);
+    }
+
+    uint8_t ToSrgb(double linear)
+    {
+        linear = std::min(std::max(linear, 0.0), 1.0);
+        const double srgb = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+        return uint8_t(std::floor(srgb * 255.0 + 0.5));
+    }
+
+    // The same filter in doubles, one texel at a time, straight from the definition
+    std::vector<std::vector<uint8_t>> ReferenceChain(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height)
+    {
+        std::vector<double> level(pixels.size());
+        for (size_t i = 0; i < pixels.size(); i += 4)
+        {
+            const double alpha = pixels[i + 3] / 255.0;
+            for (int c = 0; c < 3; ++c)
+                level[i + c] = ToLinear(pixels[i + c]) * alpha;
+            level[i + 3] = alpha;
+        }
+
+        // Texel i of the smaller level covers [i * size / next, (i + 1) * size / next)
+        auto coverage = [](uint32_t size, uint32_t next, uint32_t i, uint32_t t)
+        {
+            if (size == 1)
+                return 1.0;
+            const double lo = double(i) * size / next;
+            const double hi = double(i + 1) * size / next;
+            return std::max(0.0, std::min(hi, t + 1.0) - std::max(lo, double(t))) * next / size;
+        };
+
+        std::vector<std::vector<uint8_t>> chain;
+        while (width > 1 || height > 1)
+        {
+            const uint32_t w = std::max(1u, width / 2);
+            const uint32_t h = std::max(1u, height / 2);
+            std::vector<double> next(size_t(w) * h * 4, 0.0);
+            std::vector<uint8_t> bytes(next.size());
+            for (uint32_t y = 0; y < h; ++y)
+            {
+                for (uint32_t x = 0; x < w; ++x)
+                {
+                    double* d = &next[(size_t(y) * w + x) * 4];
+                    for (uint32_t sy = 0; sy < height; ++sy)
+                    {
+                        const double wy = coverage(height, h, y, sy);
+                        if (wy == 0.0)
+                            continue;
+                        for (uint32_t sx = 0; sx < width; ++sx)
+                        {
+                            const double wx = coverage(width, w, x, sx);
+                            for (int c = 0; c < 4 && wx != 0.0; ++c)
+                                d[c] += level[(size_t(sy) * width + sx) * 4 + c] * wx * wy;
+                        }
+                    }
+
+                    uint8_t* b = &bytes[(size_t(y) * w + x) * 4];
+                    for (int c = 0; c < 3; ++c)
+                        b[c] = d[3] > 0.0 ? ToSrgb(d[c] / d[3]) : 0;
+                    b[3] = uint8_t(std::floor(std::min(std::max(d[3], 0.0), 1.0) * 255.0 + 0.5));
+                }
+            }
+            chain.push_back(bytes);
+            level.swap(next);
+            width = w;
+            height = h;
+        }
+        return chain;
+    }
+
+    int MaxDifference(const uint8_t* a, const uint8_t* b, size_t count)
+    {
+        int worst = 0;
+        for (size_t i = 0; i < count; ++i)
+            worst = std::max(worst, std::abs(int(a[i]) - int(b[i])));
+        return worst;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t width = argc > 1 ? uint32_t(atoi(argv[1])) : 4095;
+    const uint32_t height = argc > 2 ? uint32_t(atoi(argv[2])) : 2047;
+    const int runs = argc > 3 ? std::max(1, atoi(argv[3])) : 5;
+
+    if (width < 64 || height < 64)
+    {
+        printf("the test frame needs at least 64x64 pixels\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> pixels = MakeDesktop(width, height);
+    for (uint32_t y = 0; y < height / 4; ++y)
+        for (uint32_t x = 0; x < width / 4; ++x)
+            pixels[(size_t(y) * width + x) * 4 + 3] = uint8_t((x + y) * 255 / (width / 4 + height / 4));
+
+    ThreadPool pool;
+    MipChain serial, parallel;
+    const uint32_t pitch = width * 4;
+
+    double ms = BestOf(runs, [&] { serial.Generate(pixels.data(), pitch, width, height, true); });
+    printf("%-24s %8.2f ms\n", "MipChain, one thread", ms);
+    const double serialMs = ms;
+    ms = BestOf(runs, [&] { parallel.Generate(pixels.data(), pitch, width, height, true, &pool); });
+    printf("%-24s %8.2f ms  (%.1fx, %u threads)\n", "MipChain, pool", ms, serialMs / ms, pool.Size());
+
+    bool allOk = serial.Levels() == parallel.Levels();
+    for (uint32_t l = 1; allOk && l < serial.Levels(); ++l)
+    {
+        const DdsSubresource& a = serial.Subresources()[l];
+        allOk = memcmp(a.data, parallel.Subresources()[l].data, a.slicePitch) == 0;
+    }
+    printf("pool matches one thread: %s\n", allOk ? "ok" : "FAILED");
+
+    // The reference is quadratic in the level size, so it only sees a crop
+    const uint32_t cropWidth = std::min(width, 255u), cropHeight = std::min(height, 191u);
+    std::vector<uint8_t> crop(size_t(cropWidth) * cropHeight * 4);
+    for (uint32_t y = 0; y < cropHeight; ++y)
+        memcpy(&crop[size_t(y) * cropWidth * 4], &pixels[size_t(y) * pitch], cropWidth * 4);
+
+    std::vector<std::vector<uint8_t>> reference;
+    ms = BestOf(1, [&] { reference = ReferenceChain(crop, cropWidth, cropHeight); });
+    printf("%-24s %8.2f ms  (%ux%u)\n", "reference, doubles", ms, cropWidth, cropHeight);
+
+    MipChain cropChain;
+    cropChain.Generate(crop.data(), cropWidth * 4, cropWidth, cropHeight, true);
+    int worst = cropChain.Levels() == reference.size() + 1 ? 0 : 256;
+    for (uint32_t l = 1; worst <= 1 && l < cropChain.Levels(); ++l)
+    {
+        const DdsSubresource& level = cropChain.Subresources()[l];
+        worst = std::max(worst, MaxDifference(static_cast<const uint8_t*>(level.data), reference[l - 1].data(),
+                                              level.slicePitch));
+    }
+    printf("largest difference from the reference: %d %s\n", worst, worst <= 1 ? "ok" : "FAILED");
+    allOk = allOk && worst <= 1;
+
+    // A flat colour, opaque or not, is the same colour on every level
+    std::vector<uint8_t> flat(size_t(width) * height * 4);
+    for (size_t i = 0; i < flat.size(); i += 4)
+    {
+        flat[i + 0] = 200;
+        flat[i + 1] = 17;
+        flat[i + 2] = 90;
+        flat[i + 3] = 130;
+    }
+    MipChain flatChain;
+    flatChain.Generate(flat.data(), pitch, width, height, true, &pool);
+    bool flatOk = true;
+    for (uint32_t l = 1; l < flatChain.Levels(); ++l)
+    {
+        const DdsSubresource& level = flatChain.Subresources()[l];
+        flatOk = flatOk && MaxDifference(static_cast<const uint8_t*>(level.data), flat.data(), level.slicePitch) == 0;
+    }
+    printf("flat colour unchanged: %s\n", flatOk ? "ok" : "FAILED");
+    allOk = allOk && flatOk;
+
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,336 @@
+//-----------------------------------------------------------------------------
+// File: MipChain.cpp
+//
+// Box-filtered mip levels on linear, premultiplied pixels: SSE2 with a scalar
+// fallback, one (level, band of rows) task per ParallelFor index.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "MipChain.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+#include "../D3D11_Screenshot/Srgb.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MIP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const size_t BAND_PIXELS = 16 * 1024;   // output pixels per task
+
+    struct Level
+    {
+        uint32_t width;
+        uint32_t height;
+        size_t   linearOffset;   // floats into m_linear
+        size_t   byteOffset;     // bytes into m_pixels
+        uint32_t bandRows;
+        size_t   firstBand;      // index of the level's first task
+    };
+
+    struct Band
+    {
+        uint32_t level;
+        uint32_t firstRow;
+        uint32_t rows;
+    };
+
+    // The texels of a `size` long axis that cover texel `i` of the next level, and
+    // how much of it each one covers
+    int Taps(uint32_t size, uint32_t i, uint32_t& first, float weights[3])
+    {
+        if (size == 1)
+        {
+            first = 0;
+            weights[0] = 1.0f;
+            return 1;
+        }
+
+        first = 2 * i;
+        if ((size & 1) == 0)
+        {
+            weights[0] = 0.5f;
+            weights[1] = 0.5f;
+            return 2;
+        }
+
+        // An odd axis of 2n + 1 texels shrinks to n, each covering (2n + 1) / n of them
+        const uint32_t n = size / 2;
+        const float scale = 1.0f / float(size);
+        weights[0] = float(n - i) * scale;
+        weights[1] = float(n) * scale;
+        weights[2] = float(i + 1) * scale;
+        return 3;
+    }
+
+    const float* UnormTable()
+    {
+        struct Table
+        {
+            float values[256];
+            Table()
+            {
+                for (int v = 0; v < 256; ++v)
+                    values[v] = float(v) / 255.0f;
+            }
+        };
+        static const Table table;
+        return table.values;
+    }
+
+    // 8-bit pixels to linear, premultiplied floats
+    void DecodeRow(const uint8_t* src, const float* table, uint32_t width, float* dst)
+    {
+        for (uint32_t x = 0; x < width; ++x, src += 4, dst += 4)
+        {
+            const float alpha = float(src[3]) * (1.0f / 255.0f);
+#ifdef MIP_SSE2
+            const __m128 colour = _mm_setr_ps(table[src[0]], table[src[1]], table[src[2]], 1.0f);
+            _mm_storeu_ps(dst, _mm_mul_ps(colour, _mm_set1_ps(alpha)));
+#else
+            dst[0] = table[src[0]] * alpha;
+            dst[1] = table[src[1]] * alpha;
+            dst[2] = table[src[2]] * alpha;
+            dst[3] = alpha;
+#endif
+        }
+    }
+
+    // out = sum of rows[k] * weights[k], `count` floats
+    void WeightRows(const float* const* rows, const float* weights, int taps, size_t count, float* out)
+    {
+        size_t i = 0;
+#ifdef MIP_SSE2
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 sum = _mm_mul_ps(_mm_loadu_ps(rows[0] + i), _mm_set1_ps(weights[0]));
+            for (int k = 1; k < taps; ++k)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+            _mm_storeu_ps(out + i, sum);
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float sum = rows[0][i] * weights[0];
+            for (int k = 1; k < taps; ++k)
+                sum += rows[k][i] * weights[k];
+            out[i] = sum;
+        }
+    }
+
+    // One row of `srcWidth` pixels down to the next level's width
+    void ShrinkRow(const float* src, uint32_t srcWidth, uint32_t dstWidth, float* dst)
+    {
+        for (uint32_t x = 0; x < dstWidth; ++x, dst += 4)
+        {
+            uint32_t first;
+            float weights[3];
+            const int taps = Taps(srcWidth, x, first, weights);
+            const float* s = src + size_t(first) * 4;
+#ifdef MIP_SSE2
+            __m128 sum = _mm_mul_ps(_mm_loadu_ps(s), _mm_set1_ps(weights[0]));
+            for (int k = 1; k < taps; ++k)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(s + k * 4), _mm_set1_ps(weights[k])));
+            _mm_storeu_ps(dst, sum);
+#else
+            for (int c = 0; c < 4; ++c)
+            {
+                float sum = s[c] * weights[0];
+                for (int k = 1; k < taps; ++k)
+                    sum += s[k * 4 + c] * weights[k];
+                dst[c] = sum;
+            }
+#endif
+        }
+    }
+
+    // Premultiplied back to straight alpha; fully transparent pixels get no colour
+    void Unpremultiply(const float* src, uint32_t width, float* dst)
+    {
+        for (uint32_t x = 0; x < width; ++x, src += 4, dst += 4)
+        {
+#ifdef MIP_SSE2
+            const __m128 v = _mm_loadu_ps(src);
+            const __m128 alpha = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+            const __m128 opaque = _mm_cmpgt_ps(alpha, _mm_setzero_ps());
+            const __m128 colour = _mm_and_ps(opaque, _mm_div_ps(v, alpha));
+            const __m128 alphaLane = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+            _mm_storeu_ps(dst, _mm_or_ps(_mm_andnot_ps(alphaLane, colour), _mm_and_ps(alphaLane, v)));
+#else
+            const float alpha = src[3];
+            const float scale = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+            dst[0] = src[0] * scale;
+            dst[1] = src[1] * scale;
+            dst[2] = src[2] * scale;
+            dst[3] = alpha;
+#endif
+        }
+    }
+
+    // [0, 1] floats to UNORM bytes, for textures that aren't sRGB
+    void EncodeUnorm(const float* src, uint8_t* dst, size_t count)
+    {
+        size_t i = 0;
+#ifdef MIP_SSE2
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i v[4];
+            for (int k = 0; k < 4; ++k)
+            {
+                const __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + k * 4), _mm_setzero_ps()), one);
+                v[k] = _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                             _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3])));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float x = src[i] > 0.0f ? src[i] : 0.0f;
+            x = x < 1.0f ? x : 1.0f;
+            dst[i] = uint8_t(std::lrint(x * 255.0f));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// MipChain
+//-----------------------------------------------------------------------------
+bool MipChain::Generate(const uint8_t* pixels, uint32_t pitch, uint32_t width, uint32_t height, bool srgb,
+                        ThreadPool* pool)
+{
+    m_subresources.clear();
+    if (!pixels || width == 0 || height == 0 || pitch < size_t(width) * 4)
+        return false;
+
+    // Level sizes, buffer offsets and the bands each level is split into
+    std::vector<Level> levels;
+    levels.push_back({ width, height, 0, 0, height, 0 });
+    size_t linearSize = 0;
+    size_t byteSize = 0;
+    size_t bandCount = 0;
+    while (levels.back().width > 1 || levels.back().height > 1)
+    {
+        Level level;
+        level.width = std::max(1u, levels.back().width / 2);
+        level.height = std::max(1u, levels.back().height / 2);
+        level.linearOffset = linearSize;
+        level.byteOffset = byteSize;
+        level.bandRows = uint32_t(std::max<size_t>(1, BAND_PIXELS / level.width));
+        level.firstBand = bandCount;
+        levels.push_back(level);
+
+        const size_t texels = size_t(level.width) * level.height;
+        linearSize += texels * 4;
+        byteSize += texels * 4;
+        bandCount += (level.height + level.bandRows - 1) / level.bandRows;
+    }
+
+    m_linear.resize(linearSize);
+    m_pixels.resize(byteSize);
+
+    std::vector<Band> bands;
+    bands.reserve(bandCount);
+    for (uint32_t l = 1; l < levels.size(); ++l)
+    {
+        for (uint32_t row = 0; row < levels[l].height; row += levels[l].bandRows)
+            bands.push_back({ l, row, std::min(levels[l].bandRows, levels[l].height - row) });
+    }
+
+    std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[bands.size()]);
+    for (size_t i = 0; i < bands.size(); ++i)
+        done[i] = false;
+
+    const float* table = srgb ? SrgbToLinearTable() : UnormTable();
+    float* linear = m_linear.data();
+    uint8_t* bytes = m_pixels.data();
+
+    // Bands come in level order, and ParallelFor hands out indices in increasing order,
+    // so whatever a band waits for has already been picked up by another thread
+    auto shrinkBand = [&](size_t index)
+    {
+        const Band& band = bands[index];
+        const Level& src = levels[band.level - 1];
+        const Level& dst = levels[band.level];
+        const size_t srcFloats = size_t(src.width) * 4;
+        const size_t dstFloats = size_t(dst.width) * 4;
+
+        uint32_t first;
+        float weights[3];
+        if (band.level > 1)
+        {
+            const uint32_t lastRow = band.firstRow + band.rows - 1;
+            const int taps = Taps(src.height, lastRow, first, weights);
+            const uint32_t lastSrcRow = first + taps - 1;
+            Taps(src.height, band.firstRow, first, weights);
+            for (uint32_t b = first / src.bandRows; b <= lastSrcRow / src.bandRows; ++b)
+            {
+                while (!done[src.firstBand + b].load(std::memory_order_acquire))
+                    std::this_thread::yield();
+            }
+        }
+
+        std::vector<float> decoded(band.level == 1 ? srcFloats * 3 : 0);
+        std::vector<float> column(srcFloats);
+        std::vector<float> straight(dstFloats);
+
+        for (uint32_t y = band.firstRow; y < band.firstRow + band.rows; ++y)
+        {
+            const int taps = Taps(src.height, y, first, weights);
+            const float* rows[3];
+            for (int k = 0; k < taps; ++k)
+            {
+                if (band.level == 1)
+                {
+                    DecodeRow(pixels + size_t(first + k) * pitch, table, src.width, decoded.data() + k * srcFloats);
+                    rows[k] = decoded.data() + k * srcFloats;
+                }
+                else
+                {
+                    rows[k] = linear + src.linearOffset + (first + k) * srcFloats;
+                }
+            }
+
+            float* out = linear + dst.linearOffset + y * dstFloats;
+            WeightRows(rows, weights, taps, srcFloats, column.data());
+            ShrinkRow(column.data(), src.width, dst.width, out);
+
+            Unpremultiply(out, dst.width, straight.data());
+            uint8_t* outBytes = bytes + dst.byteOffset + y * dstFloats;
+            if (srgb)
+                LinearToSrgbRgba(straight.data(), outBytes, dst.width);
+            else
+                EncodeUnorm(straight.data(), outBytes, dstFloats);
+        }
+
+        done[index].store(true, std::memory_order_release);
+    };
+
+    if (pool)
+        pool->ParallelFor(bands.size(), shrinkBand);
+    else
+        for (size_t i = 0; i < bands.size(); ++i)
+            shrinkBand(i);
+
+    m_subresources.reserve(levels.size());
+    m_subresources.push_back({ pixels, pitch, pitch * height });
+    for (size_t l = 1; l < levels.size(); ++l)
+    {
+        const uint32_t rowPitch = levels[l].width * 4;
+        m_subresources.push_back({ bytes + levels[l].byteOffset, rowPitch, rowPitch * levels[l].height });
+    }
+    return true;
+}
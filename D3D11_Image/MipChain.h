@@ -0,0 +1,54 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: MipChain.h
+//
+// Builds the full mip chain below a decoded RGBA8 image on the CPU, for
+// textures that don't come with their own levels. Every level halves the one
+// above it, rounding down as Direct3D does, and each output texel is the area
+// average of the texels it covers: a 2x2 box on even sizes and three weighted
+// taps per axis on odd ones, so no row or column of a non-power-of-two image
+// is dropped.
+//
+// Filtering happens on linear values (through the sRGB curve when the
+// texture is _SRGB) with alpha premultiplied, so dark and transparent texels
+// don't bleed into their neighbours; the levels are stored unpremultiplied
+// again, like the source. Levels are worked on in bands of rows on a thread
+// pool, and a band starts as soon as the rows it reads from the level above
+// are done, so small levels overlap the large ones instead of waiting.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "DdsLoader.h"
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Class declarations
+//-----------------------------------------------------------------------------
+
+class MipChain
+{
+public:
+    // Level 0 is `pixels` itself and is not copied, so it has to outlive the chain. The
+    // channel order doesn't matter as long as alpha comes last.
+    bool Generate(const uint8_t* pixels, uint32_t pitch, uint32_t width, uint32_t height, bool srgb,
+                  ThreadPool* pool = nullptr);
+
+    uint32_t Levels() const { return static_cast<uint32_t>(m_subresources.size()); }
+
+    // One entry per level, largest first, ready for CreateTexture2D
+    const DdsSubresource* Subresources() const { return m_subresources.data(); }
+
+private:
+    std::vector<uint8_t>        m_pixels;       // levels 1 and below
+    std::vector<float>          m_linear;       // the same, linear and premultiplied
+    std::vector<DdsSubresource> m_subresources;
+};
@@ -0,0 +1,395 @@
+//-----------------------------------------------------------------------------
+// File: PngDecodeBench.cpp
+//
+// Headless benchmark for PNG loading through stb_image, not part of the
+// application build. Builds a corpus of RGB and RGBA PNGs from a synthetic
+// desktop and a photo-like frame, each with every row using one filter type
+// and once with adaptive filters, plus any PNG files named on the command
+// line. Every file is decoded with the generic C loops, then with the SSE2
+// unfilter kernels, then with those and the table-driven inflate, to 4
+// channels and to its own channel count. The results have to be identical,
+// and the RGBA files have to give back the source. Then zlib streams of
+// slices of the frames, at every level and strategy and with bits flipped or
+// cut short, go through both inflate loops, which have to agree on the
+// output and on which streams they reject.
+//
+//   g++ -std=c++14 -O2 PngDecodeBench.cpp -lz -o pngdecodebench
+//   ./pngdecodebench [width] [height] [runs] [file.png ...]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "../D3D11_Screenshot/BenchImage.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_TEST_HOOKS // SetDecoder switches the decoders through these
+#include "stb_image.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Smooth gradients under fine noise, hard on every filter the way photos are
+    std::vector<uint8_t> MakePhoto(uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> bgra(size_t(width) * height * 4);
+        std::mt19937 rng(7);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint8_t* p = &bgra[(size_t(y) * width + x) * 4];
+                p[0] = uint8_t((x * 255 / width + (rng() & 7)) & 0xff);
+                p[1] = uint8_t((y * 255 / height + (rng() & 7)) & 0xff);
+                p[2] = uint8_t(((x + y) * 128 / (width + height) + 64 + (rng() & 15)) & 0xff);
+                p[3] = uint8_t(255 - ((x ^ y) & 0x3f));
+            }
+        }
+        return bgra;
+    }
+
+    uint8_t Paeth(int a, int b, int c)
+    {
+        const int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        return uint8_t(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+    }
+
+    void Filter(int type, const uint8_t* cur, const uint8_t* prev, size_t bytes, int bpp, uint8_t* out)
+    {
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            const int a = i >= size_t(bpp) ? cur[i - bpp] : 0, b = prev[i], c = i >= size_t(bpp) ? prev[i - bpp] : 0;
+            int predicted = 0;
+            switch (type)
+            {
+            case 1: predicted = a; break;
+            case 2: predicted = b; break;
+            case 3: predicted = (a + b) >> 1; break;
+            case 4: predicted = Paeth(a, b, c); break;
+            }
+            out[i] = uint8_t(cur[i] - predicted);
+        }
+    }
+
+    void AppendChunk(std::vector<uint8_t>& png, const char* type, const uint8_t* data, size_t size)
+    {
+        const uint8_t length[4] = { uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size) };
+        png.insert(png.end(), length, length + 4);
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data, data + size);
+        uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+        crc = crc32(crc, data, uInt(size));
+        const uint8_t crcBytes[4] = { uint8_t(crc >> 24), uint8_t(crc >> 16), uint8_t(crc >> 8), uint8_t(crc) };
+        png.insert(png.end(), crcBytes, crcBytes + 4);
+    }
+
+    // Every row with filter `type`, or the one with the smallest sum of absolute values for -1
+    std::vector<uint8_t> WritePng(const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height, int channels, int type)
+    {
+        const size_t rowBytes = size_t(width) * channels;
+        std::vector<uint8_t> filtered((rowBytes + 1) * height), prev(rowBytes, 0), cur(rowBytes), trial(rowBytes);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const uint8_t* p = &bgra[(size_t(y) * width + x) * 4];
+                uint8_t* q = &cur[size_t(x) * channels];
+                q[0] = p[2];
+                q[1] = p[1];
+                q[2] = p[0];
+                if (channels == 4)
+                    q[3] = p[3];
+            }
+
+            uint8_t* out = &filtered[y * (rowBytes + 1)];
+            int chosen = type;
+            if (type < 0)
+            {
+                uint64_t best = UINT64_MAX;
+                for (int t = 0; t < 5; ++t)
+                {
+                    Filter(t, cur.data(), prev.data(), rowBytes, channels, trial.data());
+                    uint64_t sum = 0;
+                    for (uint8_t v : trial)
+                        sum += v < 128 ? v : 256 - v;
+                    if (sum < best)
+                    {
+                        best = sum;
+                        chosen = t;
+                    }
+                }
+            }
+            out[0] = uint8_t(chosen);
+            Filter(chosen, cur.data(), prev.data(), rowBytes, channels, out + 1);
+            prev.swap(cur);
+        }
+
+        std::vector<uint8_t> zlib(compressBound(uLong(filtered.size())));
+        uLongf zlibSize = uLongf(zlib.size());
+        compress2(zlib.data(), &zlibSize, filtered.data(), uLong(filtered.size()), 6);
+
+        static const uint8_t SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        const uint8_t header[13] =
+        {
+            uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+            uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+            8, uint8_t(channels == 4 ? 6 : 2), 0, 0, 0,
+        };
+        std::vector<uint8_t> png(SIGNATURE, SIGNATURE + 8);
+        AppendChunk(png, "IHDR", header, sizeof(header));
+        AppendChunk(png, "IDAT", zlib.data(), zlibSize);
+        AppendChunk(png, "IEND", nullptr, 0);
+        return png;
+    }
+
+    // Options seen by every decode after the call
+    void SetDecoder(bool simdUnfilter, bool fastInflate)
+    {
+#ifdef STBI_SSE2
+        stbi__png_simd_global = simdUnfilter ? 1 : 0;
+#else
+        (void)simdUnfilter;
+#endif
+        stbi__zlib_fast_global = fastInflate ? 1 : 0;
+    }
+
+    // Both loops through the malloc and fixed buffer entry points; true if they agree
+    bool InflateSame(const std::vector<uint8_t>& stream, int parseHeader, int guess, int bufferSize, bool& rejected)
+    {
+        int lengths[2] = {};
+        char* outputs[2] = {};
+        int results[2] = {};
+        std::vector<char> buffers[2];
+        for (int fast = 0; fast < 2; ++fast)
+        {
+            SetDecoder(true, fast != 0);
+            outputs[fast] = stbi_zlib_decode_malloc_guesssize_headerflag(reinterpret_cast<const char*>(stream.data()),
+                                                                         int(stream.size()), guess, &lengths[fast], parseHeader);
+            buffers[fast].resize(size_t(bufferSize) + 1);
+            results[fast] = parseHeader ?
+                stbi_zlib_decode_buffer(buffers[fast].data(), bufferSize, reinterpret_cast<const char*>(stream.data()), int(stream.size())) :
+                stbi_zlib_decode_noheader_buffer(buffers[fast].data(), bufferSize, reinterpret_cast<const char*>(stream.data()), int(stream.size()));
+        }
+        bool same = !outputs[0] == !outputs[1] && results[0] == results[1];
+        if (same && outputs[0])
+            same = lengths[0] == lengths[1] && memcmp(outputs[0], outputs[1], size_t(lengths[0])) == 0;
+        if (same && results[0] > 0)
+            same = memcmp(buffers[0].data(), buffers[1].data(), size_t(results[0])) == 0;
+        rejected = !outputs[0];
+        STBI_FREE(outputs[0]);
+        STBI_FREE(outputs[1]);
+        return same;
+    }
+
+    // Random slices of the frames as zlib or raw deflate streams, some of them damaged
+    bool FuzzInflate(const std::vector<uint8_t>& desktop, const std::vector<uint8_t>& photo, int streams)
+    {
+        static const int STRATEGIES[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED };
+        std::mt19937 rng(11);
+        int rejected = 0, mismatches = 0;
+        for (int i = 0; i < streams; ++i)
+        {
+            const std::vector<uint8_t>& image = i & 1 ? photo : desktop;
+            const size_t size = (rng() % 4 ? rng() % 4096 : rng() % 262144) % image.size();
+            const size_t start = rng() % (image.size() - size);
+            const bool raw = rng() % 4 == 0;
+
+            z_stream z = {};
+            deflateInit2(&z, int(rng() % 10), Z_DEFLATED, raw ? -15 : 15, 8, STRATEGIES[rng() % 5]);
+            std::vector<uint8_t> stream(deflateBound(&z, uLong(size)));
+            z.next_in = const_cast<Bytef*>(&image[start]);
+            z.avail_in = uInt(size);
+            z.next_out = stream.data();
+            z.avail_out = uInt(stream.size());
+            deflate(&z, Z_FINISH);
+            stream.resize(z.total_out);
+            deflateEnd(&z);
+
+            switch (rng() % 3)
+            {
+            case 1:
+                for (uint32_t flips = 1 + rng() % 4; flips > 0; --flips)
+                    stream[rng() % stream.size()] ^= uint8_t(1 << (rng() % 8));
+                break;
+            case 2:
+                stream.resize(rng() % stream.size());
+                break;
+            }
+
+            bool both = false;
+            const int bufferSize = rng() % 2 ? int(size) : int(rng() % (size + 512));
+            if (!InflateSame(stream, raw ? 0 : 1, 1 + int(rng() % (size + 64)), bufferSize, both))
+                ++mismatches;
+            rejected += both ? 1 : 0;
+        }
+        printf("\ninflate fuzz: %d streams, %d rejected by both loops, %d mismatches\n", streams, rejected, mismatches);
+        return mismatches == 0;
+    }
+
+    struct Decoded
+    {
+        std::vector<uint8_t> pixels;
+        int width = 0, height = 0, channels = 0;
+    };
+
+    // Best time of `runs` decodes to `components` channels (0 for the file's own)
+    double Decode(const std::vector<uint8_t>& png, int components, int runs, Decoded& decoded)
+    {
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            int w = 0, h = 0, n = 0;
+            const auto start = std::chrono::steady_clock::now();
+            stbi_uc* pixels = stbi_load_from_memory(png.data(), int(png.size()), &w, &h, &n, components);
+            best = std::min(best, MillisecondsSince(start));
+            if (!pixels)
+                return -1.0;
+            decoded.width = w;
+            decoded.height = h;
+            decoded.channels = components ? components : n;
+            decoded.pixels.assign(pixels, pixels + size_t(w) * h * decoded.channels);
+            stbi_image_free(pixels);
+        }
+        return best;
+    }
+
+    bool ReadFile(const char* path, std::vector<uint8_t>& data)
+    {
+        FILE* file = fopen(path, "rb");
+        if (!file)
+            return false;
+        uint8_t buffer[65536];
+        for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+            data.insert(data.end(), buffer, buffer + read);
+        fclose(file);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t width = argc > 1 ? uint32_t(atoi(argv[1])) : 3840;
+    const uint32_t height = argc > 2 ? uint32_t(atoi(argv[2])) : 2160;
+    const int runs = argc > 3 ? std::max(1, atoi(argv[3])) : 3;
+
+    if (width < 64 || height < 64)
+    {
+        printf("the test frames need at least 64x64 pixels\n");
+        return 1;
+    }
+#ifndef STBI_SSE2
+    printf("stb_image was built without SSE2, there is nothing to compare\n");
+    return 1;
+#else
+
+    struct Entry
+    {
+        std::string name;
+        std::vector<uint8_t> png;
+        const std::vector<uint8_t>* source;     // BGRA the file was written from, null for files read in
+        int channels;
+    };
+    std::vector<Entry> corpus;
+
+    const std::vector<uint8_t> desktop = MakeDesktop(width, height);
+    const std::vector<uint8_t> photo = MakePhoto(width, height);
+    static const char* const FILTERS[] = { "none", "sub", "up", "avg", "paeth" };
+    for (const std::vector<uint8_t>* image : { &desktop, &photo })
+    {
+        for (int channels : { 3, 4 })
+        {
+            for (int type = -1; type < 5; ++type)
+            {
+                Entry entry;
+                entry.name = std::string(image == &desktop ? "desktop " : "photo ") + (channels == 4 ? "rgba " : "rgb ") +
+                             (type < 0 ? "adaptive" : FILTERS[type]);
+                entry.png = WritePng(*image, width, height, channels, type);
+                entry.source = image;
+                entry.channels = channels;
+                corpus.push_back(std::move(entry));
+            }
+        }
+    }
+    for (int i = 4; i < argc; ++i)
+    {
+        Entry entry;
+        entry.name = argv[i];
+        entry.source = nullptr;
+        entry.channels = 0;
+        if (!ReadFile(argv[i], entry.png))
+        {
+            printf("can't read %s\n", argv[i]);
+            return 1;
+        }
+        corpus.push_back(std::move(entry));
+    }
+
+    printf("%ux%u synthetic frames, best of %d\n\n", width, height, runs);
+    printf("%-24s %5s %9s %10s %10s %10s %8s\n", "file", "comp", "KiB", "scalar ms", "sse2 ms", "+inflate", "speedup");
+
+    bool allOk = true;
+    double scalarTotal = 0.0, simdTotal = 0.0, fastTotal = 0.0;
+    for (const Entry& entry : corpus)
+    {
+        for (int components : { 4, 0 })
+        {
+            Decoded scalar, simd, fast;
+            SetDecoder(false, false);
+            const double scalarMs = Decode(entry.png, components, runs, scalar);
+            SetDecoder(true, false);
+            const double simdMs = Decode(entry.png, components, runs, simd);
+            SetDecoder(true, true);
+            const double fastMs = Decode(entry.png, components, runs, fast);
+
+            bool ok = scalarMs >= 0.0 && simdMs >= 0.0 && fastMs >= 0.0 && scalar.pixels == simd.pixels &&
+                      scalar.pixels == fast.pixels && scalar.width == simd.width && scalar.height == simd.height &&
+                      scalar.channels == simd.channels;
+
+            // The synthetic RGBA files have to give back their source exactly
+            if (ok && entry.source && entry.channels == 4 && components == 4)
+            {
+                for (size_t i = 0; ok && i < size_t(width) * height; ++i)
+                {
+                    const uint8_t* p = &(*entry.source)[i * 4];
+                    const uint8_t* q = &simd.pixels[i * 4];
+                    ok = q[0] == p[2] && q[1] == p[1] && q[2] == p[0] && q[3] == p[3];
+                }
+            }
+
+            printf("%-24s %5s %9zu %10.2f %10.2f %10.2f ", entry.name.c_str(), components ? "4" : "own",
+                   entry.png.size() / 1024, scalarMs, simdMs, fastMs);
+            if (ok)
+                printf("%7.2fx\n", scalarMs / fastMs);
+            else
+                printf("%8s\n", "MISMATCH");
+            allOk = allOk && ok;
+            scalarTotal += scalarMs;
+            simdTotal += simdMs;
+            fastTotal += fastMs;
+        }
+    }
+
+    printf("\n%-24s %5s %9s %10.1f %10.1f %10.1f %7.2fx\n", "total", "", "", scalarTotal, simdTotal, fastTotal,
+           scalarTotal / fastTotal);
+
+    allOk = FuzzInflate(desktop, photo, 4000) && allOk;
+    return allOk ? 0 : 1;
+#endif
+}
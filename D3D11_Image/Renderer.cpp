@@ -5,6 +5,9 @@
 #include <d3dcompiler.h>
 
 #include "Renderer.h"
+#include "DdsLoader.h"
+#include "MipChain.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -110,50 +113,90 @@ void Renderer::CreateDeviceDependentResources()
     m_offset = 0;
     m_numVertices = sizeof(vertexData) / m_stride;
 
-    // Load image
-
-    int ImageWidth;
-    int ImageHeight;
-    int ImageChannels;
-    int ImageDesiredChannels = 4;
-
-    unsigned char* ImageData = stbi_load("dx11.png",
-        &ImageWidth,
-        &ImageHeight,
-        &ImageChannels, ImageDesiredChannels);
-    assert(ImageData);
-    int aaa = sizeof(*ImageData);
-    int ImagePitch = ImageWidth * 4;
-
-    // Texture
-
-    D3D11_TEXTURE2D_DESC ImageTextureDesc = {};
-
-    ImageTextureDesc.Width = ImageWidth;
-    ImageTextureDesc.Height = ImageHeight;
-    ImageTextureDesc.MipLevels = 1;
-    ImageTextureDesc.ArraySize = 1;
-    ImageTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
-    ImageTextureDesc.SampleDesc.Count = 1;
-    ImageTextureDesc.SampleDesc.Quality = 0;
-    ImageTextureDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    ImageTextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-
-    D3D11_SUBRESOURCE_DATA ImageSubresourceData = {};
-
-    ImageSubresourceData.pSysMem = ImageData;
-    ImageSubresourceData.SysMemPitch = ImagePitch;
-
-    ID3D11Texture2D* ImageTexture;
-
-    hr = device->CreateTexture2D(&ImageTextureDesc,
-        &ImageSubresourceData,
-        &ImageTexture
-    );
-
-    assert(SUCCEEDED(hr));
-
-    free(ImageData);
+    // Load image: a DDS next to the executable is used in place without decoding;
+    // otherwise the PNG is decoded. The shader samples a Texture2D, so cubemaps and
+    // arrays are left to the PNG as well.
+
+    ID3D11Texture2D* ImageTexture = nullptr;
+
+    DdsFile ImageFile;
+    if (ImageFile.Open("dx11.dds") && !ImageFile.Image().cubemap && ImageFile.Image().arraySize == 1)
+    {
+        const DdsImage& Image = ImageFile.Image();
+
+        D3D11_TEXTURE2D_DESC ImageTextureDesc = {};
+
+        ImageTextureDesc.Width = Image.width;
+        ImageTextureDesc.Height = Image.height;
+        ImageTextureDesc.MipLevels = Image.mipLevels;
+        ImageTextureDesc.ArraySize = 1;
+        ImageTextureDesc.Format = static_cast<DXGI_FORMAT>(Image.dxgiFormat);
+        ImageTextureDesc.SampleDesc.Count = 1;
+        ImageTextureDesc.SampleDesc.Quality = 0;
+        ImageTextureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        ImageTextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        // The subresource table already points into the mapped file
+        static_assert(sizeof(DdsSubresource) == sizeof(D3D11_SUBRESOURCE_DATA), "DdsSubresource layout");
+        hr = device->CreateTexture2D(&ImageTextureDesc,
+            reinterpret_cast<const D3D11_SUBRESOURCE_DATA*>(Image.subresources.data()),
+            &ImageTexture
+        );
+
+        if (FAILED(hr))
+            ImageTexture = nullptr;
+    }
+
+    if (!ImageTexture)
+    {
+        int ImageWidth;
+        int ImageHeight;
+        int ImageChannels;
+        int ImageDesiredChannels = 4;
+
+        unsigned char* ImageData = stbi_load("dx11.png",
+            &ImageWidth,
+            &ImageHeight,
+            &ImageChannels, ImageDesiredChannels);
+        assert(ImageData);
+        int ImagePitch = ImageWidth * 4;
+
+        // The PNG has no mip levels of its own; without them the trilinear sampler
+        // aliases as soon as the image is drawn smaller than it is
+
+        ThreadPool MipPool;
+        MipChain ImageMips;
+        ImageMips.Generate(ImageData, ImagePitch, ImageWidth, ImageHeight, true, &MipPool);
+
+        // Texture
+
+        D3D11_TEXTURE2D_DESC ImageTextureDesc = {};
+
+        ImageTextureDesc.Width = ImageWidth;
+        ImageTextureDesc.Height = ImageHeight;
+        ImageTextureDesc.MipLevels = ImageMips.Levels() ? ImageMips.Levels() : 1;
+        ImageTextureDesc.ArraySize = 1;
+        ImageTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        ImageTextureDesc.SampleDesc.Count = 1;
+        ImageTextureDesc.SampleDesc.Quality = 0;
+        ImageTextureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        ImageTextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        D3D11_SUBRESOURCE_DATA ImageSubresourceData = {};
+
+        ImageSubresourceData.pSysMem = ImageData;
+        ImageSubresourceData.SysMemPitch = ImagePitch;
+
+        hr = device->CreateTexture2D(&ImageTextureDesc,
+            ImageMips.Levels() ? reinterpret_cast<const D3D11_SUBRESOURCE_DATA*>(ImageMips.Subresources())
+                               : &ImageSubresourceData,
+            &ImageTexture
+        );
+
+        assert(SUCCEEDED(hr));
+
+        free(ImageData);
+    }
 
     // Shader resource view
 
@@ -257,7 +257,9 @@ RECENT REVISION HISTORY:
 //
 // The JPEG decoder will try to automatically use SIMD kernels on x86 when
 // supported by the compiler. For ARM Neon support, you must explicitly
-// request it.
+// request it. The PNG decoder undoes the Sub, Up, Average and Paeth filters
+// of 8-bit images with 3 or 4 channels with SSE2 kernels on x86; they give
+// exactly the same bytes as the generic C loops.
 //
 // (The old do-it-yourself SIMD API is no longer supported in the current
 // code.)
@@ -641,12 +643,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned long long stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -748,7 +752,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -759,7 +763,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -4082,6 +4086,7 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
 //      - fast huffman
+//      - table-driven inner loop on a 64-bit bit buffer, see stbi__parse_huffman_fast
 
 #ifndef STBI_NO_ZLIB
 
@@ -4090,6 +4095,10 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
+// tables for the bulk decoder, looked up with the next 12 or 10 bits of input
+#define STBI__ZFAST_LENGTH_BITS    12
+#define STBI__ZFAST_DISTANCE_BITS  10
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -4184,6 +4193,9 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+   // bulk decoder tables, on the heap as they'd add 20KB to the stack
+   stbi__uint32 *zfast_length;   // 1 << STBI__ZFAST_LENGTH_BITS entries
+   stbi__uint32 *zfast_distance; // 1 << STBI__ZFAST_DISTANCE_BITS entries
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
@@ -4292,11 +4304,272 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+#ifdef STBI_TEST_HOOKS
+// benchmarks clear this to time and check the one-symbol-at-a-time decoder
+static int stbi__zlib_fast_global = 1;
+#else
+#define stbi__zlib_fast_global 1
+#endif
+
+// Bulk decoder. Each entry of the length table covers one code of up to
+// STBI__ZFAST_LENGTH_BITS bits, or two literal codes that fit together:
+//    bits  0- 4  bits used by the entry
+//    bits  5- 7  STBI__ZFAST_* kind, 0 when the code is longer or invalid
+//    bits  8-15  literal, or number of extra bits of a length
+//    bits 16-24  second literal of a pair, or length base
+//    bits 25-29  bits used by the first literal of a pair
+// A distance entry is the code size in bits 0-4, the number of extra bits
+// in bits 5-8 and the distance base in bits 16-31.
+#define STBI__ZFAST_LITERAL   1
+#define STBI__ZFAST_LITERAL2  2
+#define STBI__ZFAST_MATCH     3
+#define STBI__ZFAST_END       4
+
+// stop STBI__ZOUT_MARGIN bytes before the end of the output, matches are
+// copied in 8-byte pieces and can write up to 7 bytes past their end
+#define STBI__ZOUT_MARGIN  (258 + 8)
+// and 16 bytes before the end of the input, so the bits the slow decoder
+// would have buffered at the same point are never past the end either
+#define STBI__ZIN_MARGIN   16
+
+static stbi__uint32 stbi__zfast_length_entry(int sym, int size)
+{
+   if (sym < 256)
+      return size | (STBI__ZFAST_LITERAL << 5) | (sym << 8);
+   if (sym == 256)
+      return size | (STBI__ZFAST_END << 5);
+   if (sym < 286)
+      return size | (STBI__ZFAST_MATCH << 5) | (stbi__zlength_extra[sym-257] << 8) | ((stbi__uint32) stbi__zlength_base[sym-257] << 16);
+   return 0; // length codes 286 and 287 must not appear in compressed data
+}
+
+static stbi__uint32 stbi__zfast_distance_entry(int sym, int size)
+{
+   if (sym < 30)
+      return size | (stbi__zdist_extra[sym] << 5) | ((stbi__uint32) stbi__zdist_base[sym] << 16);
+   return 0; // distance codes 30 and 31 must not appear in compressed data
+}
+
+// sizelist has to have passed stbi__zbuild_huffman
+static void stbi__zbuild_fast(stbi__uint32 *fast, int bits, const stbi_uc *sizelist, int num, int length)
+{
+   int i,j,code, next_code[16], sizes[16];
+   memset(sizes, 0, sizeof(sizes));
+   memset(fast, 0, sizeof(*fast) << bits);
+   for (i=0; i < num; ++i)
+      ++sizes[sizelist[i]];
+   sizes[0] = 0;
+   code = 0;
+   for (i=1; i < 16; ++i) {
+      next_code[i] = code;
+      code = (code + sizes[i]) << 1;
+   }
+   for (i=0; i < num; ++i) {
+      int s = sizelist[i];
+      if (s) {
+         stbi__uint32 v = length ? stbi__zfast_length_entry(i, s) : stbi__zfast_distance_entry(i, s);
+         if (s <= bits && v) {
+            for (j = stbi__bit_reverse(next_code[s],s); j < (1 << bits); j += (1 << s))
+               fast[j] = v;
+         }
+         ++next_code[s];
+      }
+   }
+   if (length) {
+      // pair up literals whose codes fit in the table together; going down
+      // means the entry for the second code hasn't been paired yet
+      for (j=(1 << bits)-1; j >= 0; --j) {
+         stbi__uint32 v = fast[j], w;
+         int s1 = v & 31;
+         if (((v >> 5) & 7) != STBI__ZFAST_LITERAL) continue;
+         w = fast[j >> s1];
+         if (((w >> 5) & 7) != STBI__ZFAST_LITERAL || s1 + (int) (w & 31) > bits) continue;
+         fast[j] = (s1 + (w & 31)) | (STBI__ZFAST_LITERAL2 << 5) | (v & 0xff00) | ((w & 0xff00) << 8) | ((stbi__uint32) s1 << 25);
+      }
+   }
+}
+
+// stbi__zhuffman_decode on a code buffer holding at least 16 bits, without consuming them
+static int stbi__zhuffman_peek(stbi__zhuffman *z, stbi__uint32 code_buffer, int *size)
+{
+   int b,s,k;
+   b = z->fast[code_buffer & STBI__ZFAST_MASK];
+   if (b) {
+      *size = b >> 9;
+      return b & 511;
+   }
+   k = stbi__bit_reverse(code_buffer & 0xffff, 16);
+   for (s=STBI__ZFAST_BITS+1; ; ++s)
+      if (k < z->maxcode[s])
+         break;
+   if (s >= 16) return -1;
+   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   if (b >= STBI__ZNSYMS) return -1;
+   if (z->size[b] != s) return -1;
+   *size = s;
+   return z->value[b];
+}
+
+stbi_inline static stbi__uint64 stbi__zload64(const stbi_uc *p)
+{
+   stbi__uint64 v;
+#if defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM64) || defined(__i386__) || defined(__x86_64__) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+   memcpy(&v, p, 8);
+#else
+   int i;
+   v = 0;
+   for (i=7; i >= 0; --i)
+      v = (v << 8) | p[i];
+#endif
+   return v;
+}
+
+// num_bits of the slow decoder after it takes n bits, when it would have
+// refilled below `need` bits
+stbi_inline static int stbi__zslow_bits(int num_bits, int need, int n)
+{
+   if (num_bits < need)
+      num_bits += ((24 - num_bits) & ~7) + 8;
+   return num_bits - n;
+}
+
+// Decodes symbols while there are STBI__ZIN_MARGIN bytes of input and
+// STBI__ZOUT_MARGIN bytes of output left, one refill of a 64-bit buffer per
+// symbol. Returns 1 at the end of the block. Otherwise it stops before the
+// symbol it can't take and leaves the stream exactly as stbi__zhuffman_decode
+// and stbi__zreceive would have, so stbi__parse_huffman_block carries on
+// with that symbol and reports any error in it the same way.
+static int stbi__parse_huffman_fast(stbi__zbuf *a)
+{
+   stbi_uc *in = a->zbuffer;
+   char *zout = a->zout;
+   stbi__uint64 bits = a->code_buffer;
+   int nbits = a->num_bits;
+   int slow_bits = a->num_bits; // the slow decoder's num_bits at the same position
+   int done = 0, k;
+
+   if (a->zbuffer_end - in < STBI__ZIN_MARGIN || a->zout_end - zout < STBI__ZOUT_MARGIN || (bits >> nbits) != 0)
+      return 0;
+
+   while (a->zbuffer_end - in >= STBI__ZIN_MARGIN && a->zout_end - zout >= STBI__ZOUT_MARGIN) {
+      stbi__uint64 saved_bits;
+      stbi_uc *saved_in;
+      stbi__uint32 e;
+      int saved_nbits, saved_slow_bits, s, sym, extra, len, dist;
+
+      // 56 to 63 bits, enough for the longest length and distance with extra bits
+      bits |= stbi__zload64(in) << nbits;
+      in += (63 - nbits) >> 3;
+      nbits |= 56;
+      saved_bits = bits; saved_in = in; saved_nbits = nbits; saved_slow_bits = slow_bits;
+
+      e = a->zfast_length[bits & ((1 << STBI__ZFAST_LENGTH_BITS) - 1)];
+      if (!e) {
+         sym = stbi__zhuffman_peek(&a->z_length, (stbi__uint32) bits, &s);
+         if (sym < 0 || !(e = stbi__zfast_length_entry(sym, s))) break;
+      }
+      s = e & 31;
+      bits >>= s;
+      nbits -= s;
+      if (((e >> 5) & 7) == STBI__ZFAST_LITERAL) {
+         slow_bits = stbi__zslow_bits(slow_bits, 16, s);
+         *zout++ = (char) (e >> 8);
+         continue;
+      }
+      if (((e >> 5) & 7) == STBI__ZFAST_LITERAL2) {
+         k = e >> 25;
+         slow_bits = stbi__zslow_bits(slow_bits, 16, k);
+         slow_bits = stbi__zslow_bits(slow_bits, 16, s - k);
+         zout[0] = (char) (e >> 8);
+         zout[1] = (char) (e >> 16);
+         zout += 2;
+         continue;
+      }
+      slow_bits = stbi__zslow_bits(slow_bits, 16, s);
+      if (((e >> 5) & 7) == STBI__ZFAST_END) {
+         done = 1;
+         break;
+      }
+
+      // length, then distance
+      len = e >> 16;
+      extra = (e >> 8) & 31;
+      if (extra) {
+         len += (int) (bits & ((1 << extra) - 1));
+         bits >>= extra;
+         nbits -= extra;
+         slow_bits = stbi__zslow_bits(slow_bits, extra, extra);
+      }
+      e = a->zfast_distance[bits & ((1 << STBI__ZFAST_DISTANCE_BITS) - 1)];
+      if (!e) {
+         sym = stbi__zhuffman_peek(&a->z_distance, (stbi__uint32) bits, &s);
+         if (sym < 0 || !(e = stbi__zfast_distance_entry(sym, s))) {
+            bits = saved_bits; in = saved_in; nbits = saved_nbits; slow_bits = saved_slow_bits;
+            break;
+         }
+      }
+      s = e & 31;
+      bits >>= s;
+      nbits -= s;
+      slow_bits = stbi__zslow_bits(slow_bits, 16, s);
+      dist = e >> 16;
+      extra = (e >> 5) & 15;
+      if (extra) {
+         dist += (int) (bits & ((1 << extra) - 1));
+         bits >>= extra;
+         nbits -= extra;
+         slow_bits = stbi__zslow_bits(slow_bits, extra, extra);
+      }
+      if (zout - a->zout_start < dist) {
+         bits = saved_bits; in = saved_in; nbits = saved_nbits; slow_bits = saved_slow_bits;
+         break;
+      }
+
+      {
+         char *q = zout, *end = zout + len;
+         const char *p = zout - dist;
+         if (dist == 1) {
+            memset(q, *p, len);
+         } else {
+            if (dist < 8) {
+               // the first 8 bytes one at a time, then whole repeats of the
+               // pattern at least 8 bytes back
+               for (k=0; k < 8; ++k)
+                  q[k] = p[k];
+               q += 8;
+               p = q - dist * ((8 + dist - 1) / dist);
+            }
+            for (; q < end; q += 8, p += 8)
+               memcpy(q, p, 8);
+         }
+         zout = end;
+      }
+   }
+
+   // give back whole bytes that are buffered but not used, then take the
+   // ones the slow decoder would have buffered
+   in -= nbits >> 3;
+   nbits &= 7;
+   bits &= (1 << nbits) - 1;
+   for (k=0; nbits + 8*k < slow_bits; ++k)
+      bits |= (stbi__uint64) in[k] << (nbits + 8*k);
+   a->zbuffer = in + k;
+   a->code_buffer = (stbi__uint32) bits;
+   a->num_bits = slow_bits;
+   a->zout = zout;
+   return done;
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+      a->zout = zout;
+      if (stbi__zlib_fast_global && stbi__parse_huffman_fast(a)) return 1;
+      zout = a->zout;
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4382,6 +4655,8 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
    if (n != ntot) return stbi__err("bad codelengths","Corrupt PNG");
    if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
    if (!stbi__zbuild_huffman(&a->z_distance, lencodes+hlit, hdist)) return 0;
+   stbi__zbuild_fast(a->zfast_length, STBI__ZFAST_LENGTH_BITS, lencodes, hlit, 1);
+   stbi__zbuild_fast(a->zfast_distance, STBI__ZFAST_DISTANCE_BITS, lencodes+hlit, hdist, 0);
    return 1;
 }
 
@@ -4476,6 +4751,8 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
             // use fixed code lengths
             if (!stbi__zbuild_huffman(&a->z_length  , stbi__zdefault_length  , STBI__ZNSYMS)) return 0;
             if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance,  32)) return 0;
+            stbi__zbuild_fast(a->zfast_length, STBI__ZFAST_LENGTH_BITS, stbi__zdefault_length, STBI__ZNSYMS, 1);
+            stbi__zbuild_fast(a->zfast_distance, STBI__ZFAST_DISTANCE_BITS, stbi__zdefault_distance, 32, 0);
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
@@ -4487,12 +4764,20 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
 
 static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse_header)
 {
+   int result;
    a->zout_start = obuf;
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
 
-   return stbi__parse_zlib(a, parse_header);
+   a->zfast_length = (stbi__uint32 *) stbi__malloc(sizeof(stbi__uint32) * ((1 << STBI__ZFAST_LENGTH_BITS) + (1 << STBI__ZFAST_DISTANCE_BITS)));
+   if (a->zfast_length == NULL) return stbi__err("outofmem", "Out of memory");
+   a->zfast_distance = a->zfast_length + (1 << STBI__ZFAST_LENGTH_BITS);
+
+   result = stbi__parse_zlib(a, parse_header);
+   STBI_FREE(a->zfast_length);
+   a->zfast_length = a->zfast_distance = NULL;
+   return result;
 }
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen)
@@ -4644,6 +4929,114 @@ static int stbi__paeth(int a, int b, int c)
    return c;
 }
 
+#ifdef STBI_SSE2
+#ifdef STBI_TEST_HOOKS
+// benchmarks clear this to time and check the generic C unfiltering
+static int stbi__png_simd_global = 1;
+#else
+#define stbi__png_simd_global 1
+#endif
+
+// 3-byte pixels are put together in a register: copying them through memory
+// stalls on store forwarding
+static __m128i stbi__png_load_pixel(const stbi_uc *p, int n)
+{
+   stbi__uint32 v;
+   if (n == 4) memcpy(&v, p, 4);
+   else        v = p[0] | (p[1] << 8) | ((stbi__uint32) p[2] << 16);
+   return _mm_cvtsi32_si128((int) v);
+}
+
+static void stbi__png_store_pixel(stbi_uc *p, __m128i x, int n)
+{
+   stbi__uint32 v = (stbi__uint32) _mm_cvtsi128_si32(x);
+   if (n == 4) memcpy(p, &v, 4);
+   else {
+      p[0] = STBI__BYTECAST(v);
+      p[1] = STBI__BYTECAST(v >> 8);
+      p[2] = STBI__BYTECAST(v >> 16);
+   }
+}
+
+// Sub, Average and Paeth depend on the pixel to the left, so these work on one
+// pixel of 3 or 4 bytes at a time, all its channels at once. Up has no such
+// dependency and takes 16 bytes at a time when the row isn't being expanded.
+// Every pixel but the last is read and written as 4 bytes (in_n, px_n): the
+// byte after a 3-byte pixel belongs to the next one, which is done right after.
+// 'cur', 'raw' and 'prior' point at the second pixel of the row; 'out_n' is
+// img_n, or 4 for RGB expanded to RGBA with alpha 255.
+static int stbi__png_unfilter_row_sse2(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, stbi__uint32 pixels, int filter, int img_n, int out_n)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i alpha = _mm_cvtsi32_si128(out_n != img_n ? (int) 0xff000000 : 0);
+   __m128i one = _mm_set1_epi8(1);
+   __m128i a = stbi__png_load_pixel(cur - out_n, out_n); // the pixel to the left
+   __m128i c;
+   stbi__uint32 i;
+
+   switch (filter) {
+      case STBI__F_sub:
+      case STBI__F_paeth_first: // Paeth with nothing above always picks the left pixel
+         for (i=0; i < pixels; ++i, raw+=img_n, cur+=out_n) {
+            int in_n = i+1 < pixels ? 4 : img_n, px_n = i+1 < pixels ? 4 : out_n;
+            a = _mm_or_si128(_mm_add_epi8(stbi__png_load_pixel(raw, in_n), a), alpha);
+            stbi__png_store_pixel(cur, a, px_n);
+         }
+         break;
+      case STBI__F_up:
+         if (img_n == out_n) {
+            stbi__uint32 n = pixels*img_n, k = 0;
+            for (; k + 16 <= n; k += 16)
+               _mm_storeu_si128((__m128i *) (cur+k), _mm_add_epi8(_mm_loadu_si128((__m128i *) (raw+k)), _mm_loadu_si128((__m128i *) (prior+k))));
+            for (; k < n; ++k)
+               cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+         } else {
+            for (i=0; i < pixels; ++i, raw+=img_n, cur+=out_n, prior+=out_n) {
+               int in_n = i+1 < pixels ? 4 : img_n;
+               __m128i b = stbi__png_load_pixel(prior, 4);
+               stbi__png_store_pixel(cur, _mm_or_si128(_mm_add_epi8(stbi__png_load_pixel(raw, in_n), b), alpha), 4);
+            }
+         }
+         break;
+      case STBI__F_avg:
+      case STBI__F_avg_first:
+         for (i=0; i < pixels; ++i, raw+=img_n, cur+=out_n, prior+=out_n) {
+            int in_n = i+1 < pixels ? 4 : img_n, px_n = i+1 < pixels ? 4 : out_n;
+            // (a + b) >> 1 without overflow: pavgb rounds up, so take back the odd bit
+            __m128i b = filter == STBI__F_avg ? stbi__png_load_pixel(prior, px_n) : zero;
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_or_si128(_mm_add_epi8(stbi__png_load_pixel(raw, in_n), avg), alpha);
+            stbi__png_store_pixel(cur, a, px_n);
+         }
+         break;
+      case STBI__F_paeth:
+         c = stbi__png_load_pixel(prior - out_n, out_n); // above the pixel to the left
+         for (i=0; i < pixels; ++i, raw+=img_n, cur+=out_n, prior+=out_n) {
+            int in_n = i+1 < pixels ? 4 : img_n, px_n = i+1 < pixels ? 4 : out_n;
+            // stbi__paeth on 16-bit lanes: pa = |b-c|, pb = |a-c|, pc = |a+b-2c|, and the
+            // first of a, b, c whose distance is the smallest
+            __m128i b = stbi__png_load_pixel(prior, px_n);
+            __m128i a16 = _mm_unpacklo_epi8(a, zero), b16 = _mm_unpacklo_epi8(b, zero), c16 = _mm_unpacklo_epi8(c, zero);
+            __m128i pa = _mm_sub_epi16(b16, c16), pb = _mm_sub_epi16(a16, c16);
+            __m128i pc = _mm_add_epi16(pa, pb), smallest, pred;
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            pred = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi16(pb, smallest), b16), _mm_andnot_si128(_mm_cmpeq_epi16(pb, smallest), c16));
+            pred = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi16(pa, smallest), a16), _mm_andnot_si128(_mm_cmpeq_epi16(pa, smallest), pred));
+            a = _mm_or_si128(_mm_add_epi8(stbi__png_load_pixel(raw, in_n), _mm_packus_epi16(pred, zero)), alpha);
+            stbi__png_store_pixel(cur, a, px_n);
+            c = b;
+         }
+         break;
+      default:
+         return 0;
+   }
+   return 1;
+}
+#endif
+
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // create the png data from post-deflated data
@@ -4659,6 +5052,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+#ifdef STBI_SSE2
+   int simd = depth == 8 && (img_n == 3 || img_n == 4) && stbi__png_simd_global && stbi__sse2_available();
+#endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
    a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4725,6 +5121,13 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          prior += 1;
       }
 
+#ifdef STBI_SSE2
+      if (simd && stbi__png_unfilter_row_sse2(cur, raw, prior, x-1, filter, img_n, out_n)) {
+         raw += (x-1)*img_n;
+         continue;
+      }
+#endif
+
       // this is a little gross, so that we don't switch per-pixel or per-component
       if (depth < 8 || img_n == out_n) {
          int nk = (width - 1)*filter_bytes;
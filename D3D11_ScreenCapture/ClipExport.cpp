@@ -0,0 +1,898 @@
+#include "ClipExport.h"
+#include "FileIo.h"
+#include "RawDump.h"
+#include "ThreadPool.h"
+#include "../D3D11_Screenshot/PngEncoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <vector>
+
+namespace
+{
+    const uint32_t BAND_ROWS = 64;              // rows per task; fixed so the output doesn't depend on the pool
+    const uint32_t HISTOGRAM_BINS = 1 << 15;    // 5 bits per channel
+    const uint8_t  GIF_TRANSPARENT = 255;
+    const size_t   FRAMES_IN_FLIGHT = 4;        // frames being coded on the pool while the next is prepared
+
+    struct Rect
+    {
+        uint32_t x, y, width, height;
+    };
+
+    // A frame of the dump, top row first
+    struct FrameView
+    {
+        const uint8_t* pixels;
+        ptrdiff_t      pitch;
+
+        const uint32_t* Row(uint32_t y) const
+        {
+            return reinterpret_cast<const uint32_t*>(pixels + ptrdiff_t(y) * pitch);
+        }
+    };
+
+    // BGRA words; the alpha of a captured desktop means nothing
+    inline bool SameColor(uint32_t a, uint32_t b)
+    {
+        return ((a ^ b) & 0x00ffffff) == 0;
+    }
+
+    inline uint32_t BinOf(uint32_t r, uint32_t g, uint32_t b)
+    {
+        return (r >> 3) << 10 | (g >> 3) << 5 | (b >> 3);
+    }
+
+    inline int Clamp255(int v)
+    {
+        return v < 0 ? 0 : (v > 255 ? 255 : v);
+    }
+
+    //-------------------------------------------------------------------------
+    // What changed since the previous frame
+    //-------------------------------------------------------------------------
+    Rect ChangedRect(const FrameView& prev, const FrameView& cur, uint32_t width, uint32_t height, ThreadPool& pool)
+    {
+        const size_t bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+        std::vector<Rect> found(bands);     // x, y = min corner, width, height = max corner + 1; empty if x == width
+        pool.ParallelFor(bands, [&](size_t band)
+        {
+            Rect r = { width, 0, 0, 0 };
+            const uint32_t last = std::min(height, uint32_t(band + 1) * BAND_ROWS);
+            for (uint32_t y = uint32_t(band) * BAND_ROWS; y < last; ++y)
+            {
+                const uint32_t* a = prev.Row(y);
+                const uint32_t* b = cur.Row(y);
+                if (memcmp(a, b, size_t(width) * 4) == 0)
+                    continue;
+
+                uint32_t left = 0, right = width;
+                while (left < width && SameColor(a[left], b[left]))
+                    ++left;
+                if (left == width)
+                    continue;   // only alpha differs
+                while (SameColor(a[right - 1], b[right - 1]))
+                    --right;
+
+                if (r.x == width)
+                    r.y = y;
+                r.x = std::min(r.x, left);
+                r.width = std::max(r.width, right);
+                r.height = y + 1;
+            }
+            found[band] = r;
+        });
+
+        Rect total = { width, height, 0, 0 };
+        for (const Rect& r : found)
+        {
+            if (r.x == width)
+                continue;
+            total.x = std::min(total.x, r.x);
+            total.y = std::min(total.y, r.y);
+            total.width = std::max(total.width, r.width);
+            total.height = std::max(total.height, r.height);
+        }
+        if (total.x == width)
+            return Rect{ 0, 0, 0, 0 };
+        return Rect{ total.x, total.y, total.width - total.x, total.height - total.y };
+    }
+
+    //-------------------------------------------------------------------------
+    // Palettes
+    //-------------------------------------------------------------------------
+    struct BinColor
+    {
+        float    c[3];      // mean R, G, B of the pixels in the bin
+        uint32_t count;
+        uint32_t bin;
+    };
+
+    // Histogram of the changed pixels of `rect`; unchanged ones will be transparent
+    std::vector<BinColor> BuildHistogram(const FrameView* prev, const FrameView& cur, const Rect& rect, ThreadPool& pool)
+    {
+        // Every part counts into its own table; the low three bits of each channel are
+        // summed so the mean colour of a bin is exact
+        const size_t bands = (rect.height + BAND_ROWS - 1) / BAND_ROWS;
+        const size_t parts = std::min<size_t>(bands, pool.Size());
+        std::vector<uint32_t> tables(parts * HISTOGRAM_BINS * 4);
+        pool.ParallelFor(parts, [&](size_t part)
+        {
+            uint32_t* table = &tables[part * HISTOGRAM_BINS * 4];
+            for (size_t band = part; band < bands; band += parts)
+            {
+                const uint32_t last = std::min(rect.height, uint32_t(band + 1) * BAND_ROWS);
+                for (uint32_t y = uint32_t(band) * BAND_ROWS; y < last; ++y)
+                {
+                    const uint32_t* row = cur.Row(rect.y + y) + rect.x;
+                    const uint32_t* old = prev ? prev->Row(rect.y + y) + rect.x : nullptr;
+                    for (uint32_t x = 0; x < rect.width; ++x)
+                    {
+                        const uint32_t px = row[x];
+                        if (old && SameColor(px, old[x]))
+                            continue;
+                        const uint32_t r = (px >> 16) & 0xff, g = (px >> 8) & 0xff, b = px & 0xff;
+                        uint32_t* entry = table + size_t(BinOf(r, g, b)) * 4;
+                        entry[0] += 1;
+                        entry[1] += r & 7;
+                        entry[2] += g & 7;
+                        entry[3] += b & 7;
+                    }
+                }
+            }
+        });
+
+        std::vector<BinColor> colors;
+        for (uint32_t bin = 0; bin < HISTOGRAM_BINS; ++bin)
+        {
+            uint32_t sums[4] = { 0, 0, 0, 0 };
+            for (size_t part = 0; part < parts; ++part)
+            {
+                const uint32_t* entry = &tables[(part * HISTOGRAM_BINS + bin) * 4];
+                for (int i = 0; i < 4; ++i)
+                    sums[i] += entry[i];
+            }
+            if (sums[0] == 0)
+                continue;
+
+            BinColor color;
+            color.count = sums[0];
+            color.bin = bin;
+            const uint32_t base[3] = { (bin >> 10) << 3, ((bin >> 5) & 31) << 3, (bin & 31) << 3 };
+            for (int i = 0; i < 3; ++i)
+                color.c[i] = float(base[i]) + float(sums[i + 1]) / float(sums[0]);
+            colors.push_back(color);
+        }
+        return colors;
+    }
+
+    // Nearest colours are looked up per cell of 4x4x4 histogram bins: a colour that is
+    // farther from the cell than another colour's farthest point of it can't win anywhere
+    // inside, so only the remaining few are searched for the 64 bins
+    const uint32_t CELLS = 512;
+
+    struct Palette
+    {
+        uint8_t  colors[256][3];    // R, G, B
+        uint32_t size;
+        uint64_t id;                // changes whenever the colours do
+        double   error;             // on the pixels it was cut for
+        std::vector<uint8_t> nearest;   // palette index of every histogram bin
+
+        Palette() : colors(), size(0), id(0), error(0.0), nearest(HISTOGRAM_BINS) {}
+
+        // Fills `nearest` for every bin centre, one cell per task
+        void Index(ThreadPool& pool)
+        {
+            pool.ParallelFor(CELLS, [&](size_t cell)
+            {
+                const int base[3] = { int(cell >> 6) * 32, int((cell >> 3) & 7) * 32, int(cell & 7) * 32 };
+
+                // Bin centres run from base + 4 to base + 28
+                uint32_t closest = ~0u;
+                uint32_t nearDistance[256];
+                for (uint32_t i = 0; i < size; ++i)
+                {
+                    uint32_t nearSum = 0, farSum = 0;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        const int lo = base[c] + 4 - colors[i][c], hi = base[c] + 28 - colors[i][c];
+                        const int nearAxis = lo > 0 ? lo : (hi < 0 ? -hi : 0);
+                        const int farAxis = std::max(std::abs(lo), std::abs(hi));
+                        nearSum += uint32_t(nearAxis * nearAxis);
+                        farSum += uint32_t(farAxis * farAxis);
+                    }
+                    nearDistance[i] = nearSum;
+                    closest = std::min(closest, farSum);
+                }
+
+                uint8_t candidates[256];
+                uint32_t count = 0;
+                for (uint32_t i = 0; i < size; ++i)
+                {
+                    if (nearDistance[i] <= closest)
+                        candidates[count++] = uint8_t(i);
+                }
+
+                for (uint32_t bin = 0; bin < 64; ++bin)
+                {
+                    const int r = base[0] + int(bin >> 4) * 8 + 4, g = base[1] + int((bin >> 2) & 3) * 8 + 4, b = base[2] + int(bin & 3) * 8 + 4;
+                    uint32_t best = candidates[0], bestDistance = ~0u;
+                    for (uint32_t k = 0; k < count; ++k)
+                    {
+                        const uint8_t* p = colors[candidates[k]];
+                        const int dr = r - p[0], dg = g - p[1], db = b - p[2];
+                        const uint32_t distance = uint32_t(dr * dr + dg * dg + db * db);
+                        if (distance < bestDistance)
+                        {
+                            bestDistance = distance;
+                            best = candidates[k];
+                        }
+                    }
+                    nearest[BinOf(uint32_t(r), uint32_t(g), uint32_t(b))] = uint8_t(best);
+                }
+            });
+        }
+
+        // Mean squared RGB error of the histogram mapped through the lookup
+        double Error(const std::vector<BinColor>& histogram) const
+        {
+            double total = 0.0;
+            uint64_t pixels = 0;
+            for (const BinColor& color : histogram)
+            {
+                const uint8_t* p = colors[nearest[color.bin]];
+                double distance = 0.0;
+                for (int i = 0; i < 3; ++i)
+                    distance += (color.c[i] - p[i]) * (color.c[i] - p[i]);
+                total += distance * color.count;
+                pixels += color.count;
+            }
+            return pixels ? total / double(pixels) : 0.0;
+        }
+    };
+
+    // Median cut: the box with the largest squared error is split at the weighted median
+    // of its widest axis, until there are `maxColors` boxes or none can be split
+    void MedianCut(std::vector<BinColor>& colors, uint32_t maxColors, Palette& palette)
+    {
+        struct Box
+        {
+            size_t begin, end;
+            double error;
+            int    axis;
+            float  mean[3];
+        };
+
+        auto measure = [&](size_t begin, size_t end)
+        {
+            Box box = { begin, end, 0.0, 0, { 0.0f, 0.0f, 0.0f } };
+            double count = 0.0, sum[3] = { 0.0, 0.0, 0.0 }, squares[3] = { 0.0, 0.0, 0.0 };
+            for (size_t i = begin; i < end; ++i)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    sum[c] += double(colors[i].c[c]) * colors[i].count;
+                    squares[c] += double(colors[i].c[c]) * colors[i].c[c] * colors[i].count;
+                }
+                count += colors[i].count;
+            }
+            double widest = -1.0;
+            for (int c = 0; c < 3; ++c)
+            {
+                const double variance = squares[c] - sum[c] * sum[c] / count;
+                box.mean[c] = float(sum[c] / count);
+                box.error += variance;
+                if (variance > widest)
+                {
+                    widest = variance;
+                    box.axis = c;
+                }
+            }
+            if (end - begin < 2)
+                box.error = 0.0;
+            return box;
+        };
+
+        std::vector<Box> boxes;
+        if (!colors.empty())
+            boxes.push_back(measure(0, colors.size()));
+        while (boxes.size() < maxColors)
+        {
+            auto worst = std::max_element(boxes.begin(), boxes.end(), [](const Box& a, const Box& b) { return a.error < b.error; });
+            if (worst == boxes.end() || worst->error <= 0.0)
+                break;
+
+            const Box box = *worst;
+            const int axis = box.axis;
+            std::sort(colors.begin() + box.begin, colors.begin() + box.end, [axis](const BinColor& a, const BinColor& b)
+            {
+                return a.c[axis] < b.c[axis] || (a.c[axis] == b.c[axis] && a.bin < b.bin);
+            });
+
+            uint64_t total = 0, below = 0;
+            for (size_t i = box.begin; i < box.end; ++i)
+                total += colors[i].count;
+            size_t split = box.begin + 1;
+            for (size_t i = box.begin; i + 1 < box.end; ++i)
+            {
+                below += colors[i].count;
+                split = i + 1;
+                if (below * 2 >= total)
+                    break;
+            }
+
+            *worst = measure(box.begin, split);
+            boxes.push_back(measure(split, box.end));
+        }
+
+        palette.size = uint32_t(std::max<size_t>(1, boxes.size()));
+        memset(palette.colors, 0, sizeof(palette.colors));
+        for (size_t i = 0; i < boxes.size(); ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                palette.colors[i][c] = uint8_t(Clamp255(int(boxes[i].mean[c] + 0.5f)));
+        }
+        ++palette.id;
+    }
+
+    //-------------------------------------------------------------------------
+    // Mapping to palette indices
+    //-------------------------------------------------------------------------
+    const int BAYER8[8][8] =
+    {
+        {  0, 32,  8, 40,  2, 34, 10, 42 },
+        { 48, 16, 56, 24, 50, 18, 58, 26 },
+        { 12, 44,  4, 36, 14, 46,  6, 38 },
+        { 60, 28, 52, 20, 62, 30, 54, 22 },
+        {  3, 35, 11, 43,  1, 33,  9, 41 },
+        { 51, 19, 59, 27, 49, 17, 57, 25 },
+        { 15, 47,  7, 39, 13, 45,  5, 37 },
+        { 63, 31, 55, 23, 61, 29, 53, 21 },
+    };
+
+    // Rows [first, last) of `rect`; unchanged pixels become transparent if there is a `prev`
+    void MapBand(const FrameView* prev, const FrameView& cur, const Rect& rect, uint32_t first, uint32_t last,
+                 const Palette& palette, ClipDither dither, uint8_t* indices)
+    {
+        // Floyd-Steinberg error of this row and the next, one pixel of margin each side
+        std::vector<int> errors;
+        if (dither == ClipDither::FloydSteinberg)
+            errors.assign(size_t(rect.width + 2) * 3 * 2, 0);
+
+        for (uint32_t y = first; y < last; ++y)
+        {
+            const uint32_t* row = cur.Row(rect.y + y) + rect.x;
+            const uint32_t* old = prev ? prev->Row(rect.y + y) + rect.x : nullptr;
+            uint8_t* out = indices + size_t(y) * rect.width;
+            int* error = errors.empty() ? nullptr : &errors[size_t(y - first) % 2 * (rect.width + 2) * 3];
+            int* below = errors.empty() ? nullptr : &errors[size_t(y - first + 1) % 2 * (rect.width + 2) * 3];
+            if (below)
+                std::fill(below, below + size_t(rect.width + 2) * 3, 0);
+
+            for (uint32_t x = 0; x < rect.width; ++x)
+            {
+                const uint32_t px = row[x];
+                if (old && SameColor(px, old[x]))
+                {
+                    out[x] = GIF_TRANSPARENT;
+                    continue;
+                }
+
+                int c[3] = { int((px >> 16) & 0xff), int((px >> 8) & 0xff), int(px & 0xff) };
+                if (dither == ClipDither::Ordered)
+                {
+                    const int offset = (BAYER8[(rect.y + y) & 7][(rect.x + x) & 7] - 32) / 4;
+                    for (int i = 0; i < 3; ++i)
+                        c[i] = Clamp255(c[i] + offset);
+                }
+                else if (error)
+                {
+                    // Errors are kept in sixteenths
+                    for (int i = 0; i < 3; ++i)
+                        c[i] = Clamp255(c[i] + (error[(x + 1) * 3 + i] + 8) / 16);
+                }
+
+                const uint32_t index = uint32_t(palette.nearest[BinOf(uint32_t(c[0]), uint32_t(c[1]), uint32_t(c[2]))]);
+                out[x] = uint8_t(index);
+
+                if (error)
+                {
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        const int e = c[i] - palette.colors[index][i];
+                        error[(x + 2) * 3 + i] += e * 7;
+                        below[x * 3 + i] += e * 3;
+                        below[(x + 1) * 3 + i] += e * 5;
+                        below[(x + 2) * 3 + i] += e;
+                    }
+                }
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // GIF LZW, 8-bit codes, packed into sub-blocks
+    //-------------------------------------------------------------------------
+    class LzwWriter
+    {
+    public:
+        explicit LzwWriter(std::vector<uint8_t>& out) : m_out(out), m_bits(0), m_count(0) {}
+
+        void Put(uint32_t code, uint32_t length)
+        {
+            m_bits |= code << m_count;
+            m_count += length;
+            for (; m_count >= 8; m_count -= 8, m_bits >>= 8)
+                m_bytes.push_back(uint8_t(m_bits));
+        }
+
+        // Flushes the last bits and cuts the bytes into sub-blocks of up to 255
+        void Finish()
+        {
+            if (m_count > 0)
+                m_bytes.push_back(uint8_t(m_bits));
+            for (size_t at = 0; at < m_bytes.size(); at += 255)
+            {
+                const size_t size = std::min<size_t>(255, m_bytes.size() - at);
+                m_out.push_back(uint8_t(size));
+                m_out.insert(m_out.end(), m_bytes.begin() + at, m_bytes.begin() + at + size);
+            }
+            m_out.push_back(0);
+        }
+
+    private:
+        std::vector<uint8_t>& m_out;
+        std::vector<uint8_t> m_bytes;
+        uint32_t m_bits;
+        uint32_t m_count;
+    };
+
+    std::vector<uint8_t> LzwEncode(const std::vector<uint8_t>& indices)
+    {
+        const uint32_t CLEAR = 256, END = 257, MAX_CODE = 4095;
+        const uint32_t HASH_BITS = 13, HASH_SIZE = 1 << HASH_BITS;
+
+        std::vector<uint8_t> out;
+        out.reserve(indices.size() / 2 + 64);
+        out.push_back(8);   // minimum code size
+        LzwWriter writer(out);
+
+        // Open addressing over (prefix code, byte) + 1, so 0 marks a free slot
+        std::vector<uint32_t> keys(HASH_SIZE);
+        std::vector<uint16_t> codes(HASH_SIZE);
+        uint32_t next = END + 1, size = 9;
+        writer.Put(CLEAR, size);
+
+        uint32_t prefix = indices.empty() ? 0 : indices[0];
+        for (size_t i = 1; i < indices.size(); ++i)
+        {
+            const uint32_t key = (prefix << 8 | indices[i]) + 1;
+            uint32_t slot = (key * 2654435761u) >> (32 - HASH_BITS);
+            while (keys[slot] != 0 && keys[slot] != key)
+                slot = (slot + 1) & (HASH_SIZE - 1);
+            if (keys[slot] == key)
+            {
+                prefix = codes[slot];
+                continue;
+            }
+
+            writer.Put(prefix, size);
+            keys[slot] = key;
+            codes[slot] = uint16_t(next++);
+            if (next - 1 == MAX_CODE)
+            {
+                // Table full: start over; the decoder is one code behind and never reaches 13 bits
+                writer.Put(CLEAR, size);
+                std::fill(keys.begin(), keys.end(), 0u);
+                next = END + 1;
+                size = 9;
+            }
+            else if (next - 1 >= (1u << size))
+            {
+                ++size;
+            }
+            prefix = indices[i];
+        }
+
+        if (!indices.empty())
+        {
+            writer.Put(prefix, size);
+            // The decoder adds an entry for that last code and may widen before reading END
+            if (next >= (1u << size) && size < 12)
+                ++size;
+        }
+        writer.Put(END, size);
+        writer.Finish();
+        return out;
+    }
+
+    //-------------------------------------------------------------------------
+    // APNG pieces
+    //-------------------------------------------------------------------------
+
+    // Crops `rect` to a BGRA image with unchanged pixels fully transparent, encodes it
+    // and returns the contents of its IDAT chunks, a complete zlib stream
+    std::vector<uint8_t> DeflateRect(const FrameView* prev, const FrameView& cur, const Rect& rect, ThreadPool& pool)
+    {
+        std::vector<uint8_t> bgra(size_t(rect.width) * rect.height * 4);
+        for (uint32_t y = 0; y < rect.height; ++y)
+        {
+            const uint32_t* row = cur.Row(rect.y + y) + rect.x;
+            const uint32_t* old = prev ? prev->Row(rect.y + y) + rect.x : nullptr;
+            uint32_t* out = reinterpret_cast<uint32_t*>(&bgra[size_t(y) * rect.width * 4]);
+            for (uint32_t x = 0; x < rect.width; ++x)
+                out[x] = old && SameColor(row[x], old[x]) ? 0 : (row[x] | 0xff000000u);
+        }
+
+        std::vector<uint8_t> png;
+        const PngOptions options = { DeflateLevel::Fast, true, 0 };
+        std::vector<uint8_t> stream;
+        if (!EncodePng(bgra.data(), ptrdiff_t(rect.width) * 4, rect.width, rect.height, options, png, &pool))
+            return stream;
+
+        for (size_t at = 8; at + 12 <= png.size();)
+        {
+            const uint32_t length = uint32_t(png[at]) << 24 | uint32_t(png[at + 1]) << 16 | uint32_t(png[at + 2]) << 8 | png[at + 3];
+            if (memcmp(&png[at + 4], "IDAT", 4) == 0)
+                stream.insert(stream.end(), png.begin() + at + 8, png.begin() + at + 8 + length);
+            at += 12 + size_t(length);
+        }
+        return stream;
+    }
+
+    inline void PutBE32(uint8_t* p, uint32_t value)
+    {
+        p[0] = uint8_t(value >> 24);
+        p[1] = uint8_t(value >> 16);
+        p[2] = uint8_t(value >> 8);
+        p[3] = uint8_t(value);
+    }
+
+    inline void PutBE16(uint8_t* p, uint32_t value)
+    {
+        p[0] = uint8_t(value >> 8);
+        p[1] = uint8_t(value);
+    }
+
+    inline void PutLE16(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(uint8_t(value));
+        out.push_back(uint8_t(value >> 8));
+    }
+
+    //-------------------------------------------------------------------------
+    // Output file
+    //-------------------------------------------------------------------------
+    class ClipFile
+    {
+    public:
+        ClipFile() : m_file(nullptr), m_bytes(0), m_ok(true) {}
+        ~ClipFile() { Close(); }
+
+        bool Open(const char* path)
+        {
+            m_file = OpenFile(path, "wb");
+            return m_file != nullptr;
+        }
+
+        void Write(const uint8_t* data, size_t size)
+        {
+            if (size == 0)
+                return;
+            m_ok = m_ok && m_file && fwrite(data, 1, size, m_file) == size;
+            m_bytes += size;
+        }
+
+        void Write(const std::vector<uint8_t>& data) { Write(data.data(), data.size()); }
+
+        void WriteChunk(const char* type, const uint8_t* data, size_t size)
+        {
+            uint8_t header[8];
+            PutBE32(header, uint32_t(size));
+            memcpy(header + 4, type, 4);
+            Write(header, 8);
+            Write(data, size);
+            uint8_t crc[4];
+            PutBE32(crc, Crc32(Crc32(0, header + 4, 4), data, size));
+            Write(crc, 4);
+        }
+
+        // Rewrites `size` bytes at `offset`, then carries on at the end
+        void Patch(int64_t offset, const uint8_t* data, size_t size)
+        {
+            m_ok = m_ok && m_file && SeekFile(m_file, offset, SEEK_SET) && fwrite(data, 1, size, m_file) == size &&
+                   SeekFile(m_file, 0, SEEK_END);
+        }
+
+        bool Close()
+        {
+            if (m_file)
+            {
+                m_ok = fclose(m_file) == 0 && m_ok;
+                m_file = nullptr;
+            }
+            return m_ok;
+        }
+
+        uint64_t Bytes() const { return m_bytes; }
+
+    private:
+        FILE* m_file;
+        uint64_t m_bytes;
+        bool m_ok;
+    };
+
+    // A frame whose coding may still be running on the pool
+    struct PendingFrame
+    {
+        Rect     rect;
+        int64_t  timestamp;
+        bool     transparent;
+        bool     localPalette;
+        uint8_t  palette[256][3];
+        std::future<std::vector<uint8_t>> data;
+    };
+
+    const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    const int64_t ACTL_OFFSET = 8 + 12 + 13;    // right behind IHDR
+}
+
+bool ExportClip(const char* inPath, const char* outPath, size_t first, size_t count, const ClipExportOptions& options,
+                ClipExportStats* stats)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    RawDumpReader dump;
+    if (!dump.Open(inPath) || first >= dump.FrameCount())
+        return false;
+    count = std::min(count, dump.FrameCount() - first);
+    if (count == 0)
+        return false;
+
+    const RAWDUMP_HEADER& header = dump.Header();
+    const uint32_t width = header.width, height = header.height;
+    if (width == 0 || height == 0 || width > 65535 || height > 65535)
+        return false;
+
+    const bool bottomUp = (header.flags & RAWDUMP_FLAG_BOTTOM_UP) != 0;
+    auto frameAt = [&](size_t index, int64_t* timestamp)
+    {
+        const uint8_t* pixels = dump.Frame(index, timestamp);
+        if (bottomUp)
+            return FrameView{ pixels + size_t(height - 1) * header.rowPitch, -ptrdiff_t(header.rowPitch) };
+        return FrameView{ pixels, ptrdiff_t(header.rowPitch) };
+    };
+
+    ClipFile file;
+    if (!file.Open(outPath))
+        return false;
+
+    ThreadPool pool(options.threads);
+    const bool gif = options.format == ClipFormat::Gif;
+    const uint32_t maxColors = std::min(255u, std::max(2u, options.colors));
+
+    // Delays are rounded on the clip's own clock, so they add up to its length
+    int64_t startTime = 0;
+    frameAt(first, &startTime);
+    const int64_t timescale = header.timescale ? header.timescale : RAWDUMP_TIMESCALE;
+    auto ticks = [&](int64_t timestamp, int64_t units)
+    {
+        return ((timestamp - startTime) * units + timescale / 2) / timescale;
+    };
+
+    // Headers
+    if (gif)
+    {
+        std::vector<uint8_t> head = { 'G', 'I', 'F', '8', '9', 'a' };
+        PutLE16(head, width);
+        PutLE16(head, height);
+        head.insert(head.end(), { 0xf7, 0, 0 });    // global table of 256 colours follows later
+        file.Write(head);
+    }
+    else
+    {
+        file.Write(PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+        uint8_t ihdr[13] = {};
+        PutBE32(ihdr, width);
+        PutBE32(ihdr + 4, height);
+        ihdr[8] = 8;
+        ihdr[9] = 6;    // RGBA
+        file.WriteChunk("IHDR", ihdr, sizeof(ihdr));
+        const uint8_t actl[8] = {};     // frame count patched in at the end, loops forever
+        file.WriteChunk("acTL", actl, sizeof(actl));
+    }
+
+    Palette palette;
+    uint64_t globalPalette = 0;
+    uint32_t sequence = 0;
+    uint64_t written = 0, palettes = 0;
+    std::deque<PendingFrame> pending;
+
+    // Writes the oldest pending frame; it is shown until `until`
+    auto writeFrame = [&](int64_t until)
+    {
+        PendingFrame frame = std::move(pending.front());
+        pending.pop_front();
+        const std::vector<uint8_t> data = frame.data.get();
+        if (data.empty())
+            return false;
+
+        if (gif)
+        {
+            std::vector<uint8_t> block;
+            if (written == 0)
+            {
+                // The first palette is the global one, followed by the loop extension
+                block.insert(block.end(), &frame.palette[0][0], &frame.palette[0][0] + 768);
+                static const uint8_t LOOP[19] = { 0x21, 0xff, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0 };
+                block.insert(block.end(), LOOP, LOOP + sizeof(LOOP));
+            }
+
+            const int64_t delay = std::max<int64_t>(2, std::min<int64_t>(65535, ticks(until, 100) - ticks(frame.timestamp, 100)));
+            block.insert(block.end(), { 0x21, 0xf9, 4, uint8_t(1 << 2 | (frame.transparent ? 1 : 0)) });   // keep the frame underneath
+            PutLE16(block, uint32_t(delay));
+            block.insert(block.end(), { GIF_TRANSPARENT, 0 });
+
+            block.push_back(0x2c);
+            PutLE16(block, frame.rect.x);
+            PutLE16(block, frame.rect.y);
+            PutLE16(block, frame.rect.width);
+            PutLE16(block, frame.rect.height);
+            block.push_back(frame.localPalette ? 0x87 : 0);
+            if (frame.localPalette)
+                block.insert(block.end(), &frame.palette[0][0], &frame.palette[0][0] + 768);
+            file.Write(block);
+            file.Write(data);
+        }
+        else
+        {
+            const int64_t delay = std::max<int64_t>(0, std::min<int64_t>(65535, ticks(until, 1000) - ticks(frame.timestamp, 1000)));
+            uint8_t fctl[26] = {};
+            PutBE32(fctl, sequence++);
+            PutBE32(fctl + 4, frame.rect.width);
+            PutBE32(fctl + 8, frame.rect.height);
+            PutBE32(fctl + 12, frame.rect.x);
+            PutBE32(fctl + 16, frame.rect.y);
+            PutBE16(fctl + 20, uint32_t(delay));
+            PutBE16(fctl + 22, 1000);
+            fctl[24] = 0;                               // APNG_DISPOSE_OP_NONE
+            fctl[25] = frame.transparent ? 1 : 0;       // APNG_BLEND_OP_OVER over the frame underneath
+            file.WriteChunk("fcTL", fctl, sizeof(fctl));
+
+            if (written == 0)
+            {
+                file.WriteChunk("IDAT", data.data(), data.size());
+            }
+            else
+            {
+                std::vector<uint8_t> fdat(4);
+                PutBE32(fdat.data(), sequence++);
+                fdat.insert(fdat.end(), data.begin(), data.end());
+                file.WriteChunk("fdAT", fdat.data(), fdat.size());
+            }
+        }
+        ++written;
+        return true;
+    };
+
+    bool ok = true;
+    FrameView prev = {};
+    for (size_t i = first; ok && i < first + count; ++i)
+    {
+        int64_t timestamp = 0;
+        const FrameView cur = frameAt(i, &timestamp);
+        const bool key = i == first;
+        const Rect rect = key ? Rect{ 0, 0, width, height } : ChangedRect(prev, cur, width, height, pool);
+        if (rect.width == 0)
+            continue;   // a repeat: the frame before stays up longer
+        const FrameView before = prev;
+        const FrameView* base = key ? nullptr : &before;
+        prev = cur;
+
+        PendingFrame frame;
+        frame.rect = rect;
+        frame.timestamp = timestamp;
+        frame.transparent = !key;
+        frame.localPalette = false;
+
+        if (gif)
+        {
+            // Keep the palette while it fits the new pixels about as well as the ones it was cut
+            // for; otherwise cut a new one
+            std::vector<BinColor> histogram = BuildHistogram(base, cur, rect, pool);
+            if (palette.size == 0 || palette.Error(histogram) > palette.error + options.reuseError)
+            {
+                MedianCut(histogram, maxColors, palette);
+                palette.Index(pool);
+                palette.error = palette.Error(histogram);
+                ++palettes;
+                if (key)
+                    globalPalette = palette.id;
+            }
+
+            memcpy(frame.palette, palette.colors, sizeof(frame.palette));
+            frame.localPalette = palette.id != globalPalette;
+
+            std::vector<uint8_t> indices(size_t(rect.width) * rect.height);
+            const size_t bands = (rect.height + BAND_ROWS - 1) / BAND_ROWS;
+            pool.ParallelFor(bands, [&](size_t band)
+            {
+                MapBand(base, cur, rect, uint32_t(band) * BAND_ROWS, std::min(rect.height, uint32_t(band + 1) * BAND_ROWS),
+                        palette, options.dither, indices.data());
+            });
+
+            frame.data = pool.Submit([indices = std::move(indices)]() { return LzwEncode(indices); });
+        }
+        else
+        {
+            const FrameView current = cur;
+            const FrameView previous = base ? *base : FrameView{};
+            const bool hasBase = base != nullptr;
+            frame.data = pool.Submit([current, previous, hasBase, rect, &pool]()
+            {
+                return DeflateRect(hasBase ? &previous : nullptr, current, rect, pool);
+            });
+        }
+
+        pending.push_back(std::move(frame));
+        if (pending.size() > FRAMES_IN_FLIGHT)
+            ok = writeFrame(pending[1].timestamp);
+    }
+
+    // The last frame lasts until the next one in the dump, or as long as the one before it
+    int64_t end = 0;
+    if (first + count < dump.FrameCount())
+    {
+        frameAt(first + count, &end);
+    }
+    else
+    {
+        int64_t before = startTime, last = startTime;
+        frameAt(first + count - 1, &last);
+        if (count > 1)
+            frameAt(first + count - 2, &before);
+        end = last + (count > 1 ? last - before : timescale / 25);
+    }
+
+    while (ok && !pending.empty())
+        ok = writeFrame(pending.size() > 1 ? pending[1].timestamp : end);
+
+    // Nothing may still be reading the dump when it is unmapped
+    for (PendingFrame& frame : pending)
+        frame.data.wait();
+
+    if (gif)
+    {
+        const uint8_t trailer = 0x3b;
+        file.Write(&trailer, 1);
+    }
+    else
+    {
+        uint8_t actl[8] = {};
+        PutBE32(actl, uint32_t(written));
+        uint8_t chunk[20];
+        PutBE32(chunk, 8);
+        memcpy(chunk + 4, "acTL", 4);
+        memcpy(chunk + 8, actl, 8);
+        PutBE32(chunk + 16, Crc32(0, chunk + 4, 12));
+        file.Patch(ACTL_OFFSET, chunk, sizeof(chunk));
+        file.WriteChunk("IEND", nullptr, 0);
+    }
+    ok = file.Close() && ok;
+
+    if (stats)
+    {
+        stats->frames = count;
+        stats->writtenFrames = written;
+        stats->palettes = palettes;
+        stats->outputBytes = file.Bytes();
+        stats->threads = pool.Size();
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return ok;
+}
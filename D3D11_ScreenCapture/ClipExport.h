@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Exports a range of frames of a raw dump (RawDump.h) as an animated GIF or
+// APNG for sharing short clips.
+//
+// Only what changed is stored: every frame is compared with the one before,
+// cropped to the rectangle of changed pixels, and the pixels inside it that
+// didn't change are made transparent so they compress to almost nothing.
+// Frames identical to the one before just extend its display time.
+//
+// GIF needs a palette of at most 255 colours (index 255 is the transparent
+// one). It is built by median cut over a 5-bit-per-channel histogram of the
+// changed pixels; the current palette is kept for as long as it represents
+// the new pixels nearly as well as the ones it was built for, which saves the
+// work and avoids colour flicker on a mostly static screen. Dithering is optional: ordered (8x8 Bayer) or
+// Floyd-Steinberg error diffusion, which runs in independent 64-row bands.
+// APNG frames are lossless RGBA through PngEncoder.
+//
+// Histograms, pixel mapping and diffing are spread over a thread pool, and
+// the LZW or deflate coding of a frame runs on the pool while the next frame
+// is being prepared. The output doesn't depend on the thread count.
+
+enum class ClipFormat
+{
+    Gif,
+    Apng,
+};
+
+enum class ClipDither
+{
+    None,
+    Ordered,
+    FloydSteinberg,
+};
+
+struct ClipExportOptions
+{
+    ClipFormat format = ClipFormat::Gif;
+    ClipDither dither = ClipDither::None;
+    unsigned threads = 0;         // 0 - one per hardware thread
+    unsigned colors = 255;        // GIF palette size, 2 to 255
+    double reuseError = 24.0;     // mean squared RGB error the GIF palette may lose on new pixels before it's replaced
+};
+
+struct ClipExportStats
+{
+    uint64_t frames = 0;          // read from the dump
+    uint64_t writtenFrames = 0;   // after merging repeats
+    uint64_t palettes = 0;        // GIF palettes built
+    uint64_t outputBytes = 0;
+    unsigned threads = 0;
+    double seconds = 0.0;
+};
+
+// Exports `count` frames starting at `first` (clamped to the dump)
+bool ExportClip(const char* inPath, const char* outPath, size_t first, size_t count, const ClipExportOptions& options,
+                ClipExportStats* stats = nullptr);
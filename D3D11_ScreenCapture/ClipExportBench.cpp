@@ -0,0 +1,304 @@
+// ClipExportBench.cpp : speed and size of GIF and APNG clip export.
+//
+// Portable and not part of the recorder build, e.g. on Linux:
+//   g++ -std=c++14 -O2 -pthread ClipExportBench.cpp ClipExport.cpp RawDump.cpp MappedFile.cpp ThreadPool.cpp
+//       ../D3D11_Screenshot/PngEncoder.cpp ../D3D11_Screenshot/Deflate.cpp ../D3D11_Screenshot/Thumbnails.cpp
+//       ../D3D11_Screenshot/ImageMetrics.cpp ../D3D11_Screenshot/PixelConvert.cpp -o ClipExportBench
+//
+//   ClipExportBench [frames] [width] [height] [dump path]
+//
+// Records a synthetic clip at 25 fps into a raw dump: a window dragged across
+// the desktop, a caret typing, a progress bar and a small animated picture,
+// with the odd idle frame in between. The clip is exported as GIF with every
+// dither mode and as APNG, each timed end to end. The start of the GIF is
+// decoded again with stb_image and compared with the recording; its PSNR and
+// SSIM have to stay above the floor set for the dither mode. The APNG key
+// frame has to come back exactly.
+
+#include "ClipExport.h"
+#include "RawDump.h"
+#include "../D3D11_Screenshot/BenchImage.h"
+#include "../D3D11_Screenshot/ImageMetrics.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_GIF
+#define STBI_ONLY_PNG
+#include "../D3D11_Image/stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const uint32_t FPS = 25;
+    const size_t   CHECKED_FRAMES = 16;  // decoding the whole GIF with stb_image takes gigabytes
+
+    struct Rect
+    {
+        uint32_t x, y, w, h;
+    };
+
+    void Fill(std::vector<uint8_t>& frame, uint32_t width, const Rect& r, uint32_t color)
+    {
+        for (uint32_t y = r.y; y < r.y + r.h; ++y)
+            for (uint32_t x = r.x; x < r.x + r.w; ++x)
+                memcpy(&frame[(size_t(y) * width + x) * 4], &color, 4);
+    }
+
+    void Copy(std::vector<uint8_t>& frame, const std::vector<uint8_t>& from, uint32_t width, const Rect& r)
+    {
+        for (uint32_t y = r.y; y < r.y + r.h; ++y)
+            memcpy(&frame[(size_t(y) * width + r.x) * 4], &from[(size_t(y) * width + r.x) * 4], size_t(r.w) * 4);
+    }
+
+    // Frame `i` of the clip, drawn over the previous one
+    void Draw(std::vector<uint8_t>& frame, const std::vector<uint8_t>& desktop, uint32_t width, uint32_t height, uint32_t i)
+    {
+        // Every eighth frame nothing happens
+        if (i % 8 == 7)
+            return;
+
+        // The window moves right for the first half, the old place shows the desktop again
+        const uint32_t step = std::min(i, 125u);
+        const Rect window = { width / 10 + step * width / 500, height / 5, width / 3, height / 3 };
+        if (step > 0 && i <= 125)
+        {
+            const uint32_t oldX = width / 10 + (step - 1) * width / 500;
+            const Rect old = { oldX, window.y, window.x - oldX, window.h };
+            Copy(frame, desktop, width, old);
+        }
+        Fill(frame, width, window, 0xfff0f0f0);
+        Fill(frame, width, Rect{ window.x, window.y, window.w, 24 }, 0xff2b579a);
+
+        // Typing into the window
+        const uint32_t glyphs = i * 3 / 2;
+        const uint32_t perLine = (window.w - 32) / 10;
+        for (uint32_t g = 0; g < glyphs && g / perLine < (window.h - 48) / 16; ++g)
+            Fill(frame, width, Rect{ window.x + 16 + (g % perLine) * 10, window.y + 40 + (g / perLine) * 16, 7, 11 },
+                 0xff202020 + ((g * 37) & 0x3f));
+
+        // Progress bar at the bottom
+        const Rect bar = { width / 4, height * 7 / 8, width / 2, 12 };
+        Fill(frame, width, Rect{ bar.x, bar.y, bar.w * std::min(i, 249u) / 250, bar.h }, 0xff27ae60);
+
+        // A little animation: colours that drift with time
+        const Rect picture = { width * 3 / 5, height / 2, width / 5, height / 4 };
+        for (uint32_t y = 0; y < picture.h; ++y)
+        {
+            for (uint32_t x = 0; x < picture.w; ++x)
+            {
+                const uint32_t r = (x * 255 / picture.w + i * 3) & 0xff;
+                const uint32_t g = (y * 255 / picture.h + i * 5) & 0xff;
+                const uint32_t b = ((x + y) / 4 + i) & 0xff;
+                const uint32_t color = 0xff000000u | r << 16 | g << 8 | b;
+                memcpy(&frame[(size_t(picture.y + y) * width + picture.x + x) * 4], &color, 4);
+            }
+        }
+    }
+
+    // Measures a decoded RGBA frame against a recorded BGRA one
+    bool MeasureFrame(const stbi_uc* rgba, const std::vector<uint8_t>& frame, uint32_t width, uint32_t height,
+                      bool ssim, ImageQuality& quality)
+    {
+        std::vector<uint8_t> bgra(rgba, rgba + size_t(width) * height * 4);
+        for (size_t i = 0; i < size_t(width) * height; ++i)
+            std::swap(bgra[i * 4], bgra[i * 4 + 2]);
+
+        const ImageMetricsOptions options = { true, false, ssim, 0 };
+        return MeasureImages(frame.data(), ptrdiff_t(width) * 4, bgra.data(), ptrdiff_t(width) * 4, width, height, options,
+                             quality);
+    }
+
+    // PSNR over the first decoded frames of a GIF together, and their mean SSIM, against the
+    // recording; false if it doesn't decode
+    bool GifQuality(const char* path, const std::vector<std::vector<uint8_t>>& frames, uint32_t width, uint32_t height,
+                    ImageQuality& quality)
+    {
+        FILE* file = fopen(path, "rb");
+        if (!file)
+            return false;
+        std::vector<uint8_t> gif;
+        uint8_t buffer[65536];
+        for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+            gif.insert(gif.end(), buffer, buffer + read);
+        fclose(file);
+
+        // Only what stb_image needs for the checked frames: cut at the image descriptor after them
+        size_t images = 0, end = gif.size();
+        for (size_t at = 13 + 768; at < gif.size();)
+        {
+            if (gif[at] == 0x21)
+            {
+                at += 2;
+                while (at < gif.size() && gif[at] != 0)
+                    at += gif[at] + 1;
+                ++at;
+            }
+            else if (gif[at] == 0x2c)
+            {
+                if (images++ == frames.size())
+                {
+                    end = at;
+                    break;
+                }
+                at += 10 + ((gif[at + 9] & 0x80) ? 768 : 0) + 1;
+                while (at < gif.size() && gif[at] != 0)
+                    at += gif[at] + 1;
+                ++at;
+            }
+            else
+            {
+                break;
+            }
+        }
+        gif.resize(end);
+        gif.push_back(0x3b);
+
+        int* delays = nullptr;
+        int w = 0, h = 0, count = 0, channels = 0;
+        stbi_uc* pixels = stbi_load_gif_from_memory(gif.data(), int(gif.size()), &delays, &w, &h, &count, &channels, 4);
+        if (!pixels)
+        {
+            printf("  stb_image: %s\n", stbi_failure_reason());
+            return false;
+        }
+
+        bool ok = uint32_t(w) == width && uint32_t(h) == height && size_t(count) == frames.size();
+        double mse = 0.0, ssim = 0.0;
+        uint32_t maxAbsDiff = 0;
+        for (size_t f = 0; ok && f < frames.size(); ++f)
+        {
+            ImageQuality frame = {};
+            ok = MeasureFrame(pixels + f * width * height * 4, frames[f], width, height, true, frame);
+            mse += frame.mse;
+            ssim += frame.ssim;
+            maxAbsDiff = std::max(maxAbsDiff, frame.maxAbsDiff);
+        }
+        stbi_image_free(pixels);
+        stbi_image_free(delays);
+        if (!ok)
+            return false;
+
+        // Every frame has the same number of samples, so their mean MSE is the clip's
+        quality = ImageQuality();
+        quality.mse = mse / frames.size();
+        quality.psnr = quality.mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / quality.mse) : INFINITY;
+        quality.maxAbsDiff = maxAbsDiff;
+        quality.ssim = ssim / frames.size();
+        quality.msSsim = NAN;
+        return true;
+    }
+
+    // The default image of an APNG is its first frame
+    bool ApngKeyFrameMatches(const char* path, const std::vector<uint8_t>& frame, uint32_t width, uint32_t height)
+    {
+        int w = 0, h = 0, channels = 0;
+        stbi_uc* pixels = stbi_load(path, &w, &h, &channels, 4);
+        ImageQuality quality;
+        const bool same = pixels && uint32_t(w) == width && uint32_t(h) == height &&
+                          MeasureFrame(pixels, frame, width, height, false, quality) && quality.maxAbsDiff == 0;
+        stbi_image_free(pixels);
+        return same;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? uint32_t(atoi(argv[1])) : 250;
+    const uint32_t width = argc > 2 ? uint32_t(atoi(argv[2])) : 1920;
+    const uint32_t height = argc > 3 ? uint32_t(atoi(argv[3])) : 1080;
+    const std::string dumpPath = argc > 4 ? argv[4] : "ClipExportBench.raw";
+
+    if (frames < CHECKED_FRAMES || width < 320 || height < 240)
+    {
+        printf("needs at least %zu frames of 320x240\n", CHECKED_FRAMES);
+        return 1;
+    }
+
+    // Record the clip
+    const std::vector<uint8_t> desktop = MakeDesktop(width, height);
+    std::vector<uint8_t> frame = desktop;
+    std::vector<std::vector<uint8_t>> checked;
+    {
+        RawDumpWriter writer;
+        if (!writer.Open(dumpPath.c_str(), width, height, width * 4, 0))
+        {
+            printf("can't write %s\n", dumpPath.c_str());
+            return 1;
+        }
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            Draw(frame, desktop, width, height, i);
+            // Repeats are merged into the frame before, the GIF has one image less for each
+            if (checked.size() < CHECKED_FRAMES && (checked.empty() || frame != checked.back()))
+                checked.push_back(frame);
+            writer.WriteFrame(frame.data(), int64_t(i) * RAWDUMP_TIMESCALE / FPS);
+        }
+        writer.Close();
+    }
+
+    printf("%u frames of %ux%u (%.1f s of clip)\n\n", frames, width, height, double(frames) / FPS);
+    printf("%-16s %8s %8s %8s %9s %8s %9s %8s\n", "export", "s", "fps", "written", "palettes", "KiB", "PSNR dB",
+           "SSIM");
+
+    // The floors sit a little below what the clip scores at any size from 320x240 to 1080p
+    struct Variant
+    {
+        const char* name;
+        ClipFormat  format;
+        ClipDither  dither;
+        const char* extension;
+        double      minPsnr;
+        double      minSsim;
+    };
+    static const Variant VARIANTS[] =
+    {
+        { "gif",           ClipFormat::Gif,  ClipDither::None,           ".gif", 35.5, 0.975 },
+        { "gif ordered",   ClipFormat::Gif,  ClipDither::Ordered,        ".gif", 33.5, 0.905 },
+        { "gif fs",        ClipFormat::Gif,  ClipDither::FloydSteinberg, ".gif", 33.0, 0.930 },
+        { "apng",          ClipFormat::Apng, ClipDither::None,           ".png", INFINITY, 1.0 },
+    };
+
+    bool allOk = true;
+    for (const Variant& variant : VARIANTS)
+    {
+        ClipExportOptions options;
+        options.format = variant.format;
+        options.dither = variant.dither;
+        std::string outPath = "ClipExportBench " + std::string(variant.name) + variant.extension;
+        std::replace(outPath.begin(), outPath.end(), ' ', '_');
+
+        ClipExportStats stats;
+        if (!ExportClip(dumpPath.c_str(), outPath.c_str(), 0, frames, options, &stats))
+        {
+            printf("%-16s FAILED\n", variant.name);
+            allOk = false;
+            continue;
+        }
+
+        ImageQuality quality = { 0.0, INFINITY, 0, 1.0, 1.0 };
+        bool decoded;
+        if (variant.format == ClipFormat::Gif)
+            decoded = GifQuality(outPath.c_str(), checked, width, height, quality);
+        else
+            decoded = ApngKeyFrameMatches(outPath.c_str(), checked[0], width, height);
+
+        printf("%-16s %8.2f %8.1f %8llu %9llu %8llu ", variant.name, stats.seconds, stats.frames / stats.seconds,
+               (unsigned long long)stats.writtenFrames, (unsigned long long)stats.palettes,
+               (unsigned long long)(stats.outputBytes / 1024));
+        if (!decoded)
+            printf("%9s\n", "MISMATCH");
+        else
+            printf("%9.2f %8.5f%s\n", quality.psnr, quality.ssim,
+                   quality.psnr < variant.minPsnr || quality.ssim < variant.minSsim ? " BELOW FLOOR" : "");
+        allOk = allOk && decoded && quality.psnr >= variant.minPsnr && quality.ssim >= variant.minSsim;
+    }
+
+    remove(dumpPath.c_str());
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "CodecFile.h"
+#include "FileIo.h"
+
+#include <cstddef>
+
+//-----------------------------------------------------------------------------
+// Writer
+//-----------------------------------------------------------------------------
+CodecFileWriter::CodecFileWriter() : m_file(nullptr), m_header(), m_bytes(0)
+{
+}
+
+CodecFileWriter::~CodecFileWriter()
+{
+    Close();
+}
+
+bool CodecFileWriter::Open(const char* path, const CODECFILE_HEADER& header)
+{
+    Close();
+
+    m_file = OpenFile(path, "wb");
+    if (!m_file)
+        return false;
+
+    setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+
+    m_header = header;
+    m_header.magic = CODECFILE_MAGIC;
+    m_header.version = CODECFILE_VERSION;
+    m_header.frameCount = 0;
+    m_bytes = sizeof(m_header);
+
+    return fwrite(&m_header, sizeof(m_header), 1, m_file) == 1;
+}
+
+bool CodecFileWriter::WritePacket(const uint8_t* data, size_t size, int64_t timestamp, bool key)
+{
+    if (!m_file || size > UINT32_MAX)
+        return false;
+
+    CODECFILE_PACKET packet = {};
+    packet.timestamp = timestamp;
+    packet.size = static_cast<uint32_t>(size);
+    packet.flags = key ? CODECFILE_PACKET_KEY : 0;
+
+    if (fwrite(&packet, sizeof(packet), 1, m_file) != 1 || fwrite(data, 1, size, m_file) != size)
+        return false;
+
+    m_bytes += sizeof(packet) + size;
+    ++m_header.frameCount;
+    return true;
+}
+
+bool CodecFileWriter::Close()
+{
+    if (!m_file)
+        return true;
+
+    bool ok = SeekFile(m_file, offsetof(CODECFILE_HEADER, frameCount), SEEK_SET) &&
+        fwrite(&m_header.frameCount, sizeof(m_header.frameCount), 1, m_file) == 1;
+    ok = (fclose(m_file) == 0) && ok;
+    m_file = nullptr;
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// Reader
+//-----------------------------------------------------------------------------
+CodecFileReader::CodecFileReader() : m_file(nullptr), m_header()
+{
+}
+
+CodecFileReader::~CodecFileReader()
+{
+    Close();
+}
+
+bool CodecFileReader::Open(const char* path)
+{
+    Close();
+
+    m_file = OpenFile(path, "rb");
+    if (!m_file)
+        return false;
+
+    setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+
+    if (fread(&m_header, sizeof(m_header), 1, m_file) != 1 ||
+        m_header.magic != CODECFILE_MAGIC || m_header.version != CODECFILE_VERSION ||
+        m_header.width == 0 || m_header.height == 0 || m_header.rowPitch < m_header.width * 4u)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void CodecFileReader::Close()
+{
+    if (m_file)
+        fclose(m_file);
+    m_file = nullptr;
+}
+
+bool CodecFileReader::ReadPacket(std::vector<uint8_t>& data, CODECFILE_PACKET& packet)
+{
+    if (!m_file || fread(&packet, sizeof(packet), 1, m_file) != 1)
+        return false;
+
+    data.resize(packet.size);
+    return packet.size == 0 || fread(data.data(), 1, packet.size, m_file) == packet.size;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Container for FrameCodec packets: a header followed by packets, each with
+// its own small header carrying the presentation timestamp. The frame count
+// in the header is patched on Close; a reader that finds 0 there scans the
+// packets instead, so a truncated file stays readable.
+//-----------------------------------------------------------------------------
+
+#define CODECFILE_MAGIC   0x31564354 // "TCV1"
+#define CODECFILE_VERSION 1
+
+#define CODECFILE_PACKET_KEY 0x00000001
+
+#pragma pack(push,1)
+
+struct CODECFILE_HEADER
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowPitch;     // of the decoded frame
+    uint32_t flags;        // RAWDUMP_FLAG_* of the source
+    uint32_t timescale;
+    uint32_t gopSize;
+    uint64_t frameCount;
+};
+
+struct CODECFILE_PACKET
+{
+    int64_t  timestamp;
+    uint32_t size;         // payload bytes following this header
+    uint32_t flags;
+};
+
+#pragma pack(pop)
+
+class CodecFileWriter
+{
+public:
+    CodecFileWriter();
+    ~CodecFileWriter();
+
+    bool Open(const char* path, const CODECFILE_HEADER& header);
+    bool WritePacket(const uint8_t* data, size_t size, int64_t timestamp, bool key);
+    bool Close();
+
+    uint64_t BytesWritten() const { return m_bytes; }
+
+private:
+    FILE* m_file;
+    CODECFILE_HEADER m_header;
+    uint64_t m_bytes;
+};
+
+class CodecFileReader
+{
+public:
+    CodecFileReader();
+    ~CodecFileReader();
+
+    bool Open(const char* path);
+    void Close();
+
+    const CODECFILE_HEADER& Header() const { return m_header; }
+
+    // Reads the next packet; returns false at the end of the file
+    bool ReadPacket(std::vector<uint8_t>& data, CODECFILE_PACKET& packet);
+
+private:
+    FILE* m_file;
+    CODECFILE_HEADER m_header;
+};
@@ -0,0 +1,156 @@
+#include "ColorConvert.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define COLORCONVERT_SSE2
+#endif
+
+// BT.601 limited range, 8-bit fixed point:
+//   Y = ((66 R + 129 G + 25 B + 128) >> 8) + 16
+//   U = ((-38 R - 74 G + 112 B) / 4 + 128)  over the sum of a 2x2 block
+//   V = ((112 R - 94 G - 18 B) / 4 + 128)   over the sum of a 2x2 block
+// The chroma bias is folded in so that the shifted value never goes negative.
+
+namespace
+{
+    const int CHROMA_BIAS = (128 << 10) + 512;
+
+    inline uint8_t LumaOf(const uint8_t* p)
+    {
+        return static_cast<uint8_t>(((66 * p[2] + 129 * p[1] + 25 * p[0] + 128) >> 8) + 16);
+    }
+
+    void LumaRow(const uint8_t* src, uint8_t* dst, uint32_t width)
+    {
+        uint32_t x = 0;
+#ifdef COLORCONVERT_SSE2
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i cr = _mm_set1_epi16(66);
+        const __m128i cg = _mm_set1_epi16(129);
+        const __m128i cb = _mm_set1_epi16(25);
+        const __m128i round = _mm_set1_epi16(128);
+        const __m128i offset = _mm_set1_epi16(16);
+
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4 + 16));
+
+            const __m128i b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+            const __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+            const __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+
+            // The weighted sum stays below 2^16, so wrapping 16-bit math and a logical shift are exact
+            __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, cr), _mm_mullo_epi16(g, cg));
+            y = _mm_add_epi16(y, _mm_mullo_epi16(b, cb));
+            y = _mm_srli_epi16(_mm_add_epi16(y, round), 8);
+            y = _mm_add_epi16(y, offset);
+
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(y, y));
+        }
+#endif
+        for (; x < width; ++x)
+            dst[x] = LumaOf(src + x * 4);
+    }
+
+    inline void ChromaOf(const uint8_t* a0, const uint8_t* a1, const uint8_t* b0, const uint8_t* b1, uint8_t* u, uint8_t* v)
+    {
+        const int b = a0[0] + a1[0] + b0[0] + b1[0];
+        const int g = a0[1] + a1[1] + b0[1] + b1[1];
+        const int r = a0[2] + a1[2] + b0[2] + b1[2];
+        *u = static_cast<uint8_t>((-38 * r - 74 * g + 112 * b + CHROMA_BIAS) >> 10);
+        *v = static_cast<uint8_t>((112 * r - 94 * g - 18 * b + CHROMA_BIAS) >> 10);
+    }
+
+#ifdef COLORCONVERT_SSE2
+    // Sums 16 pixels of two rows into 8 horizontal 2x2 block sums per channel
+    inline void BlockSums(const uint8_t* row0, const uint8_t* row1, __m128i& b, __m128i& g, __m128i& r)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sums[3][2];
+
+        for (int half = 0; half < 2; ++half)
+        {
+            const __m128i* s0 = reinterpret_cast<const __m128i*>(row0 + half * 32);
+            const __m128i* s1 = reinterpret_cast<const __m128i*>(row1 + half * 32);
+            const __m128i p00 = _mm_loadu_si128(s0);
+            const __m128i p01 = _mm_loadu_si128(s0 + 1);
+            const __m128i p10 = _mm_loadu_si128(s1);
+            const __m128i p11 = _mm_loadu_si128(s1 + 1);
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const __m128i top = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p00, c * 8), mask), _mm_and_si128(_mm_srli_epi32(p01, c * 8), mask));
+                const __m128i bottom = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p10, c * 8), mask), _mm_and_si128(_mm_srli_epi32(p11, c * 8), mask));
+                sums[c][half] = _mm_madd_epi16(_mm_add_epi16(top, bottom), ones);
+            }
+        }
+
+        b = _mm_packs_epi32(sums[0][0], sums[0][1]);
+        g = _mm_packs_epi32(sums[1][0], sums[1][1]);
+        r = _mm_packs_epi32(sums[2][0], sums[2][1]);
+    }
+
+    inline __m128i ChromaSse2(__m128i b, __m128i g, __m128i r, __m128i coefBG, __m128i coefR)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi32(CHROMA_BIAS);
+
+        __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(b, g), coefBG), _mm_madd_epi16(_mm_unpacklo_epi16(r, zero), coefR));
+        __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(b, g), coefBG), _mm_madd_epi16(_mm_unpackhi_epi16(r, zero), coefR));
+        lo = _mm_srli_epi32(_mm_add_epi32(lo, bias), 10);
+        hi = _mm_srli_epi32(_mm_add_epi32(hi, bias), 10);
+
+        const __m128i c16 = _mm_packs_epi32(lo, hi);
+        return _mm_packus_epi16(c16, c16);
+    }
+#endif
+
+    void ChromaRow(const uint8_t* row0, const uint8_t* row1, uint8_t* dstU, uint8_t* dstV, uint32_t width)
+    {
+        const uint32_t chromaWidth = (width + 1) / 2;
+        const uint32_t fullPairs = width / 2;
+        uint32_t x = 0;
+#ifdef COLORCONVERT_SSE2
+        const __m128i coefUBG = _mm_set_epi16(-74, 112, -74, 112, -74, 112, -74, 112);
+        const __m128i coefUR = _mm_set_epi16(0, -38, 0, -38, 0, -38, 0, -38);
+        const __m128i coefVBG = _mm_set_epi16(-94, -18, -94, -18, -94, -18, -94, -18);
+        const __m128i coefVR = _mm_set_epi16(0, 112, 0, 112, 0, 112, 0, 112);
+
+        for (; x + 8 <= fullPairs; x += 8)
+        {
+            __m128i b, g, r;
+            BlockSums(row0 + x * 8, row1 + x * 8, b, g, r);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dstU + x), ChromaSse2(b, g, r, coefUBG, coefUR));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dstV + x), ChromaSse2(b, g, r, coefVBG, coefVR));
+        }
+#endif
+        for (; x < chromaWidth; ++x)
+        {
+            const uint32_t x0 = x * 2;
+            const uint32_t x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+            ChromaOf(row0 + x0 * 4, row0 + x1 * 4, row1 + x0 * 4, row1 + x1 * 4, dstU + x, dstV + x);
+        }
+    }
+}
+
+void ConvertBgraToI420(
+    const uint8_t* src, ptrdiff_t srcStride,
+    uint32_t width, uint32_t height,
+    uint8_t* dstY, ptrdiff_t strideY,
+    uint8_t* dstU, ptrdiff_t strideU,
+    uint8_t* dstV, ptrdiff_t strideV)
+{
+    for (uint32_t y = 0; y < height; y += 2)
+    {
+        const uint8_t* row0 = src + ptrdiff_t(y) * srcStride;
+        const uint8_t* row1 = (y + 1 < height) ? row0 + srcStride : row0;
+
+        LumaRow(row0, dstY + ptrdiff_t(y) * strideY, width);
+        if (y + 1 < height)
+            LumaRow(row1, dstY + ptrdiff_t(y + 1) * strideY, width);
+
+        ChromaRow(row0, row1, dstU + ptrdiff_t(y / 2) * strideU, dstV + ptrdiff_t(y / 2) * strideV, width);
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// BGRA (32-bit, Capture::buf layout) to planar YUV 4:2:0, BT.601 limited range.
+// Strides are signed: pass the last row and a negative stride for bottom-up sources.
+// Odd widths/heights replicate the last column/row for chroma.
+void ConvertBgraToI420(
+    const uint8_t* src, ptrdiff_t srcStride,
+    uint32_t width, uint32_t height,
+    uint8_t* dstY, ptrdiff_t strideY,
+    uint8_t* dstU, ptrdiff_t strideU,
+    uint8_t* dstV, ptrdiff_t strideV);
+
@@ -20,7 +20,17 @@
 #include <vector>
 #include <atlbase.h>
 #include <dxgi1_2.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include "capture.h"
+#include "ClipExport.h"
+#include "FrameCodec.h"
+#include "Mp4Muxer.h"
+#include "RawDump.h"
+#include "TileStream.h"
+#include "Transcoder.h"
+#include "Y4mWriter.h"
 
 template <class T> void SafeRelease(T** ppT) {
 
@@ -37,6 +47,25 @@ const UINT32 VIDEO_BIT_RATE        = 1000000;
 const GUID   VIDEO_ENCODING_FORMAT = MFVideoFormat_WMV3;
 const GUID   VIDEO_INPUT_FORMAT    = MFVideoFormat_RGB32;
 //const UINT32 VIDEO_FRAME_COUNT = 5 * VIDEO_FPS;
+const UINT32 MP4_FRAGMENT_FRAMES   = VIDEO_FPS; // one self-contained fragment per second
+
+// MP4 track carrying FrameCodec packets: sample entry "TLZ1" with a "tlzC" box
+// holding the decoded row pitch and the RAWDUMP_FLAG_* row order
+Mp4Muxer::TrackInfo MakeFrameCodecTrack(const UINT32 uiWidth, const UINT32 uiHeight)
+{
+    Mp4Muxer::TrackInfo track;
+    memcpy(track.codec, "TLZ1", 4);
+    track.width = uiWidth;
+    track.height = uiHeight;
+    track.timescale = RAWDUMP_TIMESCALE;
+
+    // Box size, type placeholder, row pitch, flags - all big-endian
+    const UINT32 fields[] = { 16, 0, uiWidth * 4, RAWDUMP_FLAG_BOTTOM_UP };
+    for (UINT32 value : fields)
+        track.configBox.insert(track.configBox.end(), { BYTE(value >> 24), BYTE(value >> 16), BYTE(value >> 8), BYTE(value) });
+    memcpy(track.configBox.data() + 4, "tlzC", 4);
+    return track;
+}
 
 HRESULT InitializeSinkWriter(IMFSinkWriter** ppWriter, DWORD* pStreamIndex, const UINT32 uiWidth, const UINT32 uiHeight) {
 
@@ -194,8 +223,116 @@ HRESULT WriteFrame(std::vector<BYTE> buf, IMFSinkWriter* pWriter, DWORD streamIn
     return hr;
 }
 
-int main()
+// Offline transcode of a raw dump: --transcode <in.raw> <out.tcv> [threads] [gop]
+int RunTranscode(int argc, char* argv[])
+{
+    TranscodeOptions options;
+    if (argc > 4)
+        options.threads = static_cast<unsigned>(atoi(argv[4]));
+    if (argc > 5)
+        options.gopSize = static_cast<unsigned>(atoi(argv[5]));
+
+    TranscodeStats stats;
+    if (!TranscodeDump(argv[2], argv[3], options, &stats))
+    {
+        std::cout << "Transcoding failed" << std::endl;
+        return -3;
+    }
+
+    const double seconds = stats.seconds > 0.0 ? stats.seconds : 1e-9;
+    std::cout << stats.frames << " frames on " << stats.threads << " threads in " << seconds << " s: "
+              << stats.frames / seconds << " fps, "
+              << stats.inputBytes / seconds / (1024.0 * 1024.0) << " MiB/s, ratio "
+              << (stats.outputBytes ? double(stats.inputBytes) / double(stats.outputBytes) : 0.0) << std::endl;
+    return 0;
+}
+
+// Raw dump to YUV4MPEG2: --y4m-from-raw <in.raw> <out.y4m | fifo | ->
+int RunY4mFromRaw(int argc, char* argv[])
+{
+    RawDumpReader dump;
+    if (!dump.Open(argv[2]))
+    {
+        std::cerr << "Can't open " << argv[2] << std::endl;
+        return -3;
+    }
+
+    const RAWDUMP_HEADER& header = dump.Header();
+    Y4mWriter writer;
+    if (!writer.Open(argv[3], header.width, header.height, VIDEO_FPS, 1))
+        return -3;
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool bottomUp = (header.flags & RAWDUMP_FLAG_BOTTOM_UP) != 0;
+    for (size_t i = 0; i < dump.FrameCount(); ++i)
+    {
+        const uint8_t* frame = dump.Frame(i);
+        if (bottomUp)
+            frame += size_t(header.height - 1) * header.rowPitch;
+        if (!writer.WriteFrame(frame, bottomUp ? -ptrdiff_t(header.rowPitch) : ptrdiff_t(header.rowPitch)))
+            return -3;
+    }
+    writer.Close();
+
+    // Statistics go to stderr, stdout may be the video stream
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << writer.Frames() << " frames in " << seconds << " s: " << writer.Frames() / seconds << " fps, "
+              << writer.BytesWritten() / seconds / (1024.0 * 1024.0) << " MiB/s (convert "
+              << writer.ConvertSeconds() << " s, write " << writer.WriteSeconds() << " s)" << std::endl;
+    return 0;
+}
+
+// Clip of a raw dump as animated GIF or APNG, by extension:
+// --export <in.raw> <out.gif | out.png> [first] [count] [none | ordered | fs]
+int RunExport(int argc, char* argv[])
+{
+    ClipExportOptions options;
+    const size_t pathLength = strlen(argv[3]);
+    if (pathLength >= 4 && (strcmp(argv[3] + pathLength - 4, ".png") == 0 || strcmp(argv[3] + pathLength - 4, ".PNG") == 0))
+        options.format = ClipFormat::Apng;
+    const size_t first = argc > 4 ? static_cast<size_t>(atoll(argv[4])) : 0;
+    const size_t count = argc > 5 ? static_cast<size_t>(atoll(argv[5])) : SIZE_MAX;
+    if (argc > 6)
+    {
+        if (strcmp(argv[6], "ordered") == 0)
+            options.dither = ClipDither::Ordered;
+        else if (strcmp(argv[6], "fs") == 0)
+            options.dither = ClipDither::FloydSteinberg;
+    }
+
+    ClipExportStats stats;
+    if (!ExportClip(argv[2], argv[3], first, count, options, &stats))
+    {
+        std::cout << "Export failed" << std::endl;
+        return -3;
+    }
+
+    const double seconds = stats.seconds > 0.0 ? stats.seconds : 1e-9;
+    std::cout << stats.frames << " frames (" << stats.writtenFrames << " written, " << stats.palettes << " palettes) on "
+              << stats.threads << " threads in " << seconds << " s: " << stats.frames / seconds << " fps, "
+              << stats.outputBytes / 1024 << " KiB" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
 {
+    // Offline tools don't need a capture device
+    if (argc >= 4 && strcmp(argv[1], "--transcode") == 0)
+        return RunTranscode(argc, argv);
+    if (argc >= 4 && strcmp(argv[1], "--y4m-from-raw") == 0)
+        return RunY4mFromRaw(argc, argv);
+    if (argc >= 4 && strcmp(argv[1], "--export") == 0)
+        return RunExport(argc, argv);
+
+    // --raw <file> records every new frame uncompressed instead of encoding WMV,
+    // --y4m <file | fifo | -> streams every new frame as YUV4MPEG2,
+    // --mp4 <file> writes crash-safe fragmented MP4 with the built-in lossless codec,
+    // --serve [port] streams changed tiles to a TileViewer on this machine
+    const char* rawPath = (argc >= 3 && strcmp(argv[1], "--raw") == 0) ? argv[2] : nullptr;
+    const char* y4mPath = (argc >= 3 && strcmp(argv[1], "--y4m") == 0) ? argv[2] : nullptr;
+    const char* mp4Path = (argc >= 3 && strcmp(argv[1], "--mp4") == 0) ? argv[2] : nullptr;
+    const bool serve = argc >= 2 && strcmp(argv[1], "--serve") == 0;
+    const uint16_t servePort = (serve && argc >= 3) ? static_cast<uint16_t>(atoi(argv[2])) : TILESTREAM_DEFAULT_PORT;
 
     HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
 
@@ -219,14 +356,31 @@ int main()
 
             IMFSinkWriter* pSinkWriter = nullptr;
             DWORD stream;
-
-            hr = InitializeSinkWriter(&pSinkWriter, &stream, uiWidth, uiHeight);
+            RawDumpWriter rawWriter;
+            Y4mWriter y4mWriter;
+            Mp4Muxer mp4Muxer;
+            FrameEncoder mp4Encoder(size_t(uiWidth) * uiHeight * 4);
+            std::vector<uint8_t> mp4Packet;
+            UINT64 mp4Frames = 0;
+            TileStreamSender tileSender;
+
+            if (rawPath)
+                hr = rawWriter.Open(rawPath, uiWidth, uiHeight, uiWidth * 4, RAWDUMP_FLAG_BOTTOM_UP) ? S_OK : E_FAIL;
+            else if (y4mPath)
+                hr = y4mWriter.Open(y4mPath, uiWidth, uiHeight, VIDEO_FPS, 1) ? S_OK : E_FAIL;
+            else if (mp4Path)
+                hr = mp4Muxer.Open(mp4Path, MakeFrameCodecTrack(uiWidth, uiHeight), MP4_FRAGMENT_FRAMES) ? S_OK : E_FAIL;
+            else if (serve)
+                hr = tileSender.Open(servePort, uiWidth, uiHeight) ? S_OK : E_FAIL;
+            else
+                hr = InitializeSinkWriter(&pSinkWriter, &stream, uiWidth, uiHeight);
 
             if (SUCCEEDED(hr))
             {
-                std::cout << "Screen recording in progress. Press Esc to stop";
+                (y4mPath ? std::cerr : std::cout) << "Screen recording in progress. Press Esc to stop";
 
                 LONGLONG rtStart = 0;
+                const auto captureStart = std::chrono::steady_clock::now();
 
                 for (;;) // for (DWORD i = 0; i < VIDEO_FRAME_COUNT; ++i) 
                 {
@@ -265,7 +419,52 @@ int main()
                     if (lDesktopResource && !cap.Get(lDesktopResource))
                         break;
 
-                    hr = WriteFrame(cap.buf, pSinkWriter, stream, rtStart, uiWidth, uiHeight);
+                    // Capture time in 100-ns units for the outputs that keep real timing
+                    const LONGLONG rtNow = std::chrono::duration_cast<std::chrono::duration<LONGLONG, std::ratio<1, RAWDUMP_TIMESCALE>>>(
+                        std::chrono::steady_clock::now() - captureStart).count();
+
+                    if (rawPath)
+                    {
+                        // Only new frames are dumped
+                        if (lDesktopResource)
+                            hr = rawWriter.WriteFrame(cap.buf.data(), rtNow) ? S_OK : E_FAIL;
+                    }
+                    else if (mp4Path)
+                    {
+                        // Every fragment starts with a key frame so it decodes on its own
+                        if (lDesktopResource)
+                        {
+                            const bool key = (mp4Frames++ % MP4_FRAGMENT_FRAMES) == 0;
+                            hr = mp4Encoder.Encode(cap.buf.data(), key, mp4Packet) &&
+                                 mp4Muxer.AddSample(mp4Packet.data(), mp4Packet.size(), rtNow, key) ? S_OK : E_FAIL;
+                        }
+                    }
+                    else if (serve)
+                    {
+                        // Held-back changes and key requests need the current frame even when the screen is static
+                        if (!cap.buf.empty() && (lDesktopResource || tileSender.Pending()))
+                        {
+                            const BYTE* top = cap.buf.data() + size_t(uiHeight - 1) * uiWidth * 4;
+                            hr = tileSender.SendFrame(top, -ptrdiff_t(uiWidth) * 4, TileStreamClock()) ? S_OK : E_FAIL;
+                        }
+                        else
+                        {
+                            tileSender.Poll();
+                        }
+                    }
+                    else if (y4mPath)
+                    {
+                        // Capture::buf is bottom-up: start at the last row and walk backwards
+                        if (lDesktopResource)
+                        {
+                            const BYTE* top = cap.buf.data() + size_t(uiHeight - 1) * uiWidth * 4;
+                            hr = y4mWriter.WriteFrame(top, -ptrdiff_t(uiWidth) * 4) ? S_OK : E_FAIL;
+                        }
+                    }
+                    else
+                    {
+                        hr = WriteFrame(cap.buf, pSinkWriter, stream, rtStart, uiWidth, uiHeight);
+                    }
 
                     if (FAILED(hr)) {
                         break;
@@ -275,6 +474,17 @@ int main()
                 }
             }
 
+            // Without Finalize the WMV file has no index and is unplayable
+            if (pSinkWriter)
+            {
+                pSinkWriter->Finalize();
+                SafeRelease(&pSinkWriter);
+            }
+            rawWriter.Close();
+            y4mWriter.Close();
+            mp4Muxer.Close();
+            tileSender.Close();
+
             MFShutdown();
         }
 
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// fopen/fseek wrappers that are /sdl clean with MSVC and 64-bit safe elsewhere
+
+inline FILE* OpenFile(const char* path, const char* mode)
+{
+#ifdef _MSC_VER
+    FILE* file = nullptr;
+    return fopen_s(&file, path, mode) == 0 ? file : nullptr;
+#else
+    return fopen(path, mode);
+#endif
+}
+
+inline bool SeekFile(FILE* file, int64_t offset, int origin)
+{
+#ifdef _MSC_VER
+    return _fseeki64(file, offset, origin) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+}
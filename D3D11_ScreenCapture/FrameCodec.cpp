@@ -0,0 +1,81 @@
+#include "FrameCodec.h"
+#include "Lz.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRAMECODEC_SSE2
+#endif
+
+void XorBuffers(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t size)
+{
+    size_t i = 0;
+#ifdef FRAMECODEC_SSE2
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(va, vb));
+    }
+#endif
+    for (; i < size; ++i)
+        dst[i] = a[i] ^ b[i];
+}
+
+//-----------------------------------------------------------------------------
+// Encoder
+//-----------------------------------------------------------------------------
+FrameEncoder::FrameEncoder(size_t frameSize) : m_frameSize(frameSize), m_havePrev(false)
+{
+}
+
+bool FrameEncoder::Encode(const uint8_t* frame, bool forceKey, std::vector<uint8_t>& packet)
+{
+    const bool key = forceKey || !m_havePrev;
+    const uint8_t* payload = frame;
+    if (!key)
+    {
+        m_delta.resize(m_frameSize);
+        XorBuffers(frame, m_prev.data(), m_delta.data(), m_frameSize);
+        payload = m_delta.data();
+    }
+
+    packet.resize(1 + LzCompressBound(m_frameSize));
+    packet[0] = key ? FRAME_KEY : FRAME_DELTA;
+    const size_t size = LzCompress(payload, m_frameSize, packet.data() + 1, packet.size() - 1);
+    if (size == 0)
+        return false;
+    packet.resize(1 + size);
+
+    m_prev.assign(frame, frame + m_frameSize);
+    m_havePrev = true;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Decoder
+//-----------------------------------------------------------------------------
+FrameDecoder::FrameDecoder(size_t frameSize) : m_frameSize(frameSize), m_havePrev(false)
+{
+}
+
+bool FrameDecoder::Decode(const uint8_t* packet, size_t size, uint8_t* frame)
+{
+    if (size < 1)
+        return false;
+
+    const uint8_t type = packet[0];
+    if (type != FRAME_KEY && (type != FRAME_DELTA || !m_havePrev))
+        return false;
+
+    if (!LzDecompress(packet + 1, size - 1, frame, m_frameSize))
+        return false;
+
+    if (type == FRAME_DELTA)
+        XorBuffers(frame, m_prev.data(), frame, m_frameSize);
+
+    m_prev.assign(frame, frame + m_frameSize);
+    m_havePrev = true;
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Built-in lossless frame codec.
+//
+// A key frame is the LZ-compressed frame; a delta frame is the LZ-compressed XOR
+// against the previous frame, so unchanged screen areas cost almost nothing.
+// A group of pictures (GOP) starts with a key frame and can be decoded on its own.
+//
+// Packet layout: 1 byte frame type followed by the LZ block.
+
+enum FrameType : uint8_t
+{
+    FRAME_KEY   = 1,
+    FRAME_DELTA = 2,
+};
+
+class FrameEncoder
+{
+public:
+    explicit FrameEncoder(size_t frameSize);
+
+    // Encodes one frame; `forceKey` starts a new GOP. Returns false on failure.
+    bool Encode(const uint8_t* frame, bool forceKey, std::vector<uint8_t>& packet);
+
+private:
+    size_t m_frameSize;
+    bool m_havePrev;
+    std::vector<uint8_t> m_prev;
+    std::vector<uint8_t> m_delta;
+};
+
+class FrameDecoder
+{
+public:
+    explicit FrameDecoder(size_t frameSize);
+
+    // Decodes a packet into `frame` (frameSize bytes). Delta packets need the previous frame of the GOP.
+    bool Decode(const uint8_t* packet, size_t size, uint8_t* frame);
+
+private:
+    size_t m_frameSize;
+    bool m_havePrev;
+    std::vector<uint8_t> m_prev;
+};
+
+// XORs `size` bytes of a and b into dst
+void XorBuffers(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t size);
@@ -0,0 +1,407 @@
+// LatencyHarness.cpp : headless glass-to-file latency measurement of the recorder's output pipelines.
+//
+// Portable and not part of the recorder build, e.g. on Linux:
+//   g++ -std=c++14 -O2 -pthread LatencyHarness.cpp LatencyStamp.cpp RawDump.cpp MappedFile.cpp CodecFile.cpp
+//       FrameCodec.cpp Lz.cpp Y4mWriter.cpp ColorConvert.cpp -o LatencyHarness
+//
+//   LatencyHarness [raw | codec | y4m | all] [frames] [width] [height] [fps] [gop] [out.csv]
+//
+// A producer thread plays the capture loop: at `fps` it renders a synthetic frame,
+// stamps the frame number and the current clock ("on glass") into it and pushes
+// it through the pipeline's writer exactly like the recorder does. A watcher
+// thread tails the output file, decodes every frame as soon as its bytes can be
+// read and takes the stamp back out; the latency is the watcher's clock minus the
+// stamped one. Stamps are decoded from the pixels, so frames that arrive damaged,
+// late or not at all show up in the report.
+
+#include "CodecFile.h"
+#include "FileIo.h"
+#include "FrameCodec.h"
+#include "LatencyStamp.h"
+#include "RawDump.h"
+#include "Y4mWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct HarnessOptions
+    {
+        uint32_t frames = 300;
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        uint32_t fps = 60;
+        uint32_t gopSize = 30;
+    };
+
+    struct FrameLatency
+    {
+        uint32_t frame;
+        int64_t latency;     // ns
+    };
+
+    struct WatchResult
+    {
+        std::vector<FrameLatency> frames;
+        uint64_t badStamps = 0;
+    };
+
+    // Reads a file that is still being written, waiting for bytes that aren't there yet
+    class FileTail
+    {
+    public:
+        explicit FileTail(const std::atomic<bool>& done) : m_done(done), m_file(nullptr) {}
+        ~FileTail() { if (m_file) fclose(m_file); }
+
+        bool Open(const char* path)
+        {
+            for (;;)
+            {
+                const bool finished = m_done.load();
+                m_file = OpenFile(path, "rb");
+                if (m_file)
+                {
+                    setvbuf(m_file, nullptr, _IONBF, 0);
+                    return true;
+                }
+                if (finished)
+                    return false;
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        // False once the writer is done and the file ends before `size` bytes
+        bool Read(void* data, size_t size)
+        {
+            uint8_t* p = static_cast<uint8_t*>(data);
+            while (size > 0)
+            {
+                const bool finished = m_done.load();
+                const size_t got = fread(p, 1, size, m_file);
+                p += got;
+                size -= got;
+                if (size == 0)
+                    break;
+                if (finished)
+                    return false;
+                clearerr(m_file);
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+            return true;
+        }
+
+    private:
+        const std::atomic<bool>& m_done;
+        FILE* m_file;
+    };
+
+    void Record(WatchResult& result, bool ok, const LatencyStamp& stamp)
+    {
+        const int64_t now = LatencyStampClock();
+        if (ok)
+            result.frames.push_back({ stamp.frame, now - stamp.timestamp });
+        else
+            ++result.badStamps;
+    }
+
+    //-------------------------------------------------------------------------
+    // Pipelines: a writer used by the producer and a matching watcher
+    //-------------------------------------------------------------------------
+
+    class Pipeline
+    {
+    public:
+        virtual ~Pipeline() {}
+        virtual bool Open(const char* path, const HarnessOptions& options) = 0;
+        virtual bool Write(const uint8_t* frame, int64_t timestamp) = 0;
+        virtual bool Close() = 0;
+        virtual void Watch(FileTail& tail, const HarnessOptions& options, WatchResult& result) = 0;
+    };
+
+    class RawPipeline : public Pipeline
+    {
+    public:
+        bool Open(const char* path, const HarnessOptions& options) override
+        {
+            return m_writer.Open(path, options.width, options.height, options.width * 4, 0);
+        }
+
+        bool Write(const uint8_t* frame, int64_t timestamp) override { return m_writer.WriteFrame(frame, timestamp / 100); }
+        bool Close() override { return m_writer.Close(); }
+
+        void Watch(FileTail& tail, const HarnessOptions& options, WatchResult& result) override
+        {
+            RAWDUMP_HEADER header;
+            if (!tail.Read(&header, sizeof(header)) || header.magic != RAWDUMP_MAGIC)
+                return;
+
+            std::vector<uint8_t> frame(size_t(header.rowPitch) * header.height);
+            RAWDUMP_FRAME record;
+            while (tail.Read(&record, sizeof(record)) && tail.Read(frame.data(), frame.size()))
+            {
+                LatencyStamp stamp;
+                const bool ok = ReadLatencyStamp(frame.data(), header.rowPitch, options.width, options.height, stamp);
+                Record(result, ok, stamp);
+            }
+        }
+
+    private:
+        RawDumpWriter m_writer;
+    };
+
+    class CodecPipeline : public Pipeline
+    {
+    public:
+        CodecPipeline() : m_frames(0) {}
+
+        bool Open(const char* path, const HarnessOptions& options) override
+        {
+            CODECFILE_HEADER header = {};
+            header.magic = CODECFILE_MAGIC;
+            header.version = CODECFILE_VERSION;
+            header.width = options.width;
+            header.height = options.height;
+            header.rowPitch = options.width * 4;
+            header.timescale = RAWDUMP_TIMESCALE;
+            header.gopSize = options.gopSize;
+
+            m_encoder.reset(new FrameEncoder(size_t(header.rowPitch) * header.height));
+            m_gopSize = options.gopSize ? options.gopSize : 1;
+            m_frames = 0;
+            return m_writer.Open(path, header);
+        }
+
+        bool Write(const uint8_t* frame, int64_t timestamp) override
+        {
+            const bool key = (m_frames++ % m_gopSize) == 0;
+            return m_encoder->Encode(frame, key, m_packet) &&
+                   m_writer.WritePacket(m_packet.data(), m_packet.size(), timestamp / 100, key);
+        }
+
+        bool Close() override { return m_writer.Close(); }
+
+        void Watch(FileTail& tail, const HarnessOptions& options, WatchResult& result) override
+        {
+            CODECFILE_HEADER header;
+            if (!tail.Read(&header, sizeof(header)) || header.magic != CODECFILE_MAGIC)
+                return;
+
+            FrameDecoder decoder(size_t(header.rowPitch) * header.height);
+            std::vector<uint8_t> frame(size_t(header.rowPitch) * header.height);
+            std::vector<uint8_t> data;
+            CODECFILE_PACKET packet;
+            while (tail.Read(&packet, sizeof(packet)))
+            {
+                data.resize(packet.size);
+                if (!tail.Read(data.data(), data.size()))
+                    break;
+
+                LatencyStamp stamp;
+                const bool ok = decoder.Decode(data.data(), data.size(), frame.data()) &&
+                    ReadLatencyStamp(frame.data(), header.rowPitch, options.width, options.height, stamp);
+                Record(result, ok, stamp);
+            }
+        }
+
+    private:
+        std::unique_ptr<FrameEncoder> m_encoder;
+        CodecFileWriter m_writer;
+        std::vector<uint8_t> m_packet;
+        uint32_t m_gopSize;
+        uint64_t m_frames;
+    };
+
+    class Y4mPipeline : public Pipeline
+    {
+    public:
+        bool Open(const char* path, const HarnessOptions& options) override
+        {
+            m_stride = ptrdiff_t(options.width) * 4;
+            return m_writer.Open(path, options.width, options.height, options.fps, 1);
+        }
+
+        bool Write(const uint8_t* frame, int64_t) override { return m_writer.WriteFrame(frame, m_stride); }
+        bool Close() override { return m_writer.Close(); }
+
+        void Watch(FileTail& tail, const HarnessOptions& options, WatchResult& result) override
+        {
+            // Stream header up to the first newline
+            char c = 0;
+            while (c != '\n')
+                if (!tail.Read(&c, 1))
+                    return;
+
+            const size_t lumaSize = size_t(options.width) * options.height;
+            const size_t chromaSize = size_t((options.width + 1) / 2) * ((options.height + 1) / 2);
+            std::vector<uint8_t> frame(lumaSize + 2 * chromaSize);
+            char marker[6];
+            while (tail.Read(marker, sizeof(marker)) && memcmp(marker, "FRAME\n", sizeof(marker)) == 0 &&
+                   tail.Read(frame.data(), frame.size()))
+            {
+                LatencyStamp stamp;
+                const bool ok = ReadLatencyStampLuma(frame.data(), options.width, options.width, options.height, stamp);
+                Record(result, ok, stamp);
+            }
+        }
+
+    private:
+        Y4mWriter m_writer;
+        ptrdiff_t m_stride;
+    };
+
+    Pipeline* CreatePipeline(const std::string& name)
+    {
+        if (name == "raw")
+            return new RawPipeline;
+        if (name == "codec")
+            return new CodecPipeline;
+        if (name == "y4m")
+            return new Y4mPipeline;
+        return nullptr;
+    }
+
+    //-------------------------------------------------------------------------
+
+    double Milliseconds(int64_t ns)
+    {
+        return ns / 1e6;
+    }
+
+    // Synthetic desktop: a static gradient with a moving bar, so every frame changes a little
+    void RenderFrame(const std::vector<uint8_t>& background, std::vector<uint8_t>& frame, uint32_t width, uint32_t height, uint32_t index)
+    {
+        memcpy(frame.data(), background.data(), frame.size());
+
+        const uint32_t barWidth = std::min(64u, width);
+        const uint32_t left = (index * 8) % (width - barWidth + 1);
+        for (uint32_t y = height / 2; y < height; ++y)
+            memset(frame.data() + (size_t(y) * width + left) * 4, 0xe0, barWidth * 4);
+    }
+
+    bool RunPipeline(const std::string& name, const HarnessOptions& options, FILE* csv)
+    {
+        std::unique_ptr<Pipeline> pipeline(CreatePipeline(name));
+        const std::string path = "latency_" + name + ".out";
+        if (!pipeline || !pipeline->Open(path.c_str(), options))
+        {
+            std::cerr << "Can't start the " << name << " pipeline" << std::endl;
+            return false;
+        }
+
+        std::atomic<bool> done(false);
+        WatchResult result;
+        std::thread watcher([&]
+        {
+            FileTail tail(done);
+            if (tail.Open(path.c_str()))
+                pipeline->Watch(tail, options, result);
+        });
+
+        const size_t frameSize = size_t(options.width) * options.height * 4;
+        std::vector<uint8_t> background(frameSize);
+        for (uint32_t y = 0; y < options.height; ++y)
+            for (uint32_t x = 0; x < options.width; ++x)
+            {
+                uint8_t* p = background.data() + (size_t(y) * options.width + x) * 4;
+                p[0] = uint8_t(x * 255 / options.width);
+                p[1] = uint8_t(y * 255 / options.height);
+                p[2] = 80;
+                p[3] = 255;
+            }
+        std::vector<uint8_t> frame(frameSize);
+
+        // Paced like the capture loop; a slow writer delays later frames, which the stamps capture
+        const auto period = std::chrono::nanoseconds(1000000000 / options.fps);
+        auto next = std::chrono::steady_clock::now();
+        bool ok = true;
+        for (uint32_t i = 0; i < options.frames && ok; ++i)
+        {
+            std::this_thread::sleep_until(next);
+            next += period;
+
+            RenderFrame(background, frame, options.width, options.height, i);
+            const LatencyStamp stamp = { i, LatencyStampClock() };
+            WriteLatencyStamp(frame.data(), ptrdiff_t(options.width) * 4, options.width, options.height, stamp);
+            ok = pipeline->Write(frame.data(), stamp.timestamp);
+        }
+        ok = pipeline->Close() && ok;
+        done = true;
+        watcher.join();
+        std::remove(path.c_str());
+
+        std::vector<int64_t> sorted;
+        for (const FrameLatency& f : result.frames)
+        {
+            sorted.push_back(f.latency);
+            if (csv)
+                fprintf(csv, "%s,%u,%.3f\n", name.c_str(), f.frame, Milliseconds(f.latency));
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        std::cout << name << " " << options.width << "x" << options.height << " @ " << options.fps << " fps";
+        if (name == "codec")
+            std::cout << ", gop " << options.gopSize;
+        std::cout << ": " << result.frames.size() << "/" << options.frames << " frames stamped back, "
+                  << result.badStamps << " unreadable" << (ok ? "" : ", WRITE FAILED") << std::endl;
+        if (!sorted.empty())
+        {
+            auto percentile = [&](size_t p) { return Milliseconds(sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)]); };
+            std::cout << "  latency ms: min " << Milliseconds(sorted.front()) << ", p50 " << percentile(50)
+                      << ", p90 " << percentile(90) << ", p99 " << percentile(99)
+                      << ", max " << Milliseconds(sorted.back()) << std::endl;
+        }
+        return ok && result.frames.size() == options.frames && result.badStamps == 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const std::string which = argc > 1 ? argv[1] : "all";
+    HarnessOptions options;
+    if (argc > 2)
+        options.frames = uint32_t(atoi(argv[2]));
+    if (argc > 3)
+        options.width = uint32_t(atoi(argv[3]));
+    if (argc > 4)
+        options.height = uint32_t(atoi(argv[4]));
+    if (argc > 5)
+        options.fps = uint32_t(atoi(argv[5]));
+    if (argc > 6)
+        options.gopSize = uint32_t(atoi(argv[6]));
+
+    if (options.frames == 0 || options.fps == 0 ||
+        options.width < LATENCYSTAMP_WIDTH || options.height < LATENCYSTAMP_HEIGHT)
+    {
+        std::cerr << "Frames must be at least " << LATENCYSTAMP_WIDTH << "x" << LATENCYSTAMP_HEIGHT << std::endl;
+        return -1;
+    }
+
+    FILE* csv = nullptr;
+    if (argc > 7)
+    {
+        csv = OpenFile(argv[7], "w");
+        if (!csv)
+            return -1;
+        fprintf(csv, "pipeline,frame,latency_ms\n");
+    }
+
+    const char* all[] = { "raw", "codec", "y4m" };
+    bool ok = true;
+    for (const char* name : all)
+        if (which == "all" || which == name)
+            ok = RunPipeline(name, options, csv) && ok;
+
+    if (csv)
+        fclose(csv);
+    return ok ? 0 : -2;
+}
@@ -0,0 +1,124 @@
+#include "LatencyStamp.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    const uint16_t SYNC_WORD = 0x5AC3;
+    const size_t STAMP_BYTES = LATENCYSTAMP_COLUMNS * LATENCYSTAMP_ROWS / 8;
+    const uint32_t SAMPLE_INSET = LATENCYSTAMP_BLOCK / 4;   // only the block centre is sampled
+
+    // CRC-16/CCITT-FALSE
+    uint16_t Crc16(const uint8_t* data, size_t size)
+    {
+        uint16_t crc = 0xffff;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc ^= uint16_t(data[i] << 8);
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+        }
+        return crc;
+    }
+
+    // Big-endian: sync, frame, timestamp, CRC of frame and timestamp
+    void Pack(const LatencyStamp& stamp, uint8_t* bytes)
+    {
+        bytes[0] = uint8_t(SYNC_WORD >> 8);
+        bytes[1] = uint8_t(SYNC_WORD);
+        for (int i = 0; i < 4; ++i)
+            bytes[2 + i] = uint8_t(stamp.frame >> (24 - 8 * i));
+        for (int i = 0; i < 8; ++i)
+            bytes[6 + i] = uint8_t(uint64_t(stamp.timestamp) >> (56 - 8 * i));
+        const uint16_t crc = Crc16(bytes + 2, 12);
+        bytes[14] = uint8_t(crc >> 8);
+        bytes[15] = uint8_t(crc);
+    }
+
+    bool Unpack(const uint8_t* bytes, LatencyStamp& stamp)
+    {
+        if (((bytes[0] << 8) | bytes[1]) != SYNC_WORD || ((bytes[14] << 8) | bytes[15]) != Crc16(bytes + 2, 12))
+            return false;
+
+        stamp.frame = 0;
+        for (int i = 0; i < 4; ++i)
+            stamp.frame = (stamp.frame << 8) | bytes[2 + i];
+        uint64_t timestamp = 0;
+        for (int i = 0; i < 8; ++i)
+            timestamp = (timestamp << 8) | bytes[6 + i];
+        stamp.timestamp = int64_t(timestamp);
+        return true;
+    }
+
+    // Thresholds the centre of every block; `Level(row, x)` gives the brightness of a pixel
+    template <class Level>
+    bool ReadBits(uint32_t width, uint32_t height, Level level, LatencyStamp& stamp)
+    {
+        if (width < LATENCYSTAMP_WIDTH || height < LATENCYSTAMP_HEIGHT)
+            return false;
+
+        uint8_t bytes[STAMP_BYTES] = {};
+        for (uint32_t bit = 0; bit < STAMP_BYTES * 8; ++bit)
+        {
+            const uint32_t x0 = (bit % LATENCYSTAMP_COLUMNS) * LATENCYSTAMP_BLOCK + SAMPLE_INSET;
+            const uint32_t y0 = (bit / LATENCYSTAMP_COLUMNS) * LATENCYSTAMP_BLOCK + SAMPLE_INSET;
+            const uint32_t span = LATENCYSTAMP_BLOCK - 2 * SAMPLE_INSET;
+
+            uint32_t sum = 0;
+            for (uint32_t y = y0; y < y0 + span; ++y)
+                for (uint32_t x = x0; x < x0 + span; ++x)
+                    sum += level(y, x);
+
+            if (sum >= 128 * span * span)
+                bytes[bit / 8] |= uint8_t(0x80 >> (bit % 8));
+        }
+        return Unpack(bytes, stamp);
+    }
+}
+
+int64_t LatencyStampClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool WriteLatencyStamp(uint8_t* bgra, ptrdiff_t stride, uint32_t width, uint32_t height, const LatencyStamp& stamp)
+{
+    if (width < LATENCYSTAMP_WIDTH || height < LATENCYSTAMP_HEIGHT)
+        return false;
+
+    uint8_t bytes[STAMP_BYTES];
+    Pack(stamp, bytes);
+
+    for (uint32_t y = 0; y < LATENCYSTAMP_HEIGHT; ++y)
+    {
+        uint8_t* row = bgra + ptrdiff_t(y) * stride;
+        for (uint32_t column = 0; column < LATENCYSTAMP_COLUMNS; ++column)
+        {
+            const uint32_t bit = (y / LATENCYSTAMP_BLOCK) * LATENCYSTAMP_COLUMNS + column;
+            const bool set = (bytes[bit / 8] & (0x80 >> (bit % 8))) != 0;
+            uint8_t* block = row + column * LATENCYSTAMP_BLOCK * 4;
+            memset(block, set ? 0xff : 0x00, LATENCYSTAMP_BLOCK * 4);
+            for (uint32_t x = 0; x < LATENCYSTAMP_BLOCK; ++x)
+                block[x * 4 + 3] = 0xff;
+        }
+    }
+    return true;
+}
+
+bool ReadLatencyStamp(const uint8_t* bgra, ptrdiff_t stride, uint32_t width, uint32_t height, LatencyStamp& stamp)
+{
+    return ReadBits(width, height, [=](uint32_t y, uint32_t x)
+    {
+        const uint8_t* p = bgra + ptrdiff_t(y) * stride + ptrdiff_t(x) * 4;
+        return uint32_t(p[0] + 2 * p[1] + p[2]) / 4;
+    }, stamp);
+}
+
+bool ReadLatencyStampLuma(const uint8_t* luma, ptrdiff_t stride, uint32_t width, uint32_t height, LatencyStamp& stamp)
+{
+    return ReadBits(width, height, [=](uint32_t y, uint32_t x)
+    {
+        return uint32_t(luma[ptrdiff_t(y) * stride + x]);
+    }, stamp);
+}
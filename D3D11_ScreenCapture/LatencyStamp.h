@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Machine-readable stamp for glass-to-file latency measurement.
+//
+// A grid of LATENCYSTAMP_COLUMNS x LATENCYSTAMP_ROWS black or white blocks in
+// the top-left corner of a frame carries 128 bits: a 16-bit sync word, the
+// 32-bit frame counter, a 64-bit timestamp and a CRC-16 over both. Blocks are
+// LATENCYSTAMP_BLOCK pixels and aligned to it, so they survive 4:2:0 chroma
+// subsampling and mild lossy coding; readers average each block's centre and
+// threshold it, and the CRC rejects anything that didn't come through intact.
+
+const uint32_t LATENCYSTAMP_BLOCK   = 8;
+const uint32_t LATENCYSTAMP_COLUMNS = 16;
+const uint32_t LATENCYSTAMP_ROWS    = 8;
+const uint32_t LATENCYSTAMP_WIDTH   = LATENCYSTAMP_BLOCK * LATENCYSTAMP_COLUMNS;
+const uint32_t LATENCYSTAMP_HEIGHT  = LATENCYSTAMP_BLOCK * LATENCYSTAMP_ROWS;
+
+struct LatencyStamp
+{
+    uint32_t frame;
+    int64_t  timestamp;
+};
+
+// Nanoseconds of the monotonic clock used for stamps
+int64_t LatencyStampClock();
+
+// Draws the stamp into a top-down BGRA frame (negative stride for bottom-up); false if the frame is too small
+bool WriteLatencyStamp(uint8_t* bgra, ptrdiff_t stride, uint32_t width, uint32_t height, const LatencyStamp& stamp);
+
+// Reads the stamp back from a BGRA frame or from the luma plane of a YUV frame
+bool ReadLatencyStamp(const uint8_t* bgra, ptrdiff_t stride, uint32_t width, uint32_t height, LatencyStamp& stamp);
+bool ReadLatencyStampLuma(const uint8_t* luma, ptrdiff_t stride, uint32_t width, uint32_t height, LatencyStamp& stamp);
@@ -0,0 +1,205 @@
+#include "Lz.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    const size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 14;
+
+    inline uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t Hash(uint32_t v)
+    {
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Writes the 255-continued remainder of a length that did not fit in a nibble
+    inline bool PutLength(uint8_t*& op, const uint8_t* end, size_t len)
+    {
+        for (; len >= 255; len -= 255)
+        {
+            if (op >= end)
+                return false;
+            *op++ = 255;
+        }
+        if (op >= end)
+            return false;
+        *op++ = static_cast<uint8_t>(len);
+        return true;
+    }
+
+    inline bool GetLength(const uint8_t*& ip, const uint8_t* end, size_t& len)
+    {
+        uint8_t b;
+        do
+        {
+            if (ip >= end)
+                return false;
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+        return true;
+    }
+
+    bool PutSequence(uint8_t*& op, const uint8_t* oend, const uint8_t* lit, size_t litLen, size_t offset, size_t matchLen)
+    {
+        if (op >= oend)
+            return false;
+
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>((litLen < 15 ? litLen : 15) << 4);
+        if (litLen >= 15 && !PutLength(op, oend, litLen - 15))
+            return false;
+
+        if (static_cast<size_t>(oend - op) < litLen)
+            return false;
+        memcpy(op, lit, litLen);
+        op += litLen;
+
+        if (matchLen == 0)
+            return true;
+
+        if (oend - op < 2)
+            return false;
+        *op++ = static_cast<uint8_t>(offset);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+
+        const size_t code = matchLen - MIN_MATCH;
+        *token |= static_cast<uint8_t>(code < 15 ? code : 15);
+        if (code >= 15 && !PutLength(op, oend, code - 15))
+            return false;
+        return true;
+    }
+}
+
+size_t LzCompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t LzCompress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity)
+{
+    uint8_t* op = dst;
+    const uint8_t* oend = dst + capacity;
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* iend = src + size;
+
+    if (size >= MIN_MATCH + 1)
+    {
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+        const uint8_t* mflimit = iend - MIN_MATCH;
+        size_t step = 1;
+
+        while (ip < mflimit)
+        {
+            const uint32_t seq = Read32(ip);
+            const uint32_t h = Hash(seq);
+            const uint8_t* ref = src + table[h];
+            table[h] = static_cast<uint32_t>(ip - src);
+
+            if (ref >= ip || size_t(ip - ref) > MAX_OFFSET || Read32(ref) != seq)
+            {
+                // Skip faster through incompressible data
+                ip += step >> 5 ? step >> 5 : 1;
+                ++step;
+                continue;
+            }
+            step = 1;
+
+            // Extend backwards over pending literals and forwards as far as possible
+            while (ip > anchor && ref > src && ip[-1] == ref[-1])
+            {
+                --ip;
+                --ref;
+            }
+            const uint8_t* mp = ip + MIN_MATCH;
+            const uint8_t* rp = ref + MIN_MATCH;
+            while (mp < iend && *mp == *rp)
+            {
+                ++mp;
+                ++rp;
+            }
+
+            if (!PutSequence(op, oend, anchor, size_t(ip - anchor), size_t(ip - ref), size_t(mp - ip)))
+                return 0;
+
+            // Only the tail of a match is indexed so long runs stay cheap
+            if (mp - 2 > ip && mp - 2 < mflimit)
+                table[Hash(Read32(mp - 2))] = static_cast<uint32_t>(mp - 2 - src);
+
+            ip = mp;
+            anchor = ip;
+        }
+    }
+
+    if (!PutSequence(op, oend, anchor, size_t(iend - anchor), 0, 0))
+        return 0;
+
+    return size_t(op - dst);
+}
+
+bool LzDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize)
+{
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + size;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dstSize;
+
+    while (ip < iend)
+    {
+        const uint8_t token = *ip++;
+
+        size_t litLen = token >> 4;
+        if (litLen == 15 && !GetLength(ip, iend, litLen))
+            return false;
+        if (static_cast<size_t>(iend - ip) < litLen || static_cast<size_t>(oend - op) < litLen)
+            return false;
+        memcpy(op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return false;
+        const size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+        ip += 2;
+
+        size_t matchLen = token & 15;
+        if (matchLen == 15 && !GetLength(ip, iend, matchLen))
+            return false;
+        matchLen += MIN_MATCH;
+
+        if (offset == 0 || offset > size_t(op - dst) || static_cast<size_t>(oend - op) < matchLen)
+            return false;
+
+        const uint8_t* ref = op - offset;
+        if (offset >= 8)
+        {
+            // Non-overlapping in 8-byte steps
+            size_t i = 0;
+            for (; i + 8 <= matchLen; i += 8)
+                memcpy(op + i, ref + i, 8);
+            for (; i < matchLen; ++i)
+                op[i] = ref[i];
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLen; ++i)
+                op[i] = ref[i];
+        }
+        op += matchLen;
+    }
+
+    return op == oend;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fast byte-oriented LZ77 block codec (LZ4-style sequences).
+//
+// A block is a list of sequences:
+//   token       - high nibble literal count, low nibble match length - 4
+//   [lit ext]   - 255-continued literal count when the nibble is 15
+//   literals
+//   offset      - 16-bit little endian back reference, absent after the last literals
+//   [match ext] - 255-continued match length when the nibble is 15
+//
+// Long runs (e.g. zero bytes of an XOR-delta frame) become overlapping matches
+// with offset 1, so the codec doubles as a run-length coder.
+
+// Upper bound of the compressed size of `size` input bytes
+size_t LzCompressBound(size_t size);
+
+// Compresses `size` bytes into `dst`; returns the compressed size or 0 if `capacity` is too small
+size_t LzCompress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+
+// Decompresses a block into exactly `dstSize` bytes; returns false on corrupt input
+bool LzDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize);
@@ -0,0 +1,351 @@
+// Mp4MuxBench.cpp : speed and structure of the fragmented MP4 muxer.
+//
+// Portable and not part of the recorder build, e.g. on Linux:
+//   g++ -std=c++14 -O2 Mp4MuxBench.cpp Mp4Muxer.cpp FrameCodec.cpp Lz.cpp -o Mp4MuxBench
+//
+//   Mp4MuxBench [frames] [width] [height] [fragment frames] [mp4 path]
+//
+// Encodes a synthetic desktop session with the built-in FrameCodec, a key
+// frame at the start of every fragment, and muxes the packets the way the
+// --mp4 capture mode does. The file is then parsed back: ftyp, moov with
+// trak, the TLZ1 sample entry and mvex/trex have to be there, and every
+// moof/mdat pair has to carry the next sequence number, a tfdt matching the
+// timestamps, and a trun whose data offset lands on its mdat payload and whose
+// sample sizes, durations and sync flags match the packets. The samples are
+// decoded back to the recorded frames. Last, the file is cut at every fragment
+// boundary and inside every fragment, and each cut has to parse up to the last
+// complete fragment, the way a recording killed mid-write would.
+
+#include "Mp4Muxer.h"
+#include "FrameCodec.h"
+#include "../D3D11_Screenshot/BenchImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const uint32_t FPS = 30;
+    const uint32_t TIMESCALE = 10000000;         // RAWDUMP_TIMESCALE, as the capture mode uses
+
+    const uint32_t SAMPLE_FLAGS_SYNC     = 0x02000000;
+    const uint32_t SAMPLE_FLAGS_NON_SYNC = 0x01010000;
+
+    double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // A window being typed into and a picture that changes every frame
+    void Draw(std::vector<uint8_t>& frame, uint32_t width, uint32_t height, uint32_t i)
+    {
+        const uint32_t perLine = width / 20;
+        const uint32_t glyph = i % (perLine * (height / 32));
+        for (uint32_t y = 0; y < 11; ++y)
+            for (uint32_t x = 0; x < 7; ++x)
+            {
+                const uint32_t color = 0xff202020 + ((i * 37) & 0x3f);
+                memcpy(&frame[((size_t(height) / 4 + (glyph / perLine) * 16 + y) * width + 16 + (glyph % perLine) * 10 + x) * 4],
+                       &color, 4);
+            }
+
+        for (uint32_t y = 0; y < height / 6; ++y)
+            for (uint32_t x = 0; x < width / 6; ++x)
+            {
+                const uint32_t color = 0xff000000u | ((x + i * 3) & 0xff) << 16 | ((y + i * 5) & 0xff) << 8 | ((x ^ y) & 0xff);
+                memcpy(&frame[((size_t(height) / 10 + y) * width + width * 3 / 4 + x) * 4], &color, 4);
+            }
+    }
+
+    //-------------------------------------------------------------------------
+    // Reading the file back
+    //-------------------------------------------------------------------------
+    uint32_t Get32(const uint8_t* p) { return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3]; }
+    uint64_t Get64(const uint8_t* p) { return uint64_t(Get32(p)) << 32 | Get32(p + 4); }
+
+    struct Box
+    {
+        const uint8_t* data;     // payload, after size and type
+        size_t size;             // payload bytes
+        char type[5];
+    };
+
+    // The boxes in [begin, end); false if the last one is cut short, the ones before it are kept
+    bool Boxes(const uint8_t* begin, const uint8_t* end, std::vector<Box>& boxes)
+    {
+        boxes.clear();
+        while (begin < end)
+        {
+            if (end - begin < 8)
+                return false;
+            const uint32_t size = Get32(begin);
+            if (size < 8 || size > size_t(end - begin))
+                return false;
+            Box box;
+            box.data = begin + 8;
+            box.size = size - 8;
+            memcpy(box.type, begin + 4, 4);
+            box.type[4] = 0;
+            boxes.push_back(box);
+            begin += size;
+        }
+        return true;
+    }
+
+    const Box* Find(const std::vector<Box>& boxes, const char* type)
+    {
+        for (const Box& box : boxes)
+            if (strcmp(box.type, type) == 0)
+                return &box;
+        return nullptr;
+    }
+
+    // Descendant `path` of a box, e.g. "trak/mdia/minf"
+    bool Child(const Box& parent, const char* path, Box& found)
+    {
+        found = parent;
+        std::vector<Box> children;
+        for (const char* name = path;; name += 5)
+        {
+            char type[5] = {};
+            memcpy(type, name, 4);
+            const Box* child = Boxes(found.data, found.data + found.size, children) ? Find(children, type) : nullptr;
+            if (!child)
+                return false;
+            found = *child;
+            if (name[4] != '/')
+                return true;
+        }
+    }
+
+    struct Sample
+    {
+        const uint8_t* data;
+        uint32_t size;
+        uint32_t duration;
+        uint32_t flags;
+        uint64_t decodeTime;
+    };
+
+    // Checks ftyp and moov, then collects the samples of every complete fragment.
+    // Returns the number of fragments, -1 if the file is malformed.
+    int Parse(const uint8_t* file, size_t size, uint32_t width, uint32_t height, std::vector<Sample>& samples)
+    {
+        samples.clear();
+
+        // Top-level boxes up to the first one cut short
+        std::vector<Box> top;
+        Boxes(file, file + size, top);
+
+        if (top.size() < 2 || strcmp(top[0].type, "ftyp") != 0 || strcmp(top[1].type, "moov") != 0)
+            return -1;
+        if (top[0].size < 8 || memcmp(top[0].data, "iso6", 4) != 0)
+            return -1;
+
+        const Box& moov = top[1];
+        Box mvhd, tkhd, stsd, trex;
+        if (!Child(moov, "mvhd", mvhd) || Get32(mvhd.data + 12) != TIMESCALE ||
+            !Child(moov, "trak/tkhd", tkhd) || Get32(tkhd.data + 76) != width << 16 || Get32(tkhd.data + 80) != height << 16 ||
+            !Child(moov, "trak/mdia/minf/stbl/stsd", stsd) || Get32(stsd.data + 4) != 1 ||
+            !Child(moov, "mvex/trex", trex) || Get32(trex.data + 4) != 1)
+            return -1;
+        if (stsd.size < 16 || memcmp(stsd.data + 12, "TLZ1", 4) != 0)
+            return -1;
+
+        // Fragments: moof followed by its mdat
+        int fragments = 0;
+        uint64_t nextDecodeTime = 0;
+        for (size_t i = 2; i + 1 < top.size(); i += 2)
+        {
+            const Box& moof = top[i];
+            const Box& mdat = top[i + 1];
+            if (strcmp(moof.type, "moof") != 0 || strcmp(mdat.type, "mdat") != 0)
+                return -1;
+
+            Box mfhd, tfhd, tfdt, trun;
+            if (!Child(moof, "mfhd", mfhd) || Get32(mfhd.data + 4) != uint32_t(fragments + 1) ||
+                !Child(moof, "traf/tfhd", tfhd) || Get32(tfhd.data + 4) != 1 ||
+                !Child(moof, "traf/tfdt", tfdt) || tfdt.data[0] != 1 ||
+                !Child(moof, "traf/trun", trun) || (Get32(trun.data) & 0xffffff) != 0x000701)
+                return -1;
+
+            const uint64_t decodeTime = Get64(tfdt.data + 4);
+            if (decodeTime != nextDecodeTime)
+                return -1;
+
+            const uint32_t count = Get32(trun.data + 4);
+            const uint32_t dataOffset = Get32(trun.data + 8);
+            if (count == 0 || trun.size != 12 + size_t(count) * 12)
+                return -1;
+
+            // The data offset counts from the moof start and has to land on the mdat payload
+            const uint8_t* moofStart = moof.data - 8;
+            if (moofStart + dataOffset != mdat.data)
+                return -1;
+
+            const uint8_t* payload = mdat.data;
+            uint64_t time = decodeTime;
+            for (uint32_t s = 0; s < count; ++s)
+            {
+                const uint8_t* entry = trun.data + 12 + size_t(s) * 12;
+                Sample sample;
+                sample.duration = Get32(entry);
+                sample.size = Get32(entry + 4);
+                sample.flags = Get32(entry + 8);
+                sample.decodeTime = time;
+                sample.data = payload;
+                if (payload + sample.size > mdat.data + mdat.size)
+                    return -1;
+                payload += sample.size;
+                time += sample.duration;
+                samples.push_back(sample);
+            }
+            if (payload != mdat.data + mdat.size)
+                return -1;
+
+            nextDecodeTime = time;
+            ++fragments;
+        }
+        return fragments;
+    }
+
+    bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+    {
+        data.clear();
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        uint8_t buffer[65536];
+        for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+            data.insert(data.end(), buffer, buffer + read);
+        fclose(file);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? uint32_t(atoi(argv[1])) : 150;
+    const uint32_t width = argc > 2 ? uint32_t(atoi(argv[2])) : 1280;
+    const uint32_t height = argc > 3 ? uint32_t(atoi(argv[3])) : 720;
+    const uint32_t fragmentFrames = argc > 4 ? uint32_t(atoi(argv[4])) : FPS;
+    const std::string path = argc > 5 ? argv[5] : "Mp4MuxBench.mp4";
+
+    if (frames < 2 || fragmentFrames == 0 || width < 320 || height < 240)
+    {
+        printf("needs at least two frames of 320x240 and one frame per fragment\n");
+        return 1;
+    }
+
+    // Record and encode the session; the last sample gets the previous duration on Close
+    const size_t frameSize = size_t(width) * height * 4;
+    std::vector<std::vector<uint8_t>> recorded, packets;
+    std::vector<int64_t> timestamps;
+    {
+        std::vector<uint8_t> frame = MakeDesktop(width, height);
+        FrameEncoder encoder(frameSize);
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            Draw(frame, width, height, i);
+            std::vector<uint8_t> packet;
+            if (!encoder.Encode(frame.data(), i % fragmentFrames == 0, packet))
+            {
+                printf("encoding frame %u failed\n", i);
+                return 1;
+            }
+            recorded.push_back(frame);
+            packets.push_back(std::move(packet));
+            // A dropped frame now and then, so durations vary
+            timestamps.push_back(int64_t(i + i / 7) * TIMESCALE / FPS);
+        }
+    }
+
+    Mp4Muxer::TrackInfo track;
+    memcpy(track.codec, "TLZ1", 4);
+    track.width = width;
+    track.height = height;
+    track.timescale = TIMESCALE;
+    const uint8_t config[16] = { 0, 0, 0, 16, 't', 'l', 'z', 'C', uint8_t(width * 4 >> 24), uint8_t(width * 4 >> 16),
+                                 uint8_t(width * 4 >> 8), uint8_t(width * 4), 0, 0, 0, 0 };
+    track.configBox.assign(config, config + sizeof(config));
+
+    Mp4Muxer muxer;
+    size_t payloadBytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    bool ok = muxer.Open(path.c_str(), track, fragmentFrames);
+    for (uint32_t i = 0; ok && i < frames; ++i)
+    {
+        ok = muxer.AddSample(packets[i].data(), packets[i].size(), timestamps[i], i % fragmentFrames == 0);
+        payloadBytes += packets[i].size();
+    }
+    ok = muxer.Close() && ok;
+    const double seconds = SecondsSince(start);
+    const uint64_t fragmentCount = muxer.Fragments();
+
+    std::vector<uint8_t> file;
+    if (!ok || !ReadFile(path, file))
+    {
+        printf("muxing %s failed\n", path.c_str());
+        return 1;
+    }
+
+    printf("%u frames of %ux%u, %u per fragment\n\n", frames, width, height, fragmentFrames);
+    printf("muxed %llu fragments, %zu KiB of samples in %zu KiB of file, %.1f ms (%.0f MB/s)\n",
+           (unsigned long long)fragmentCount, payloadBytes / 1024, file.size() / 1024, seconds * 1000.0,
+           payloadBytes / seconds / 1e6);
+
+    // The whole file: every sample where it belongs, decoding to the recording
+    bool allOk = true;
+    std::vector<Sample> samples;
+    const int fragments = Parse(file.data(), file.size(), width, height, samples);
+    bool same = fragments >= 0 && uint64_t(fragments) == fragmentCount && samples.size() == frames;
+    FrameDecoder decoder(frameSize);
+    std::vector<uint8_t> decoded(frameSize);
+    for (uint32_t i = 0; same && i < frames; ++i)
+    {
+        const Sample& s = samples[i];
+        const uint32_t duration = i + 1 < frames ? uint32_t(timestamps[i + 1] - timestamps[i]) :
+                                                   uint32_t(timestamps[i] - timestamps[i - 1]);
+        const bool sync = i % fragmentFrames == 0;
+        same = s.size == packets[i].size() && memcmp(s.data, packets[i].data(), s.size) == 0 &&
+               s.duration == duration && s.decodeTime == uint64_t(timestamps[i] - timestamps[0]) &&
+               s.flags == (sync ? SAMPLE_FLAGS_SYNC : SAMPLE_FLAGS_NON_SYNC) &&
+               decoder.Decode(s.data, s.size, decoded.data()) && decoded == recorded[i];
+    }
+    printf("%-36s %s\n", "boxes, samples and decoded frames", same ? "ok" : "MISMATCH");
+    allOk = allOk && same;
+
+    // Cuts at and inside every fragment keep the fragments before them
+    std::vector<size_t> boundaries;
+    for (size_t at = 0; at + 8 <= file.size(); at += Get32(&file[at]))
+        if (memcmp(&file[at + 4], "moof", 4) == 0)
+            boundaries.push_back(at);
+    boundaries.push_back(file.size());
+
+    bool cutsOk = boundaries.size() == fragmentCount + 1;
+    for (size_t f = 0; cutsOk && f + 1 < boundaries.size(); ++f)
+    {
+        const size_t cuts[] = { boundaries[f], boundaries[f] + 9, (boundaries[f] + boundaries[f + 1]) / 2, boundaries[f + 1] - 1 };
+        for (size_t cut : cuts)
+        {
+            std::vector<Sample> kept;
+            const int complete = Parse(file.data(), cut, width, height, kept);
+            size_t expected = 0;
+            for (size_t g = 0; g < f; ++g)
+                expected += std::min<size_t>(fragmentFrames, frames - g * fragmentFrames);
+            cutsOk = cutsOk && complete == int(f) && kept.size() == expected;
+            for (size_t i = 0; cutsOk && i < kept.size(); ++i)
+                cutsOk = kept[i].size == packets[i].size() && memcmp(kept[i].data, packets[i].data(), kept[i].size) == 0;
+        }
+    }
+    printf("%-36s %s\n", "files cut at and inside fragments", cutsOk ? "ok" : "MISMATCH");
+    allOk = allOk && cutsOk;
+
+    remove(path.c_str());
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,349 @@
+#include "Mp4Muxer.h"
+#include "FileIo.h"
+
+#include <cstring>
+
+namespace
+{
+    // Sample flags of the track fragment run (ISO/IEC 14496-12, 8.8.3.1)
+    const uint32_t SAMPLE_FLAGS_SYNC     = 0x02000000; // sample_depends_on = 2
+    const uint32_t SAMPLE_FLAGS_NON_SYNC = 0x01010000; // sample_depends_on = 1, is_non_sync_sample
+
+    const uint32_t TFHD_DEFAULT_BASE_IS_MOOF = 0x020000;
+    const uint32_t TRUN_DATA_OFFSET    = 0x000001;
+    const uint32_t TRUN_SAMPLE_DURATION = 0x000100;
+    const uint32_t TRUN_SAMPLE_SIZE    = 0x000200;
+    const uint32_t TRUN_SAMPLE_FLAGS   = 0x000400;
+
+    const uint32_t TRACK_ID = 1;
+
+    //-------------------------------------------------------------------------
+    // Big-endian box building
+    //-------------------------------------------------------------------------
+    void Put8(std::vector<uint8_t>& b, uint32_t v) { b.push_back(static_cast<uint8_t>(v)); }
+    void Put16(std::vector<uint8_t>& b, uint32_t v) { Put8(b, v >> 8); Put8(b, v); }
+    void Put32(std::vector<uint8_t>& b, uint32_t v) { Put16(b, v >> 16); Put16(b, v); }
+    void Put64(std::vector<uint8_t>& b, uint64_t v) { Put32(b, uint32_t(v >> 32)); Put32(b, uint32_t(v)); }
+    void PutZeros(std::vector<uint8_t>& b, size_t n) { b.insert(b.end(), n, 0); }
+    void PutType(std::vector<uint8_t>& b, const char* type) { b.insert(b.end(), type, type + 4); }
+
+    void Patch32(std::vector<uint8_t>& b, size_t at, uint32_t v)
+    {
+        b[at] = uint8_t(v >> 24);
+        b[at + 1] = uint8_t(v >> 16);
+        b[at + 2] = uint8_t(v >> 8);
+        b[at + 3] = uint8_t(v);
+    }
+
+    size_t BeginBox(std::vector<uint8_t>& b, const char* type)
+    {
+        const size_t at = b.size();
+        Put32(b, 0);
+        PutType(b, type);
+        return at;
+    }
+
+    size_t BeginFullBox(std::vector<uint8_t>& b, const char* type, uint32_t version, uint32_t flags)
+    {
+        const size_t at = BeginBox(b, type);
+        Put32(b, (version << 24) | flags);
+        return at;
+    }
+
+    void EndBox(std::vector<uint8_t>& b, size_t at)
+    {
+        Patch32(b, at, static_cast<uint32_t>(b.size() - at));
+    }
+
+    void PutMatrix(std::vector<uint8_t>& b)
+    {
+        const uint32_t unity[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+        for (uint32_t v : unity)
+            Put32(b, v);
+    }
+}
+
+Mp4Muxer::Mp4Muxer() :
+    m_file(nullptr), m_fragmentFrames(0), m_sequence(0), m_lastDuration(0), m_baseTimestamp(0)
+{
+}
+
+Mp4Muxer::~Mp4Muxer()
+{
+    Close();
+}
+
+bool Mp4Muxer::Open(const char* path, const TrackInfo& track, uint32_t fragmentFrames)
+{
+    Close();
+
+    if (track.width == 0 || track.height == 0 || track.width > 0xffff || track.height > 0xffff || track.timescale == 0)
+        return false;
+
+    m_file = OpenFile(path, "wb");
+    if (!m_file)
+        return false;
+
+    m_fragmentFrames = fragmentFrames ? fragmentFrames : 1;
+    m_sequence = 0;
+    m_lastDuration = 0;
+    m_samples.clear();
+    m_payload.clear();
+
+    if (!WriteHeader(track))
+    {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool Mp4Muxer::WriteHeader(const TrackInfo& track)
+{
+    std::vector<uint8_t>& b = m_box;
+    b.clear();
+
+    size_t ftyp = BeginBox(b, "ftyp");
+    PutType(b, "iso6");
+    Put32(b, 0);
+    PutType(b, "iso6");
+    PutType(b, "iso5");
+    PutType(b, "isom");
+    EndBox(b, ftyp);
+
+    size_t moov = BeginBox(b, "moov");
+    {
+        size_t mvhd = BeginFullBox(b, "mvhd", 0, 0);
+        Put32(b, 0);                    // creation_time
+        Put32(b, 0);                    // modification_time
+        Put32(b, track.timescale);
+        Put32(b, 0);                    // duration: unknown, lives in the fragments
+        Put32(b, 0x00010000);           // rate 1.0
+        Put16(b, 0x0100);               // volume 1.0
+        PutZeros(b, 10);
+        PutMatrix(b);
+        PutZeros(b, 24);                // pre_defined
+        Put32(b, TRACK_ID + 1);         // next_track_ID
+        EndBox(b, mvhd);
+
+        size_t trak = BeginBox(b, "trak");
+        {
+            size_t tkhd = BeginFullBox(b, "tkhd", 0, 0x000003); // enabled, in movie
+            Put32(b, 0);
+            Put32(b, 0);
+            Put32(b, TRACK_ID);
+            Put32(b, 0);
+            Put32(b, 0);                // duration
+            PutZeros(b, 8);
+            Put16(b, 0);                // layer
+            Put16(b, 0);                // alternate_group
+            Put16(b, 0);                // volume
+            Put16(b, 0);
+            PutMatrix(b);
+            Put32(b, track.width << 16);
+            Put32(b, track.height << 16);
+            EndBox(b, tkhd);
+
+            size_t mdia = BeginBox(b, "mdia");
+            {
+                size_t mdhd = BeginFullBox(b, "mdhd", 0, 0);
+                Put32(b, 0);
+                Put32(b, 0);
+                Put32(b, track.timescale);
+                Put32(b, 0);
+                Put16(b, 0x55c4);       // language "und"
+                Put16(b, 0);
+                EndBox(b, mdhd);
+
+                size_t hdlr = BeginFullBox(b, "hdlr", 0, 0);
+                Put32(b, 0);
+                PutType(b, "vide");
+                PutZeros(b, 12);
+                const char name[] = "VideoHandler";
+                b.insert(b.end(), name, name + sizeof(name));
+                EndBox(b, hdlr);
+
+                size_t minf = BeginBox(b, "minf");
+                {
+                    size_t vmhd = BeginFullBox(b, "vmhd", 0, 1);
+                    PutZeros(b, 8);
+                    EndBox(b, vmhd);
+
+                    size_t dinf = BeginBox(b, "dinf");
+                    size_t dref = BeginFullBox(b, "dref", 0, 0);
+                    Put32(b, 1);
+                    EndBox(b, BeginFullBox(b, "url ", 0, 1)); // media data is in this file
+                    EndBox(b, dref);
+                    EndBox(b, dinf);
+
+                    size_t stbl = BeginBox(b, "stbl");
+                    {
+                        size_t stsd = BeginFullBox(b, "stsd", 0, 0);
+                        Put32(b, 1);
+
+                        char codec[5] = {};
+                        memcpy(codec, track.codec, 4);
+                        size_t entry = BeginBox(b, codec);
+                        PutZeros(b, 6);
+                        Put16(b, 1);            // data_reference_index
+                        PutZeros(b, 16);
+                        Put16(b, track.width);
+                        Put16(b, track.height);
+                        Put32(b, 0x00480000);   // 72 dpi
+                        Put32(b, 0x00480000);
+                        Put32(b, 0);
+                        Put16(b, 1);            // frame_count
+                        PutZeros(b, 32);        // compressorname
+                        Put16(b, 0x0018);       // depth
+                        Put16(b, 0xffff);       // pre_defined = -1
+                        b.insert(b.end(), track.configBox.begin(), track.configBox.end());
+                        EndBox(b, entry);
+
+                        EndBox(b, stsd);
+
+                        // Empty sample tables: all samples live in the fragments
+                        size_t stts = BeginFullBox(b, "stts", 0, 0);
+                        Put32(b, 0);
+                        EndBox(b, stts);
+                        size_t stsc = BeginFullBox(b, "stsc", 0, 0);
+                        Put32(b, 0);
+                        EndBox(b, stsc);
+                        size_t stsz = BeginFullBox(b, "stsz", 0, 0);
+                        Put32(b, 0);
+                        Put32(b, 0);
+                        EndBox(b, stsz);
+                        size_t stco = BeginFullBox(b, "stco", 0, 0);
+                        Put32(b, 0);
+                        EndBox(b, stco);
+                    }
+                    EndBox(b, stbl);
+                }
+                EndBox(b, minf);
+            }
+            EndBox(b, mdia);
+        }
+        EndBox(b, trak);
+
+        size_t mvex = BeginBox(b, "mvex");
+        size_t trex = BeginFullBox(b, "trex", 0, 0);
+        Put32(b, TRACK_ID);
+        Put32(b, 1);                    // default_sample_description_index
+        Put32(b, 0);
+        Put32(b, 0);
+        Put32(b, 0);
+        EndBox(b, trex);
+        EndBox(b, mvex);
+    }
+    EndBox(b, moov);
+
+    return fwrite(b.data(), 1, b.size(), m_file) == b.size() && fflush(m_file) == 0;
+}
+
+bool Mp4Muxer::AddSample(const uint8_t* data, size_t size, int64_t timestamp, bool sync)
+{
+    if (!m_file || size > UINT32_MAX)
+        return false;
+
+    if (m_sequence == 0 && m_samples.empty())
+        m_baseTimestamp = timestamp;
+
+    // The previous sample's duration is only known now
+    if (!m_samples.empty())
+    {
+        Sample& prev = m_samples.back();
+        const int64_t delta = timestamp - prev.timestamp;
+        if (delta <= 0 || delta > INT32_MAX)
+            return false;
+        prev.duration = static_cast<uint32_t>(delta);
+        m_lastDuration = prev.duration;
+    }
+
+    if (m_samples.size() >= m_fragmentFrames && !FlushFragment())
+        return false;
+
+    Sample sample = {};
+    sample.size = static_cast<uint32_t>(size);
+    sample.sync = sync;
+    sample.timestamp = timestamp;
+    m_samples.push_back(sample);
+    m_payload.insert(m_payload.end(), data, data + size);
+    return true;
+}
+
+bool Mp4Muxer::FlushFragment()
+{
+    const size_t count = m_samples.size();
+    if (count == 0)
+        return true;
+
+    std::vector<uint8_t>& b = m_box;
+    b.clear();
+
+    size_t moof = BeginBox(b, "moof");
+    size_t mfhd = BeginFullBox(b, "mfhd", 0, 0);
+    Put32(b, ++m_sequence);
+    EndBox(b, mfhd);
+
+    size_t traf = BeginBox(b, "traf");
+    size_t tfhd = BeginFullBox(b, "tfhd", 0, TFHD_DEFAULT_BASE_IS_MOOF);
+    Put32(b, TRACK_ID);
+    EndBox(b, tfhd);
+
+    size_t tfdt = BeginFullBox(b, "tfdt", 1, 0);
+    Put64(b, uint64_t(m_samples[0].timestamp - m_baseTimestamp));
+    EndBox(b, tfdt);
+
+    size_t trun = BeginFullBox(b, "trun", 0, TRUN_DATA_OFFSET | TRUN_SAMPLE_DURATION | TRUN_SAMPLE_SIZE | TRUN_SAMPLE_FLAGS);
+    Put32(b, static_cast<uint32_t>(count));
+    const size_t dataOffsetAt = b.size();
+    Put32(b, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        Put32(b, m_samples[i].duration);
+        Put32(b, m_samples[i].size);
+        Put32(b, m_samples[i].sync ? SAMPLE_FLAGS_SYNC : SAMPLE_FLAGS_NON_SYNC);
+    }
+    EndBox(b, trun);
+    EndBox(b, traf);
+    EndBox(b, moof);
+
+    // Data offset is relative to the moof start: skip the moof and the mdat header
+    Patch32(b, dataOffsetAt, static_cast<uint32_t>(b.size() - moof + 8));
+
+    const size_t payloadSize = m_payload.size();
+    if (payloadSize + 8 > UINT32_MAX)
+        return false;
+
+    Put32(b, static_cast<uint32_t>(payloadSize + 8));
+    PutType(b, "mdat");
+
+    if (fwrite(b.data(), 1, b.size(), m_file) != b.size() ||
+        fwrite(m_payload.data(), 1, payloadSize, m_file) != payloadSize ||
+        fflush(m_file) != 0)
+        return false;
+
+    m_samples.clear();
+    m_payload.clear();
+    return true;
+}
+
+bool Mp4Muxer::Close()
+{
+    if (!m_file)
+        return true;
+
+    // The last sample repeats the previous duration
+    bool ok = true;
+    if (!m_samples.empty())
+    {
+        m_samples.back().duration = m_lastDuration ? m_lastDuration : 1;
+        ok = FlushFragment();
+    }
+
+    ok = (fclose(m_file) == 0) && ok;
+    m_file = nullptr;
+    m_samples.clear();
+    m_payload.clear();
+    return ok;
+}
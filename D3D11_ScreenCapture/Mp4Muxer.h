@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Crash-safe fragmented MP4 (ISO BMFF) muxer for a single video track.
+//
+// The file starts with ftyp + moov (with mvex, no sample tables) and then gets
+// a self-contained moof + mdat pair every `fragmentFrames` samples. Only the
+// samples of the current fragment are kept in memory, so memory stays flat for
+// any recording length, and a crash loses at most the fragment being built.
+// Callers should start each fragment with a sync sample so fragments decode on
+// their own.
+class Mp4Muxer
+{
+public:
+    struct TrackInfo
+    {
+        char     codec[4];                 // sample entry type, e.g. FrameCodec's "TLZ1"
+        uint32_t width;
+        uint32_t height;
+        uint32_t timescale;                // timestamp units per second
+        std::vector<uint8_t> configBox;    // optional complete box appended to the sample entry
+    };
+
+    Mp4Muxer();
+    ~Mp4Muxer();
+
+    Mp4Muxer(const Mp4Muxer&) = delete;
+    Mp4Muxer& operator=(const Mp4Muxer&) = delete;
+
+    bool Open(const char* path, const TrackInfo& track, uint32_t fragmentFrames);
+
+    // Timestamps must increase; a sample's duration is known once the next one arrives
+    bool AddSample(const uint8_t* data, size_t size, int64_t timestamp, bool sync);
+
+    // Flushes the last fragment and closes the file
+    bool Close();
+
+    uint64_t Fragments() const { return m_sequence; }
+
+private:
+    struct Sample
+    {
+        uint32_t size;
+        uint32_t duration;
+        bool sync;
+        int64_t timestamp;
+    };
+
+    bool WriteHeader(const TrackInfo& track);
+    bool FlushFragment();
+
+    FILE* m_file;
+    uint32_t m_fragmentFrames;
+    uint32_t m_sequence;
+    uint32_t m_lastDuration;
+    int64_t m_baseTimestamp;
+    std::vector<Sample> m_samples;      // pending samples of the current fragment
+    std::vector<uint8_t> m_payload;     // their data, becomes the mdat
+    std::vector<uint8_t> m_box;         // scratch for building boxes
+};
@@ -0,0 +1,99 @@
+#include "RawDump.h"
+#include "FileIo.h"
+
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// Writer
+//-----------------------------------------------------------------------------
+RawDumpWriter::RawDumpWriter() : m_file(nullptr), m_frameSize(0)
+{
+}
+
+RawDumpWriter::~RawDumpWriter()
+{
+    Close();
+}
+
+bool RawDumpWriter::Open(const char* path, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t flags)
+{
+    Close();
+
+    m_file = OpenFile(path, "wb");
+    if (!m_file)
+        return false;
+
+    // Frames are written whole, so a large stdio buffer only adds a copy
+    setvbuf(m_file, nullptr, _IONBF, 0);
+
+    RAWDUMP_HEADER header = {};
+    header.magic = RAWDUMP_MAGIC;
+    header.version = RAWDUMP_VERSION;
+    header.width = width;
+    header.height = height;
+    header.rowPitch = rowPitch;
+    header.flags = flags;
+    header.timescale = RAWDUMP_TIMESCALE;
+    m_frameSize = size_t(rowPitch) * height;
+
+    return fwrite(&header, sizeof(header), 1, m_file) == 1;
+}
+
+bool RawDumpWriter::WriteFrame(const uint8_t* pixels, int64_t timestamp)
+{
+    if (!m_file)
+        return false;
+
+    RAWDUMP_FRAME frame = {};
+    frame.timestamp = timestamp;
+
+    if (fwrite(&frame, sizeof(frame), 1, m_file) != 1)
+        return false;
+    return fwrite(pixels, 1, m_frameSize, m_file) == m_frameSize;
+}
+
+bool RawDumpWriter::Close()
+{
+    if (!m_file)
+        return true;
+
+    const bool ok = fclose(m_file) == 0;
+    m_file = nullptr;
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// Reader
+//-----------------------------------------------------------------------------
+bool RawDumpReader::Open(const char* path)
+{
+    m_frameCount = 0;
+    if (!m_file.Open(path) || m_file.Size() < sizeof(RAWDUMP_HEADER))
+        return false;
+
+    memcpy(&m_header, m_file.Data(), sizeof(m_header));
+    if (m_header.magic != RAWDUMP_MAGIC || m_header.version != RAWDUMP_VERSION)
+        return false;
+    if (m_header.width == 0 || m_header.height == 0 || m_header.rowPitch < uint64_t(m_header.width) * 4 || m_header.timescale == 0)
+        return false;
+
+    // A trailing partial record (recorder killed mid-write) is ignored
+    const size_t record = sizeof(RAWDUMP_FRAME) + FrameSize();
+    m_frameCount = (m_file.Size() - sizeof(RAWDUMP_HEADER)) / record;
+    return true;
+}
+
+const uint8_t* RawDumpReader::Frame(size_t index, int64_t* timestamp) const
+{
+    if (index >= m_frameCount)
+        return nullptr;
+
+    const uint8_t* record = m_file.Data() + sizeof(RAWDUMP_HEADER) + index * (sizeof(RAWDUMP_FRAME) + FrameSize());
+    if (timestamp)
+    {
+        RAWDUMP_FRAME frame;
+        memcpy(&frame, record, sizeof(frame));
+        *timestamp = frame.timestamp;
+    }
+    return record + sizeof(RAWDUMP_FRAME);
+}
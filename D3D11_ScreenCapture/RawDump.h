@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include "MappedFile.h"
+
+//-----------------------------------------------------------------------------
+// Raw frame dump: a fixed-size header followed by fixed-size frame records,
+// so frame i lives at sizeof(RAWDUMP_HEADER) + i * record size. The frame
+// count is derived from the file size, which keeps a dump readable up to the
+// last complete frame even if the recorder was killed.
+//-----------------------------------------------------------------------------
+
+#define RAWDUMP_MAGIC   0x46445254 // "TRDF"
+#define RAWDUMP_VERSION 1
+
+#define RAWDUMP_FLAG_BOTTOM_UP 0x00000001 // rows are stored last row first (Capture::buf layout)
+
+// 100-ns units, as used by Media Foundation sample times
+#define RAWDUMP_TIMESCALE 10000000
+
+#pragma pack(push,1)
+
+struct RAWDUMP_HEADER
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowPitch;     // bytes per row, 32-bit BGRA pixels
+    uint32_t flags;
+    uint32_t timescale;    // timestamp units per second
+    uint32_t reserved;
+};
+
+struct RAWDUMP_FRAME
+{
+    int64_t  timestamp;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+#pragma pack(pop)
+
+class RawDumpWriter
+{
+public:
+    RawDumpWriter();
+    ~RawDumpWriter();
+
+    bool Open(const char* path, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t flags);
+    bool WriteFrame(const uint8_t* pixels, int64_t timestamp);
+    bool Close();
+
+private:
+    FILE* m_file;
+    size_t m_frameSize;
+};
+
+class RawDumpReader
+{
+public:
+    bool Open(const char* path);
+
+    const RAWDUMP_HEADER& Header() const { return m_header; }
+    size_t FrameSize() const { return size_t(m_header.rowPitch) * m_header.height; }
+    size_t FrameCount() const { return m_frameCount; }
+
+    const uint8_t* Frame(size_t index, int64_t* timestamp = nullptr) const;
+
+private:
+    MappedFile m_file;
+    RAWDUMP_HEADER m_header = {};
+    size_t m_frameCount = 0;
+};
@@ -0,0 +1,248 @@
+#include "Socket.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#pragma comment(lib, "ws2_32")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    typedef SOCKET NativeSocket;
+    typedef int IoSize;
+
+    // Winsock needs a one-time WSAStartup per process
+    bool StartSockets()
+    {
+        struct Startup
+        {
+            bool ok;
+            Startup() { WSADATA data; ok = WSAStartup(MAKEWORD(2, 2), &data) == 0; }
+            ~Startup() { if (ok) WSACleanup(); }
+        };
+        static Startup startup;
+        return startup.ok;
+    }
+
+    bool WouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+    bool Interrupted() { return false; }
+    void CloseNative(NativeSocket s) { closesocket(s); }
+#else
+    typedef int NativeSocket;
+    typedef size_t IoSize;
+
+    bool StartSockets() { return true; }
+    bool WouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+    bool Interrupted() { return errno == EINTR; }
+    void CloseNative(NativeSocket s) { close(s); }
+#endif
+
+#ifdef MSG_NOSIGNAL
+    const int SEND_FLAGS = MSG_NOSIGNAL;   // a vanished peer is an error, not a SIGPIPE
+#else
+    const int SEND_FLAGS = 0;
+#endif
+
+    NativeSocket Native(intptr_t s) { return static_cast<NativeSocket>(s); }
+}
+
+TcpSocket::TcpSocket() : m_socket(-1)
+{
+}
+
+TcpSocket::~TcpSocket()
+{
+    Close();
+}
+
+bool TcpSocket::Listen(uint16_t port, bool loopbackOnly)
+{
+    Close();
+    if (!StartSockets())
+        return false;
+
+    const NativeSocket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (intptr_t(s) == -1)
+        return false;
+    m_socket = intptr_t(s);
+
+    const int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    if (bind(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(s, 1) != 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool TcpSocket::Accept(TcpSocket& client)
+{
+    if (!IsOpen())
+        return false;
+
+    const NativeSocket s = accept(Native(m_socket), nullptr, nullptr);
+    if (intptr_t(s) == -1)
+        return false;
+
+    client.Close();
+    client.m_socket = intptr_t(s);
+    return true;
+}
+
+bool TcpSocket::Connect(const char* host, uint16_t port)
+{
+    Close();
+    if (!StartSockets())
+        return false;
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result)
+        return false;
+
+    sockaddr_in address = *reinterpret_cast<const sockaddr_in*>(result->ai_addr);
+    address.sin_port = htons(port);
+    freeaddrinfo(result);
+
+    const NativeSocket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (intptr_t(s) == -1)
+        return false;
+    m_socket = intptr_t(s);
+
+    if (connect(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void TcpSocket::Close()
+{
+    if (m_socket != -1)
+        CloseNative(Native(m_socket));
+    m_socket = -1;
+}
+
+bool TcpSocket::IsOpen() const
+{
+    return m_socket != -1;
+}
+
+uint16_t TcpSocket::LocalPort() const
+{
+    sockaddr_in address = {};
+#ifdef _WIN32
+    int length = sizeof(address);
+#else
+    socklen_t length = sizeof(address);
+#endif
+    if (!IsOpen() || getsockname(Native(m_socket), reinterpret_cast<sockaddr*>(&address), &length) != 0)
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+bool TcpSocket::SetNonBlocking(bool nonBlocking)
+{
+    if (!IsOpen())
+        return false;
+#ifdef _WIN32
+    u_long mode = nonBlocking ? 1 : 0;
+    return ioctlsocket(Native(m_socket), FIONBIO, &mode) == 0;
+#else
+    const int flags = fcntl(m_socket, F_GETFL, 0);
+    return flags >= 0 && fcntl(m_socket, F_SETFL, nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) == 0;
+#endif
+}
+
+bool TcpSocket::SetNoDelay(bool noDelay)
+{
+    const int value = noDelay ? 1 : 0;
+    return IsOpen() && setsockopt(Native(m_socket), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+}
+
+ptrdiff_t TcpSocket::SendSome(const void* data, size_t size)
+{
+    if (!IsOpen())
+        return -1;
+
+    // Winsock takes int lengths; a partial send is fine for callers of SendSome
+    const IoSize chunk = size > 0x40000000 ? 0x40000000 : static_cast<IoSize>(size);
+    for (;;)
+    {
+        const auto sent = send(Native(m_socket), static_cast<const char*>(data), chunk, SEND_FLAGS);
+        if (sent >= 0)
+            return ptrdiff_t(sent);
+        if (Interrupted())
+            continue;
+        return WouldBlock() ? 0 : -1;
+    }
+}
+
+ptrdiff_t TcpSocket::ReceiveSome(void* data, size_t size)
+{
+    if (!IsOpen())
+        return -1;
+
+    const IoSize chunk = size > 0x40000000 ? 0x40000000 : static_cast<IoSize>(size);
+    for (;;)
+    {
+        const auto received = recv(Native(m_socket), static_cast<char*>(data), chunk, 0);
+        if (received > 0)
+            return ptrdiff_t(received);
+        if (received == 0)
+            return -1;      // orderly shutdown by the peer
+        if (Interrupted())
+            continue;
+        return WouldBlock() ? 0 : -1;
+    }
+}
+
+bool TcpSocket::SendAll(const void* data, size_t size)
+{
+    const char* p = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ptrdiff_t sent = SendSome(p, size);
+        if (sent <= 0)
+            return false;
+        p += sent;
+        size -= size_t(sent);
+    }
+    return true;
+}
+
+bool TcpSocket::ReceiveAll(void* data, size_t size)
+{
+    char* p = static_cast<char*>(data);
+    while (size > 0)
+    {
+        const ptrdiff_t received = ReceiveSome(p, size);
+        if (received <= 0)
+            return false;
+        p += received;
+        size -= size_t(received);
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Minimal TCP socket over Winsock or BSD sockets.
+//
+// Blocking by default; SetNonBlocking(true) turns Accept/SendSome/ReceiveSome
+// into polls that report "nothing to do" instead of waiting.
+class TcpSocket
+{
+public:
+    TcpSocket();
+    ~TcpSocket();
+
+    TcpSocket(const TcpSocket&) = delete;
+    TcpSocket& operator=(const TcpSocket&) = delete;
+
+    // Listens on 127.0.0.1 (or all interfaces); port 0 picks a free one, see LocalPort()
+    bool Listen(uint16_t port, bool loopbackOnly = true);
+
+    // Replaces `client` with the next pending connection; false if there is none (non-blocking) or on error
+    bool Accept(TcpSocket& client);
+
+    bool Connect(const char* host, uint16_t port);
+    void Close();
+
+    bool IsOpen() const;
+    uint16_t LocalPort() const;
+
+    bool SetNonBlocking(bool nonBlocking);
+    bool SetNoDelay(bool noDelay);
+
+    // Returns the number of bytes transferred, 0 if the call would block, -1 on error or a closed peer
+    ptrdiff_t SendSome(const void* data, size_t size);
+    ptrdiff_t ReceiveSome(void* data, size_t size);
+
+    // Blocking helpers for blocking sockets
+    bool SendAll(const void* data, size_t size);
+    bool ReceiveAll(void* data, size_t size);
+
+private:
+    intptr_t m_socket;      // SOCKET or file descriptor, -1 when closed
+};
@@ -0,0 +1,152 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Identifies the pool and deque of the current worker thread
+    thread_local const ThreadPool* t_pool = nullptr;
+    thread_local unsigned t_index = 0;
+}
+
+ThreadPool::ThreadPool(unsigned threadCount) : m_pending(0), m_next(0), m_stop(false)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < threadCount; ++i)
+        m_queues.emplace_back(new Queue());
+
+    for (unsigned i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_wakeLock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void ThreadPool::Push(std::function<void()> task)
+{
+    const unsigned index = (t_pool == this) ? t_index : m_next++ % Size();
+    {
+        // Counted before it is queued so that a pop never sees the counter at zero;
+        // taking the lock orders the increment against a worker going to sleep
+        std::lock_guard<std::mutex> guard(m_wakeLock);
+        ++m_pending;
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_queues[index]->lock);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+bool ThreadPool::TryPop(unsigned index, std::function<void()>& task)
+{
+    Queue& queue = *m_queues[index];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.tasks.empty())
+        return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    --m_pending;
+    return true;
+}
+
+bool ThreadPool::TrySteal(unsigned thief, std::function<void()>& task)
+{
+    const unsigned count = Size();
+    for (unsigned i = 1; i <= count; ++i)
+    {
+        Queue& queue = *m_queues[(thief + i) % count];
+        std::unique_lock<std::mutex> guard(queue.lock, std::try_to_lock);
+        if (!guard.owns_lock() || queue.tasks.empty())
+            continue;
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --m_pending;
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::RunPendingTask()
+{
+    std::function<void()> task;
+    const unsigned index = (t_pool == this) ? t_index : 0;
+    if (TryPop(index, task) || TrySteal(index, task))
+    {
+        task();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned index)
+{
+    t_pool = this;
+    t_index = index;
+
+    for (;;)
+    {
+        std::function<void()> task;
+        if (TryPop(index, task) || TrySteal(index, task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(m_wakeLock);
+        m_wake.wait(guard, [this]() { return m_stop || m_pending > 0; });
+        if (m_stop && m_pending == 0)
+            return;
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if (count == 0)
+        return;
+
+    struct State
+    {
+        std::atomic<size_t> next;
+        std::atomic<size_t> done;
+    };
+    auto state = std::make_shared<State>();
+    state->next = 0;
+    state->done = 0;
+
+    auto run = [state, count, &body]()
+    {
+        for (size_t i = state->next++; i < count; i = state->next++)
+        {
+            body(i);
+            ++state->done;
+        }
+    };
+
+    // Helpers that start after the range is exhausted return immediately,
+    // so `body` is never touched once `done` reaches `count`.
+    const size_t helpers = std::min<size_t>(count, Size()) - 1;
+    for (size_t i = 0; i < helpers; ++i)
+        Push(run);
+
+    run();
+
+    while (state->done < count)
+    {
+        if (!RunPendingTask())
+            std::this_thread::yield();
+    }
+}
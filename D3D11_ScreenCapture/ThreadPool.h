@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+//
+// Every worker owns a deque: tasks submitted from a worker go to the back of its
+// own deque and are popped LIFO (cache-warm), idle workers steal FIFO from the
+// front of the other deques. Tasks submitted from outside the pool are spread
+// round-robin over the deques.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threadCount = 0);   // 0 - one worker per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned Size() const { return static_cast<unsigned>(m_queues.size()); }
+
+    template <class F>
+    auto Submit(F&& f) -> std::future<decltype(f())>
+    {
+        using Result = decltype(f());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        std::future<Result> result = task->get_future();
+        Push([task]() { (*task)(); });
+        return result;
+    }
+
+    // Runs body(i) for i in [0, count). The calling thread takes part in the work,
+    // so it is safe to call from inside a pool task.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    // Runs one queued task on the calling thread, if there is any.
+    bool RunPendingTask();
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void Push(std::function<void()> task);
+    bool TryPop(unsigned index, std::function<void()>& task);
+    bool TrySteal(unsigned thief, std::function<void()>& task);
+    void WorkerLoop(unsigned index);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::mutex m_wakeLock;
+    std::condition_variable m_wake;
+    std::atomic<size_t> m_pending;
+    std::atomic<unsigned> m_next;
+    bool m_stop;
+};
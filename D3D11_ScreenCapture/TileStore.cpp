@@ -0,0 +1,488 @@
+#include "TileStore.h"
+#include "FileIo.h"
+#include "Lz.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace
+{
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+    const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+
+    inline uint64_t Rotl(uint64_t v, int bits)
+    {
+        return (v << bits) | (v >> (64 - bits));
+    }
+
+    inline uint64_t Read64(const uint8_t* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t Round(uint64_t acc, uint64_t input)
+    {
+        return Rotl(acc + input * PRIME2, 31) * PRIME1;
+    }
+
+    inline uint64_t Merge(uint64_t hash, uint64_t value)
+    {
+        return (hash ^ Round(0, value)) * PRIME1 + PRIME4;
+    }
+
+    inline uint64_t Avalanche(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        return h ^ (h >> 32);
+    }
+
+    uint32_t TilesAcross(uint32_t size, uint32_t tileSize)
+    {
+        return (size + tileSize - 1) / tileSize;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Tile keys: four multiply-rotate lanes over the rows, finished two different
+// ways into the two halves of the key
+//-----------------------------------------------------------------------------
+TILESTORE_KEY TileStoreKey(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height)
+{
+    const size_t rowBytes = size_t(width) * 4;
+    uint64_t v0 = PRIME1 + PRIME2 + width;
+    uint64_t v1 = PRIME2 + height;
+    uint64_t v2 = 0;
+    uint64_t v3 = 0 - PRIME1;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = bgra + ptrdiff_t(y) * pitch;
+        size_t i = 0;
+        for (; i + 32 <= rowBytes; i += 32)
+        {
+            v0 = Round(v0, Read64(row + i));
+            v1 = Round(v1, Read64(row + i + 8));
+            v2 = Round(v2, Read64(row + i + 16));
+            v3 = Round(v3, Read64(row + i + 24));
+        }
+        for (; i + 8 <= rowBytes; i += 8)
+            v0 = Round(v0, Read64(row + i));
+        if (i < rowBytes)
+        {
+            uint64_t last = 0;
+            memcpy(&last, row + i, rowBytes - i);
+            v1 = Round(v1, last);
+        }
+    }
+
+    uint64_t lo = Rotl(v0, 1) + Rotl(v1, 7) + Rotl(v2, 12) + Rotl(v3, 18);
+    lo = Merge(Merge(Merge(Merge(lo, v0), v1), v2), v3);
+    uint64_t hi = Rotl(v3, 5) ^ Rotl(v2, 23) ^ Rotl(v1, 41) ^ v0;
+    hi = Merge(Merge(Merge(Merge(hi + PRIME3, v3), v2), v1), v0);
+
+    TILESTORE_KEY key;
+    key.lo = Avalanche(lo);
+    key.hi = Avalanche(hi ^ (uint64_t(width) << 32 | height));
+    return key;
+}
+
+//-----------------------------------------------------------------------------
+// Writer
+//-----------------------------------------------------------------------------
+TileStoreWriter::TileStoreWriter() :
+    m_tileSize(0), m_pack(0), m_packFile(nullptr), m_packBytes(0), m_shotsFile(nullptr), m_stats()
+{
+}
+
+TileStoreWriter::~TileStoreWriter()
+{
+    Close();
+}
+
+std::string TileStoreWriter::FileName(uint32_t pack, const char* extension) const
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%04u.%s", pack, extension);
+    return m_base + suffix;
+}
+
+bool TileStoreWriter::Open(const char* base, uint32_t tileSize)
+{
+    Close();
+
+    if (!base || tileSize == 0)
+        return false;
+
+    m_base = base;
+    m_tileSize = tileSize;
+    m_stats = TileStoreStats();
+
+    // Learn what is already stored; the new session gets the first free pack number
+    bool sizeKnown = false;
+    for (m_pack = 0;; ++m_pack)
+    {
+        MappedFile pack;
+        if (!pack.Open(FileName(m_pack, "tiles").c_str()))
+            break;
+
+        TileStoreReader::ForEachTile(pack, [this](const TILESTORE_TILE& tile) { m_known.insert(tile.key); });
+
+        MappedFile shots;
+        if (!sizeKnown && shots.Open(FileName(m_pack, "shots").c_str()) && shots.Size() >= sizeof(TILESTORE_SHOTS_HEADER))
+        {
+            const TILESTORE_SHOTS_HEADER* header = reinterpret_cast<const TILESTORE_SHOTS_HEADER*>(shots.Data());
+            if (header->magic == TILESTORE_SHOTS_MAGIC && header->tileSize != 0)
+            {
+                m_tileSize = header->tileSize;
+                sizeKnown = true;
+            }
+        }
+    }
+    return true;
+}
+
+// The files of a session are created with its first screenshot
+bool TileStoreWriter::OpenSession()
+{
+    if (!OpenPack())
+        return false;
+
+    m_shotsFile = OpenFile(FileName(m_pack, "shots").c_str(), "wb");
+    if (!m_shotsFile)
+        return false;
+
+    TILESTORE_SHOTS_HEADER header = {};
+    header.magic = TILESTORE_SHOTS_MAGIC;
+    header.version = TILESTORE_VERSION;
+    header.tileSize = m_tileSize;
+    m_stats.archiveBytes += sizeof(header);
+    return fwrite(&header, sizeof(header), 1, m_shotsFile) == 1;
+}
+
+bool TileStoreWriter::OpenPack()
+{
+    m_packFile = OpenFile(FileName(m_pack, "tiles").c_str(), "wb");
+    if (!m_packFile)
+        return false;
+
+    setvbuf(m_packFile, nullptr, _IOFBF, 1 << 20);
+
+    TILESTORE_PACK_HEADER header = {};
+    header.magic = TILESTORE_PACK_MAGIC;
+    header.version = TILESTORE_VERSION;
+    m_packBytes = sizeof(header);
+    m_stats.archiveBytes += sizeof(header);
+    return fwrite(&header, sizeof(header), 1, m_packFile) == 1;
+}
+
+bool TileStoreWriter::Add(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, int64_t timestamp,
+                          ThreadPool* pool)
+{
+    if (m_base.empty() || !bgra || width == 0 || height == 0)
+        return false;
+
+    if (!m_shotsFile && !OpenSession())
+    {
+        Close();
+        return false;
+    }
+
+    const uint32_t tileSize = m_tileSize;
+    const uint32_t columns = TilesAcross(width, tileSize);
+    const uint32_t rows = TilesAcross(height, tileSize);
+    const size_t tileCount = size_t(columns) * rows;
+
+    auto forEach = [pool](size_t count, const std::function<void(size_t)>& body)
+    {
+        if (pool)
+            pool->ParallelFor(count, body);
+        else
+            for (size_t i = 0; i < count; ++i)
+                body(i);
+    };
+
+    auto tileOrigin = [&](size_t tile) { return bgra + ptrdiff_t(tile / columns * tileSize) * pitch + tile % columns * tileSize * 4; };
+    auto tileWidth = [&](size_t tile) { return std::min(tileSize, width - uint32_t(tile % columns) * tileSize); };
+    auto tileHeight = [&](size_t tile) { return std::min(tileSize, height - uint32_t(tile / columns) * tileSize); };
+
+    std::vector<TILESTORE_KEY> keys(tileCount);
+    forEach(rows, [&](size_t row)
+    {
+        for (size_t tile = row * columns; tile < (row + 1) * columns; ++tile)
+            keys[tile] = TileStoreKey(tileOrigin(tile), pitch, tileWidth(tile), tileHeight(tile));
+    });
+
+    // Tiles seen for the first time, each once even if it repeats within the screenshot
+    std::vector<size_t> fresh;
+    for (size_t tile = 0; tile < tileCount; ++tile)
+    {
+        if (m_known.insert(keys[tile]).second)
+            fresh.push_back(tile);
+    }
+
+    std::vector<std::vector<uint8_t>> stored(fresh.size());
+    std::vector<uint32_t> rawSizes(fresh.size());
+    forEach(fresh.size(), [&](size_t i)
+    {
+        const size_t tile = fresh[i];
+        const uint32_t w = tileWidth(tile);
+        const uint32_t h = tileHeight(tile);
+        const size_t rowBytes = size_t(w) * 4;
+        const size_t rawSize = rowBytes * h;
+
+        std::vector<uint8_t> raw(rawSize);
+        const uint8_t* src = tileOrigin(tile);
+        for (uint32_t y = 0; y < h; ++y)
+            memcpy(raw.data() + y * rowBytes, src + ptrdiff_t(y) * pitch, rowBytes);
+
+        std::vector<uint8_t>& out = stored[i];
+        out.resize(LzCompressBound(rawSize));
+        const size_t size = LzCompress(raw.data(), rawSize, out.data(), out.size());
+        if (size == 0 || size >= rawSize)
+            out.swap(raw);
+        else
+            out.resize(size);
+        rawSizes[i] = uint32_t(rawSize);
+    });
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < fresh.size(); ++i)
+    {
+        const uint64_t recordBytes = sizeof(TILESTORE_TILE) + stored[i].size();
+        if (m_packBytes + recordBytes > TILESTORE_MAX_PACK_BYTES && m_packBytes > sizeof(TILESTORE_PACK_HEADER))
+        {
+            ok = fclose(m_packFile) == 0;
+            m_packFile = nullptr;
+            ++m_pack;
+            ok = ok && OpenPack();
+            if (!ok)
+                break;
+        }
+
+        TILESTORE_TILE record = {};
+        record.key = keys[fresh[i]];
+        record.rawSize = rawSizes[i];
+        record.storedSize = uint32_t(stored[i].size());
+        ok = fwrite(&record, sizeof(record), 1, m_packFile) == 1 &&
+             fwrite(stored[i].data(), 1, stored[i].size(), m_packFile) == stored[i].size();
+        m_packBytes += recordBytes;
+        m_stats.archiveBytes += recordBytes;
+    }
+
+    // The tiles reach the file before the manifest that names them
+    ok = ok && fflush(m_packFile) == 0;
+
+    TILESTORE_SHOT shot = {};
+    shot.timestamp = timestamp;
+    shot.width = width;
+    shot.height = height;
+    shot.tileCount = uint32_t(tileCount);
+    ok = ok && fwrite(&shot, sizeof(shot), 1, m_shotsFile) == 1 &&
+         fwrite(keys.data(), sizeof(TILESTORE_KEY), tileCount, m_shotsFile) == tileCount &&
+         fflush(m_shotsFile) == 0;
+
+    if (!ok)
+    {
+        Close();
+        return false;
+    }
+
+    m_stats.archiveBytes += sizeof(shot) + tileCount * sizeof(TILESTORE_KEY);
+    ++m_stats.screenshots;
+    m_stats.tiles += tileCount;
+    m_stats.storedTiles += fresh.size();
+    m_stats.rawBytes += uint64_t(width) * height * 4;
+    return true;
+}
+
+bool TileStoreWriter::Close()
+{
+    bool ok = true;
+    if (m_packFile)
+        ok = fclose(m_packFile) == 0;
+    if (m_shotsFile)
+        ok = (fclose(m_shotsFile) == 0) && ok;
+    m_packFile = nullptr;
+    m_shotsFile = nullptr;
+    m_base.clear();
+    m_known.clear();
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// Reader
+//-----------------------------------------------------------------------------
+TileStoreReader::TileStoreReader() : m_tileSize(0)
+{
+}
+
+TileStoreReader::~TileStoreReader()
+{
+    Close();
+}
+
+bool TileStoreReader::Open(const char* base)
+{
+    Close();
+
+    if (!base)
+        return false;
+
+    for (uint32_t number = 0;; ++number)
+    {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%04u.tiles", number);
+        std::unique_ptr<MappedFile> pack(new MappedFile());
+        if (!pack->Open((std::string(base) + suffix).c_str()))
+            break;
+        if (!IndexPack(*pack))
+        {
+            Close();
+            return false;
+        }
+        m_files.push_back(std::move(pack));
+
+        snprintf(suffix, sizeof(suffix), ".%04u.shots", number);
+        std::unique_ptr<MappedFile> shots(new MappedFile());
+        if (!shots->Open((std::string(base) + suffix).c_str()))
+            continue;
+        if (!ReadShots(*shots))
+        {
+            Close();
+            return false;
+        }
+        m_files.push_back(std::move(shots));
+    }
+    return !m_files.empty();
+}
+
+void TileStoreReader::Close()
+{
+    m_tiles.clear();
+    m_shots.clear();
+    m_files.clear();
+    m_tileSize = 0;
+}
+
+bool TileStoreReader::IndexPack(const MappedFile& pack)
+{
+    return ForEachTile(pack, [this](const TILESTORE_TILE& tile) { m_tiles.emplace(tile.key, &tile); });
+}
+
+// Stops at a record cut short; it can't be named by any complete manifest
+bool TileStoreReader::ForEachTile(const MappedFile& pack, const std::function<void(const TILESTORE_TILE&)>& visit)
+{
+    if (pack.Size() < sizeof(TILESTORE_PACK_HEADER))
+        return false;
+    const TILESTORE_PACK_HEADER* header = reinterpret_cast<const TILESTORE_PACK_HEADER*>(pack.Data());
+    if (header->magic != TILESTORE_PACK_MAGIC || header->version != TILESTORE_VERSION)
+        return false;
+
+    const uint8_t* p = pack.Data() + sizeof(TILESTORE_PACK_HEADER);
+    const uint8_t* end = pack.Data() + pack.Size();
+    while (size_t(end - p) >= sizeof(TILESTORE_TILE))
+    {
+        const TILESTORE_TILE* tile = reinterpret_cast<const TILESTORE_TILE*>(p);
+        if (tile->storedSize > tile->rawSize || tile->storedSize > size_t(end - p) - sizeof(TILESTORE_TILE))
+            break;
+        visit(*tile);
+        p += sizeof(TILESTORE_TILE) + tile->storedSize;
+    }
+    return true;
+}
+
+bool TileStoreReader::ReadShots(const MappedFile& shots)
+{
+    if (shots.Size() < sizeof(TILESTORE_SHOTS_HEADER))
+        return false;
+    const TILESTORE_SHOTS_HEADER* header = reinterpret_cast<const TILESTORE_SHOTS_HEADER*>(shots.Data());
+    if (header->magic != TILESTORE_SHOTS_MAGIC || header->version != TILESTORE_VERSION || header->tileSize == 0)
+        return false;
+    if (m_tileSize != 0 && header->tileSize != m_tileSize)
+        return false;
+    m_tileSize = header->tileSize;
+
+    const uint8_t* p = shots.Data() + sizeof(TILESTORE_SHOTS_HEADER);
+    const uint8_t* end = shots.Data() + shots.Size();
+    while (size_t(end - p) >= sizeof(TILESTORE_SHOT))
+    {
+        const TILESTORE_SHOT* shot = reinterpret_cast<const TILESTORE_SHOT*>(p);
+        const uint64_t expected = uint64_t(TilesAcross(shot->width, m_tileSize)) * TilesAcross(shot->height, m_tileSize);
+        if (shot->width == 0 || shot->height == 0 || shot->tileCount != expected)
+            return false;
+
+        const size_t keyBytes = size_t(shot->tileCount) * sizeof(TILESTORE_KEY);
+        if (keyBytes > size_t(end - p) - sizeof(TILESTORE_SHOT))
+            break;
+        m_shots.push_back(shot);
+        p += sizeof(TILESTORE_SHOT) + keyBytes;
+    }
+    return true;
+}
+
+bool TileStoreReader::Reconstruct(size_t index, uint8_t* bgra, ptrdiff_t pitch, ThreadPool* pool) const
+{
+    if (index >= m_shots.size() || !bgra)
+        return false;
+
+    const TILESTORE_SHOT& shot = *m_shots[index];
+    const TILESTORE_KEY* keys = reinterpret_cast<const TILESTORE_KEY*>(m_shots[index] + 1);
+    const uint32_t tileSize = m_tileSize;
+    const uint32_t columns = TilesAcross(shot.width, tileSize);
+    const uint32_t rows = TilesAcross(shot.height, tileSize);
+
+    std::atomic<bool> ok(true);
+    auto rebuildRow = [&](size_t row)
+    {
+        std::vector<uint8_t> scratch(size_t(tileSize) * tileSize * 4);
+        const uint32_t y0 = uint32_t(row) * tileSize;
+        const uint32_t h = std::min(tileSize, shot.height - y0);
+
+        for (uint32_t column = 0; column < columns; ++column)
+        {
+            const uint32_t x0 = column * tileSize;
+            const uint32_t w = std::min(tileSize, shot.width - x0);
+            const size_t rowBytes = size_t(w) * 4;
+
+            auto found = m_tiles.find(keys[row * columns + column]);
+            if (found == m_tiles.end() || found->second->rawSize != rowBytes * h)
+            {
+                ok = false;
+                return;
+            }
+
+            const TILESTORE_TILE* tile = found->second;
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(tile + 1);
+            if (tile->storedSize != tile->rawSize)
+            {
+                if (!LzDecompress(src, tile->storedSize, scratch.data(), tile->rawSize))
+                {
+                    ok = false;
+                    return;
+                }
+                src = scratch.data();
+            }
+
+            uint8_t* dst = bgra + ptrdiff_t(y0) * pitch + size_t(x0) * 4;
+            for (uint32_t y = 0; y < h; ++y)
+                memcpy(dst + ptrdiff_t(y) * pitch, src + y * rowBytes, rowBytes);
+        }
+    };
+
+    if (pool)
+        pool->ParallelFor(rows, rebuildRow);
+    else
+        for (uint32_t row = 0; row < rows; ++row)
+            rebuildRow(row);
+
+    return ok;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Content-addressed screenshot archive. Every screenshot is cut into square
+// tiles, and each tile is named by a 128-bit hash of its pixels and size. A
+// screenshot is stored as a manifest: its size, its timestamp and the list of
+// tile keys. The tiles live in packfiles, each LZ-compressed (or stored when
+// that doesn't help), and a tile that is already in the archive is never
+// written again. Successive screens of a desktop share most of their tiles,
+// so the archive grows with what actually changed.
+//
+// The files are only ever appended to. An archive `base` is made of
+//   base.NNNN.tiles  packs: TILESTORE_PACK_HEADER, then records of
+//                    TILESTORE_TILE + data; a writer moves on to the next
+//                    pack number when one reaches TILESTORE_MAX_PACK_BYTES
+//   base.NNNN.shots  manifests: TILESTORE_SHOTS_HEADER, then records of
+//                    TILESTORE_SHOT + tileCount keys, written by the session
+//                    that started pack NNNN
+// Every writer session starts a new pack, so files written by earlier
+// sessions are never touched again. A tile record is always written before
+// the first manifest that refers to it. A record cut short by a crash is
+// ignored by readers.
+//
+// The reader maps every file, indexes the tile records by key and rebuilds a
+// screenshot straight from the mapped packs, a row of tiles per task.
+//-----------------------------------------------------------------------------
+
+#define TILESTORE_PACK_MAGIC   0x50535454 // "TTSP"
+#define TILESTORE_SHOTS_MAGIC  0x4d535454 // "TTSM"
+#define TILESTORE_VERSION      1
+
+const uint32_t TILESTORE_DEFAULT_TILE_SIZE = 64;
+const uint64_t TILESTORE_MAX_PACK_BYTES    = uint64_t(1) << 30;
+
+#pragma pack(push,1)
+
+struct TILESTORE_KEY
+{
+    uint64_t lo;
+    uint64_t hi;
+};
+
+struct TILESTORE_PACK_HEADER
+{
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct TILESTORE_TILE
+{
+    TILESTORE_KEY key;
+    uint32_t rawSize;       // width * height * 4 of the tile
+    uint32_t storedSize;    // equal to rawSize when stored uncompressed
+};
+
+struct TILESTORE_SHOTS_HEADER
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t tileSize;
+    uint32_t reserved;
+};
+
+struct TILESTORE_SHOT
+{
+    int64_t  timestamp;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileCount;     // keys following, row by row
+    uint32_t reserved;
+};
+
+#pragma pack(pop)
+
+inline bool operator==(const TILESTORE_KEY& a, const TILESTORE_KEY& b)
+{
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+// Keys are hashes already, so any 64 bits of one make a good bucket index
+struct TileStoreKeyHash
+{
+    size_t operator()(const TILESTORE_KEY& key) const { return static_cast<size_t>(key.lo); }
+};
+
+// Key of a `width` x `height` BGRA tile
+TILESTORE_KEY TileStoreKey(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height);
+
+struct TileStoreStats
+{
+    uint64_t screenshots;
+    uint64_t tiles;          // referenced by manifests
+    uint64_t storedTiles;    // written to packs
+    uint64_t rawBytes;       // pixels of all screenshots
+    uint64_t archiveBytes;   // everything written, headers and manifests included
+};
+
+class TileStoreWriter
+{
+public:
+    TileStoreWriter();
+    ~TileStoreWriter();
+
+    TileStoreWriter(const TileStoreWriter&) = delete;
+    TileStoreWriter& operator=(const TileStoreWriter&) = delete;
+
+    // Opens the archive at `base` for appending, creating it if it doesn't exist. The tile
+    // size of an existing archive wins over `tileSize`.
+    bool Open(const char* base, uint32_t tileSize = TILESTORE_DEFAULT_TILE_SIZE);
+
+    // Adds a top-down BGRA screenshot. Tiles are hashed and compressed on `pool` if given.
+    // A failed write closes the writer, since the pack may end in a partial record.
+    bool Add(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, int64_t timestamp,
+             ThreadPool* pool = nullptr);
+
+    bool Close();
+
+    uint32_t TileSize() const { return m_tileSize; }
+
+    // Counts of this session only
+    const TileStoreStats& Stats() const { return m_stats; }
+
+private:
+    bool OpenSession();
+    bool OpenPack();
+    std::string FileName(uint32_t pack, const char* extension) const;
+
+    std::string m_base;
+    uint32_t m_tileSize;
+    uint32_t m_pack;            // number of the pack being written
+    FILE* m_packFile;
+    uint64_t m_packBytes;
+    FILE* m_shotsFile;
+    std::unordered_set<TILESTORE_KEY, TileStoreKeyHash> m_known;      // tiles already in the archive
+    TileStoreStats m_stats;
+};
+
+class TileStoreReader
+{
+public:
+    TileStoreReader();
+    ~TileStoreReader();
+
+    TileStoreReader(const TileStoreReader&) = delete;
+    TileStoreReader& operator=(const TileStoreReader&) = delete;
+
+    bool Open(const char* base);
+    void Close();
+
+    uint32_t TileSize() const { return m_tileSize; }
+    size_t ScreenshotCount() const { return m_shots.size(); }
+    const TILESTORE_SHOT& Screenshot(size_t index) const { return *m_shots[index]; }
+
+    // Rebuilds screenshot `index` into a top-down BGRA image of its size, rows of tiles
+    // spread over `pool` if given; returns false if a tile is missing or corrupt
+    bool Reconstruct(size_t index, uint8_t* bgra, ptrdiff_t pitch, ThreadPool* pool = nullptr) const;
+
+private:
+    friend class TileStoreWriter;
+
+    // Calls `visit` for every complete tile record of a pack; false if it isn't one
+    static bool ForEachTile(const MappedFile& pack, const std::function<void(const TILESTORE_TILE&)>& visit);
+
+    bool IndexPack(const MappedFile& pack);
+    bool ReadShots(const MappedFile& shots);
+
+    uint32_t m_tileSize;
+    std::vector<std::unique_ptr<MappedFile>> m_files;
+    std::unordered_map<TILESTORE_KEY, const TILESTORE_TILE*, TileStoreKeyHash> m_tiles;
+    std::vector<const TILESTORE_SHOT*> m_shots;     // keys follow each one
+};
@@ -0,0 +1,249 @@
+// TileStoreBench.cpp : storage ratio and reconstruction throughput of the tile store.
+//
+// Portable and not part of the recorder build, e.g. on Linux:
+//   g++ -std=c++14 -O2 -pthread TileStoreBench.cpp TileStore.cpp Lz.cpp MappedFile.cpp ThreadPool.cpp
+//       -o TileStoreBench
+//
+//   TileStoreBench [screenshots] [width] [height] [archive base]
+//
+// Plays an idle-ish working day on a synthetic desktop: a caret typing into a
+// window, a mouse cursor wandering about, a clock that ticks every minute, a
+// text window that scrolls now and then and an occasional switch to a new
+// "photo". Every frame is archived in two writer sessions, so the second one
+// has to pick up the tiles of the first. The archive is compared with storing
+// each screenshot LZ-compressed on its own, then every screenshot is rebuilt on
+// one thread and on the pool and checked against the hash of the original.
+
+#include "TileStore.h"
+#include "Lz.h"
+#include "ThreadPool.h"
+#include "../D3D11_Screenshot/BenchImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct Rect
+    {
+        uint32_t x, y, w, h;
+    };
+
+    void Fill(std::vector<uint8_t>& frame, uint32_t width, const Rect& r, uint32_t color)
+    {
+        for (uint32_t y = r.y; y < r.y + r.h; ++y)
+            for (uint32_t x = r.x; x < r.x + r.w; ++x)
+                memcpy(&frame[(size_t(y) * width + x) * 4], &color, 4);
+    }
+
+    // The desktop changes the way a real one does between screenshots taken once a second
+    class Workload
+    {
+    public:
+        Workload(uint32_t width, uint32_t height) :
+            m_width(width), m_height(height), m_desktop(MakeDesktop(width, height)), m_rng(7),
+            m_editor{ width / 8, height / 6, width / 2, height / 2 },
+            m_caretX(0), m_caretY(0), m_mouseX(width / 2), m_mouseY(height / 2)
+        {
+            Fill(m_desktop, m_width, m_editor, 0xffffffff);
+        }
+
+        // The next screenshot, cursor included
+        const std::vector<uint8_t>& Next(uint32_t second)
+        {
+            // Typing: a glyph most seconds, a new line now and then
+            if (m_rng() % 4 != 0)
+            {
+                const uint32_t glyphWidth = 4 + m_rng() % 5;
+                if (m_caretX + glyphWidth + 2 >= m_editor.w - 16)
+                    NewLine();
+                Fill(m_desktop, m_width, Rect{ m_editor.x + 8 + m_caretX, m_editor.y + 8 + m_caretY, glyphWidth, 10 }, 0xff202020);
+                m_caretX += glyphWidth + 2;
+            }
+            if (m_rng() % 40 == 0)
+                NewLine();
+
+            // The clock in the corner
+            if (second % 60 == 0)
+            {
+                const uint32_t minute = second / 60;
+                Fill(m_desktop, m_width, Rect{ m_width - 72, m_height - 20, 64, 14 }, 0xff1f1f1f);
+                for (uint32_t digit = 0; digit < 4; ++digit)
+                {
+                    const uint32_t shade = 0xff808080 + ((minute * 37 + digit * 11) % 127) * 0x010101;
+                    Fill(m_desktop, m_width, Rect{ m_width - 70 + digit * 15, m_height - 18, 10, 10 }, shade);
+                }
+            }
+
+            // Switching to a picture: a block of new noise
+            if (second % 300 == 150)
+            {
+                const Rect photo{ m_width / 2, m_height / 8, m_width / 3, m_height / 3 };
+                for (uint32_t y = photo.y; y < photo.y + photo.h; ++y)
+                    for (uint32_t x = photo.x; x < photo.x + photo.w; ++x)
+                        for (int c = 0; c < 3; ++c)
+                            m_desktop[(size_t(y) * m_width + x) * 4 + c] = uint8_t(m_rng());
+            }
+
+            m_frame = m_desktop;
+
+            // The mouse wanders, mostly a little
+            const int step = m_rng() % 10 == 0 ? 400 : 24;
+            m_mouseX = uint32_t(std::min<int>(int(m_width) - 16, std::max(0, int(m_mouseX) + int(m_rng() % (2 * step)) - step)));
+            m_mouseY = uint32_t(std::min<int>(int(m_height) - 24, std::max(0, int(m_mouseY) + int(m_rng() % (2 * step)) - step)));
+            for (uint32_t y = 0; y < 19; ++y)
+                Fill(m_frame, m_width, Rect{ m_mouseX, m_mouseY + y, std::max(1u, y * 11 / 19), 1 }, y == 18 ? 0xff000000 : 0xfff8f8f8);
+
+            return m_frame;
+        }
+
+    private:
+        // The editor scrolls by a line once the caret reaches the bottom
+        void NewLine()
+        {
+            m_caretX = 0;
+            m_caretY += 14;
+            if (m_caretY + 24 < m_editor.h)
+                return;
+
+            m_caretY -= 14;
+            const size_t rowBytes = size_t(m_editor.w) * 4;
+            for (uint32_t y = m_editor.y; y + 14 < m_editor.y + m_editor.h; ++y)
+                memmove(&m_desktop[(size_t(y) * m_width + m_editor.x) * 4], &m_desktop[(size_t(y + 14) * m_width + m_editor.x) * 4], rowBytes);
+            Fill(m_desktop, m_width, Rect{ m_editor.x, m_editor.y + m_editor.h - 14, m_editor.w, 14 }, 0xffffffff);
+        }
+
+        uint32_t m_width, m_height;
+        std::vector<uint8_t> m_desktop;
+        std::vector<uint8_t> m_frame;
+        std::mt19937 m_rng;
+        Rect m_editor;
+        uint32_t m_caretX, m_caretY;
+        uint32_t m_mouseX, m_mouseY;
+    };
+
+    void RemoveArchive(const std::string& base)
+    {
+        for (uint32_t number = 0; number < 10000; ++number)
+        {
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), ".%04u.tiles", number);
+            if (std::remove((base + suffix).c_str()) != 0)
+                break;
+            snprintf(suffix, sizeof(suffix), ".%04u.shots", number);
+            std::remove((base + suffix).c_str());
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const uint32_t count = argc > 1 ? uint32_t(atoi(argv[1])) : 600;
+    const uint32_t width = argc > 2 ? uint32_t(atoi(argv[2])) : 1920;
+    const uint32_t height = argc > 3 ? uint32_t(atoi(argv[3])) : 1080;
+    const std::string base = argc > 4 ? argv[4] : "tilestore_bench";
+
+    if (count < 2 || width < 256 || height < 256)
+    {
+        std::cerr << "Needs at least 2 screenshots of 256x256" << std::endl;
+        return -1;
+    }
+
+    RemoveArchive(base);
+    ThreadPool pool;
+    Workload workload(width, height);
+    const size_t frameBytes = size_t(width) * height * 4;
+
+    // Archive in two sessions and keep a hash of every screenshot for the check
+    std::vector<TILESTORE_KEY> hashes;
+    std::vector<uint8_t> lz(LzCompressBound(frameBytes));
+    uint64_t separateBytes = 0;
+    uint64_t archiveBytes = 0;
+    uint64_t storedTiles = 0;
+    uint64_t tiles = 0;
+    double addSeconds = 0.0;
+    for (uint32_t session = 0; session < 2; ++session)
+    {
+        TileStoreWriter writer;
+        if (!writer.Open(base.c_str()))
+        {
+            std::cerr << "Can't open " << base << std::endl;
+            return -1;
+        }
+
+        const uint32_t first = session == 0 ? 0 : count / 2;
+        const uint32_t last = session == 0 ? count / 2 : count;
+        for (uint32_t second = first; second < last; ++second)
+        {
+            const std::vector<uint8_t>& frame = workload.Next(second);
+            hashes.push_back(TileStoreKey(frame.data(), ptrdiff_t(width) * 4, width, height));
+            separateBytes += LzCompress(frame.data(), frameBytes, lz.data(), lz.size());
+
+            const auto start = std::chrono::steady_clock::now();
+            if (!writer.Add(frame.data(), ptrdiff_t(width) * 4, width, height, int64_t(second), &pool))
+            {
+                std::cerr << "Writing screenshot " << second << " failed" << std::endl;
+                return -1;
+            }
+            addSeconds += SecondsSince(start);
+        }
+
+        archiveBytes += writer.Stats().archiveBytes;
+        storedTiles += writer.Stats().storedTiles;
+        tiles += writer.Stats().tiles;
+        if (!writer.Close())
+            return -1;
+    }
+
+    const double rawMB = double(frameBytes) * count / 1e6;
+    std::cout << count << " screenshots " << width << "x" << height << ", " << rawMB << " MB raw" << std::endl;
+    std::cout << "  LZ each on its own: " << separateBytes / 1e6 << " MB (" << rawMB * 1e6 / separateBytes << ":1)" << std::endl;
+    std::cout << "  tile store:         " << archiveBytes / 1e6 << " MB (" << rawMB * 1e6 / archiveBytes << ":1), "
+              << storedTiles << " of " << tiles << " tiles stored" << std::endl;
+    std::cout << "  archiving:          " << rawMB / addSeconds << " MB/s, " << count / addSeconds << " screenshots/s ("
+              << pool.Size() << " threads)" << std::endl;
+
+    TileStoreReader reader;
+    if (!reader.Open(base.c_str()) || reader.ScreenshotCount() != count)
+    {
+        std::cerr << "Reading the archive back failed" << std::endl;
+        return -1;
+    }
+
+    std::vector<uint8_t> rebuilt(frameBytes);
+    bool allOk = true;
+    for (int threaded = 0; threaded < 2; ++threaded)
+    {
+        uint32_t mismatches = 0;
+        double seconds = 0.0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            memset(rebuilt.data(), 0, rebuilt.size());
+            const auto start = std::chrono::steady_clock::now();
+            const bool ok = reader.Reconstruct(i, rebuilt.data(), ptrdiff_t(width) * 4, threaded ? &pool : nullptr);
+            seconds += SecondsSince(start);
+            if (!ok || !(TileStoreKey(rebuilt.data(), ptrdiff_t(width) * 4, width, height) == hashes[i]))
+                ++mismatches;
+        }
+        std::cout << "  rebuilding, " << (threaded ? "pool:      " : "one thread:") << " " << rawMB / seconds << " MB/s, "
+                  << count / seconds << " screenshots/s, " << (mismatches ? "MISMATCHES " : "all match ") << "("
+                  << mismatches << ")" << std::endl;
+        allOk = allOk && mismatches == 0;
+    }
+
+    reader.Close();
+    RemoveArchive(base);
+    return allOk ? 0 : 1;
+}
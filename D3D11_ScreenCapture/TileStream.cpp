@@ -0,0 +1,412 @@
+#include "TileStream.h"
+#include "Lz.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    const size_t MAX_REQUEST_SIZE = 64;
+
+    template <class T>
+    void Append(std::vector<uint8_t>& out, const T& value)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), p, p + sizeof(T));
+    }
+}
+
+int64_t TileStreamClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TileStreamSender::TileStreamSender() :
+    m_width(0), m_height(0), m_columns(0), m_rows(0), m_sequence(0), m_acked(0), m_keyPending(true), m_dirty(false),
+    m_outOffset(0), m_framesSent(0), m_framesCoalesced(0), m_keyFrames(0), m_tilesSent(0), m_bytesSent(0)
+{
+}
+
+bool TileStreamSender::Open(uint16_t port, uint32_t width, uint32_t height)
+{
+    Close();
+    if (width == 0 || height == 0 || width > 0xffff * TILESTREAM_TILE_SIZE || height > 0xffff * TILESTREAM_TILE_SIZE)
+        return false;
+
+    if (!m_listener.Listen(port) || !m_listener.SetNonBlocking(true))
+    {
+        m_listener.Close();
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_columns = (width + TILESTREAM_TILE_SIZE - 1) / TILESTREAM_TILE_SIZE;
+    m_rows = (height + TILESTREAM_TILE_SIZE - 1) / TILESTREAM_TILE_SIZE;
+    m_reference.assign(size_t(width) * height * 4, 0);
+    m_tile.resize(TILESTREAM_TILE_SIZE * TILESTREAM_TILE_SIZE * 4);
+    return true;
+}
+
+void TileStreamSender::Close()
+{
+    Disconnect();
+    m_listener.Close();
+}
+
+void TileStreamSender::Disconnect()
+{
+    m_client.Close();
+    m_out.clear();
+    m_outOffset = 0;
+    m_in.clear();
+}
+
+void TileStreamSender::AcceptViewer()
+{
+    if (m_client.IsOpen() || !m_listener.Accept(m_client))
+        return;
+
+    m_client.SetNonBlocking(true);
+    m_client.SetNoDelay(true);
+
+    // A new viewer has nothing yet
+    m_keyPending = true;
+    m_acked = m_sequence;
+    m_out.clear();
+    m_outOffset = 0;
+    m_in.clear();
+
+    TILESTREAM_HELLO hello = {};
+    hello.magic = TILESTREAM_MAGIC;
+    hello.width = m_width;
+    hello.height = m_height;
+    hello.tileSize = TILESTREAM_TILE_SIZE;
+    AppendMessage(TILESTREAM_MSG_HELLO, &hello, sizeof(hello));
+}
+
+void TileStreamSender::ReadRequests()
+{
+    uint8_t buffer[256];
+    for (;;)
+    {
+        const ptrdiff_t received = m_client.ReceiveSome(buffer, sizeof(buffer));
+        if (received < 0)
+        {
+            Disconnect();
+            return;
+        }
+        if (received == 0)
+            break;
+        m_in.insert(m_in.end(), buffer, buffer + received);
+    }
+
+    size_t offset = 0;
+    while (m_in.size() - offset >= sizeof(TILESTREAM_MESSAGE))
+    {
+        TILESTREAM_MESSAGE message;
+        memcpy(&message, m_in.data() + offset, sizeof(message));
+        if (message.size > MAX_REQUEST_SIZE)
+        {
+            Disconnect();
+            return;
+        }
+        if (m_in.size() - offset < sizeof(message) + message.size)
+            break;
+
+        TILESTREAM_SEQUENCE request = {};
+        memcpy(&request, m_in.data() + offset + sizeof(message), std::min<size_t>(message.size, sizeof(request)));
+        if (message.type == TILESTREAM_MSG_KEY_REQUEST)
+            m_keyPending = true;
+        else if (message.type == TILESTREAM_MSG_ACK && request.sequence - m_acked <= m_sequence - m_acked)
+            m_acked = request.sequence;
+        offset += sizeof(message) + message.size;
+    }
+    m_in.erase(m_in.begin(), m_in.begin() + ptrdiff_t(offset));
+}
+
+bool TileStreamSender::Flush()
+{
+    while (m_outOffset < m_out.size())
+    {
+        const ptrdiff_t sent = m_client.SendSome(m_out.data() + m_outOffset, m_out.size() - m_outOffset);
+        if (sent < 0)
+        {
+            Disconnect();
+            return false;
+        }
+        if (sent == 0)
+            return false;
+        m_outOffset += size_t(sent);
+        m_bytesSent += uint64_t(sent);
+    }
+    m_out.clear();
+    m_outOffset = 0;
+    return true;
+}
+
+void TileStreamSender::Poll()
+{
+    AcceptViewer();
+    if (m_client.IsOpen())
+        ReadRequests();
+    if (m_client.IsOpen())
+        Flush();
+}
+
+bool TileStreamSender::Pending() const
+{
+    return m_client.IsOpen() && (m_dirty || m_keyPending);
+}
+
+void TileStreamSender::AppendMessage(uint32_t type, const void* payload, size_t size)
+{
+    TILESTREAM_MESSAGE message = { type, static_cast<uint32_t>(size) };
+    Append(m_out, message);
+    const uint8_t* p = static_cast<const uint8_t*>(payload);
+    m_out.insert(m_out.end(), p, p + size);
+}
+
+bool TileStreamSender::SendFrame(const uint8_t* bgra, ptrdiff_t stride, int64_t timestamp)
+{
+    if (!m_listener.IsOpen())
+        return false;
+
+    Poll();
+    if (!m_client.IsOpen())
+        return true;
+
+    // The viewer is behind: hold the changes back, they stay different from the
+    // reference and go out with the next frame that is sent
+    if (!Flushed() || m_sequence - m_acked >= TILESTREAM_MAX_IN_FLIGHT)
+    {
+        m_dirty = true;
+        ++m_framesCoalesced;
+        return true;
+    }
+
+    const bool key = m_keyPending;
+    const size_t frameOffset = m_out.size();
+    m_out.resize(frameOffset + sizeof(TILESTREAM_MESSAGE) + sizeof(TILESTREAM_FRAME));
+
+    uint32_t tileCount = 0;
+    for (uint32_t row = 0; row < m_rows; ++row)
+    {
+        const uint32_t y0 = row * TILESTREAM_TILE_SIZE;
+        const uint32_t tileHeight = std::min(TILESTREAM_TILE_SIZE, m_height - y0);
+
+        for (uint32_t column = 0; column < m_columns; ++column)
+        {
+            const uint32_t x0 = column * TILESTREAM_TILE_SIZE;
+            const size_t rowBytes = size_t(std::min(TILESTREAM_TILE_SIZE, m_width - x0)) * 4;
+            const uint8_t* src = bgra + ptrdiff_t(y0) * stride + ptrdiff_t(x0) * 4;
+            uint8_t* ref = m_reference.data() + (size_t(y0) * m_width + x0) * 4;
+            const size_t refPitch = size_t(m_width) * 4;
+
+            bool changed = key;
+            for (uint32_t y = 0; y < tileHeight && !changed; ++y)
+                changed = memcmp(src + ptrdiff_t(y) * stride, ref + y * refPitch, rowBytes) != 0;
+            if (!changed)
+                continue;
+
+            // Pack the tile and bring the reference up to date with what the viewer will have
+            for (uint32_t y = 0; y < tileHeight; ++y)
+            {
+                memcpy(m_tile.data() + y * rowBytes, src + ptrdiff_t(y) * stride, rowBytes);
+                memcpy(ref + y * refPitch, src + ptrdiff_t(y) * stride, rowBytes);
+            }
+            const size_t rawSize = rowBytes * tileHeight;
+
+            const size_t tileOffset = m_out.size();
+            m_out.resize(tileOffset + sizeof(TILESTREAM_TILE) + LzCompressBound(rawSize));
+            uint8_t* data = m_out.data() + tileOffset + sizeof(TILESTREAM_TILE);
+            size_t size = LzCompress(m_tile.data(), rawSize, data, rawSize - 1);
+            if (size == 0)
+            {
+                memcpy(data, m_tile.data(), rawSize);
+                size = rawSize;
+            }
+            m_out.resize(tileOffset + sizeof(TILESTREAM_TILE) + size);
+
+            TILESTREAM_TILE tile = { static_cast<uint16_t>(column), static_cast<uint16_t>(row), static_cast<uint32_t>(size) };
+            memcpy(m_out.data() + tileOffset, &tile, sizeof(tile));
+            ++tileCount;
+        }
+    }
+
+    m_dirty = false;
+    if (tileCount == 0)
+    {
+        // Nothing changed since the viewer's picture
+        m_out.resize(frameOffset);
+        return true;
+    }
+
+    TILESTREAM_MESSAGE message = { TILESTREAM_MSG_FRAME, static_cast<uint32_t>(m_out.size() - frameOffset - sizeof(TILESTREAM_MESSAGE)) };
+    TILESTREAM_FRAME frame = {};
+    frame.sequence = ++m_sequence;
+    frame.flags = key ? TILESTREAM_FRAME_KEY : 0;
+    frame.timestamp = timestamp;
+    frame.tileCount = tileCount;
+    memcpy(m_out.data() + frameOffset, &message, sizeof(message));
+    memcpy(m_out.data() + frameOffset + sizeof(message), &frame, sizeof(frame));
+
+    m_keyPending = false;
+    ++m_framesSent;
+    m_tilesSent += tileCount;
+    if (key)
+        ++m_keyFrames;
+
+    Flush();
+    return true;
+}
+
+TileStreamReceiver::TileStreamReceiver() :
+    m_width(0), m_height(0), m_tileSize(0), m_synced(false), m_keyRequested(false), m_sequence(0),
+    m_timestamp(0), m_key(false), m_tiles(0), m_messageBytes(0), m_resyncs(0)
+{
+}
+
+bool TileStreamReceiver::Connect(const char* host, uint16_t port)
+{
+    if (!m_socket.Connect(host, port))
+        return false;
+    m_socket.SetNoDelay(true);
+
+    TILESTREAM_MESSAGE message;
+    TILESTREAM_HELLO hello;
+    if (!m_socket.ReceiveAll(&message, sizeof(message)) || message.type != TILESTREAM_MSG_HELLO ||
+        message.size != sizeof(hello) || !m_socket.ReceiveAll(&hello, sizeof(hello)) ||
+        hello.magic != TILESTREAM_MAGIC || hello.width == 0 || hello.height == 0 ||
+        hello.tileSize == 0 || hello.tileSize > 1024)
+    {
+        m_socket.Close();
+        return false;
+    }
+
+    m_width = hello.width;
+    m_height = hello.height;
+    m_tileSize = hello.tileSize;
+    m_synced = false;
+    m_keyRequested = false;
+    m_frame.assign(size_t(m_width) * m_height * 4, 0);
+    m_tile.resize(size_t(m_tileSize) * m_tileSize * 4);
+    return true;
+}
+
+bool TileStreamReceiver::SendSequence(uint32_t type, uint32_t sequence)
+{
+    struct
+    {
+        TILESTREAM_MESSAGE message;
+        TILESTREAM_SEQUENCE payload;
+    } request = { { type, sizeof(TILESTREAM_SEQUENCE) }, { sequence, 0 } };
+    return m_socket.SendAll(&request, sizeof(request));
+}
+
+bool TileStreamReceiver::RequestKeyFrame()
+{
+    m_synced = false;
+    m_keyRequested = true;
+    ++m_resyncs;
+    return SendSequence(TILESTREAM_MSG_KEY_REQUEST, m_sequence);
+}
+
+bool TileStreamReceiver::ReceiveFrame()
+{
+    // Largest sane frame: every tile present and incompressible
+    const size_t columns = (m_width + m_tileSize - 1) / m_tileSize;
+    const size_t rows = (m_height + m_tileSize - 1) / m_tileSize;
+    const size_t maxPayload = sizeof(TILESTREAM_FRAME) + columns * rows * (sizeof(TILESTREAM_TILE) + m_tile.size());
+
+    for (;;)
+    {
+        TILESTREAM_MESSAGE message;
+        if (!m_socket.ReceiveAll(&message, sizeof(message)) || message.size > maxPayload)
+            return false;
+        m_payload.resize(message.size);
+        if (!m_socket.ReceiveAll(m_payload.data(), m_payload.size()))
+            return false;
+
+        if (message.type != TILESTREAM_MSG_FRAME || message.size < sizeof(TILESTREAM_FRAME))
+            continue;
+
+        TILESTREAM_FRAME frame;
+        memcpy(&frame, m_payload.data(), sizeof(frame));
+
+        // Acknowledge before decoding so the sender can prepare the next frame meanwhile
+        if (!SendSequence(TILESTREAM_MSG_ACK, frame.sequence))
+            return false;
+
+        const bool key = (frame.flags & TILESTREAM_FRAME_KEY) != 0;
+
+        // A delta only applies on top of the frame right before it
+        if (!key && (!m_synced || frame.sequence != m_sequence + 1))
+        {
+            if (!m_keyRequested && !RequestKeyFrame())
+                return false;
+            continue;
+        }
+
+        if (!ApplyFrame(m_payload.data() + sizeof(frame), m_payload.size() - sizeof(frame)) || frame.tileCount != m_tiles)
+        {
+            if (!RequestKeyFrame())
+                return false;
+            continue;
+        }
+
+        m_synced = true;
+        if (key)
+            m_keyRequested = false;
+        m_sequence = frame.sequence;
+        m_timestamp = frame.timestamp;
+        m_key = key;
+        m_messageBytes = sizeof(message) + message.size;
+        return true;
+    }
+}
+
+bool TileStreamReceiver::ApplyFrame(const uint8_t* payload, size_t size)
+{
+    const uint32_t columns = (m_width + m_tileSize - 1) / m_tileSize;
+    const uint32_t rows = (m_height + m_tileSize - 1) / m_tileSize;
+    const size_t pitch = size_t(m_width) * 4;
+
+    m_tiles = 0;
+    while (size > 0)
+    {
+        TILESTREAM_TILE tile;
+        if (size < sizeof(tile))
+            return false;
+        memcpy(&tile, payload, sizeof(tile));
+        payload += sizeof(tile);
+        size -= sizeof(tile);
+
+        if (tile.column >= columns || tile.row >= rows || tile.size > size)
+            return false;
+
+        const uint32_t x0 = tile.column * m_tileSize;
+        const uint32_t y0 = tile.row * m_tileSize;
+        const size_t rowBytes = size_t(std::min(m_tileSize, m_width - x0)) * 4;
+        const uint32_t tileHeight = std::min(m_tileSize, m_height - y0);
+        const size_t rawSize = rowBytes * tileHeight;
+
+        const uint8_t* pixels = payload;
+        if (tile.size != rawSize)
+        {
+            if (!LzDecompress(payload, tile.size, m_tile.data(), rawSize))
+                return false;
+            pixels = m_tile.data();
+        }
+
+        uint8_t* dst = m_frame.data() + size_t(y0) * pitch + size_t(x0) * 4;
+        for (uint32_t y = 0; y < tileHeight; ++y)
+            memcpy(dst + y * pitch, pixels + y * rowBytes, rowBytes);
+
+        payload += tile.size;
+        size -= tile.size;
+        ++m_tiles;
+    }
+    return true;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "Socket.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Live streaming of captured frames to a viewer over a local TCP socket.
+//
+// Frames are cut into TILESTREAM_TILE_SIZE square tiles and a frame message
+// carries only the tiles that differ from what the viewer already has, each
+// LZ-compressed or stored when that doesn't help.
+//
+// The sender never blocks the capture loop: while more than
+// TILESTREAM_MAX_IN_FLIGHT frames are unacknowledged or the socket hasn't taken
+// the previous message, new frames are not sent at all. Tiles are diffed against
+// the last frame that was sent, so the next message carries the union of all
+// changes in between - the frame rate follows the bandwidth and the viewer
+// never falls behind by more than a couple of frames, however deep the socket
+// buffers are.
+//
+// Every message is a TILESTREAM_MESSAGE followed by `size` payload bytes:
+//   sender -> viewer  HELLO once per connection, then
+//                     FRAME = TILESTREAM_FRAME + tileCount * (TILESTREAM_TILE + data)
+//   viewer -> sender  ACK for every frame received, KEY_REQUEST
+// Frames are numbered. A viewer that sees a gap or can't decode a tile asks for
+// a key frame (all tiles) and drops delta frames until it arrives.
+
+const uint32_t TILESTREAM_MAGIC         = 0x31535454; // "TTS1"
+const uint32_t TILESTREAM_TILE_SIZE     = 64;
+const uint16_t TILESTREAM_DEFAULT_PORT  = 5960;
+const uint32_t TILESTREAM_MAX_IN_FLIGHT = 2;          // unacknowledged frames
+
+enum TileStreamMessage : uint32_t
+{
+    TILESTREAM_MSG_HELLO       = 1,
+    TILESTREAM_MSG_FRAME       = 2,
+    TILESTREAM_MSG_KEY_REQUEST = 3,
+    TILESTREAM_MSG_ACK         = 4,
+};
+
+const uint32_t TILESTREAM_FRAME_KEY = 0x1;
+
+struct TILESTREAM_MESSAGE
+{
+    uint32_t type;              // TileStreamMessage
+    uint32_t size;              // payload bytes that follow
+};
+
+struct TILESTREAM_HELLO
+{
+    uint32_t magic;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+};
+
+struct TILESTREAM_FRAME
+{
+    uint32_t sequence;
+    uint32_t flags;             // TILESTREAM_FRAME_*
+    int64_t  timestamp;         // TileStreamClock() at capture, for latency
+    uint32_t tileCount;
+    uint32_t reserved;
+};
+
+struct TILESTREAM_TILE
+{
+    uint16_t column;
+    uint16_t row;
+    uint32_t size;              // equal to the raw tile size when stored uncompressed
+};
+
+// Payload of KEY_REQUEST and ACK
+struct TILESTREAM_SEQUENCE
+{
+    uint32_t sequence;          // KEY_REQUEST: last frame applied, ACK: frame received
+    uint32_t reserved;
+};
+
+// Nanoseconds of the monotonic clock, comparable between processes on one machine
+int64_t TileStreamClock();
+
+class TileStreamSender
+{
+public:
+    TileStreamSender();
+
+    // Starts listening for a viewer on 127.0.0.1:port
+    bool Open(uint16_t port, uint32_t width, uint32_t height);
+
+    // Sends the changed tiles of a BGRA frame (negative stride for bottom-up) if the
+    // viewer keeps up, otherwise leaves them for a later frame. Never blocks; losing
+    // the viewer is not an error, it just waits for the next one.
+    bool SendFrame(const uint8_t* bgra, ptrdiff_t stride, int64_t timestamp);
+
+    // Accepts viewers, answers key requests and pushes out queued data
+    void Poll();
+
+    // True while changes were held back or a key frame is wanted: the current
+    // frame should be offered again even if the screen didn't change
+    bool Pending() const;
+
+    // True when the viewer has acknowledged every frame sent
+    bool Delivered() const { return Flushed() && m_acked == m_sequence; }
+
+    uint16_t Port() const { return m_listener.LocalPort(); }
+    bool Connected() const { return m_client.IsOpen(); }
+
+    void Close();
+
+    uint64_t FramesSent() const { return m_framesSent; }
+    uint64_t FramesCoalesced() const { return m_framesCoalesced; }
+    uint64_t KeyFrames() const { return m_keyFrames; }
+    uint64_t TilesSent() const { return m_tilesSent; }
+    uint64_t BytesSent() const { return m_bytesSent; }
+
+private:
+    void AcceptViewer();
+    void ReadRequests();
+    bool Flush();
+    bool Flushed() const { return m_outOffset == m_out.size(); }
+    void Disconnect();
+    void AppendMessage(uint32_t type, const void* payload, size_t size);
+
+    TcpSocket m_listener;
+    TcpSocket m_client;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_columns;
+    uint32_t m_rows;
+    uint32_t m_sequence;
+    uint32_t m_acked;
+    bool m_keyPending;
+    bool m_dirty;                       // a frame was held back since the last send
+    std::vector<uint8_t> m_reference;   // what the viewer has: top-down, width * 4 pitch
+    std::vector<uint8_t> m_tile;        // scratch for one packed tile
+    std::vector<uint8_t> m_out;         // queued outgoing bytes
+    size_t m_outOffset;
+    std::vector<uint8_t> m_in;          // partial incoming request
+    uint64_t m_framesSent;
+    uint64_t m_framesCoalesced;
+    uint64_t m_keyFrames;
+    uint64_t m_tilesSent;
+    uint64_t m_bytesSent;
+};
+
+class TileStreamReceiver
+{
+public:
+    TileStreamReceiver();
+
+    // Connects and reads the stream parameters
+    bool Connect(const char* host, uint16_t port);
+
+    // Blocks until the next frame has been applied; false when the stream ends
+    bool ReceiveFrame();
+
+    // Asks the sender for a key frame; deltas are dropped until it arrives
+    bool RequestKeyFrame();
+
+    void Close() { m_socket.Close(); }
+
+    // Current picture: top-down BGRA, Width() * 4 pitch
+    const uint8_t* Frame() const { return m_frame.data(); }
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+
+    // Details of the last applied frame
+    uint32_t Sequence() const { return m_sequence; }
+    int64_t Timestamp() const { return m_timestamp; }
+    bool KeyFrame() const { return m_key; }
+    uint32_t Tiles() const { return m_tiles; }
+    size_t MessageBytes() const { return m_messageBytes; }
+
+    uint64_t Resyncs() const { return m_resyncs; }
+
+private:
+    bool SendSequence(uint32_t type, uint32_t sequence);
+    bool ApplyFrame(const uint8_t* payload, size_t size);
+
+    TcpSocket m_socket;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_tileSize;
+    bool m_synced;
+    bool m_keyRequested;
+    uint32_t m_sequence;
+    int64_t m_timestamp;
+    bool m_key;
+    uint32_t m_tiles;
+    size_t m_messageBytes;
+    uint64_t m_resyncs;
+    std::vector<uint8_t> m_frame;
+    std::vector<uint8_t> m_payload;
+    std::vector<uint8_t> m_tile;
+};
@@ -0,0 +1,235 @@
+// TileViewer.cpp : stand-in viewer for the recorder's --serve mode and a loopback benchmark.
+//
+// Portable and not part of the recorder build, e.g. on Linux:
+//   g++ -std=c++14 -O2 -pthread TileViewer.cpp TileStream.cpp Socket.cpp Lz.cpp RawDump.cpp MappedFile.cpp -o TileViewer
+//
+//   TileViewer [host] [port] [out.raw]                    watch a session, optionally dumping what arrives
+//   TileViewer --bench [frames] [width] [height] [fps]    sender and viewer over loopback, synthetic content
+
+#include "RawDump.h"
+#include "TileStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct ViewerStats
+    {
+        std::vector<double> latencyMs;
+        uint64_t bytes = 0;
+        uint64_t tiles = 0;
+        uint64_t keyFrames = 0;
+
+        void Add(const TileStreamReceiver& viewer)
+        {
+            latencyMs.push_back((TileStreamClock() - viewer.Timestamp()) / 1e6);
+            bytes += viewer.MessageBytes();
+            tiles += viewer.Tiles();
+            keyFrames += viewer.KeyFrame() ? 1 : 0;
+        }
+
+        void Print(std::ostream& out, double seconds, uint64_t resyncs)
+        {
+            const size_t frames = latencyMs.size();
+            if (frames == 0)
+            {
+                out << "no frames received" << std::endl;
+                return;
+            }
+
+            std::vector<double> sorted(latencyMs);
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for (double ms : sorted)
+                sum += ms;
+
+            out << frames << " frames (" << keyFrames << " key, " << resyncs << " resyncs) in " << seconds << " s: "
+                << frames / seconds << " fps, " << bytes / 1024.0 / frames << " KiB/frame, "
+                << double(tiles) / frames << " tiles/frame, "
+                << bytes / seconds / (1024.0 * 1024.0) << " MiB/s" << std::endl;
+            out << "latency ms: avg " << sum / frames << ", p50 " << sorted[frames / 2]
+                << ", p99 " << sorted[std::min(frames - 1, frames * 99 / 100)]
+                << ", max " << sorted.back() << std::endl;
+        }
+    };
+
+    double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Desktop-like test picture: static gradient, a bouncing window and a ticking clock
+    void DrawFrame(std::vector<uint8_t>& frame, uint32_t width, uint32_t height, uint32_t index)
+    {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            uint8_t* row = frame.data() + size_t(y) * width * 4;
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                row[x * 4 + 0] = static_cast<uint8_t>(x * 255 / width);
+                row[x * 4 + 1] = static_cast<uint8_t>(y * 255 / height);
+                row[x * 4 + 2] = 96;
+                row[x * 4 + 3] = 255;
+            }
+        }
+
+        const uint32_t boxWidth = std::min(320u, width);
+        const uint32_t boxHeight = std::min(200u, height);
+        const uint32_t rangeX = width - boxWidth + 1;
+        const uint32_t rangeY = height - boxHeight + 1;
+        const uint32_t bx = (index * 7) % (2 * rangeX);
+        const uint32_t by = (index * 3) % (2 * rangeY);
+        const uint32_t left = bx < rangeX ? bx : 2 * rangeX - 1 - bx;
+        const uint32_t top = by < rangeY ? by : 2 * rangeY - 1 - by;
+        for (uint32_t y = top; y < top + boxHeight; ++y)
+        {
+            uint8_t* row = frame.data() + (size_t(y) * width + left) * 4;
+            for (uint32_t x = 0; x < boxWidth; ++x)
+            {
+                const bool text = ((x / 4 + y / 8 + index / 10) % 5) == 0;
+                row[x * 4 + 0] = text ? 0 : 240;
+                row[x * 4 + 1] = text ? 0 : 240;
+                row[x * 4 + 2] = text ? 0 : 240;
+            }
+        }
+
+        const uint32_t clockWidth = std::min(48u, width);
+        const uint32_t clockHeight = std::min(16u, height);
+        for (uint32_t y = height - clockHeight; y < height; ++y)
+            memset(frame.data() + (size_t(y) * width + width - clockWidth) * 4, int(index & 0xff), clockWidth * 4);
+    }
+
+    int RunViewer(const char* host, uint16_t port, const char* dumpPath)
+    {
+        TileStreamReceiver viewer;
+        if (!viewer.Connect(host, port))
+        {
+            std::cerr << "Can't connect to " << host << ":" << port << std::endl;
+            return -1;
+        }
+        std::cout << "Viewing " << viewer.Width() << "x" << viewer.Height() << " from " << host << ":" << port << std::endl;
+
+        RawDumpWriter dump;
+        if (dumpPath && !dump.Open(dumpPath, viewer.Width(), viewer.Height(), viewer.Width() * 4, 0))
+        {
+            std::cerr << "Can't create " << dumpPath << std::endl;
+            return -1;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        auto reportStart = start;
+        ViewerStats total;
+        ViewerStats interval;
+        while (viewer.ReceiveFrame())
+        {
+            total.Add(viewer);
+            interval.Add(viewer);
+            if (dumpPath && !dump.WriteFrame(viewer.Frame(), viewer.Timestamp() / 100))
+                return -1;
+
+            if (SecondsSince(reportStart) >= 1.0)
+            {
+                interval.Print(std::cout, SecondsSince(reportStart), viewer.Resyncs());
+                interval = ViewerStats();
+                reportStart = std::chrono::steady_clock::now();
+            }
+        }
+
+        std::cout << "Stream ended. Total: ";
+        total.Print(std::cout, SecondsSince(start), viewer.Resyncs());
+        return 0;
+    }
+
+    int RunBench(uint32_t frames, uint32_t width, uint32_t height, uint32_t fps)
+    {
+        TileStreamSender sender;
+        if (!sender.Open(0, width, height))
+        {
+            std::cerr << "Can't listen on loopback" << std::endl;
+            return -1;
+        }
+
+        std::vector<uint8_t> frame(size_t(width) * height * 4);
+        std::thread producer([&]
+        {
+            while (!sender.Connected())
+            {
+                sender.Poll();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            // Paced like a capture loop; SendFrame never waits for the viewer
+            const auto period = std::chrono::nanoseconds(1000000000 / fps);
+            auto next = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < frames; ++i)
+            {
+                DrawFrame(frame, width, height, i);
+                sender.SendFrame(frame.data(), ptrdiff_t(width) * 4, TileStreamClock());
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+
+            // Deliver whatever was held back so the viewer ends on the last frame; closing
+            // before the last acknowledgement is read could reset the connection
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (sender.Connected() && (sender.Pending() || !sender.Delivered()) && std::chrono::steady_clock::now() < deadline)
+            {
+                if (sender.Pending())
+                    sender.SendFrame(frame.data(), ptrdiff_t(width) * 4, TileStreamClock());
+                else
+                    sender.Poll();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            sender.Close();
+        });
+
+        TileStreamReceiver viewer;
+        if (!viewer.Connect("127.0.0.1", sender.Port()))
+        {
+            std::cerr << "Can't connect to the sender" << std::endl;
+            sender.Close();
+            producer.join();
+            return -1;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        ViewerStats stats;
+        while (viewer.ReceiveFrame())
+            stats.Add(viewer);
+        const double seconds = SecondsSince(start);
+        producer.join();
+
+        const size_t rawFrameBytes = size_t(width) * height * 4;
+        std::cout << width << "x" << height << " at " << fps << " fps, " << frames << " frames offered, "
+                  << sender.FramesSent() << " sent, " << sender.FramesCoalesced() << " coalesced under backpressure" << std::endl;
+        stats.Print(std::cout, seconds, viewer.Resyncs());
+        std::cout << "raw frame " << rawFrameBytes / 1024.0 << " KiB, reduction "
+                  << (sender.BytesSent() ? double(rawFrameBytes) * sender.FramesSent() / double(sender.BytesSent()) : 0.0)
+                  << "x, last frame " << (memcmp(viewer.Frame(), frame.data(), rawFrameBytes) == 0 ? "matches" : "DIFFERS") << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+    {
+        const uint32_t frames = argc > 2 ? uint32_t(atoi(argv[2])) : 600;
+        const uint32_t width = argc > 3 ? uint32_t(atoi(argv[3])) : 1920;
+        const uint32_t height = argc > 4 ? uint32_t(atoi(argv[4])) : 1080;
+        const uint32_t fps = argc > 5 ? uint32_t(atoi(argv[5])) : 60;
+        if (frames == 0 || width == 0 || height == 0 || fps == 0)
+            return -1;
+        return RunBench(frames, width, height, fps);
+    }
+
+    const char* host = argc > 1 ? argv[1] : "127.0.0.1";
+    const uint16_t port = argc > 2 ? uint16_t(atoi(argv[2])) : TILESTREAM_DEFAULT_PORT;
+    return RunViewer(host, port, argc > 3 ? argv[3] : nullptr);
+}
@@ -0,0 +1,223 @@
+// TranscodeBench.cpp : core scaling of the offline raw dump transcoder.
+//
+// Portable and not part of the recorder build, e.g. on Linux:
+//   g++ -std=c++14 -O2 -pthread TranscodeBench.cpp Transcoder.cpp CodecFile.cpp FrameCodec.cpp Lz.cpp
+//       RawDump.cpp MappedFile.cpp ThreadPool.cpp -o TranscodeBench
+//
+//   TranscodeBench [frames] [width] [height] [gop] [max threads] [dump path]
+//
+// Records a synthetic desktop session into a raw dump: a caret typing into a
+// window, a mouse cursor moving about and a picture that changes every frame,
+// with a scroll now and then. The dump is transcoded on 1, 2, 4 ... threads up
+// to the hardware thread count (or the one given), each timed end to end.
+// Every run has to write the same file as the one-thread run, and that file
+// has to decode back to the recorded frames.
+
+#include "Transcoder.h"
+#include "CodecFile.h"
+#include "FrameCodec.h"
+#include "RawDump.h"
+#include "../D3D11_Screenshot/BenchImage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const uint32_t FPS = 30;
+
+    struct Rect
+    {
+        uint32_t x, y, w, h;
+    };
+
+    void Fill(std::vector<uint8_t>& frame, uint32_t width, const Rect& r, uint32_t color)
+    {
+        for (uint32_t y = r.y; y < r.y + r.h; ++y)
+            for (uint32_t x = r.x; x < r.x + r.w; ++x)
+                memcpy(&frame[(size_t(y) * width + x) * 4], &color, 4);
+    }
+
+    // Frame `i` of the session, drawn over the previous one
+    void Draw(std::vector<uint8_t>& frame, const std::vector<uint8_t>& desktop, uint32_t width, uint32_t height, uint32_t i)
+    {
+        const Rect window = { width / 8, height / 6, width / 2, height / 2 };
+        if (i == 0)
+            Fill(frame, width, window, 0xffffffff);
+
+        // Every 90 frames the window scrolls by a line of text
+        if (i > 0 && i % 90 == 0)
+        {
+            for (uint32_t y = window.y; y + 16 < window.y + window.h; ++y)
+                memcpy(&frame[(size_t(y) * width + window.x) * 4], &frame[(size_t(y + 16) * width + window.x) * 4],
+                       size_t(window.w) * 4);
+            Fill(frame, width, Rect{ window.x, window.y + window.h - 16, window.w, 16 }, 0xffffffff);
+        }
+
+        // Typing: one glyph per frame
+        const uint32_t perLine = (window.w - 32) / 10;
+        const uint32_t lines = (window.h - 32) / 16;
+        const uint32_t glyph = i % (perLine * lines);
+        Fill(frame, width, Rect{ window.x + 16 + (glyph % perLine) * 10, window.y + 16 + (glyph / perLine) * 16, 7, 11 },
+             0xff202020 + ((i * 37) & 0x3f));
+
+        // The cursor leaves the desktop behind where it was
+        const uint32_t span = width / 2;
+        const uint32_t oldX = width / 4 + ((i + span - 1) % span), newX = width / 4 + i % span;
+        const uint32_t cursorY = height * 3 / 4;
+        for (uint32_t y = cursorY; y < cursorY + 20; ++y)
+            memcpy(&frame[(size_t(y) * width + oldX) * 4], &desktop[(size_t(y) * width + oldX) * 4], 12 * 4);
+        Fill(frame, width, Rect{ newX, cursorY, 12, 20 }, 0xff000000);
+
+        // A small video playing in a corner
+        const Rect picture = { width * 3 / 4, height / 10, width / 6, height / 6 };
+        for (uint32_t y = 0; y < picture.h; ++y)
+        {
+            for (uint32_t x = 0; x < picture.w; ++x)
+            {
+                const uint32_t r = (x * 255 / picture.w + i * 3) & 0xff;
+                const uint32_t g = (y * 255 / picture.h + i * 5) & 0xff;
+                const uint32_t b = ((x ^ y) + i) & 0xff;
+                const uint32_t color = 0xff000000u | r << 16 | g << 8 | b;
+                memcpy(&frame[(size_t(picture.y + y) * width + picture.x + x) * 4], &color, 4);
+            }
+        }
+    }
+
+    bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+    {
+        data.clear();
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        uint8_t buffer[65536];
+        for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+            data.insert(data.end(), buffer, buffer + read);
+        fclose(file);
+        return true;
+    }
+
+    // The transcoded file has to give back every frame and timestamp of the dump
+    bool DecodesToDump(const std::string& codecPath, const RawDumpReader& dump)
+    {
+        CodecFileReader reader;
+        if (!reader.Open(codecPath.c_str()) || reader.Header().frameCount != dump.FrameCount())
+            return false;
+
+        FrameDecoder decoder(dump.FrameSize());
+        std::vector<uint8_t> packet, frame(dump.FrameSize());
+        CODECFILE_PACKET info;
+        size_t index = 0;
+        for (; reader.ReadPacket(packet, info); ++index)
+        {
+            int64_t timestamp = 0;
+            const uint8_t* expected = dump.Frame(index, &timestamp);
+            if (!expected || info.timestamp != timestamp ||
+                !decoder.Decode(packet.data(), packet.size(), frame.data()) ||
+                memcmp(frame.data(), expected, frame.size()) != 0)
+            {
+                return false;
+            }
+        }
+        return index == dump.FrameCount();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? uint32_t(atoi(argv[1])) : 300;
+    const uint32_t width = argc > 2 ? uint32_t(atoi(argv[2])) : 1920;
+    const uint32_t height = argc > 3 ? uint32_t(atoi(argv[3])) : 1080;
+    const uint32_t gop = argc > 4 ? uint32_t(atoi(argv[4])) : 30;
+    const unsigned maxThreads = argc > 5 ? unsigned(atoi(argv[5])) : 0;
+    const std::string dumpPath = argc > 6 ? argv[6] : "TranscodeBench.raw";
+
+    if (frames == 0 || gop == 0 || width < 320 || height < 240)
+    {
+        printf("needs at least one frame of 320x240 and a GOP of one\n");
+        return 1;
+    }
+
+    // Record the session
+    {
+        const std::vector<uint8_t> desktop = MakeDesktop(width, height);
+        std::vector<uint8_t> frame = desktop;
+        RawDumpWriter writer;
+        if (!writer.Open(dumpPath.c_str(), width, height, width * 4, 0))
+        {
+            printf("can't write %s\n", dumpPath.c_str());
+            return 1;
+        }
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            Draw(frame, desktop, width, height, i);
+            writer.WriteFrame(frame.data(), int64_t(i) * RAWDUMP_TIMESCALE / FPS);
+        }
+        writer.Close();
+    }
+
+    RawDumpReader dump;
+    if (!dump.Open(dumpPath.c_str()) || dump.FrameCount() != frames)
+    {
+        printf("can't read back %s\n", dumpPath.c_str());
+        return 1;
+    }
+
+    // 1, 2, 4 ... and the largest count itself
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned largest = maxThreads ? maxThreads : hardware;
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < largest; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(largest);
+
+    printf("%u frames of %ux%u, GOP %u, %u hardware threads\n\n", frames, width, height, gop, hardware);
+    printf("%8s %8s %10s %8s %9s %10s\n", "threads", "s", "frames/s", "MB/s", "speedup", "KiB");
+
+    bool allOk = true;
+    double baseSeconds = 0.0;
+    std::vector<uint8_t> expected, output;
+    const std::string firstPath = "TranscodeBench_1.tcv";
+    for (unsigned threads : threadCounts)
+    {
+        const std::string outPath = "TranscodeBench_" + std::to_string(threads) + ".tcv";
+        TranscodeOptions options;
+        options.threads = threads;
+        options.gopSize = gop;
+
+        TranscodeStats stats;
+        if (!TranscodeDump(dumpPath.c_str(), outPath.c_str(), options, &stats))
+        {
+            printf("%8u FAILED\n", threads);
+            allOk = false;
+            continue;
+        }
+
+        // Chunks are stitched in order, so every thread count writes the same bytes
+        bool same;
+        if (threads == 1)
+        {
+            baseSeconds = stats.seconds;
+            same = ReadFile(outPath, expected) && DecodesToDump(outPath, dump);
+        }
+        else
+        {
+            same = ReadFile(outPath, output) && output == expected;
+            remove(outPath.c_str());
+        }
+
+        printf("%8u %8.2f %10.1f %8.1f %8.2fx %10llu %s\n", stats.threads, stats.seconds, stats.frames / stats.seconds,
+               stats.inputBytes / stats.seconds / 1e6, baseSeconds / stats.seconds,
+               (unsigned long long)(stats.outputBytes / 1024), same ? "" : "MISMATCH");
+        allOk = allOk && same;
+    }
+
+    remove(firstPath.c_str());
+    remove(dumpPath.c_str());
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include "Transcoder.h"
+#include "CodecFile.h"
+#include "FrameCodec.h"
+#include "RawDump.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <vector>
+
+namespace
+{
+    struct EncodedChunk
+    {
+        bool ok = false;
+        std::vector<std::vector<uint8_t>> packets;
+    };
+
+    EncodedChunk EncodeChunk(const RawDumpReader& dump, size_t first, size_t count)
+    {
+        EncodedChunk chunk;
+        chunk.packets.resize(count);
+
+        // Every chunk starts with a key frame, so chunks never depend on each other
+        FrameEncoder encoder(dump.FrameSize());
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!encoder.Encode(dump.Frame(first + i), i == 0, chunk.packets[i]))
+                return chunk;
+        }
+
+        chunk.ok = true;
+        return chunk;
+    }
+}
+
+bool TranscodeDump(const char* inPath, const char* outPath, const TranscodeOptions& options, TranscodeStats* stats)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    RawDumpReader dump;
+    if (!dump.Open(inPath))
+        return false;
+
+    const RAWDUMP_HEADER& src = dump.Header();
+    const size_t gopSize = std::max(1u, options.gopSize);
+
+    CODECFILE_HEADER header = {};
+    header.width = src.width;
+    header.height = src.height;
+    header.rowPitch = src.rowPitch;
+    header.flags = src.flags;
+    header.timescale = src.timescale;
+    header.gopSize = static_cast<uint32_t>(gopSize);
+
+    CodecFileWriter writer;
+    if (!writer.Open(outPath, header))
+        return false;
+
+    ThreadPool pool(options.threads);
+
+    const size_t frameCount = dump.FrameCount();
+    const size_t chunkCount = (frameCount + gopSize - 1) / gopSize;
+    const size_t window = size_t(pool.Size()) * 2;
+
+    std::deque<std::future<EncodedChunk>> inFlight;
+    size_t submitted = 0;
+    bool ok = true;
+
+    for (size_t written = 0; ok && written < chunkCount; ++written)
+    {
+        while (submitted < chunkCount && inFlight.size() < window)
+        {
+            const size_t first = submitted * gopSize;
+            const size_t count = std::min(gopSize, frameCount - first);
+            inFlight.push_back(pool.Submit([&dump, first, count]() { return EncodeChunk(dump, first, count); }));
+            ++submitted;
+        }
+
+        EncodedChunk chunk = inFlight.front().get();
+        inFlight.pop_front();
+        if (!chunk.ok)
+        {
+            ok = false;
+            break;
+        }
+
+        const size_t first = written * gopSize;
+        for (size_t i = 0; i < chunk.packets.size(); ++i)
+        {
+            int64_t timestamp = 0;
+            dump.Frame(first + i, &timestamp);
+            if (!writer.WritePacket(chunk.packets[i].data(), chunk.packets[i].size(), timestamp, i == 0))
+            {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    // Drain anything still running before the dump mapping goes away
+    for (auto& pending : inFlight)
+        pending.wait();
+
+    ok = writer.Close() && ok;
+
+    if (stats)
+    {
+        stats->frames = frameCount;
+        stats->inputBytes = uint64_t(frameCount) * dump.FrameSize();
+        stats->outputBytes = writer.BytesWritten();
+        stats->threads = pool.Size();
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return ok;
+}
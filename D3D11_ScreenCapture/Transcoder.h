@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// Offline transcoder: raw frame dump (RawDump.h) -> FrameCodec container (CodecFile.h).
+//
+// The memory-mapped dump is split into GOP-aligned chunks that are encoded
+// independently on a work-stealing pool; the main thread stitches the chunks
+// back in order with their original timestamps. At most a couple of chunks
+// per worker are in flight, so memory does not grow with the dump length.
+
+struct TranscodeOptions
+{
+    unsigned threads = 0;    // 0 - one per hardware thread
+    unsigned gopSize = 30;   // frames per independently decodable chunk
+};
+
+struct TranscodeStats
+{
+    uint64_t frames = 0;
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    unsigned threads = 0;
+    double seconds = 0.0;
+};
+
+bool TranscodeDump(const char* inPath, const char* outPath, const TranscodeOptions& options, TranscodeStats* stats = nullptr);
@@ -0,0 +1,185 @@
+#include "Y4mWriter.h"
+#include "ColorConvert.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char FRAME_MARKER[] = "FRAME\n";
+    const size_t FRAME_MARKER_SIZE = sizeof(FRAME_MARKER) - 1;
+    const size_t FRAME_ALIGNMENT = 4096;
+
+    uint8_t* AllocatePages(size_t size)
+    {
+        size = (size + FRAME_ALIGNMENT - 1) & ~(FRAME_ALIGNMENT - 1);
+#ifdef _WIN32
+        return static_cast<uint8_t*>(_aligned_malloc(size, FRAME_ALIGNMENT));
+#else
+        void* p = nullptr;
+        return posix_memalign(&p, FRAME_ALIGNMENT, size) == 0 ? static_cast<uint8_t*>(p) : nullptr;
+#endif
+    }
+
+    void FreePages(uint8_t* p)
+    {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+Y4mWriter::Y4mWriter() :
+    m_width(0), m_height(0), m_frame(nullptr), m_frameSize(0), m_ownsOutput(false),
+#ifdef _WIN32
+    m_handle(nullptr),
+#else
+    m_fd(-1),
+#endif
+    m_frames(0), m_bytes(0), m_convertSeconds(0.0), m_writeSeconds(0.0)
+{
+}
+
+Y4mWriter::~Y4mWriter()
+{
+    Close();
+}
+
+bool Y4mWriter::Open(const char* path, uint32_t width, uint32_t height, uint32_t fpsNum, uint32_t fpsDen)
+{
+    Close();
+
+    if (width == 0 || height == 0 || fpsNum == 0 || fpsDen == 0)
+        return false;
+
+    const bool toStdout = strcmp(path, "-") == 0;
+#ifdef _WIN32
+    if (toStdout)
+    {
+        m_handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    }
+    else
+    {
+        HANDLE h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        m_handle = (h == INVALID_HANDLE_VALUE) ? nullptr : h;
+    }
+    if (!m_handle)
+        return false;
+#else
+    // A reader that goes away must surface as a write error, not kill the recorder
+    signal(SIGPIPE, SIG_IGN);
+    m_fd = toStdout ? STDOUT_FILENO : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0)
+        return false;
+#endif
+    m_ownsOutput = !toStdout;
+
+    m_width = width;
+    m_height = height;
+    const size_t lumaSize = size_t(width) * height;
+    const size_t chromaSize = size_t((width + 1) / 2) * ((height + 1) / 2);
+    m_frameSize = FRAME_MARKER_SIZE + lumaSize + 2 * chromaSize;
+
+    m_frame = AllocatePages(m_frameSize);
+    if (!m_frame)
+    {
+        Close();
+        return false;
+    }
+    memcpy(m_frame, FRAME_MARKER, FRAME_MARKER_SIZE);
+
+    char header[128];
+    const int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+        width, height, fpsNum, fpsDen);
+    return length > 0 && WriteAll(reinterpret_cast<const uint8_t*>(header), size_t(length));
+}
+
+bool Y4mWriter::WriteFrame(const uint8_t* bgra, ptrdiff_t stride)
+{
+    if (!m_frame)
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    const uint32_t chromaWidth = (m_width + 1) / 2;
+    uint8_t* y = m_frame + FRAME_MARKER_SIZE;
+    uint8_t* u = y + size_t(m_width) * m_height;
+    uint8_t* v = u + size_t(chromaWidth) * ((m_height + 1) / 2);
+    ConvertBgraToI420(bgra, stride, m_width, m_height, y, m_width, u, chromaWidth, v, chromaWidth);
+
+    m_convertSeconds += SecondsSince(start);
+    start = std::chrono::steady_clock::now();
+
+    const bool ok = WriteAll(m_frame, m_frameSize);
+
+    m_writeSeconds += SecondsSince(start);
+    if (ok)
+        ++m_frames;
+    return ok;
+}
+
+bool Y4mWriter::WriteAll(const uint8_t* data, size_t size)
+{
+    // Pipes accept partial writes, so keep going until everything is out
+    while (size > 0)
+    {
+#ifdef _WIN32
+        const DWORD chunk = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+        DWORD written = 0;
+        if (!WriteFile(m_handle, data, chunk, &written, nullptr) || written == 0)
+            return false;
+#else
+        const ssize_t written = write(m_fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+#endif
+        data += written;
+        size -= size_t(written);
+        m_bytes += uint64_t(written);
+    }
+    return true;
+}
+
+bool Y4mWriter::Close()
+{
+    bool ok = true;
+#ifdef _WIN32
+    if (m_handle && m_ownsOutput)
+        ok = CloseHandle(m_handle) != FALSE;
+    m_handle = nullptr;
+#else
+    if (m_fd >= 0 && m_ownsOutput)
+        ok = close(m_fd) == 0;
+    m_fd = -1;
+#endif
+    if (m_frame)
+        FreePages(m_frame);
+    m_frame = nullptr;
+    return ok;
+}
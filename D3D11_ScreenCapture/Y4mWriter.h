@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Streaming YUV4MPEG2 writer for piping frames into external encoders, e.g.
+//   D3D11_ScreenCapture --y4m - | ffmpeg -i - -c:v libx264 out.mp4
+//
+// Frames are converted straight into a page-aligned buffer that already holds
+// the "FRAME\n" marker in front of the Y, U and V planes, so every frame goes
+// out as a single large write with no intermediate copy.
+class Y4mWriter
+{
+public:
+    Y4mWriter();
+    ~Y4mWriter();
+
+    Y4mWriter(const Y4mWriter&) = delete;
+    Y4mWriter& operator=(const Y4mWriter&) = delete;
+
+    // `path` may be a regular file, a FIFO / named pipe, or "-" for stdout
+    bool Open(const char* path, uint32_t width, uint32_t height, uint32_t fpsNum, uint32_t fpsDen);
+
+    // Converts a BGRA frame (negative stride for bottom-up) and writes it
+    bool WriteFrame(const uint8_t* bgra, ptrdiff_t stride);
+
+    bool Close();
+
+    uint64_t Frames() const { return m_frames; }
+    uint64_t BytesWritten() const { return m_bytes; }
+    double ConvertSeconds() const { return m_convertSeconds; }
+    double WriteSeconds() const { return m_writeSeconds; }
+
+private:
+    bool WriteAll(const uint8_t* data, size_t size);
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint8_t* m_frame;        // "FRAME\n" + Y + U + V
+    size_t m_frameSize;
+    bool m_ownsOutput;
+#ifdef _WIN32
+    void* m_handle;
+#else
+    int m_fd;
+#endif
+    uint64_t m_frames;
+    uint64_t m_bytes;
+    double m_convertSeconds;
+    double m_writeSeconds;
+};
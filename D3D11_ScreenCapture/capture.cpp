@@ -1,4 +1,5 @@
 #include "capture.h"
+#include "../D3D11_Screenshot/DxgiFormat.h"
 
 HRESULT Capture::CreateDirect3DDevice()
 {
@@ -197,25 +198,35 @@ bool Capture::Get(IDXGIResource* lDesktopResource, RECT* rcx)
     if (FAILED(hr))
         return 0;
 
-    auto sz = lOutputDuplDesc.ModeDesc.Width * lOutputDuplDesc.ModeDesc.Height * 4;
+    // Every caller reads the buffer as four bytes a pixel, and GetDC needs a 32-bit
+    // format anyway; anything else (a float HDR desktop) isn't captured
+    const DxgiFormatInfo format = GetDxgiFormatInfo(lOutputDuplDesc.ModeDesc.Format);
+    const UINT bytesPerPixel = 4;
+    if (format.layout != DxgiLayout::Linear || format.bitsPerPixel != bytesPerPixel * 8)
+    {
+        context->Unmap(lDestImage, subresource);
+        return 0;
+    }
+
+    auto sz = lOutputDuplDesc.ModeDesc.Width * lOutputDuplDesc.ModeDesc.Height * bytesPerPixel;
     auto sz2 = sz;
     buf.resize(sz);
     if (rcx)
     {
-        sz2 = (rcx->right - rcx->left) * (rcx->bottom - rcx->top) * 4;
+        sz2 = (rcx->right - rcx->left) * (rcx->bottom - rcx->top) * bytesPerPixel;
         buf.resize(sz2);
         sz = sz2;
     }
 
-    UINT lBmpRowPitch = lOutputDuplDesc.ModeDesc.Width * 4;
+    UINT lBmpRowPitch = lOutputDuplDesc.ModeDesc.Width * bytesPerPixel;
     if (rcx)
-        lBmpRowPitch = (rcx->right - rcx->left) * 4;
+        lBmpRowPitch = (rcx->right - rcx->left) * bytesPerPixel;
     UINT lRowPitch = std::min<UINT>(lBmpRowPitch, resource.RowPitch);
 
     BYTE* sptr = reinterpret_cast<BYTE*>(resource.pData);
     BYTE* dptr = buf.data() + sz - lBmpRowPitch;
     if (rcx)
-        sptr += rcx->left * 4;
+        sptr += rcx->left * bytesPerPixel;
     for (size_t h = 0; h < lOutputDuplDesc.ModeDesc.Height; ++h)
     {
         if (rcx && h < (size_t)rcx->top)
@@ -0,0 +1,167 @@
+//-----------------------------------------------------------------------------
+// File: BcBench.cpp
+//
+// Headless benchmark for BlockCompress, not part of the application build.
+// Compresses a synthetic desktop-like frame in every format and mode, on one
+// thread and on the pool, checks that both produce the same blocks, and
+// reports throughput and the reference decoder's PSNR, SSIM and largest
+// error against the source. A second copy of the frame with an alpha ramp
+// measures the alpha channel. PSNR or SSIM below the floor set for a mode
+// fails the bench.
+//
+//   g++ -std=c++14 -O2 -I. BcBench.cpp BlockCompress.cpp DdsWriter.cpp ImageMetrics.cpp PixelConvert.cpp
+//       ../D3D11_ScreenCapture/ThreadPool.cpp -pthread -o bcbench
+//   ./bcbench [width] [height] [runs] [out.dds]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "BlockCompress.h"
+#include "BenchImage.h"
+#include "DdsWriter.h"
+#include "ImageMetrics.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Lowest PSNR and SSIM the decoded frame may have, by format, quality and alpha, with
+    // some room under what the test frame gets at any size up to 4K
+    const double PSNR_FLOOR[3][2][2] =
+    {
+        { { 28.8, 0.0 },  { 29.0, 0.0 } },      // BC1 isn't run with alpha
+        { { 28.8, 30.0 }, { 29.0, 30.2 } },
+        { { 37.0, 38.0 }, { 37.5, 38.5 } },
+    };
+    const double SSIM_FLOOR[3][2][2] =
+    {
+        { { 0.985, 0.0 },   { 0.986, 0.0 } },
+        { { 0.985, 0.985 }, { 0.986, 0.986 } },
+        { { 0.990, 0.990 }, { 0.991, 0.991 } },
+    };
+
+    // The BC7 quality result as a single-level DDS a texture viewer can open
+    bool WriteDds(const char* path, const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height)
+    {
+        FILE* f = fopen(path, "wb");
+        if (!f)
+            return false;
+
+        DdsTextureDesc desc = {};
+        desc.width = width;
+        desc.height = height;
+        desc.mipLevels = 1;
+        desc.arraySize = 1;
+        desc.dxgiFormat = BcDxgiFormat(BcFormat::Bc7, false);
+        desc.compressed = true;
+        desc.rowBytes = uint32_t((width + 3) / 4 * BcBlockBytes(BcFormat::Bc7));
+        desc.rowCount = (height + 3) / 4;
+
+        uint8_t header[DDS_MAX_HEADER_SIZE];
+        const size_t headerSize = BuildDdsHeader(desc, header);
+        bool ok = headerSize != 0;
+        {
+            DdsStreamWriter writer([f](const uint8_t* data, size_t size) { return fwrite(data, 1, size, f) == size; });
+            ok = ok && writer.Write(header, headerSize) && writer.Write(blocks.data(), blocks.size()) && writer.Finish();
+        }
+        return fclose(f) == 0 && ok;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t width = argc > 1 ? uint32_t(atoi(argv[1])) : 3840;
+    const uint32_t height = argc > 2 ? uint32_t(atoi(argv[2])) : 2160;
+    const int runs = argc > 3 ? std::max(1, atoi(argv[3])) : 3;
+    const char* outPath = argc > 4 ? argv[4] : nullptr;
+
+    if (width < 64 || height < 64)
+    {
+        printf("the test frame needs at least 64x64 pixels\n");
+        return 1;
+    }
+
+    const std::vector<uint8_t> opaque = MakeDesktop(width, height);
+    std::vector<uint8_t> translucent = opaque;
+    for (uint32_t y = 0; y < height; ++y)
+        for (uint32_t x = 0; x < width; ++x)
+            translucent[(size_t(y) * width + x) * 4 + 3] = uint8_t((uint64_t(x) * 255 / width + uint64_t(y) * 255 / height) / 2);
+
+    const double megapixels = double(width) * height / 1e6;
+    const ptrdiff_t pitch = ptrdiff_t(width) * 4;
+    ThreadPool pool;
+    printf("%ux%u, %u threads, best of %d\n\n", width, height, pool.Size(), runs);
+    printf("%-18s %9s %9s %9s %9s %8s %8s %8s %s\n", "mode", "ms 1t", "MPix/s", "ms mt", "MPix/s", "PSNR", "SSIM", "max err",
+           "check");
+
+    static const char* FORMAT_NAMES[] = { "bc1", "bc3", "bc7" };
+    static const char* QUALITY_NAMES[] = { "fast", "quality" };
+
+    bool allOk = true;
+    std::vector<uint8_t> single, threaded, decoded(opaque.size());
+    for (int alpha = 0; alpha < 2; ++alpha)
+    {
+        const std::vector<uint8_t>& source = alpha ? translucent : opaque;
+        for (int format = 0; format < 3; ++format)
+        {
+            // BC1's one-bit alpha isn't meant for a ramp
+            if (alpha && format == 0)
+                continue;
+
+            for (int quality = 0; quality < 2; ++quality)
+            {
+                const BcOptions options = { static_cast<BcFormat>(format), static_cast<BcQuality>(quality), true };
+
+                double best[2] = { 1e30, 1e30 };
+                for (int run = 0; run < runs; ++run)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    BcCompress(source.data(), pitch, width, height, options, single);
+                    best[0] = std::min(best[0], MillisecondsSince(start));
+
+                    start = std::chrono::steady_clock::now();
+                    BcCompress(source.data(), pitch, width, height, options, threaded, &pool);
+                    best[1] = std::min(best[1], MillisecondsSince(start));
+                }
+
+                const bool decodes = BcDecompress(single.data(), single.size(), width, height, options.format, true,
+                                                  decoded.data(), pitch);
+                const ImageMetricsOptions metrics = { true, alpha != 0, true, 0 };
+                ImageQuality score = {};
+                const bool measured = MeasureImages(source.data(), pitch, decoded.data(), pitch, width, height, metrics,
+                                                    score, nullptr, &pool);
+                const bool floor = measured && score.psnr >= PSNR_FLOOR[format][quality][alpha] &&
+                                   score.ssim >= SSIM_FLOOR[format][quality][alpha];
+                const bool ok = decodes && single == threaded && floor;
+                allOk = allOk && ok;
+
+                const std::string name = std::string(FORMAT_NAMES[format]) + " " + QUALITY_NAMES[quality] + (alpha ? " rgba" : "");
+                printf("%-18s %9.1f %9.1f %9.1f %9.1f %8.2f %8.5f %8u %s\n", name.c_str(),
+                       best[0], megapixels / (best[0] / 1000.0), best[1], megapixels / (best[1] / 1000.0),
+                       score.psnr, score.ssim, score.maxAbsDiff,
+                       ok ? "ok" : (!decodes ? "UNDECODABLE" : single != threaded ? "THREAD MISMATCH" : "BELOW FLOOR"));
+
+                if (outPath && !alpha && options.format == BcFormat::Bc7 && options.quality == BcQuality::Quality &&
+                    !WriteDds(outPath, single, width, height))
+                {
+                    printf("can't write %s\n", outPath);
+                    allOk = false;
+                }
+            }
+        }
+    }
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: BenchImage.h
+//
+// Synthetic test frame shared by the headless benchmarks.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Windows, title bars, text-like glyph runs, a gradient wallpaper and a noisy "photo"
+inline std::vector<uint8_t> MakeDesktop(uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> bgra(size_t(width) * height * 4);
+    std::mt19937 rng(1234);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint8_t* p = &bgra[(size_t(y) * width + x) * 4];
+            p[0] = uint8_t(96 + 64 * y / height);
+            p[1] = uint8_t(64 + 32 * x / width);
+            p[2] = uint8_t(32);
+            p[3] = 255;
+        }
+    }
+
+    auto fill = [&](uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, uint32_t color)
+    {
+        for (uint32_t y = y0; y < std::min(height, y0 + h); ++y)
+            for (uint32_t x = x0; x < std::min(width, x0 + w); ++x)
+                memcpy(&bgra[(size_t(y) * width + x) * 4], &color, 4);
+    };
+
+    for (int window = 0; window < 6; ++window)
+    {
+        const uint32_t w = width / 3 + rng() % (width / 4);
+        const uint32_t h = height / 3 + rng() % (height / 4);
+        const uint32_t x0 = rng() % (width - w);
+        const uint32_t y0 = rng() % (height - h);
+        fill(x0, y0, w, h, 0xfff0f0f0);
+        fill(x0, y0, w, 24, 0xff2b579a);
+
+        // Lines of "text": short dark runs with gaps
+        for (uint32_t line = y0 + 40; line + 12 < y0 + h; line += 18)
+        {
+            uint32_t x = x0 + 8;
+            while (x + 40 < x0 + w)
+            {
+                const uint32_t word = 8 + rng() % 48;
+                for (uint32_t gy = 0; gy < 10; ++gy)
+                    for (uint32_t gx = 0; gx < word && x + gx < x0 + w; ++gx)
+                        if ((rng() & 3) != 0)
+                            fill(x + gx, line + gy, 1, 1, 0xff202020 + (rng() & 0x3f) * 0x010101);
+                x += word + 6;
+            }
+        }
+    }
+
+    // Photo-like area
+    const uint32_t pw = width / 4, ph = height / 4;
+    for (uint32_t y = 0; y < ph; ++y)
+        for (uint32_t x = 0; x < pw; ++x)
+        {
+            uint8_t* p = &bgra[(size_t(height - ph + y) * width + (width - pw + x)) * 4];
+            p[0] = uint8_t((x * 3 + y + rng() % 24) & 0xff);
+            p[1] = uint8_t((x + y * 2 + rng() % 24) & 0xff);
+            p[2] = uint8_t((x ^ y) + rng() % 24);
+        }
+    return bgra;
+}
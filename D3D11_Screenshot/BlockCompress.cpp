@@ -0,0 +1,1148 @@
+//-----------------------------------------------------------------------------
+// File: BlockCompress.cpp
+//
+// Endpoint search, index selection and bit packing for BC1, BC3 and BC7, and
+// the reference decoder the encoder's palettes are built to match.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "BlockCompress.h"
+#include "DxgiFormat.h"
+#include "ImageMetrics.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // 16 pixels, R, G, B, A each, row by row
+    struct Block
+    {
+        alignas(16) uint8_t rgba[64];
+    };
+
+    // Up to 16 palette entries in the same layout as the pixels
+    struct Palette
+    {
+        alignas(16) uint8_t rgba[16][4];
+        int count;
+    };
+
+    const int16_t WEIGHTS_RGB[4]   = { 1, 1, 1, 0 };
+    const int16_t WEIGHTS_RGBA[4]  = { 1, 1, 1, 1 };
+    const int16_t WEIGHTS_ALPHA[4] = { 0, 0, 0, 1 };
+
+    // BC7 interpolation weights, in 64ths
+    const int BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+    const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // The same as fractions, for the least-squares fit
+    const float BC7_T2[4] = { 0.0f, 21 / 64.0f, 43 / 64.0f, 1.0f };
+    const float BC7_T4[16] =
+    {
+        0.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+        34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 1.0f,
+    };
+
+    template <class T>
+    T Clamp(T value, T lo, T hi)
+    {
+        return value < lo ? lo : (value > hi ? hi : value);
+    }
+
+    //-------------------------------------------------------------------------
+    // Block loading
+    //-------------------------------------------------------------------------
+
+    // Edge blocks repeat the last row and column
+    void LoadBlock(const uint8_t* pixels, ptrdiff_t pitch, uint32_t width, uint32_t height, uint32_t bx, uint32_t by,
+                   bool bgra, Block& block)
+    {
+        const uint32_t x0 = bx * 4;
+        const uint32_t y0 = by * 4;
+
+#ifdef BC_SSE2
+        if (x0 + 4 <= width && y0 + 4 <= height)
+        {
+            for (int y = 0; y < 4; ++y)
+            {
+                __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + ptrdiff_t(y0 + y) * pitch + size_t(x0) * 4));
+                if (bgra)
+                {
+                    // Swap bytes 0 and 2 of every pixel
+                    const __m128i ga = _mm_and_si128(row, _mm_set1_epi32(int(0xff00ff00)));
+                    const __m128i r = _mm_srli_epi32(_mm_and_si128(row, _mm_set1_epi32(0x00ff0000)), 16);
+                    const __m128i b = _mm_slli_epi32(_mm_and_si128(row, _mm_set1_epi32(0x000000ff)), 16);
+                    row = _mm_or_si128(ga, _mm_or_si128(r, b));
+                }
+                _mm_store_si128(reinterpret_cast<__m128i*>(block.rgba + y * 16), row);
+            }
+            return;
+        }
+#endif
+
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            const uint8_t* row = pixels + ptrdiff_t(std::min(y0 + y, height - 1)) * pitch;
+            for (uint32_t x = 0; x < 4; ++x)
+            {
+                const uint8_t* p = row + size_t(std::min(x0 + x, width - 1)) * 4;
+                uint8_t* d = block.rgba + (y * 4 + x) * 4;
+                d[0] = bgra ? p[2] : p[0];
+                d[1] = p[1];
+                d[2] = bgra ? p[0] : p[2];
+                d[3] = p[3];
+            }
+        }
+    }
+
+    // Flat areas are most of a desktop; they skip the endpoint search
+    bool IsSolid(const Block& block)
+    {
+        uint32_t first;
+        memcpy(&first, block.rgba, 4);
+        for (int p = 1; p < 16; ++p)
+        {
+            uint32_t pixel;
+            memcpy(&pixel, block.rgba + p * 4, 4);
+            if (pixel != first)
+                return false;
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Nearest palette entry for every pixel, by weighted squared error
+    //-------------------------------------------------------------------------
+    uint32_t FindIndices(const Block& block, const Palette& palette, const int16_t (&weights)[4], uint8_t (&indices)[16])
+    {
+#ifdef BC_SSE2
+        __m128i entries[16];
+        for (int i = 0; i < palette.count; ++i)
+        {
+            const uint8_t* e = palette.rgba[i];
+            entries[i] = _mm_setr_epi16(e[0], e[1], e[2], e[3], e[0], e[1], e[2], e[3]);
+        }
+        const __m128i w = _mm_setr_epi16(weights[0], weights[1], weights[2], weights[3],
+                                         weights[0], weights[1], weights[2], weights[3]);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i total = zero;
+        for (int group = 0; group < 4; ++group)
+        {
+            const __m128i px = _mm_load_si128(reinterpret_cast<const __m128i*>(block.rgba + group * 16));
+            const __m128i lo = _mm_unpacklo_epi8(px, zero);     // pixels 0 and 1
+            const __m128i hi = _mm_unpackhi_epi8(px, zero);     // pixels 2 and 3
+
+            __m128i best = _mm_set1_epi32(std::numeric_limits<int>::max());
+            __m128i bestIndex = zero;
+            for (int i = 0; i < palette.count; ++i)
+            {
+                const __m128i dl = _mm_sub_epi16(lo, entries[i]);
+                const __m128i dh = _mm_sub_epi16(hi, entries[i]);
+                const __m128i sl = _mm_madd_epi16(dl, _mm_mullo_epi16(dl, w));
+                const __m128i sh = _mm_madd_epi16(dh, _mm_mullo_epi16(dh, w));
+
+                // Each pixel left two partial sums (R+G, B+A); add them up in pixel order
+                const __m128 fl = _mm_castsi128_ps(sl);
+                const __m128 fh = _mm_castsi128_ps(sh);
+                const __m128i error = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(fl, fh, _MM_SHUFFLE(2, 0, 2, 0))),
+                                                    _mm_castps_si128(_mm_shuffle_ps(fl, fh, _MM_SHUFFLE(3, 1, 3, 1))));
+
+                const __m128i better = _mm_cmplt_epi32(error, best);
+                best = _mm_or_si128(_mm_and_si128(better, error), _mm_andnot_si128(better, best));
+                bestIndex = _mm_or_si128(_mm_and_si128(better, _mm_set1_epi32(i)), _mm_andnot_si128(better, bestIndex));
+            }
+
+            total = _mm_add_epi32(total, best);
+            alignas(16) int32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+            for (int i = 0; i < 4; ++i)
+                indices[group * 4 + i] = uint8_t(lanes[i]);
+        }
+
+        alignas(16) uint32_t sums[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(sums), total);
+        return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+        uint32_t total = 0;
+        for (int p = 0; p < 16; ++p)
+        {
+            const uint8_t* px = block.rgba + p * 4;
+            uint32_t best = UINT32_MAX;
+            for (int i = 0; i < palette.count; ++i)
+            {
+                uint32_t error = 0;
+                for (int c = 0; c < 4; ++c)
+                {
+                    const int d = int(px[c]) - palette.rgba[i][c];
+                    error += uint32_t(weights[c] * d * d);
+                }
+                if (error < best)
+                {
+                    best = error;
+                    indices[p] = uint8_t(i);
+                }
+            }
+            total += best;
+        }
+        return total;
+#endif
+    }
+
+    //-------------------------------------------------------------------------
+    // Endpoint search
+    //-------------------------------------------------------------------------
+
+    // Per-channel bounds, inset by a quarter step of the palette, with channels that fall while the widest one
+    // rises swapped so the line follows the block's main diagonal
+    void BoundingBox(const Block& block, const float (&mask)[16], int channels, int levels, float (&lo)[4], float (&hi)[4])
+    {
+        float mean[4] = {};
+        float count = 0.0f;
+        for (int c = 0; c < channels; ++c)
+        {
+            lo[c] = 255.0f;
+            hi[c] = 0.0f;
+        }
+        for (int p = 0; p < 16; ++p)
+        {
+            if (mask[p] == 0.0f)
+                continue;
+            count += 1.0f;
+            for (int c = 0; c < channels; ++c)
+            {
+                const float v = block.rgba[p * 4 + c];
+                lo[c] = std::min(lo[c], v);
+                hi[c] = std::max(hi[c], v);
+                mean[c] += v;
+            }
+        }
+        if (count == 0.0f)
+            return;
+
+        int widest = 0;
+        for (int c = 0; c < channels; ++c)
+        {
+            mean[c] /= count;
+            if (hi[c] - lo[c] > hi[widest] - lo[widest])
+                widest = c;
+        }
+
+        float covariance[4] = {};
+        for (int p = 0; p < 16; ++p)
+        {
+            if (mask[p] == 0.0f)
+                continue;
+            const float d = block.rgba[p * 4 + widest] - mean[widest];
+            for (int c = 0; c < channels; ++c)
+                covariance[c] += d * (block.rgba[p * 4 + c] - mean[c]);
+        }
+
+        for (int c = 0; c < channels; ++c)
+        {
+            const float inset = (hi[c] - lo[c]) / float(4 * levels);
+            lo[c] += inset;
+            hi[c] -= inset;
+            if (covariance[c] < 0.0f)
+                std::swap(lo[c], hi[c]);
+        }
+    }
+
+    // Extremes of the block along its principal axis
+    void PrincipalAxis(const Block& block, const float (&mask)[16], int channels, float (&lo)[4], float (&hi)[4])
+    {
+        float mean[4] = {};
+        float count = 0.0f;
+        for (int p = 0; p < 16; ++p)
+        {
+            count += mask[p];
+            for (int c = 0; c < channels; ++c)
+                mean[c] += mask[p] * block.rgba[p * 4 + c];
+        }
+        if (count == 0.0f)
+            return;
+        for (int c = 0; c < channels; ++c)
+            mean[c] /= count;
+
+        float cov[4][4] = {};
+        for (int p = 0; p < 16; ++p)
+        {
+            float d[4];
+            for (int c = 0; c < channels; ++c)
+                d[c] = block.rgba[p * 4 + c] - mean[c];
+            for (int i = 0; i < channels; ++i)
+                for (int j = i; j < channels; ++j)
+                    cov[i][j] += mask[p] * d[i] * d[j];
+        }
+        for (int i = 0; i < channels; ++i)
+            for (int j = 0; j < i; ++j)
+                cov[i][j] = cov[j][i];
+
+        // Power iteration, starting from the row with the largest variance
+        int start = 0;
+        for (int c = 1; c < channels; ++c)
+            if (cov[c][c] > cov[start][start])
+                start = c;
+        float axis[4];
+        for (int c = 0; c < channels; ++c)
+            axis[c] = cov[start][c];
+
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = {};
+            float length = 0.0f;
+            for (int i = 0; i < channels; ++i)
+            {
+                for (int j = 0; j < channels; ++j)
+                    next[i] += cov[i][j] * axis[j];
+                length = std::max(length, std::fabs(next[i]));
+            }
+            if (length == 0.0f)
+                break;
+            for (int c = 0; c < channels; ++c)
+                axis[c] = next[c] / length;
+        }
+
+        float norm = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            norm += axis[c] * axis[c];
+        if (norm == 0.0f)
+        {
+            // Flat block
+            for (int c = 0; c < channels; ++c)
+                lo[c] = hi[c] = mean[c];
+            return;
+        }
+
+        float tMin = std::numeric_limits<float>::max();
+        float tMax = -tMin;
+        for (int p = 0; p < 16; ++p)
+        {
+            if (mask[p] == 0.0f)
+                continue;
+            float t = 0.0f;
+            for (int c = 0; c < channels; ++c)
+                t += (block.rgba[p * 4 + c] - mean[c]) * axis[c];
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+        for (int c = 0; c < channels; ++c)
+        {
+            lo[c] = Clamp(mean[c] + tMin * axis[c] / norm, 0.0f, 255.0f);
+            hi[c] = Clamp(mean[c] + tMax * axis[c] / norm, 0.0f, 255.0f);
+        }
+    }
+
+    // Best endpoints for fixed indices: least squares on x = (1 - t) * lo + t * hi
+    bool RefineEndpoints(const Block& block, const float (&mask)[16], const uint8_t (&indices)[16], const float* t,
+                         int firstChannel, int channels, float (&lo)[4], float (&hi)[4])
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (int p = 0; p < 16; ++p)
+        {
+            const float b = t[indices[p]] * mask[p];
+            const float a = mask[p] - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = firstChannel; c < firstChannel + channels; ++c)
+            {
+                ax[c] += a * block.rgba[p * 4 + c];
+                bx[c] += b * block.rgba[p * 4 + c];
+            }
+        }
+
+        const float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-4f)
+            return false;
+        for (int c = firstChannel; c < firstChannel + channels; ++c)
+        {
+            lo[c] = Clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+            hi[c] = Clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Bit packing, least significant bit first
+    //-------------------------------------------------------------------------
+    // Fields are at most 8 bits, so each touches one or two bytes
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(uint8_t* out) : m_out(out), m_bit(0) { memset(out, 0, 16); }
+
+        void Write(uint32_t value, int bits)
+        {
+            const uint32_t shifted = value << (m_bit & 7);
+            m_out[m_bit >> 3] |= uint8_t(shifted);
+            if ((m_bit & 7) + bits > 8)
+                m_out[(m_bit >> 3) + 1] |= uint8_t(shifted >> 8);
+            m_bit += bits;
+        }
+
+    private:
+        uint8_t* m_out;
+        int      m_bit;
+    };
+
+    class BitReader
+    {
+    public:
+        explicit BitReader(const uint8_t* in) : m_in(in), m_bit(0) {}
+
+        uint32_t Read(int bits)
+        {
+            const int byte = m_bit >> 3;
+            const uint32_t window = m_in[byte] | (byte < 15 ? uint32_t(m_in[byte + 1]) << 8 : 0);
+            const uint32_t value = (window >> (m_bit & 7)) & ((1u << bits) - 1);
+            m_bit += bits;
+            return value;
+        }
+
+    private:
+        const uint8_t* m_in;
+        int            m_bit;
+    };
+
+    void PutLE16(uint8_t* p, uint32_t v) { p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); }
+    uint32_t GetLE16(const uint8_t* p) { return uint32_t(p[0]) | uint32_t(p[1]) << 8; }
+
+    //-------------------------------------------------------------------------
+    // BC1 colour block
+    //-------------------------------------------------------------------------
+    uint32_t To565(const float (&c)[4])
+    {
+        const uint32_t r = uint32_t(Clamp(c[0], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        const uint32_t g = uint32_t(Clamp(c[1], 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+        const uint32_t b = uint32_t(Clamp(c[2], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        return r << 11 | g << 5 | b;
+    }
+
+    void From565(uint32_t c, uint8_t* rgba)
+    {
+        const uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgba[0] = uint8_t(r << 3 | r >> 2);
+        rgba[1] = uint8_t(g << 2 | g >> 4);
+        rgba[2] = uint8_t(b << 3 | b >> 2);
+        rgba[3] = 255;
+    }
+
+    // The four colours a decoder derives from two endpoints
+    void Bc1Palette(uint32_t c0, uint32_t c1, bool alwaysFourColors, Palette& palette)
+    {
+        From565(c0, palette.rgba[0]);
+        From565(c1, palette.rgba[1]);
+        const uint8_t* a = palette.rgba[0];
+        const uint8_t* b = palette.rgba[1];
+        if (c0 > c1 || alwaysFourColors)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                palette.rgba[2][c] = uint8_t((2 * a[c] + b[c] + 1) / 3);
+                palette.rgba[3][c] = uint8_t((a[c] + 2 * b[c] + 1) / 3);
+            }
+            palette.rgba[2][3] = palette.rgba[3][3] = 255;
+        }
+        else
+        {
+            for (int c = 0; c < 3; ++c)
+                palette.rgba[2][c] = uint8_t((a[c] + b[c] + 1) / 2);
+            palette.rgba[2][3] = 255;
+            memset(palette.rgba[3], 0, 4);
+        }
+        palette.count = 4;
+    }
+
+    // BC1 allows transparent pixels through the three-colour mode; BC3's colour
+    // block is always decoded with four colours
+    void EncodeColorBlock(const Block& block, bool quality, bool bc1, uint8_t* out)
+    {
+        float mask[16];
+        uint32_t transparent = 0;
+        for (int p = 0; p < 16; ++p)
+        {
+            const bool clear = bc1 && block.rgba[p * 4 + 3] < 128;
+            transparent |= uint32_t(clear) << p;
+            mask[p] = clear ? 0.0f : 1.0f;
+        }
+
+        if (transparent == 0xffff)
+        {
+            PutLE16(out, 0);
+            PutLE16(out + 2, 0);
+            memset(out + 4, 0xff, 4);
+            return;
+        }
+
+        if (transparent == 0 && IsSolid(block))
+        {
+            const float color[4] = { float(block.rgba[0]), float(block.rgba[1]), float(block.rgba[2]), 255.0f };
+            const uint32_t c = To565(color);
+            PutLE16(out, c);
+            PutLE16(out + 2, c);
+            memset(out + 4, 0, 4);
+            return;
+        }
+        const bool threeColors = transparent != 0;
+
+        // Transparent pixels get the first palette colour so they add no error to the search
+        Block search = block;
+
+        uint32_t bestError = UINT32_MAX;
+        uint32_t bestC0 = 0, bestC1 = 0;
+        uint8_t bestIndices[16] = {};
+
+        auto evaluate = [&](const float (&lo)[4], const float (&hi)[4])
+        {
+            uint32_t c0 = To565(lo), c1 = To565(hi);
+            if (threeColors ? c0 > c1 : c0 < c1)
+                std::swap(c0, c1);
+
+            Palette palette;
+            Bc1Palette(c0, c1, !bc1, palette);
+            const bool fourColors = !bc1 || c0 > c1;
+            palette.count = fourColors ? 4 : 3;
+            for (int p = 0; p < 16; ++p)
+                if (transparent & (1u << p))
+                    memcpy(search.rgba + p * 4, palette.rgba[0], 4);
+
+            uint8_t indices[16];
+            const uint32_t error = FindIndices(search, palette, WEIGHTS_RGB, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestC0 = c0;
+                bestC1 = c1;
+                for (int p = 0; p < 16; ++p)
+                    bestIndices[p] = (transparent & (1u << p)) ? 3 : indices[p];
+            }
+        };
+
+        // Quality also tries the principal axis, which wins on blocks the box diagonal misses
+        float lo[4], hi[4];
+        BoundingBox(block, mask, 3, 4, lo, hi);
+        evaluate(lo, hi);
+        if (quality && bestError > 0)
+        {
+            PrincipalAxis(block, mask, 3, lo, hi);
+            evaluate(lo, hi);
+        }
+
+        // One refinement pass recovers the exact ends of two-colour blocks the inset moved
+        for (int iteration = 0; iteration < (quality ? 2 : 1) && bestError > 0; ++iteration)
+        {
+            static const float T4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+            static const float T3[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+            const bool fourColors = !bc1 || bestC0 > bestC1;
+            if (!RefineEndpoints(block, mask, bestIndices, fourColors ? T4 : T3, 0, 3, lo, hi))
+                break;
+            evaluate(lo, hi);
+        }
+
+        PutLE16(out, bestC0);
+        PutLE16(out + 2, bestC1);
+        uint32_t bits = 0;
+        for (int p = 0; p < 16; ++p)
+            bits |= uint32_t(bestIndices[p]) << (p * 2);
+        for (int i = 0; i < 4; ++i)
+            out[4 + i] = uint8_t(bits >> (i * 8));
+    }
+
+    //-------------------------------------------------------------------------
+    // BC3 alpha block
+    //-------------------------------------------------------------------------
+    void AlphaPalette(uint32_t a0, uint32_t a1, uint8_t (&values)[8])
+    {
+        values[0] = uint8_t(a0);
+        values[1] = uint8_t(a1);
+        if (a0 > a1)
+        {
+            for (uint32_t i = 1; i < 7; ++i)
+                values[i + 1] = uint8_t(((7 - i) * a0 + i * a1 + 3) / 7);
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; ++i)
+                values[i + 1] = uint8_t(((5 - i) * a0 + i * a1 + 2) / 5);
+            values[6] = 0;
+            values[7] = 255;
+        }
+    }
+
+    void EncodeAlphaBlock(const Block& block, bool quality, uint8_t* out)
+    {
+        int lo = 255, hi = 0;
+        int innerLo = 255, innerHi = 0;     // ignoring 0 and 255, which the six-value mode has for free
+        for (int p = 0; p < 16; ++p)
+        {
+            const int a = block.rgba[p * 4 + 3];
+            lo = std::min(lo, a);
+            hi = std::max(hi, a);
+            if (a != 0 && a != 255)
+            {
+                innerLo = std::min(innerLo, a);
+                innerHi = std::max(innerHi, a);
+            }
+        }
+
+        uint32_t bestError = UINT32_MAX;
+        uint32_t bestA0 = uint32_t(hi), bestA1 = uint32_t(lo);
+        uint8_t bestIndices[16] = {};
+
+        auto evaluate = [&](uint32_t a0, uint32_t a1)
+        {
+            uint8_t values[8];
+            AlphaPalette(a0, a1, values);
+            Palette palette;
+            palette.count = 8;
+            for (int i = 0; i < 8; ++i)
+            {
+                memset(palette.rgba[i], 0, 3);
+                palette.rgba[i][3] = values[i];
+            }
+
+            uint8_t indices[16];
+            const uint32_t error = FindIndices(block, palette, WEIGHTS_ALPHA, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestA0 = a0;
+                bestA1 = a1;
+                memcpy(bestIndices, indices, 16);
+            }
+        };
+
+        if (lo == hi)
+        {
+            out[0] = out[1] = uint8_t(lo);
+            memset(out + 2, 0, 6);
+            return;
+        }
+
+        evaluate(uint32_t(hi), uint32_t(lo));
+        if (quality)
+        {
+            // Pulling the ends in trades the extremes for finer steps in between
+            for (int inset = 1; inset <= 3 && hi - lo > 2 * inset; ++inset)
+            {
+                evaluate(uint32_t(hi - inset), uint32_t(lo));
+                evaluate(uint32_t(hi), uint32_t(lo + inset));
+                evaluate(uint32_t(hi - inset), uint32_t(lo + inset));
+            }
+            if (innerLo <= innerHi)
+                evaluate(uint32_t(innerLo), uint32_t(innerHi));
+        }
+
+        out[0] = uint8_t(bestA0);
+        out[1] = uint8_t(bestA1);
+        uint64_t bits = 0;
+        for (int p = 0; p < 16; ++p)
+            bits |= uint64_t(bestIndices[p]) << (p * 3);
+        for (int i = 0; i < 6; ++i)
+            out[2 + i] = uint8_t(bits >> (i * 8));
+    }
+
+    //-------------------------------------------------------------------------
+    // BC7 modes 6 and 5
+    //-------------------------------------------------------------------------
+    uint8_t Interpolate(int e0, int e1, int weight)
+    {
+        return uint8_t(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+    }
+
+    struct Mode6Endpoints
+    {
+        int q[2][4];        // 7 bits per channel
+        int p[2];           // shared low bit per endpoint
+    };
+
+    int Mode6Error(const float (&v)[4], int p, int (&q)[4])
+    {
+        int error = 0;
+        for (int c = 0; c < 4; ++c)
+        {
+            q[c] = Clamp(int((v[c] - p) / 2.0f + 0.5f), 0, 127);
+            const int d = (q[c] * 2 + p) - int(v[c] + 0.5f);
+            error += d * d;
+        }
+        return error;
+    }
+
+    // Picks each endpoint's p-bit for the closest representable colour
+    Mode6Endpoints QuantizeMode6(const float (&lo)[4], const float (&hi)[4])
+    {
+        Mode6Endpoints e;
+        const float (*ends[2])[4] = { &lo, &hi };
+        for (int i = 0; i < 2; ++i)
+        {
+            int q0[4], q1[4];
+            const int error0 = Mode6Error(*ends[i], 0, q0);
+            const int error1 = Mode6Error(*ends[i], 1, q1);
+            e.p[i] = error1 < error0 ? 1 : 0;
+            memcpy(e.q[i], e.p[i] ? q1 : q0, sizeof(q0));
+        }
+        return e;
+    }
+
+    void Mode6Palette(const Mode6Endpoints& e, Palette& palette)
+    {
+        palette.count = 16;
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 4; ++c)
+                palette.rgba[i][c] = Interpolate(e.q[0][c] * 2 + e.p[0], e.q[1][c] * 2 + e.p[1], BC7_WEIGHTS4[i]);
+    }
+
+    uint32_t EncodeMode6(const Block& block, bool quality, uint8_t* out)
+    {
+        static const float MASK[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+        uint32_t bestError = UINT32_MAX;
+        Mode6Endpoints best = {};
+        uint8_t bestIndices[16] = {};
+
+        auto evaluate = [&](const Mode6Endpoints& e)
+        {
+            Palette palette;
+            Mode6Palette(e, palette);
+            uint8_t indices[16];
+            const uint32_t error = FindIndices(block, palette, WEIGHTS_RGBA, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                best = e;
+                memcpy(bestIndices, indices, 16);
+            }
+        };
+
+        float lo[4], hi[4];
+        if (IsSolid(block))
+        {
+            for (int c = 0; c < 4; ++c)
+                lo[c] = hi[c] = block.rgba[c];
+            evaluate(QuantizeMode6(lo, hi));
+        }
+        else
+        {
+            BoundingBox(block, MASK, 4, 16, lo, hi);
+            evaluate(QuantizeMode6(lo, hi));
+        }
+        if (quality && bestError > 0)
+        {
+            PrincipalAxis(block, MASK, 4, lo, hi);
+            evaluate(QuantizeMode6(lo, hi));
+        }
+
+        for (int iteration = 0; iteration < (quality ? 2 : 1) && bestError > 0; ++iteration)
+        {
+            if (!RefineEndpoints(block, MASK, bestIndices, BC7_T4, 0, 4, lo, hi))
+                break;
+            evaluate(QuantizeMode6(lo, hi));
+
+            // The rounding choice per endpoint isn't always the best pair
+            for (int pbits = 0; quality && pbits < 4; ++pbits)
+            {
+                Mode6Endpoints alt;
+                alt.p[0] = pbits & 1;
+                alt.p[1] = pbits >> 1;
+                Mode6Error(lo, alt.p[0], alt.q[0]);
+                Mode6Error(hi, alt.p[1], alt.q[1]);
+                evaluate(alt);
+            }
+        }
+
+        // The first pixel's index has an implied top bit of zero
+        if (bestIndices[0] & 8)
+        {
+            std::swap(best.q[0], best.q[1]);
+            std::swap(best.p[0], best.p[1]);
+            for (uint8_t& index : bestIndices)
+                index = uint8_t(15 - index);
+        }
+
+        BitWriter bits(out);
+        bits.Write(1 << 6, 7);
+        for (int c = 0; c < 4; ++c)
+        {
+            bits.Write(uint32_t(best.q[0][c]), 7);
+            bits.Write(uint32_t(best.q[1][c]), 7);
+        }
+        bits.Write(uint32_t(best.p[0]), 1);
+        bits.Write(uint32_t(best.p[1]), 1);
+        bits.Write(bestIndices[0], 3);
+        for (int p = 1; p < 16; ++p)
+            bits.Write(bestIndices[p], 4);
+        return bestError;
+    }
+
+    // Colour and alpha get separate two-bit indices; no rotation
+    uint32_t EncodeMode5(const Block& block, uint8_t* out)
+    {
+        static const float MASK[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+        auto expand7 = [](int q) { return (q << 1) | (q >> 6); };
+
+        // Colour
+        uint32_t colorError = UINT32_MAX;
+        int colorQ[2][3] = {};
+        uint8_t colorIndices[16] = {};
+
+        auto evaluateColor = [&](const float (&lo)[4], const float (&hi)[4])
+        {
+            int q[2][3];
+            for (int c = 0; c < 3; ++c)
+            {
+                q[0][c] = Clamp(int(lo[c] * 127.0f / 255.0f + 0.5f), 0, 127);
+                q[1][c] = Clamp(int(hi[c] * 127.0f / 255.0f + 0.5f), 0, 127);
+            }
+            Palette palette;
+            palette.count = 4;
+            for (int i = 0; i < 4; ++i)
+            {
+                for (int c = 0; c < 3; ++c)
+                    palette.rgba[i][c] = Interpolate(expand7(q[0][c]), expand7(q[1][c]), BC7_WEIGHTS2[i]);
+                palette.rgba[i][3] = 0;
+            }
+            uint8_t indices[16];
+            const uint32_t error = FindIndices(block, palette, WEIGHTS_RGB, indices);
+            if (error < colorError)
+            {
+                colorError = error;
+                memcpy(colorQ, q, sizeof(q));
+                memcpy(colorIndices, indices, 16);
+            }
+        };
+
+        float lo[4], hi[4];
+        PrincipalAxis(block, MASK, 3, lo, hi);
+        evaluateColor(lo, hi);
+        for (int iteration = 0; iteration < 2 && colorError > 0; ++iteration)
+        {
+            if (!RefineEndpoints(block, MASK, colorIndices, BC7_T2, 0, 3, lo, hi))
+                break;
+            evaluateColor(lo, hi);
+        }
+
+        // Alpha
+        int aLo = 255, aHi = 0;
+        for (int p = 0; p < 16; ++p)
+        {
+            aLo = std::min(aLo, int(block.rgba[p * 4 + 3]));
+            aHi = std::max(aHi, int(block.rgba[p * 4 + 3]));
+        }
+
+        uint32_t alphaError = UINT32_MAX;
+        int alphaQ[2] = {};
+        uint8_t alphaIndices[16] = {};
+        auto evaluateAlpha = [&](int a0, int a1)
+        {
+            Palette palette;
+            palette.count = 4;
+            for (int i = 0; i < 4; ++i)
+            {
+                memset(palette.rgba[i], 0, 3);
+                palette.rgba[i][3] = Interpolate(a0, a1, BC7_WEIGHTS2[i]);
+            }
+            uint8_t indices[16];
+            const uint32_t error = FindIndices(block, palette, WEIGHTS_ALPHA, indices);
+            if (error < alphaError)
+            {
+                alphaError = error;
+                alphaQ[0] = a0;
+                alphaQ[1] = a1;
+                memcpy(alphaIndices, indices, 16);
+            }
+        };
+        evaluateAlpha(aLo, aHi);
+        for (int inset = 1; inset <= 4 && aHi - aLo > 2 * inset; ++inset)
+            evaluateAlpha(aLo + inset, aHi - inset);
+
+        if (colorIndices[0] & 2)
+        {
+            std::swap(colorQ[0], colorQ[1]);
+            for (uint8_t& index : colorIndices)
+                index = uint8_t(3 - index);
+        }
+        if (alphaIndices[0] & 2)
+        {
+            std::swap(alphaQ[0], alphaQ[1]);
+            for (uint8_t& index : alphaIndices)
+                index = uint8_t(3 - index);
+        }
+
+        BitWriter bits(out);
+        bits.Write(1 << 5, 6);
+        bits.Write(0, 2);
+        for (int c = 0; c < 3; ++c)
+        {
+            bits.Write(uint32_t(colorQ[0][c]), 7);
+            bits.Write(uint32_t(colorQ[1][c]), 7);
+        }
+        bits.Write(uint32_t(alphaQ[0]), 8);
+        bits.Write(uint32_t(alphaQ[1]), 8);
+        bits.Write(colorIndices[0], 1);
+        for (int p = 1; p < 16; ++p)
+            bits.Write(colorIndices[p], 2);
+        bits.Write(alphaIndices[0], 1);
+        for (int p = 1; p < 16; ++p)
+            bits.Write(alphaIndices[p], 2);
+        return colorError + alphaError;
+    }
+
+    void EncodeBc7Block(const Block& block, bool quality, uint8_t* out)
+    {
+        const uint32_t error6 = EncodeMode6(block, quality, out);
+        if (!quality || error6 == 0)
+            return;
+
+        bool alphaVaries = false;
+        for (int p = 1; p < 16 && !alphaVaries; ++p)
+            alphaVaries = block.rgba[p * 4 + 3] != block.rgba[3];
+        if (!alphaVaries)
+            return;
+
+        uint8_t mode5[16];
+        if (EncodeMode5(block, mode5) < error6)
+            memcpy(out, mode5, 16);
+    }
+
+    //-------------------------------------------------------------------------
+    // Decoding
+    //-------------------------------------------------------------------------
+    void DecodeBc1(const uint8_t* in, bool alwaysFourColors, uint8_t (&rgba)[64])
+    {
+        Palette palette;
+        Bc1Palette(GetLE16(in), GetLE16(in + 2), alwaysFourColors, palette);
+        for (int p = 0; p < 16; ++p)
+            memcpy(rgba + p * 4, palette.rgba[(in[4 + p / 4] >> ((p % 4) * 2)) & 3], 4);
+    }
+
+    void DecodeBc3Alpha(const uint8_t* in, uint8_t (&rgba)[64])
+    {
+        uint8_t values[8];
+        AlphaPalette(in[0], in[1], values);
+        uint64_t bits = 0;
+        for (int i = 0; i < 6; ++i)
+            bits |= uint64_t(in[2 + i]) << (i * 8);
+        for (int p = 0; p < 16; ++p)
+            rgba[p * 4 + 3] = values[(bits >> (p * 3)) & 7];
+    }
+
+    bool DecodeBc7(const uint8_t* in, uint8_t (&rgba)[64])
+    {
+        BitReader bits(in);
+        int mode = 0;
+        while (mode < 8 && bits.Read(1) == 0)
+            ++mode;
+
+        if (mode == 6)
+        {
+            int e[2][4];
+            for (int c = 0; c < 4; ++c)
+            {
+                e[0][c] = int(bits.Read(7)) << 1;
+                e[1][c] = int(bits.Read(7)) << 1;
+            }
+            const int p0 = int(bits.Read(1)), p1 = int(bits.Read(1));
+            for (int c = 0; c < 4; ++c)
+            {
+                e[0][c] |= p0;
+                e[1][c] |= p1;
+            }
+            for (int p = 0; p < 16; ++p)
+            {
+                const int index = int(bits.Read(p == 0 ? 3 : 4));
+                for (int c = 0; c < 4; ++c)
+                    rgba[p * 4 + c] = Interpolate(e[0][c], e[1][c], BC7_WEIGHTS4[index]);
+            }
+            return true;
+        }
+
+        if (mode == 5)
+        {
+            const uint32_t rotation = bits.Read(2);
+            int e[2][4];
+            for (int c = 0; c < 3; ++c)
+            {
+                const int q0 = int(bits.Read(7)), q1 = int(bits.Read(7));
+                e[0][c] = (q0 << 1) | (q0 >> 6);
+                e[1][c] = (q1 << 1) | (q1 >> 6);
+            }
+            e[0][3] = int(bits.Read(8));
+            e[1][3] = int(bits.Read(8));
+            for (int p = 0; p < 16; ++p)
+            {
+                const int index = int(bits.Read(p == 0 ? 1 : 2));
+                for (int c = 0; c < 3; ++c)
+                    rgba[p * 4 + c] = Interpolate(e[0][c], e[1][c], BC7_WEIGHTS2[index]);
+            }
+            for (int p = 0; p < 16; ++p)
+                rgba[p * 4 + 3] = Interpolate(e[0][3], e[1][3], BC7_WEIGHTS2[bits.Read(p == 0 ? 1 : 2)]);
+            if (rotation != 0)
+                for (int p = 0; p < 16; ++p)
+                    std::swap(rgba[p * 4 + 3], rgba[p * 4 + rotation - 1]);
+            return true;
+        }
+
+        memset(rgba, 0, sizeof(rgba));
+        return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Sizes and formats
+//-----------------------------------------------------------------------------
+size_t BcBlockBytes(BcFormat format)
+{
+    return format == BcFormat::Bc1 ? 8 : 16;
+}
+
+size_t BcCompressedSize(BcFormat format, uint32_t width, uint32_t height)
+{
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * BcBlockBytes(format);
+}
+
+static_assert(GetDxgiFormatInfo(71).bytesPerElement == 8 && GetDxgiFormatInfo(77).bytesPerElement == 16 &&
+              GetDxgiFormatInfo(98).bytesPerElement == 16, "BC block sizes");
+static_assert(DxgiSrgbFormat(71) == 72 && DxgiSrgbFormat(77) == 78 && DxgiSrgbFormat(98) == 99, "BC sRGB formats");
+
+uint32_t BcDxgiFormat(BcFormat format, bool srgb)
+{
+    switch (format)
+    {
+    case BcFormat::Bc1: return srgb ? 72 : 71;  // DXGI_FORMAT_BC1_UNORM(_SRGB)
+    case BcFormat::Bc3: return srgb ? 78 : 77;  // DXGI_FORMAT_BC3_UNORM(_SRGB)
+    default:            return srgb ? 99 : 98;  // DXGI_FORMAT_BC7_UNORM(_SRGB)
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Compression, one task per block row
+//-----------------------------------------------------------------------------
+bool BcCompress(const uint8_t* pixels, ptrdiff_t pitch, uint32_t width, uint32_t height, const BcOptions& options,
+                std::vector<uint8_t>& blocks, ThreadPool* pool)
+{
+    if (!pixels || width == 0 || height == 0 || width > 0x7ffffffc || height > 0x7ffffffc)
+        return false;
+
+    const uint32_t blocksWide = (width + 3) / 4;
+    const uint32_t blocksHigh = (height + 3) / 4;
+    const size_t blockBytes = BcBlockBytes(options.format);
+    const size_t rowBytes = blocksWide * blockBytes;
+    if (SIZE_MAX / rowBytes < blocksHigh)
+        return false;
+    blocks.resize(rowBytes * blocksHigh);
+
+    const bool quality = options.quality == BcQuality::Quality;
+    auto body = [&](size_t by)
+    {
+        uint8_t* out = blocks.data() + by * rowBytes;
+        Block block;
+        for (uint32_t bx = 0; bx < blocksWide; ++bx, out += blockBytes)
+        {
+            LoadBlock(pixels, pitch, width, height, bx, uint32_t(by), options.bgra, block);
+            switch (options.format)
+            {
+            case BcFormat::Bc1:
+                EncodeColorBlock(block, quality, true, out);
+                break;
+            case BcFormat::Bc3:
+                EncodeAlphaBlock(block, quality, out);
+                EncodeColorBlock(block, quality, false, out + 8);
+                break;
+            case BcFormat::Bc7:
+                EncodeBc7Block(block, quality, out);
+                break;
+            }
+        }
+    };
+
+    if (pool)
+        pool->ParallelFor(blocksHigh, body);
+    else
+        for (size_t by = 0; by < blocksHigh; ++by)
+            body(by);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Reference decoder
+//-----------------------------------------------------------------------------
+bool BcDecompress(const uint8_t* blocks, size_t size, uint32_t width, uint32_t height, BcFormat format, bool bgra,
+                  uint8_t* pixels, ptrdiff_t pitch)
+{
+    if (!blocks || !pixels || width == 0 || height == 0 || size < BcCompressedSize(format, width, height))
+        return false;
+
+    const uint32_t blocksWide = (width + 3) / 4;
+    const size_t blockBytes = BcBlockBytes(format);
+    bool ok = true;
+    for (uint32_t by = 0; by < (height + 3) / 4; ++by)
+    {
+        for (uint32_t bx = 0; bx < blocksWide; ++bx)
+        {
+            const uint8_t* in = blocks + (size_t(by) * blocksWide + bx) * blockBytes;
+            uint8_t rgba[64];
+            switch (format)
+            {
+            case BcFormat::Bc1:
+                DecodeBc1(in, false, rgba);
+                break;
+            case BcFormat::Bc3:
+                DecodeBc1(in + 8, true, rgba);
+                DecodeBc3Alpha(in, rgba);
+                break;
+            case BcFormat::Bc7:
+                ok = DecodeBc7(in, rgba) && ok;
+                break;
+            }
+
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+            {
+                uint8_t* row = pixels + ptrdiff_t(by * 4 + y) * pitch;
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+                {
+                    const uint8_t* s = rgba + (y * 4 + x) * 4;
+                    uint8_t* d = row + size_t(bx * 4 + x) * 4;
+                    d[0] = bgra ? s[2] : s[0];
+                    d[1] = s[1];
+                    d[2] = bgra ? s[0] : s[2];
+                    d[3] = s[3];
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// Error metrics
+//-----------------------------------------------------------------------------
+BcError BcMeasure(const uint8_t* a, ptrdiff_t pitchA, const uint8_t* b, ptrdiff_t pitchB,
+                  uint32_t width, uint32_t height, bool alpha)
+{
+    // Only empty images fail, and those have nothing to differ
+    const ImageMetricsOptions options = { true, alpha, false, 0 };
+    ImageQuality quality = { 0.0, std::numeric_limits<double>::infinity(), 0, 0.0, 0.0 };
+    MeasureImages(a, pitchA, b, pitchB, width, height, options, quality);
+
+    BcError error;
+    error.rmse = std::sqrt(quality.mse);
+    error.psnr = quality.psnr;
+    error.maxError = quality.maxAbsDiff;
+    return error;
+}
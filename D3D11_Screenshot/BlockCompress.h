@@ -0,0 +1,86 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: BlockCompress.h
+//
+// Portable BC1, BC3 and BC7 block compressor for screenshots and textures,
+// with a matching reference decoder and error metrics. Every 4x4 block is
+// encoded on its own: endpoints come from the bounding box (Fast), or the
+// better of the box and the principal axis (Quality), refined by least
+// squares, and the palette index of every pixel is found with an SSE2
+// nearest-colour search. Solid blocks skip the search. Block rows are spread
+// over a thread pool.
+//
+// BC7 uses the single-subset modes: mode 6 for every block and, in Quality,
+// mode 5 for blocks whose alpha varies. The partitioned modes are not used,
+// so sharp multi-colour blocks come out softer than a full BC7 search would
+// make them.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+enum class BcFormat
+{
+    Bc1,            // 4 bpp, RGB with 1-bit alpha
+    Bc3,            // 8 bpp, RGB with interpolated alpha
+    Bc7,            // 8 bpp, RGBA
+};
+
+enum class BcQuality
+{
+    Fast,
+    Quality,
+};
+
+struct BcOptions
+{
+    BcFormat  format;
+    BcQuality quality;
+    bool      bgra;         // source pixels are B, G, R, A; otherwise R, G, B, A
+};
+
+struct BcError
+{
+    double   rmse;          // over all measured channels
+    double   psnr;          // dB; infinite for identical images
+    uint32_t maxError;      // largest difference in any channel
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+size_t BcBlockBytes(BcFormat format);
+
+// Rows of blocks, each row ceil(width / 4) blocks long, as DDS and D3D11 store them
+size_t BcCompressedSize(BcFormat format, uint32_t width, uint32_t height);
+
+// The DXGI_FORMAT value of the compressed data
+uint32_t BcDxgiFormat(BcFormat format, bool srgb);
+
+// Compresses a top-down image (negative pitch for bottom-up) into `blocks`. Block rows
+// are compressed on `pool` if given, otherwise on the calling thread.
+bool BcCompress(const uint8_t* pixels, ptrdiff_t pitch, uint32_t width, uint32_t height, const BcOptions& options,
+                std::vector<uint8_t>& blocks, ThreadPool* pool = nullptr);
+
+// Reference decoder. BC7 blocks in modes other than 5 and 6 decode to transparent
+// black and make it return false.
+bool BcDecompress(const uint8_t* blocks, size_t size, uint32_t width, uint32_t height, BcFormat format, bool bgra,
+                  uint8_t* pixels, ptrdiff_t pitch);
+
+// Compares two 8-bit four-channel images; the alpha channel only counts when `alpha` is set.
+// A shorthand for MeasureImages without SSIM, for callers that only want the error.
+BcError BcMeasure(const uint8_t* a, ptrdiff_t pitchA, const uint8_t* b, ptrdiff_t pitchB,
+                  uint32_t width, uint32_t height, bool alpha);
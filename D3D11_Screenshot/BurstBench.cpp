@@ -0,0 +1,218 @@
+//-----------------------------------------------------------------------------
+// File: BurstBench.cpp
+//
+// Headless benchmark for the burst container, not part of the application
+// build. A synthetic desktop changes a little between shots: typing, a
+// ticking clock, a window being dragged, with an occasional switch to a new
+// "photo". Every shot is saved as its own QOI file, as its own fast PNG, and
+// appended to a burst. The burst is timed from the first Add until Close
+// returns, so its figure is the sustained rate with the background compressor
+// keeping up. Every shot is then read back from the burst, in order and
+// at random, and compared with the hash of the original.
+//
+//   g++ -std=c++14 -O2 -I. BurstBench.cpp BurstFile.cpp FrameHash.cpp QoiEncoder.cpp PngEncoder.cpp Deflate.cpp
+//       Thumbnails.cpp ../D3D11_ScreenCapture/Lz.cpp ../D3D11_ScreenCapture/MappedFile.cpp
+//       ../D3D11_ScreenCapture/ThreadPool.cpp -pthread -o burstbench
+//   ./burstbench [shots] [width] [height] [key interval]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "BurstFile.h"
+#include "BenchImage.h"
+#include "FrameHash.h"
+#include "PngEncoder.h"
+#include "QoiEncoder.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void Fill(std::vector<uint8_t>& frame, uint32_t width, uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, uint32_t color)
+    {
+        for (uint32_t y = y0; y < y0 + h; ++y)
+            for (uint32_t x = x0; x < x0 + w; ++x)
+                memcpy(&frame[(size_t(y) * width + x) * 4], &color, 4);
+    }
+
+    // Moves the desktop on by one shot
+    void Step(std::vector<uint8_t>& frame, const std::vector<uint8_t>& desktop, uint32_t width, uint32_t height,
+              uint32_t shot, std::mt19937& rng)
+    {
+        // A glyph typed into the top left window
+        const uint32_t perLine = width / 3 / 9;
+        const uint32_t glyph = shot % (perLine * 20);
+        Fill(frame, width, width / 16 + (glyph % perLine) * 9, height / 8 + (glyph / perLine) * 16, 7, 11,
+             0xff202020 + (rng() & 0x1f) * 0x010101);
+
+        // The clock in the corner ticks every tenth shot
+        if (shot % 10 == 0)
+            Fill(frame, width, width - 120, height - 28, 100, 20, 0xff000000 | (rng() & 0xffffff));
+
+        // A window dragged to the right, the desktop showing again where it was
+        const uint32_t w = width / 4, h = height / 4;
+        const uint32_t travel = width - w - width / 8;
+        const uint32_t x = width / 8 + (shot * 8) % travel, y = height / 2;
+        if (x >= 8 + width / 8)
+        {
+            for (uint32_t row = y; row < y + h; ++row)
+                memcpy(&frame[(size_t(row) * width + x - 8) * 4], &desktop[(size_t(row) * width + x - 8) * 4], 8 * 4);
+        }
+        Fill(frame, width, x, y, w, h, 0xfff0f0f0);
+        Fill(frame, width, x, y, w, 24, 0xff2b579a);
+
+        // Now and then a different photo: a big noisy change
+        if (shot % 50 == 49)
+        {
+            for (uint32_t row = height / 8; row < height / 8 + height / 3; ++row)
+                for (uint32_t col = width / 2; col < width / 2 + width / 3; ++col)
+                {
+                    const uint32_t c = 0xff000000 | ((col + shot) & 0xff) << 16 | ((row * 2) & 0xff) << 8 | (rng() & 0x3f);
+                    memcpy(&frame[(size_t(row) * width + col) * 4], &c, 4);
+                }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t shots = argc > 1 ? uint32_t(atoi(argv[1])) : 120;
+    const uint32_t width = argc > 2 ? uint32_t(atoi(argv[2])) : 3840;
+    const uint32_t height = argc > 3 ? uint32_t(atoi(argv[3])) : 2160;
+    const uint32_t keyInterval = argc > 4 ? uint32_t(atoi(argv[4])) : BURST_DEFAULT_KEY_INTERVAL;
+
+    if (shots == 0 || width < 640 || height < 480)
+    {
+        printf("needs at least one shot of 640x480\n");
+        return 1;
+    }
+
+    // The shots are generated up front, so only saving them is timed
+    const std::vector<uint8_t> desktop = MakeDesktop(width, height);
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint64_t> hashes;
+    {
+        std::mt19937 rng(99);
+        std::vector<uint8_t> frame = desktop;
+        for (uint32_t shot = 0; shot < shots; ++shot)
+        {
+            Step(frame, desktop, width, height, shot, rng);
+            frames.push_back(frame);
+            hashes.push_back(HashFrame(frame.data(), ptrdiff_t(width) * 4, size_t(width) * 4, height));
+        }
+    }
+
+    ThreadPool pool;
+    const double rawMiB = double(width) * height * 4 * shots / (1024.0 * 1024.0);
+    printf("%u shots of %ux%u, %u threads, key frame every %u\n\n", shots, width, height, pool.Size(), keyInterval);
+    printf("%-18s %10s %10s %12s %8s\n", "saving", "shots/s", "ms/shot", "MiB", "ratio");
+    auto report = [&](const char* name, double seconds, uint64_t bytes)
+    {
+        printf("%-18s %10.1f %10.2f %12.1f %8.2f\n", name, shots / seconds, seconds * 1000.0 / shots,
+               bytes / (1024.0 * 1024.0), rawMiB * 1024.0 * 1024.0 / double(bytes));
+    };
+
+    // One file per shot, the way the service saves them otherwise
+    auto separateFiles = [&](const char* name, const char* extension, bool png)
+    {
+        std::vector<uint8_t> encoded;
+        const PngOptions options = { DeflateLevel::Fast, false, 0 };
+        uint64_t bytes = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t shot = 0; shot < shots; ++shot)
+        {
+            if (png)
+                EncodePng(frames[shot].data(), ptrdiff_t(width) * 4, width, height, options, encoded, &pool);
+            else
+                EncodeQoi(frames[shot].data(), ptrdiff_t(width) * 4, width, height, false, encoded);
+            const std::string path = "BurstBench." + std::to_string(shot) + extension;
+            if (FILE* file = fopen(path.c_str(), "wb"))
+            {
+                fwrite(encoded.data(), 1, encoded.size(), file);
+                fclose(file);
+            }
+            bytes += encoded.size();
+        }
+        report(name, SecondsSince(start), bytes);
+        for (uint32_t shot = 0; shot < shots; ++shot)
+            remove(("BurstBench." + std::to_string(shot) + extension).c_str());
+    };
+    separateFiles("qoi files", ".qoi", false);
+    separateFiles("png fast files mt", ".png", true);
+
+    const char* burstPath = "BurstBench.burst";
+    BurstStats stats = {};
+    {
+        BurstWriter writer;
+        const auto start = std::chrono::steady_clock::now();
+        if (!writer.Open(burstPath, width, height, &pool, keyInterval))
+        {
+            printf("can't create %s\n", burstPath);
+            return 1;
+        }
+        for (uint32_t shot = 0; shot < shots; ++shot)
+            writer.Add(frames[shot].data(), ptrdiff_t(width) * 4, int64_t(shot));
+        const bool closed = writer.Close();
+        stats = writer.Stats();
+        report("burst mt", SecondsSince(start), stats.fileBytes);
+        if (!closed)
+        {
+            printf("burst write failed\n");
+            return 1;
+        }
+    }
+    printf("  %llu key frames, %.1f tiles stored per shot, %llu adds waited for a buffer\n",
+           (unsigned long long)stats.keyFrames, double(stats.storedTiles) / shots, (unsigned long long)stats.waits);
+
+    // Read back in order, then at random, and compare
+    BurstReader reader;
+    if (!reader.Open(burstPath) || reader.FrameCount() != shots)
+    {
+        printf("burst doesn't read back\n");
+        return 1;
+    }
+    std::vector<uint8_t> frame(size_t(width) * height * 4);
+    bool allOk = true;
+    auto check = [&](const char* name, const std::vector<uint32_t>& order)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        uint32_t bad = 0;
+        for (uint32_t shot : order)
+        {
+            if (!reader.Frame(shot, frame.data(), ptrdiff_t(width) * 4, &pool) ||
+                HashFrame(frame.data(), ptrdiff_t(width) * 4, size_t(width) * 4, height) != hashes[shot] ||
+                reader.Timestamp(shot) != int64_t(shot))
+                ++bad;
+        }
+        const double seconds = SecondsSince(start);
+        printf("%-18s %10.1f %10.2f %12s %8s\n", name, order.size() / seconds, seconds * 1000.0 / order.size(), "",
+               bad ? "MISMATCH" : "ok");
+        allOk = allOk && bad == 0;
+    };
+
+    std::vector<uint32_t> order(shots);
+    for (uint32_t shot = 0; shot < shots; ++shot)
+        order[shot] = shot;
+    check("read in order", order);
+    std::shuffle(order.begin(), order.end(), std::mt19937(5));
+    check("read at random", order);
+
+    reader.Close();
+    remove(burstPath);
+    return allOk ? 0 : 1;
+}
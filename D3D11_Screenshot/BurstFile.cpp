@@ -0,0 +1,447 @@
+//-----------------------------------------------------------------------------
+// File: BurstFile.cpp
+//
+// Burst container: background tile delta compression and random access reads.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "BurstFile.h"
+#include "../D3D11_ScreenCapture/FileIo.h"
+#include "../D3D11_ScreenCapture/Lz.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+
+namespace
+{
+    const size_t TILES_PER_TASK = 32;   // reader work item; a tile is only 16 KiB at the default size
+
+    uint32_t TilesAcross(uint32_t size, uint32_t tileSize)
+    {
+        return (size + tileSize - 1) / tileSize;
+    }
+
+    // Runs body(i) for i in [0, count), on the pool if there is one
+    void ForEach(ThreadPool* pool, size_t count, const std::function<void(size_t)>& body)
+    {
+        if (pool)
+        {
+            pool->ParallelFor(count, body);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i)
+            body(i);
+    }
+
+    // XORs `size` bytes of `b` into `a`, a word at a time
+    void XorInto(uint8_t* a, const uint8_t* b, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t x, y;
+            memcpy(&x, a + i, 8);
+            memcpy(&y, b + i, 8);
+            x ^= y;
+            memcpy(a + i, &x, 8);
+        }
+        for (; i < size; ++i)
+            a[i] ^= b[i];
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Writer
+//-----------------------------------------------------------------------------
+BurstWriter::BurstWriter() :
+    m_file(nullptr), m_pool(nullptr), m_width(0), m_height(0), m_tileSize(0), m_keyInterval(0),
+    m_closing(false), m_failed(false), m_stats()
+{
+}
+
+BurstWriter::~BurstWriter()
+{
+    Close();
+}
+
+#ifdef _WIN32
+bool BurstWriter::Open(const wchar_t* path, uint32_t width, uint32_t height, ThreadPool* pool,
+                       uint32_t keyInterval, uint32_t tileSize, uint32_t buffers)
+#else
+bool BurstWriter::Open(const char* path, uint32_t width, uint32_t height, ThreadPool* pool,
+                       uint32_t keyInterval, uint32_t tileSize, uint32_t buffers)
+#endif
+{
+    Close();
+
+    if (!path || width == 0 || height == 0 || tileSize == 0 || buffers == 0)
+        return false;
+
+#ifdef _WIN32
+    if (_wfopen_s(&m_file, path, L"wb") != 0)
+        m_file = nullptr;
+#else
+    m_file = OpenFile(path, "wb");
+#endif
+    if (!m_file)
+        return false;
+
+    const BURST_HEADER header = { BURST_MAGIC, BURST_VERSION, width, height, tileSize, std::max(1u, keyInterval) };
+    if (fwrite(&header, sizeof(header), 1, m_file) != 1)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+
+    m_pool = pool;
+    m_width = width;
+    m_height = height;
+    m_tileSize = tileSize;
+    m_keyInterval = header.keyInterval;
+    m_previous.assign(size_t(width) * height * 4, 0);
+    m_tileData.assign(size_t(TilesAcross(width, tileSize)) * TilesAcross(height, tileSize), std::vector<uint8_t>());
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_free.clear();
+    for (uint32_t i = 0; i < buffers; ++i)
+    {
+        m_free.emplace_back(new Shot());
+        m_free.back()->pixels.resize(m_previous.size());
+    }
+    m_queue.clear();
+    m_closing = false;
+    m_failed = false;
+    m_stats = BurstStats();
+    m_stats.fileBytes = sizeof(header);
+    m_compressor = std::thread(&BurstWriter::CompressorMain, this);
+    return true;
+}
+
+bool BurstWriter::Add(const uint8_t* bgra, ptrdiff_t pitch, int64_t timestamp)
+{
+    if (!m_file)
+        return false;
+
+    std::unique_ptr<Shot> shot;
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        if (m_free.empty() && !m_failed)
+        {
+            ++m_stats.waits;
+            m_freed.wait(lock, [this] { return !m_free.empty() || m_failed; });
+        }
+        if (m_failed)
+            return false;
+        shot = std::move(m_free.back());
+        m_free.pop_back();
+    }
+
+    const size_t rowBytes = size_t(m_width) * 4;
+    for (uint32_t y = 0; y < m_height; ++y)
+        memcpy(&shot->pixels[y * rowBytes], bgra + ptrdiff_t(y) * pitch, rowBytes);
+    shot->timestamp = timestamp;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_queue.push_back(std::move(shot));
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+bool BurstWriter::Close()
+{
+    if (!m_file)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_closing = true;
+    }
+    m_wake.notify_all();
+    if (m_compressor.joinable())
+        m_compressor.join();
+
+    const bool closed = fclose(m_file) == 0;
+    m_file = nullptr;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_failed = m_failed || !closed;
+    return !m_failed;
+}
+
+BurstStats BurstWriter::Stats() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_stats;
+}
+
+void BurstWriter::CompressorMain()
+{
+    for (;;)
+    {
+        std::unique_ptr<Shot> shot;
+        bool failed;
+        uint64_t frames;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wake.wait(lock, [this] { return m_closing || !m_queue.empty(); });
+            if (m_queue.empty())
+                break;
+            shot = std::move(m_queue.front());
+            m_queue.pop_front();
+            failed = m_failed;
+            frames = m_stats.frames;
+        }
+
+        // After a failed write the file may end in a partial record, so nothing more goes in
+        const bool key = frames % m_keyInterval == 0;
+        const bool written = !failed && WriteShot(*shot, key);
+
+        // The shot is what the next one is compared with; its buffer takes the old one's place
+        shot->pixels.swap(m_previous);
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_failed = m_failed || !written;
+            m_free.push_back(std::move(shot));
+        }
+        m_freed.notify_one();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// One record: every tile of a key frame, otherwise the changed tiles XORed with
+// the shot before. Rows of tiles are compressed in parallel.
+//-----------------------------------------------------------------------------
+bool BurstWriter::WriteShot(const Shot& shot, bool key)
+{
+    const uint32_t tilesX = TilesAcross(m_width, m_tileSize);
+    const uint32_t tilesY = TilesAcross(m_height, m_tileSize);
+    const size_t rowBytes = size_t(m_width) * 4;
+
+    ForEach(m_pool, tilesY, [&](size_t ty)
+    {
+        std::vector<uint8_t> raw(size_t(m_tileSize) * m_tileSize * 4);
+        const uint32_t y0 = uint32_t(ty) * m_tileSize;
+        const uint32_t h = std::min(m_tileSize, m_height - y0);
+        for (uint32_t tx = 0; tx < tilesX; ++tx)
+        {
+            const uint32_t x0 = tx * m_tileSize;
+            const size_t tileRow = size_t(std::min(m_tileSize, m_width - x0)) * 4;
+            const size_t rawSize = tileRow * h;
+            std::vector<uint8_t>& out = m_tileData[ty * tilesX + tx];
+
+            // Most tiles of a delta frame are unchanged, and comparing is cheaper than XORing
+            bool changed = key;
+            for (uint32_t y = 0; y < h && !changed; ++y)
+            {
+                const size_t at = size_t(y0 + y) * rowBytes + size_t(x0) * 4;
+                changed = memcmp(&shot.pixels[at], &m_previous[at], tileRow) != 0;
+            }
+            if (!changed)
+            {
+                out.clear();
+                continue;
+            }
+
+            for (uint32_t y = 0; y < h; ++y)
+            {
+                const size_t at = size_t(y0 + y) * rowBytes + size_t(x0) * 4;
+                memcpy(&raw[y * tileRow], &shot.pixels[at], tileRow);
+                if (!key)
+                    XorInto(&raw[y * tileRow], &m_previous[at], tileRow);
+            }
+
+            out.resize(LzCompressBound(rawSize));
+            const size_t size = LzCompress(raw.data(), rawSize, out.data(), out.size());
+            if (size == 0 || size >= rawSize)
+                out.assign(raw.begin(), raw.begin() + rawSize);
+            else
+                out.resize(size);
+        }
+    });
+
+    std::vector<BURST_TILE> tiles;
+    uint64_t dataSize = 0;
+    for (size_t i = 0; i < m_tileData.size(); ++i)
+    {
+        if (m_tileData[i].empty())
+            continue;
+        tiles.push_back(BURST_TILE{ uint32_t(i), uint32_t(m_tileData[i].size()) });
+        dataSize += m_tileData[i].size();
+    }
+
+    const BURST_FRAME frame = { shot.timestamp, key ? BURST_FRAME_KEY : 0u, uint32_t(tiles.size()), dataSize };
+    bool ok = fwrite(&frame, sizeof(frame), 1, m_file) == 1;
+    ok = ok && (tiles.empty() || fwrite(tiles.data(), sizeof(BURST_TILE), tiles.size(), m_file) == tiles.size());
+    for (const BURST_TILE& tile : tiles)
+        ok = ok && fwrite(m_tileData[tile.index].data(), 1, tile.storedSize, m_file) == tile.storedSize;
+    if (!ok)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    ++m_stats.frames;
+    m_stats.keyFrames += key ? 1 : 0;
+    m_stats.storedTiles += tiles.size();
+    m_stats.rawBytes += uint64_t(m_width) * m_height * 4;
+    m_stats.fileBytes += sizeof(frame) + tiles.size() * sizeof(BURST_TILE) + dataSize;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Reader
+//-----------------------------------------------------------------------------
+BurstReader::BurstReader() : m_header(), m_currentIndex(SIZE_MAX)
+{
+}
+
+bool BurstReader::Open(const char* path)
+{
+    Close();
+
+    if (!m_file.Open(path) || m_file.Size() < sizeof(BURST_HEADER))
+        return false;
+
+    memcpy(&m_header, m_file.Data(), sizeof(m_header));
+    if (m_header.magic != BURST_MAGIC || m_header.version != BURST_VERSION || m_header.width == 0 ||
+        m_header.height == 0 || m_header.tileSize == 0)
+    {
+        Close();
+        return false;
+    }
+
+    // Index the complete records; a crash may have cut the last one short
+    const uint64_t tileCount = uint64_t(TilesAcross(m_header.width, m_header.tileSize)) * TilesAcross(m_header.height, m_header.tileSize);
+    const uint8_t* data = m_file.Data();
+    size_t at = sizeof(BURST_HEADER);
+    while (m_file.Size() - at >= sizeof(BURST_FRAME))
+    {
+        const BURST_FRAME* frame = reinterpret_cast<const BURST_FRAME*>(data + at);
+        const uint64_t left = m_file.Size() - at - sizeof(BURST_FRAME);
+        if (frame->tileCount > tileCount || frame->tileCount * sizeof(BURST_TILE) > left ||
+            frame->dataSize > left - frame->tileCount * sizeof(BURST_TILE))
+            break;
+        m_frames.push_back(frame);
+        at += sizeof(BURST_FRAME) + frame->tileCount * sizeof(BURST_TILE) + size_t(frame->dataSize);
+    }
+
+    m_current.resize(size_t(m_header.width) * m_header.height * 4);
+    return true;
+}
+
+void BurstReader::Close()
+{
+    m_frames.clear();
+    m_current.clear();
+    m_currentIndex = SIZE_MAX;
+    m_header = BURST_HEADER();
+    m_file.Close();
+}
+
+bool BurstReader::Frame(size_t index, uint8_t* bgra, ptrdiff_t pitch, ThreadPool* pool)
+{
+    if (index >= m_frames.size())
+        return false;
+
+    size_t key = index;
+    while (!IsKeyFrame(key))
+    {
+        if (key == 0)
+            return false;
+        --key;
+    }
+
+    // Carry on from the shot rebuilt last if it lies between the key frame and this one
+    size_t next = key;
+    if (m_currentIndex != SIZE_MAX && m_currentIndex >= key && m_currentIndex <= index)
+        next = m_currentIndex + 1;
+    for (; next <= index; ++next)
+    {
+        if (!Apply(next, pool))
+        {
+            m_currentIndex = SIZE_MAX;
+            return false;
+        }
+        m_currentIndex = next;
+    }
+
+    const size_t rowBytes = size_t(m_header.width) * 4;
+    for (uint32_t y = 0; y < m_header.height; ++y)
+        memcpy(bgra + ptrdiff_t(y) * pitch, &m_current[y * rowBytes], rowBytes);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Rebuild shot `index` over m_current, which holds the one before unless it
+// is a key frame
+//-----------------------------------------------------------------------------
+bool BurstReader::Apply(size_t index, ThreadPool* pool)
+{
+    const BURST_FRAME* frame = m_frames[index];
+    const BURST_TILE* tiles = reinterpret_cast<const BURST_TILE*>(frame + 1);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(tiles + frame->tileCount);
+    const bool key = (frame->flags & BURST_FRAME_KEY) != 0;
+
+    const uint32_t tileSize = m_header.tileSize;
+    const uint32_t tilesX = TilesAcross(m_header.width, tileSize);
+    const uint32_t tileCount = tilesX * TilesAcross(m_header.height, tileSize);
+    if (key && frame->tileCount != tileCount)
+        return false;
+
+    // Tiles are listed in increasing order, so no two tasks touch the same pixels
+    std::vector<size_t> offsets(frame->tileCount);
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < frame->tileCount; ++i)
+    {
+        if (tiles[i].index >= tileCount || (i > 0 && tiles[i].index <= tiles[i - 1].index))
+            return false;
+        offsets[i] = size_t(offset);
+        offset += tiles[i].storedSize;
+    }
+    if (offset != frame->dataSize)
+        return false;
+
+    const size_t rowBytes = size_t(m_header.width) * 4;
+    std::atomic<bool> ok(true);
+    ForEach(pool, (frame->tileCount + TILES_PER_TASK - 1) / TILES_PER_TASK, [&](size_t task)
+    {
+        std::vector<uint8_t> raw(size_t(tileSize) * tileSize * 4);
+        const size_t last = std::min<size_t>(frame->tileCount, (task + 1) * TILES_PER_TASK);
+        for (size_t i = task * TILES_PER_TASK; i < last; ++i)
+        {
+            const uint32_t x0 = (tiles[i].index % tilesX) * tileSize;
+            const uint32_t y0 = (tiles[i].index / tilesX) * tileSize;
+            const size_t tileRow = size_t(std::min(tileSize, m_header.width - x0)) * 4;
+            const uint32_t h = std::min(tileSize, m_header.height - y0);
+            const size_t rawSize = tileRow * h;
+
+            const uint8_t* pixels = data + offsets[i];
+            if (tiles[i].storedSize != rawSize)
+            {
+                if (!LzDecompress(pixels, tiles[i].storedSize, raw.data(), rawSize))
+                {
+                    ok = false;
+                    return;
+                }
+                pixels = raw.data();
+            }
+
+            for (uint32_t y = 0; y < h; ++y)
+            {
+                uint8_t* row = &m_current[size_t(y0 + y) * rowBytes + size_t(x0) * 4];
+                if (key)
+                    memcpy(row, pixels + y * tileRow, tileRow);
+                else
+                    XorInto(row, pixels + y * tileRow, tileRow);
+            }
+        }
+    });
+    return ok;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: BurstFile.h
+//
+// Container for bursts of screenshots: one file per burst instead of one per
+// shot. A single header gives the size, and every shot is appended as a
+// record. Every keyInterval-th shot is a key frame, which stores all its
+// tiles LZ-compressed. The shots in between store only the tiles that
+// changed, XORed with the same tile of the shot before, so what didn't change
+// inside a tile compresses to runs of zeros.
+//
+//   BURST_HEADER
+//   records: BURST_FRAME, tileCount x BURST_TILE, the tile data in that order
+//
+// Tiles are tileSize square, cut short at the right and bottom edges, and
+// numbered row by row. A tile whose data is as long as the tile itself is
+// stored without compression. Records are written whole, and readers ignore
+// one that a crash cut short.
+//
+// The writer copies a shot and returns; a background thread diffs it with
+// the shot before and compresses the tiles on a thread pool. The reader maps
+// the file and rebuilds any shot from the key frame in front of it, carrying
+// on from the last shot it rebuilt when reading forward.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "../D3D11_ScreenCapture/MappedFile.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+#define BURST_MAGIC   0x42425254 // "TRBB"
+#define BURST_VERSION 1
+
+#define BURST_FRAME_KEY 0x00000001 // tiles hold pixels rather than differences
+
+const uint32_t BURST_DEFAULT_TILE_SIZE    = 64;
+const uint32_t BURST_DEFAULT_KEY_INTERVAL = 30;
+
+#pragma pack(push,1)
+
+struct BURST_HEADER
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t keyInterval;
+};
+
+struct BURST_FRAME
+{
+    int64_t  timestamp;
+    uint32_t flags;
+    uint32_t tileCount;    // tiles stored, BURST_TILE entries following
+    uint64_t dataSize;     // bytes of tile data after the entries
+};
+
+struct BURST_TILE
+{
+    uint32_t index;        // row by row
+    uint32_t storedSize;
+};
+
+#pragma pack(pop)
+
+struct BurstStats
+{
+    uint64_t frames;            // written to the file
+    uint64_t keyFrames;
+    uint64_t storedTiles;
+    uint64_t rawBytes;          // width * height * 4 per frame
+    uint64_t fileBytes;
+    uint64_t waits;             // Add calls that had to wait for a free buffer
+};
+
+//-----------------------------------------------------------------------------
+// Class declarations
+//-----------------------------------------------------------------------------
+
+class BurstWriter
+{
+public:
+    BurstWriter();
+    ~BurstWriter();
+
+    BurstWriter(const BurstWriter&) = delete;
+    BurstWriter& operator=(const BurstWriter&) = delete;
+
+    // Creates the file and starts the compressor. `buffers` shots may wait for it before
+    // Add blocks; the tiles of a shot are compressed on `pool`, or one by one without.
+#ifdef _WIN32
+    bool Open(const wchar_t* path, uint32_t width, uint32_t height, ThreadPool* pool = nullptr,
+              uint32_t keyInterval = BURST_DEFAULT_KEY_INTERVAL, uint32_t tileSize = BURST_DEFAULT_TILE_SIZE,
+              uint32_t buffers = 3);
+#else
+    bool Open(const char* path, uint32_t width, uint32_t height, ThreadPool* pool = nullptr,
+              uint32_t keyInterval = BURST_DEFAULT_KEY_INTERVAL, uint32_t tileSize = BURST_DEFAULT_TILE_SIZE,
+              uint32_t buffers = 3);
+#endif
+
+    // Copies a top-down BGRA shot (negative pitch for bottom-up) and queues it. Waits only
+    // when every buffer is taken; returns false once a write has failed.
+    bool Add(const uint8_t* bgra, ptrdiff_t pitch, int64_t timestamp);
+
+    // Writes everything queued and closes the file
+    bool Close();
+
+    bool IsOpen() const { return m_file != nullptr; }
+
+    BurstStats Stats() const;
+
+private:
+    struct Shot
+    {
+        std::vector<uint8_t> pixels;    // top-down, width * 4 per row
+        int64_t timestamp;
+    };
+
+    void CompressorMain();
+    bool WriteShot(const Shot& shot, bool key);
+
+    FILE* m_file;
+    ThreadPool* m_pool;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_tileSize;
+    uint32_t m_keyInterval;
+
+    std::thread m_compressor;
+    mutable std::mutex m_lock;          // guards everything below
+    std::condition_variable m_wake;     // a shot was queued or the writer is closing
+    std::condition_variable m_freed;    // a buffer came back
+    std::vector<std::unique_ptr<Shot>> m_free;
+    std::deque<std::unique_ptr<Shot>> m_queue;
+    bool m_closing;
+    bool m_failed;
+    BurstStats m_stats;
+
+    // Compressor thread only
+    std::vector<uint8_t> m_previous;    // the shot before, what deltas are taken against
+    std::vector<std::vector<uint8_t>> m_tileData;
+};
+
+class BurstReader
+{
+public:
+    BurstReader();
+
+    BurstReader(const BurstReader&) = delete;
+    BurstReader& operator=(const BurstReader&) = delete;
+
+    bool Open(const char* path);
+    void Close();
+
+    const BURST_HEADER& Header() const { return m_header; }
+    size_t FrameCount() const { return m_frames.size(); }
+    int64_t Timestamp(size_t index) const { return m_frames[index]->timestamp; }
+    bool IsKeyFrame(size_t index) const { return (m_frames[index]->flags & BURST_FRAME_KEY) != 0; }
+
+    // Rebuilds shot `index` into a top-down BGRA image, tiles spread over `pool` if given;
+    // returns false if the data is corrupt
+    bool Frame(size_t index, uint8_t* bgra, ptrdiff_t pitch, ThreadPool* pool = nullptr);
+
+private:
+    bool Apply(size_t index, ThreadPool* pool);
+
+    MappedFile m_file;
+    BURST_HEADER m_header;
+    std::vector<const BURST_FRAME*> m_frames;   // tile entries and data follow each one
+    std::vector<uint8_t> m_current;             // the last shot rebuilt
+    size_t m_currentIndex;                      // SIZE_MAX if none
+};
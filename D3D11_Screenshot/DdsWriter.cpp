@@ -0,0 +1,177 @@
+//-----------------------------------------------------------------------------
+// File: DdsWriter.cpp
+//
+// DDS header construction and double-buffered row streaming.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "DdsWriter.h"
+
+#include <algorithm>
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+// Header
+//-----------------------------------------------------------------------------
+size_t BuildDdsHeader(const DdsTextureDesc& desc, uint8_t (&header)[DDS_MAX_HEADER_SIZE])
+{
+    if (desc.width == 0 || desc.height == 0 || desc.mipLevels == 0 || desc.arraySize == 0)
+        return 0;
+
+    if (desc.cubemap && desc.arraySize % 6 != 0)
+        return 0;
+
+    const uint64_t pitchOrLinearSize = desc.compressed ? uint64_t(desc.rowBytes) * desc.rowCount : uint64_t(desc.rowBytes);
+    if (pitchOrLinearSize > UINT32_MAX)
+        return 0;
+
+    memset(header, 0, sizeof(header));
+    const uint32_t magic = DDS_MAGIC;
+    memcpy(header, &magic, sizeof(magic));
+
+    DDS_HEADER dds = {};
+    dds.size = sizeof(DDS_HEADER);
+    dds.flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP |
+                (desc.compressed ? DDS_HEADER_FLAGS_LINEARSIZE : DDS_HEADER_FLAGS_PITCH);
+    dds.height = desc.height;
+    dds.width = desc.width;
+    dds.pitchOrLinearSize = static_cast<uint32_t>(pitchOrLinearSize);
+    dds.mipMapCount = desc.mipLevels;
+    dds.caps = DDS_SURFACE_FLAGS_TEXTURE;
+    if (desc.mipLevels > 1)
+        dds.caps |= DDS_SURFACE_FLAGS_MIPMAP;
+    if (desc.cubemap)
+    {
+        dds.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+        dds.caps2 = DDS_CUBEMAP_ALLFACES;
+    }
+
+    // Legacy headers can describe a single texture or a single cube, nothing larger
+    const bool legacy = desc.legacyFormat && desc.arraySize == (desc.cubemap ? 6u : 1u);
+    dds.ddspf = legacy ? *desc.legacyFormat : DDSPF_DX10;
+    memcpy(header + sizeof(uint32_t), &dds, sizeof(dds));
+
+    if (legacy)
+        return sizeof(uint32_t) + sizeof(DDS_HEADER);
+
+    DDS_HEADER_DXT10 ext = {};
+    ext.dxgiFormat = desc.dxgiFormat;
+    ext.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    ext.miscFlag = desc.cubemap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+    ext.arraySize = desc.cubemap ? desc.arraySize / 6 : desc.arraySize;
+    memcpy(header + sizeof(uint32_t) + sizeof(DDS_HEADER), &ext, sizeof(ext));
+    return DDS_MAX_HEADER_SIZE;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor: allocates both buffers and starts the writer thread
+//-----------------------------------------------------------------------------
+DdsStreamWriter::DdsStreamWriter(Sink sink, size_t bufferSize) :
+    m_sink(std::move(sink)), m_bufferSize(std::max<size_t>(bufferSize, 4096)), m_current(0), m_used(0),
+    m_pending(nullptr), m_pendingSize(0), m_failed(false), m_stopping(false)
+{
+    m_buffers[0].reset(new uint8_t[m_bufferSize]);
+    m_buffers[1].reset(new uint8_t[m_bufferSize]);
+    m_writer = std::thread(&DdsStreamWriter::WriterMain, this);
+}
+
+DdsStreamWriter::~DdsStreamWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_writer.join();
+}
+
+//-----------------------------------------------------------------------------
+// Producer side: fill the current buffer, hand it over when full
+//-----------------------------------------------------------------------------
+bool DdsStreamWriter::Write(const void* data, size_t size)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    while (size > 0)
+    {
+        const size_t chunk = std::min(size, m_bufferSize - m_used);
+        memcpy(m_buffers[m_current].get() + m_used, src, chunk);
+        m_used += chunk;
+        src += chunk;
+        size -= chunk;
+
+        if (m_used == m_bufferSize && !Submit())
+            return false;
+    }
+    return true;
+}
+
+bool DdsStreamWriter::WriteRows(const uint8_t* src, size_t srcPitch, size_t rowBytes, size_t rowCount)
+{
+    // Tightly packed rows are one contiguous block
+    if (srcPitch == rowBytes)
+        return Write(src, rowBytes * rowCount);
+
+    for (size_t row = 0; row < rowCount; ++row, src += srcPitch)
+    {
+        if (!Write(src, rowBytes))
+            return false;
+    }
+    return true;
+}
+
+bool DdsStreamWriter::Finish()
+{
+    if (m_used > 0 && !Submit())
+        return false;
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_wake.wait(lock, [this] { return !m_pending; });
+    return !m_failed;
+}
+
+// Waits until the writer has finished with the other buffer, then swaps
+bool DdsStreamWriter::Submit()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_wake.wait(lock, [this] { return !m_pending || m_failed; });
+        if (m_failed)
+            return false;
+
+        m_pending = m_buffers[m_current].get();
+        m_pendingSize = m_used;
+    }
+    m_wake.notify_all();
+
+    m_current ^= 1;
+    m_used = 0;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Writer thread: pass each full buffer to the sink
+//-----------------------------------------------------------------------------
+void DdsStreamWriter::WriterMain()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (;;)
+    {
+        m_wake.wait(lock, [this] { return m_pending || m_stopping; });
+        if (!m_pending)
+            break;
+
+        const uint8_t* data = m_pending;
+        const size_t size = m_pendingSize;
+
+        lock.unlock();
+        const bool ok = m_sink(data, size);
+        lock.lock();
+
+        m_pending = nullptr;
+        m_failed = m_failed || !ok;
+        m_wake.notify_all();
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: DdsWriter.h
+//
+// Streams a DDS file from mapped subresources without staging the whole image
+// in memory. The header is built from a plain description, then the rows of
+// every subresource are copied into one of two fixed-size buffers while a
+// writer thread drains the other, so the disk write starts with the first
+// megabyte and peak memory no longer grows with the texture.
+//
+// Subresources must be written in DDS order: for each array item (cubemap
+// face), every mip level from the top down.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Dds.h"
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+const size_t DDS_MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+
+struct DdsTextureDesc
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t arraySize;         // faces for cubemaps, six per cube
+    uint32_t dxgiFormat;
+    bool     cubemap;
+    bool     compressed;        // the header stores the top level's size instead of its pitch
+    size_t   rowBytes;          // of the top level
+    size_t   rowCount;
+    const DDS_PIXELFORMAT* legacyFormat;    // nullptr writes the DX10 extension
+};
+
+//-----------------------------------------------------------------------------
+// Class declarations
+//-----------------------------------------------------------------------------
+
+class DdsStreamWriter
+{
+public:
+    // Receives the file in order; returns false to abort the stream
+    typedef std::function<bool(const uint8_t* data, size_t size)> Sink;
+
+    explicit DdsStreamWriter(Sink sink, size_t bufferSize = 1 << 20);
+    ~DdsStreamWriter();
+
+    DdsStreamWriter(const DdsStreamWriter&) = delete;
+    DdsStreamWriter& operator=(const DdsStreamWriter&) = delete;
+
+    bool Write(const void* data, size_t size);
+
+    // Copies `rowCount` rows of `rowBytes` each, `srcPitch` apart
+    bool WriteRows(const uint8_t* src, size_t srcPitch, size_t rowBytes, size_t rowCount);
+
+    // Writes what is still buffered and waits for the sink; false if any write failed
+    bool Finish();
+
+private:
+    void WriterMain();
+    bool Submit();
+
+    Sink                        m_sink;
+    size_t                      m_bufferSize;
+    std::unique_ptr<uint8_t[]>  m_buffers[2];
+    int                         m_current;      // buffer being filled
+    size_t                      m_used;
+
+    std::thread                 m_writer;
+    std::mutex                  m_lock;         // guards everything below
+    std::condition_variable     m_wake;
+    const uint8_t*              m_pending;      // buffer handed to the writer
+    size_t                      m_pendingSize;
+    bool                        m_failed;
+    bool                        m_stopping;
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Fills `header` with the magic, DDS_HEADER and (when needed) DDS_HEADER_DXT10;
+// returns the number of bytes used, or 0 if the description can't be stored
+size_t BuildDdsHeader(const DdsTextureDesc& desc, uint8_t (&header)[DDS_MAX_HEADER_SIZE]);
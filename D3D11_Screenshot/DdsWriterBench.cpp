@@ -0,0 +1,426 @@
+//-----------------------------------------------------------------------------
+// File: DdsWriterBench.cpp
+//
+// Headless test and benchmark for DdsWriter, not part of the application
+// build. Streams mip chains, texture arrays, cubemaps and a cube array in
+// uncompressed and BC formats from padded source rows, the way mapped staging
+// subresources arrive, through every buffer size from 4 KiB to 1 MiB. Each
+// file has to match one assembled row by row, with none of the padding in it,
+// and every header field has to describe the texture. A sink that fails part
+// of the way through has to stop the stream, and writers destroyed with data
+// still queued or half a buffer filled have to hand over only whole buffers
+// and join cleanly. Then a 4K frame is streamed for throughput.
+//
+//   g++ -std=c++14 -O2 -I. DdsWriterBench.cpp DdsWriter.cpp -pthread -o ddswriterbench
+//   ./ddswriterbench [runs]
+//
+// The same line with -O1 -g -fsanitize=thread checks the hand-over between
+// the producer and the writer thread.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "DdsWriter.h"
+#include "DxgiFormat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const uint8_t PADDING = 0xee;
+    const size_t  BUFFER_SIZES[] = { 1, 4096, 12345, 65536, 1 << 20 };   // 1 is raised to 4 KiB
+
+    struct TextureCase
+    {
+        const char*            name;
+        uint32_t               dxgiFormat;
+        uint32_t               width, height, mipLevels, arraySize;
+        bool                   cubemap;
+        const DDS_PIXELFORMAT* legacyFormat;
+    };
+
+    // One subresource as Map returns it: rows `pitch` apart, the gap filled with PADDING
+    struct Subresource
+    {
+        std::vector<uint8_t> data;
+        size_t               pitch, rowBytes, rowCount;
+    };
+
+    struct Texture
+    {
+        DdsTextureDesc           desc;
+        std::vector<Subresource> subresources;  // DDS order: every level of item 0, then item 1, ...
+        std::vector<uint8_t>     expected;      // the whole file, assembled row by row
+        size_t                   headerSize;
+    };
+
+    // Pitches are rounded up to 256 bytes and then some, except on every third
+    // subresource, which is tight to take the single-block path
+    bool MakeTexture(const TextureCase& tc, Texture& texture)
+    {
+        const DxgiFormatInfo format = GetDxgiFormatInfo(tc.dxgiFormat);
+        const DxgiSurfaceSize top = GetDxgiSurfaceSize(format, tc.width, tc.height);
+
+        DdsTextureDesc& desc = texture.desc;
+        desc = DdsTextureDesc();
+        desc.width = tc.width;
+        desc.height = tc.height;
+        desc.mipLevels = tc.mipLevels;
+        desc.arraySize = tc.arraySize;
+        desc.dxgiFormat = tc.dxgiFormat;
+        desc.cubemap = tc.cubemap;
+        desc.compressed = format.layout == DxgiLayout::Block4x4;
+        desc.rowBytes = size_t(top.rowBytes);
+        desc.rowCount = size_t(top.rowCount);
+        desc.legacyFormat = tc.legacyFormat;
+
+        uint8_t header[DDS_MAX_HEADER_SIZE];
+        texture.headerSize = BuildDdsHeader(desc, header);
+        if (!texture.headerSize)
+            return false;
+        texture.expected.assign(header, header + texture.headerSize);
+
+        texture.subresources.clear();
+        for (uint32_t item = 0; item < tc.arraySize; ++item)
+        {
+            for (uint32_t level = 0; level < tc.mipLevels; ++level)
+            {
+                const DxgiSurfaceSize size = GetDxgiSurfaceSize(format, std::max(1u, tc.width >> level),
+                                                                std::max(1u, tc.height >> level));
+                Subresource sub;
+                sub.rowBytes = size_t(size.rowBytes);
+                sub.rowCount = size_t(size.rowCount);
+                sub.pitch = texture.subresources.size() % 3 == 2 ? sub.rowBytes : ((sub.rowBytes + 255) & ~size_t(255)) + 64;
+                sub.data.assign(sub.pitch * sub.rowCount, PADDING);
+                for (size_t y = 0; y < sub.rowCount; ++y)
+                {
+                    uint8_t* row = &sub.data[y * sub.pitch];
+                    for (size_t x = 0; x < sub.rowBytes; ++x)
+                        row[x] = uint8_t((x * 7 + y * 13 + level * 29 + item * 53) % 251);
+                    texture.expected.insert(texture.expected.end(), row, row + sub.rowBytes);
+                }
+                texture.subresources.push_back(std::move(sub));
+            }
+        }
+        return true;
+    }
+
+    bool WriteTexture(DdsStreamWriter& writer, const Texture& texture)
+    {
+        if (!writer.Write(texture.expected.data(), texture.headerSize))
+            return false;
+        for (const Subresource& sub : texture.subresources)
+        {
+            if (!writer.WriteRows(sub.data.data(), sub.pitch, sub.rowBytes, sub.rowCount))
+                return false;
+        }
+        return writer.Finish();
+    }
+
+    bool Check(const char* name, bool ok)
+    {
+        printf("%-44s %s\n", name, ok ? "ok" : "MISMATCH");
+        return ok;
+    }
+
+    //-------------------------------------------------------------------------
+    // Header
+    //-------------------------------------------------------------------------
+
+    bool HeaderMatches(const TextureCase& tc, const Texture& texture)
+    {
+        const uint8_t* file = texture.expected.data();
+        uint32_t magic;
+        DDS_HEADER dds;
+        memcpy(&magic, file, sizeof(magic));
+        memcpy(&dds, file + sizeof(magic), sizeof(dds));
+
+        const DdsTextureDesc& desc = texture.desc;
+        const uint64_t pitchOrLinearSize = desc.compressed ? uint64_t(desc.rowBytes) * desc.rowCount : desc.rowBytes;
+        bool ok = magic == DDS_MAGIC && dds.size == sizeof(DDS_HEADER) && dds.width == tc.width &&
+                  dds.height == tc.height && dds.mipMapCount == tc.mipLevels && dds.pitchOrLinearSize == pitchOrLinearSize &&
+                  (dds.flags & (desc.compressed ? DDS_HEADER_FLAGS_LINEARSIZE : DDS_HEADER_FLAGS_PITCH)) &&
+                  (dds.caps & DDS_SURFACE_FLAGS_TEXTURE) &&
+                  ((dds.caps & DDS_SURFACE_FLAGS_MIPMAP) == DDS_SURFACE_FLAGS_MIPMAP) == (tc.mipLevels > 1) &&
+                  (dds.caps2 == DDS_CUBEMAP_ALLFACES) == tc.cubemap;
+
+        // A legacy format only fits a single texture or a single cube
+        const bool legacy = tc.legacyFormat && tc.arraySize == (tc.cubemap ? 6u : 1u);
+        if (legacy)
+            return ok && texture.headerSize == sizeof(uint32_t) + sizeof(DDS_HEADER) &&
+                   memcmp(&dds.ddspf, tc.legacyFormat, sizeof(DDS_PIXELFORMAT)) == 0;
+
+        DDS_HEADER_DXT10 ext;
+        memcpy(&ext, file + sizeof(magic) + sizeof(dds), sizeof(ext));
+        return ok && texture.headerSize == DDS_MAX_HEADER_SIZE && memcmp(&dds.ddspf, &DDSPF_DX10, sizeof(DDS_PIXELFORMAT)) == 0 &&
+               ext.dxgiFormat == tc.dxgiFormat && ext.resourceDimension == DDS_DIMENSION_TEXTURE2D &&
+               ext.miscFlag == (tc.cubemap ? uint32_t(DDS_RESOURCE_MISC_TEXTURECUBE) : 0u) &&
+               ext.arraySize == (tc.cubemap ? tc.arraySize / 6 : tc.arraySize);
+    }
+
+    bool RejectsBadDescriptions()
+    {
+        DdsTextureDesc good = {};
+        good.width = 64;
+        good.height = 64;
+        good.mipLevels = 1;
+        good.arraySize = 6;
+        good.dxgiFormat = 71;
+        good.cubemap = true;
+        good.compressed = true;
+        good.rowBytes = 16 * 8;
+        good.rowCount = 16;
+
+        uint8_t header[DDS_MAX_HEADER_SIZE];
+        bool ok = BuildDdsHeader(good, header) == DDS_MAX_HEADER_SIZE;
+
+        DdsTextureDesc bad = good;
+        bad.width = 0;
+        ok = ok && !BuildDdsHeader(bad, header);
+        bad = good;
+        bad.height = 0;
+        ok = ok && !BuildDdsHeader(bad, header);
+        bad = good;
+        bad.mipLevels = 0;
+        ok = ok && !BuildDdsHeader(bad, header);
+        bad = good;
+        bad.arraySize = 0;
+        ok = ok && !BuildDdsHeader(bad, header);
+        bad = good;
+        bad.arraySize = 7;      // not whole cubes
+        ok = ok && !BuildDdsHeader(bad, header);
+        bad = good;
+        bad.rowBytes = size_t(1) << 20;
+        bad.rowCount = size_t(1) << 12;     // linear size beyond 32 bits
+        ok = ok && !BuildDdsHeader(bad, header);
+        return ok;
+    }
+
+    //-------------------------------------------------------------------------
+    // Streaming
+    //-------------------------------------------------------------------------
+
+    // Appends to `file`; every chunk but the last has to be exactly one buffer
+    struct CollectingSink
+    {
+        std::vector<uint8_t>* file;
+        std::vector<size_t>*  chunks;
+
+        bool operator()(const uint8_t* data, size_t size) const
+        {
+            file->insert(file->end(), data, data + size);
+            chunks->push_back(size);
+            if (chunks->size() % 5 == 0)
+                std::this_thread::yield();      // let the producer run ahead now and then
+            return true;
+        }
+    };
+
+    bool StreamsEverySize(const Texture& texture)
+    {
+        for (size_t bufferSize : BUFFER_SIZES)
+        {
+            const size_t used = std::max<size_t>(bufferSize, 4096);
+            std::vector<uint8_t> file;
+            std::vector<size_t> chunks;
+            bool ok;
+            {
+                DdsStreamWriter writer(CollectingSink{ &file, &chunks }, bufferSize);
+                ok = WriteTexture(writer, texture);
+            }
+            for (size_t i = 0; ok && i + 1 < chunks.size(); ++i)
+                ok = chunks[i] == used;
+            ok = ok && !chunks.empty() && chunks.back() > 0 && chunks.back() <= used && file == texture.expected;
+            if (!ok)
+            {
+                printf("  %zu byte buffers: %zu bytes in %zu chunks, expected %zu\n", bufferSize, file.size(),
+                       chunks.size(), texture.expected.size());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A sink that fails on its `failAt`th call: nothing is passed on after it, and the
+    // producer sees the failure no later than Finish
+    bool StopsOnFailure(const Texture& texture)
+    {
+        for (size_t bufferSize : { size_t(4096), size_t(65536) })
+        {
+            const int buffers = int((texture.expected.size() + bufferSize - 1) / bufferSize);
+            for (int failAt = 1; failAt <= std::min(buffers, 3); ++failAt)
+            {
+                std::vector<uint8_t> file;
+                std::atomic<int> calls(0);
+                bool written;
+                {
+                    DdsStreamWriter writer([&](const uint8_t* data, size_t size) {
+                        if (++calls == failAt)
+                            return false;
+                        file.insert(file.end(), data, data + size);
+                        return true;
+                    }, bufferSize);
+                    written = WriteTexture(writer, texture);
+
+                    // Once failed, everything after fails too
+                    written = written || writer.Write(texture.expected.data(), bufferSize * 2) || writer.Finish();
+                }
+                const bool prefix = file.size() == bufferSize * (failAt - 1) &&
+                                    std::equal(file.begin(), file.end(), texture.expected.begin());
+                if (written || calls != failAt || !prefix)
+                {
+                    printf("  failing on call %d of %zu byte buffers: written %d, %d calls, %zu bytes\n", failAt,
+                           bufferSize, written, int(calls), file.size());
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Destroying the writer without Finish: a buffer already handed over is still
+    // written, the one being filled is dropped, and the destructor waits for the sink
+    bool DestroysMidWrite(const Texture& texture, std::mt19937& random)
+    {
+        const size_t bufferSize = 4096;
+        if (texture.expected.size() < bufferSize * 4)
+            return false;
+
+        // The sink is stuck on the first buffer while the second is half full
+        {
+            std::vector<uint8_t> file;
+            std::atomic<bool> open(false), entered(false), returned(false);
+            bool waited = false;
+            std::thread opener;
+            {
+                DdsStreamWriter writer([&](const uint8_t* data, size_t size) {
+                    entered = true;
+                    while (!open)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    file.insert(file.end(), data, data + size);
+                    return true;
+                }, bufferSize);
+                writer.Write(texture.expected.data(), bufferSize + bufferSize / 2);
+                while (!entered)
+                    std::this_thread::yield();
+
+                opener = std::thread([&]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+                    waited = !returned;
+                    open = true;
+                });
+            }
+            returned = true;
+            opener.join();
+            if (!waited || file.size() != bufferSize || !std::equal(file.begin(), file.end(), texture.expected.begin()))
+            {
+                printf("  blocked sink: %zu bytes written, destructor %s\n", file.size(), waited ? "waited" : "didn't wait");
+                return false;
+            }
+        }
+
+        // Then at random points: every whole buffer and nothing else
+        for (int run = 0; run < 200; ++run)
+        {
+            std::vector<uint8_t> file;
+            std::vector<size_t> chunks;
+            const size_t stop = random() % texture.expected.size();
+            {
+                DdsStreamWriter writer(CollectingSink{ &file, &chunks }, bufferSize);
+                writer.Write(texture.expected.data(), stop);
+            }
+            if (file.size() != stop / bufferSize * bufferSize ||
+                !std::equal(file.begin(), file.end(), texture.expected.begin()))
+            {
+                printf("  destroyed after %zu bytes: %zu written\n", stop, file.size());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int runs = argc > 1 ? std::max(1, atoi(argv[1])) : 3;
+
+    static const TextureCase CASES[] =
+    {
+        { "bgra mips",              87, 333, 187, 9, 1,  false, &DDSPF_A8R8G8B8 },
+        { "bgra array",             87, 100, 60,  3, 5,  false, &DDSPF_A8R8G8B8 },
+        { "r16 float",              54, 97,  33,  1, 1,  false, nullptr },
+        { "rgba16 float mips",      10, 1024, 768, 2, 1, false, nullptr },
+        { "bc1 cube",               71, 64,  64,  7, 6,  true,  &DDSPF_DXT1 },
+        { "bc7 cube array",         98, 36,  36,  6, 12, true,  nullptr },
+        { "bc3 odd mips",           77, 129, 65,  8, 2,  false, &DDSPF_DXT5 },
+    };
+
+    bool allOk = Check("bad descriptions rejected", RejectsBadDescriptions());
+
+    std::mt19937 random(1);
+    Texture texture;
+    for (const TextureCase& tc : CASES)
+    {
+        if (!MakeTexture(tc, texture))
+        {
+            allOk = Check(tc.name, false) && allOk;
+            continue;
+        }
+        printf("%s: %ux%u, %u levels, %u items, %zu bytes\n", tc.name, tc.width, tc.height, tc.mipLevels, tc.arraySize,
+               texture.expected.size());
+        allOk = Check("  header", HeaderMatches(tc, texture)) && allOk;
+        allOk = Check("  streamed, 4 KiB to 1 MiB buffers", StreamsEverySize(texture)) && allOk;
+        allOk = Check("  failing sink stops the stream", StopsOnFailure(texture)) && allOk;
+        if (texture.expected.size() >= 4 * 4096)
+            allOk = Check("  destroyed mid-write", DestroysMidWrite(texture, random)) && allOk;
+    }
+
+    // Throughput: a 4K frame from a padded staging texture into a sink that copies
+    const TextureCase frame = { "4k bgra", 87, 3840, 2160, 1, 1, false, &DDSPF_A8R8G8B8 };
+    if (!MakeTexture(frame, texture))
+        return 1;
+    printf("\n%-12s %10s %10s\n", "buffer", "ms", "MB/s");
+    std::vector<uint8_t> file(texture.expected.size());
+    for (size_t bufferSize : BUFFER_SIZES)
+    {
+        double best = 1e30;
+        bool same = true;
+        for (int run = 0; run < runs; ++run)
+        {
+            size_t at = 0;
+            const auto start = std::chrono::steady_clock::now();
+            {
+                DdsStreamWriter writer([&](const uint8_t* data, size_t size) {
+                    if (at + size > file.size())
+                        return false;
+                    memcpy(&file[at], data, size);
+                    at += size;
+                    return true;
+                }, bufferSize);
+                same = WriteTexture(writer, texture) && same;
+            }
+            best = std::min(best, MillisecondsSince(start));
+            same = same && at == file.size() && file == texture.expected;
+        }
+        printf("%-12zu %10.2f %10.1f %s\n", std::max<size_t>(bufferSize, 4096), best, file.size() / best / 1e3,
+               same ? "" : "MISMATCH");
+        allOk = allOk && same;
+    }
+
+    return allOk ? 0 : 1;
+}
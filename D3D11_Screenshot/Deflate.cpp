@@ -0,0 +1,636 @@
+//-----------------------------------------------------------------------------
+// File: Deflate.cpp
+//
+// LZ77 match finding, Huffman code construction and block output.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "Deflate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const uint32_t WINDOW_SIZE = 32768;
+    const uint32_t WINDOW_MASK = WINDOW_SIZE - 1;
+    const uint32_t HASH_BITS   = 15;
+    const uint32_t MIN_MATCH   = 3;        // shortest match deflate can code, one RGB pixel
+    const uint32_t MAX_MATCH   = 258;
+    const size_t   BLOCK_TOKENS = 1 << 16;  // tokens per Huffman block
+
+    const uint32_t LITLEN_CODES = 286;
+    const uint32_t DIST_CODES   = 30;
+    const uint32_t CODELEN_CODES = 19;
+    const uint32_t END_OF_BLOCK = 256;
+
+    struct LevelParams
+    {
+        uint32_t maxChain;      // candidates examined per position
+        uint32_t niceLength;    // stop searching at this length
+        bool     lazy;          // defer a match if the next position has a longer one
+        uint32_t maxInsert;     // longer matches don't index their inner positions
+    };
+
+    const LevelParams LEVELS[] =
+    {
+        {   1,  16, false,   4 },   // Fastest
+        {   4,  32, false,  16 },   // Fast
+        {  16, 128, true,  258 },   // Default
+        { 128, 258, true,  258 },   // Smallest
+    };
+
+    const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                       67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+                                       5, 5, 5, 5, 0 };
+    const uint16_t DIST_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                     1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t DIST_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+                                     11, 11, 12, 12, 13, 13 };
+    const uint8_t CODELEN_ORDER[CODELEN_CODES] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // Length and distance to code lookups
+    struct CodeTables
+    {
+        uint8_t lengthCode[MAX_MATCH + 1];
+        uint8_t distCodeLow[256];       // distance - 1 below 256
+        uint8_t distCodeHigh[256];      // (distance - 1) >> 7 from 256 on
+
+        CodeTables()
+        {
+            for (uint32_t code = 0; code < 29; ++code)
+            {
+                const uint32_t last = (code == 28) ? MAX_MATCH : LENGTH_BASE[code] + (1u << LENGTH_EXTRA[code]) - 1;
+                for (uint32_t length = LENGTH_BASE[code]; length <= last; ++length)
+                    lengthCode[length] = uint8_t(code);
+            }
+            lengthCode[0] = lengthCode[1] = lengthCode[2] = 0;
+
+            for (uint32_t code = 0; code < DIST_CODES; ++code)
+            {
+                const uint32_t last = DIST_BASE[code] + (1u << DIST_EXTRA[code]) - 1;
+                for (uint32_t distance = DIST_BASE[code]; distance <= last; ++distance)
+                {
+                    if (distance <= 256)
+                        distCodeLow[distance - 1] = uint8_t(code);
+                    else
+                        distCodeHigh[(distance - 1) >> 7] = uint8_t(code);
+                }
+            }
+        }
+
+        uint32_t DistCode(uint32_t distance) const
+        {
+            return distance <= 256 ? distCodeLow[distance - 1] : distCodeHigh[(distance - 1) >> 7];
+        }
+    };
+
+    const CodeTables& Tables()
+    {
+        static const CodeTables tables;
+        return tables;
+    }
+
+    //-------------------------------------------------------------------------
+    // Bit output, least significant bit first
+    //-------------------------------------------------------------------------
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : m_out(out), m_bits(0), m_count(0) {}
+
+        // `count` <= 32
+        void Put(uint32_t value, uint32_t count)
+        {
+            m_bits |= uint64_t(value) << m_count;
+            m_count += count;
+            if (m_count >= 32)
+            {
+                const uint8_t bytes[4] = { uint8_t(m_bits), uint8_t(m_bits >> 8), uint8_t(m_bits >> 16), uint8_t(m_bits >> 24) };
+                m_out.insert(m_out.end(), bytes, bytes + 4);
+                m_bits >>= 32;
+                m_count -= 32;
+            }
+        }
+
+        void AlignToByte()
+        {
+            while (m_count > 0)
+            {
+                m_out.push_back(uint8_t(m_bits));
+                m_bits >>= 8;
+                m_count = m_count > 8 ? m_count - 8 : 0;
+            }
+            m_bits = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& m_out;
+        uint64_t              m_bits;
+        uint32_t              m_count;
+    };
+
+    //-------------------------------------------------------------------------
+    // Huffman codes
+    //-------------------------------------------------------------------------
+
+    // Code lengths for `count` symbols, none longer than `limit`. Unused symbols get 0.
+    void BuildLengths(const uint32_t* freq, uint32_t count, uint32_t limit, uint8_t* lengths)
+    {
+        std::vector<uint32_t> weights(freq, freq + count);
+        std::vector<uint32_t> symbols;
+        std::vector<uint32_t> weight, parent, depth;
+
+        memset(lengths, 0, count);
+        for (;;)
+        {
+            symbols.clear();
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (weights[i])
+                    symbols.push_back(i);
+            }
+            if (symbols.empty())
+                return;
+            if (symbols.size() == 1)
+            {
+                lengths[symbols[0]] = 1;
+                return;
+            }
+
+            std::stable_sort(symbols.begin(), symbols.end(),
+                             [&](uint32_t a, uint32_t b) { return weights[a] < weights[b]; });
+
+            // Two-queue construction: leaves in order, internal nodes are created in order too
+            const size_t leaves = symbols.size();
+            weight.assign(2 * leaves - 1, 0);
+            parent.assign(2 * leaves - 1, 0);
+            depth.assign(2 * leaves - 1, 0);
+            for (size_t i = 0; i < leaves; ++i)
+                weight[i] = weights[symbols[i]];
+
+            size_t leaf = 0, node = leaves;
+            for (size_t next = leaves; next < 2 * leaves - 1; ++next)
+            {
+                size_t pick[2];
+                for (size_t& p : pick)
+                {
+                    if (leaf < leaves && (node >= next || weight[leaf] <= weight[node]))
+                        p = leaf++;
+                    else
+                        p = node++;
+                }
+                weight[next] = weight[pick[0]] + weight[pick[1]];
+                parent[pick[0]] = parent[pick[1]] = uint32_t(next);
+            }
+
+            uint32_t longest = 0;
+            for (size_t i = 2 * leaves - 1; i-- > 0;)
+            {
+                if (i != 2 * leaves - 2)
+                    depth[i] = depth[parent[i]] + 1;
+                if (i < leaves)
+                    longest = std::max(longest, depth[i]);
+            }
+
+            if (longest <= limit)
+            {
+                for (size_t i = 0; i < leaves; ++i)
+                    lengths[symbols[i]] = uint8_t(depth[i]);
+                return;
+            }
+
+            // Too deep: flatten the distribution and try again
+            for (uint32_t& w : weights)
+            {
+                if (w)
+                    w = (w + 1) / 2;
+            }
+        }
+    }
+
+    // Canonical codes, bit-reversed for LSB-first output
+    void BuildCodes(const uint8_t* lengths, uint32_t count, uint16_t* codes)
+    {
+        uint32_t lengthCount[16] = {};
+        for (uint32_t i = 0; i < count; ++i)
+            ++lengthCount[lengths[i]];
+        lengthCount[0] = 0;
+
+        uint32_t next[16] = {};
+        uint32_t code = 0;
+        for (uint32_t bits = 1; bits < 16; ++bits)
+        {
+            code = (code + lengthCount[bits - 1]) << 1;
+            next[bits] = code;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t length = lengths[i];
+            if (!length)
+            {
+                codes[i] = 0;
+                continue;
+            }
+            uint32_t value = next[length]++;
+            uint32_t reversed = 0;
+            for (uint32_t bit = 0; bit < length; ++bit, value >>= 1)
+                reversed = (reversed << 1) | (value & 1);
+            codes[i] = uint16_t(reversed);
+        }
+    }
+
+    // Decoders want complete codes; two used symbols always give one
+    void EnsureTwoCodes(uint32_t* freq, uint32_t count)
+    {
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < count; ++i)
+            used += freq[i] ? 1 : 0;
+        for (uint32_t i = 0; i < count && used < 2; ++i)
+        {
+            if (!freq[i])
+            {
+                freq[i] = 1;
+                ++used;
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Compressor
+    //-------------------------------------------------------------------------
+    struct Token
+    {
+        uint16_t length;        // literal byte when distance is 0
+        uint16_t distance;
+    };
+
+    class Compressor
+    {
+    public:
+        Compressor(const uint8_t* data, size_t start, size_t end, DeflateLevel level, std::vector<uint8_t>& out) :
+            m_data(data), m_base(start > WINDOW_SIZE ? start - WINDOW_SIZE : 0), m_start(start), m_end(end),
+            m_params(LEVELS[static_cast<int>(level)]), m_tables(Tables()), m_writer(out),
+            m_head(size_t(1) << HASH_BITS, -1), m_prev(WINDOW_SIZE, -1)
+        {
+            m_tokens.reserve(BLOCK_TOKENS);
+            ResetFrequencies();
+        }
+
+        void Run(bool last)
+        {
+            for (size_t p = m_base; p < m_start; ++p)
+                Insert(p);
+
+            size_t p = m_start;
+            while (p < m_end)
+            {
+                uint32_t distance = 0;
+                uint32_t length = FindMatch(p, distance);
+                if (length < MIN_MATCH)
+                {
+                    Insert(p);
+                    Literal(m_data[p]);
+                    ++p;
+                    continue;
+                }
+
+                Insert(p);
+                if (m_params.lazy)
+                {
+                    // Prefer a longer match starting one byte later
+                    while (length < m_params.niceLength && p + 1 < m_end)
+                    {
+                        uint32_t nextDistance = 0;
+                        const uint32_t nextLength = FindMatch(p + 1, nextDistance);
+                        if (nextLength <= length)
+                            break;
+                        Literal(m_data[p]);
+                        ++p;
+                        Insert(p);
+                        length = nextLength;
+                        distance = nextDistance;
+                    }
+                }
+
+                Match(length, distance);
+                if (length <= m_params.maxInsert)
+                {
+                    for (size_t i = p + 1; i < p + length; ++i)
+                        Insert(i);
+                }
+                p += length;
+            }
+
+            FlushBlock(last);
+            if (last)
+            {
+                m_writer.AlignToByte();
+            }
+            else
+            {
+                // Sync flush: empty stored block
+                m_writer.Put(0, 3);
+                m_writer.AlignToByte();
+                m_writer.Put(0xffff0000u, 32);
+            }
+        }
+
+    private:
+        uint32_t Hash(size_t p) const
+        {
+            const uint32_t v = uint32_t(m_data[p]) | uint32_t(m_data[p + 1]) << 8 | uint32_t(m_data[p + 2]) << 16;
+            return (v * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        void Insert(size_t p)
+        {
+            if (p + MIN_MATCH > m_end)
+                return;
+            const uint32_t h = Hash(p);
+            const int32_t position = int32_t(p - m_base);
+            m_prev[position & WINDOW_MASK] = m_head[h];
+            m_head[h] = position;
+        }
+
+        uint32_t MatchLength(size_t candidate, size_t p, uint32_t maxLength) const
+        {
+            uint32_t length = 0;
+            while (length + 8 <= maxLength)
+            {
+                uint64_t a, b;
+                memcpy(&a, m_data + candidate + length, 8);
+                memcpy(&b, m_data + p + length, 8);
+                if (a != b)
+                {
+                    // Little endian: the lowest differing byte is the first mismatch
+                    uint64_t diff = a ^ b;
+                    while (!(diff & 0xff))
+                    {
+                        diff >>= 8;
+                        ++length;
+                    }
+                    return length;
+                }
+                length += 8;
+            }
+            while (length < maxLength && m_data[candidate + length] == m_data[p + length])
+                ++length;
+            return length;
+        }
+
+        // Longest earlier match for position `p` (not yet inserted)
+        uint32_t FindMatch(size_t p, uint32_t& bestDistance) const
+        {
+            const uint32_t maxLength = uint32_t(std::min<size_t>(MAX_MATCH, m_end - p));
+            if (maxLength < MIN_MATCH)
+                return 0;
+
+            uint32_t best = 0;
+            int32_t candidate = m_head[Hash(p)];
+            const int32_t position = int32_t(p - m_base);
+            for (uint32_t chain = m_params.maxChain; candidate >= 0 && chain > 0; --chain)
+            {
+                const uint32_t distance = uint32_t(position - candidate);
+                if (distance == 0 || distance > WINDOW_SIZE)
+                    break;
+
+                const size_t c = m_base + size_t(candidate);
+                if (m_data[c + best] == m_data[p + best])
+                {
+                    const uint32_t length = MatchLength(c, p, maxLength);
+                    if (length > best)
+                    {
+                        best = length;
+                        bestDistance = distance;
+                        if (best >= m_params.niceLength || best >= maxLength)
+                            break;
+                    }
+                }
+
+                const int32_t next = m_prev[candidate & WINDOW_MASK];
+                if (next >= candidate)
+                    break;      // overwritten by a newer position
+                candidate = next;
+            }
+            return best;
+        }
+
+        void Literal(uint8_t value)
+        {
+            m_tokens.push_back(Token{ value, 0 });
+            ++m_litFreq[value];
+            if (m_tokens.size() == BLOCK_TOKENS)
+                FlushBlock(false);
+        }
+
+        void Match(uint32_t length, uint32_t distance)
+        {
+            m_tokens.push_back(Token{ uint16_t(length), uint16_t(distance) });
+            ++m_litFreq[257 + m_tables.lengthCode[length]];
+            ++m_distFreq[m_tables.DistCode(distance)];
+            if (m_tokens.size() == BLOCK_TOKENS)
+                FlushBlock(false);
+        }
+
+        void ResetFrequencies()
+        {
+            memset(m_litFreq, 0, sizeof(m_litFreq));
+            memset(m_distFreq, 0, sizeof(m_distFreq));
+        }
+
+        // Writes the buffered tokens as one dynamic Huffman block
+        void FlushBlock(bool last)
+        {
+            m_litFreq[END_OF_BLOCK] = 1;
+            EnsureTwoCodes(m_litFreq, LITLEN_CODES);
+            EnsureTwoCodes(m_distFreq, DIST_CODES);
+
+            uint8_t litLengths[LITLEN_CODES], distLengths[DIST_CODES];
+            uint16_t litCodes[LITLEN_CODES], distCodes[DIST_CODES];
+            BuildLengths(m_litFreq, LITLEN_CODES, 15, litLengths);
+            BuildLengths(m_distFreq, DIST_CODES, 15, distLengths);
+            BuildCodes(litLengths, LITLEN_CODES, litCodes);
+            BuildCodes(distLengths, DIST_CODES, distCodes);
+
+            uint32_t litCount = LITLEN_CODES, distCount = DIST_CODES;
+            while (litCount > 257 && !litLengths[litCount - 1])
+                --litCount;
+            while (distCount > 1 && !distLengths[distCount - 1])
+                --distCount;
+
+            // Run-length code the two length tables as one sequence
+            uint8_t lengths[LITLEN_CODES + DIST_CODES];
+            memcpy(lengths, litLengths, litCount);
+            memcpy(lengths + litCount, distLengths, distCount);
+            const uint32_t total = litCount + distCount;
+
+            struct Run { uint8_t symbol; uint8_t extra; };
+            Run runs[LITLEN_CODES + DIST_CODES];
+            uint32_t runCount = 0;
+            uint32_t codeLenFreq[CODELEN_CODES] = {};
+            auto emit = [&](uint8_t symbol, uint8_t extra)
+            {
+                runs[runCount++] = Run{ symbol, extra };
+                ++codeLenFreq[symbol];
+            };
+
+            for (uint32_t i = 0; i < total;)
+            {
+                const uint8_t value = lengths[i];
+                uint32_t run = 1;
+                while (i + run < total && lengths[i + run] == value)
+                    ++run;
+                i += run;
+
+                if (value == 0)
+                {
+                    while (run >= 11)
+                    {
+                        const uint32_t n = std::min(run, 138u);
+                        emit(18, uint8_t(n - 11));
+                        run -= n;
+                    }
+                    if (run >= 3)
+                    {
+                        emit(17, uint8_t(run - 3));
+                        run = 0;
+                    }
+                }
+                else
+                {
+                    emit(value, 0);
+                    --run;
+                    while (run >= 3)
+                    {
+                        const uint32_t n = std::min(run, 6u);
+                        emit(16, uint8_t(n - 3));
+                        run -= n;
+                    }
+                }
+                while (run-- > 0)
+                    emit(value, 0);
+            }
+
+            uint8_t codeLenLengths[CODELEN_CODES];
+            uint16_t codeLenCodes[CODELEN_CODES];
+            BuildLengths(codeLenFreq, CODELEN_CODES, 7, codeLenLengths);
+            BuildCodes(codeLenLengths, CODELEN_CODES, codeLenCodes);
+
+            uint32_t codeLenCount = CODELEN_CODES;
+            while (codeLenCount > 4 && !codeLenLengths[CODELEN_ORDER[codeLenCount - 1]])
+                --codeLenCount;
+
+            // Header
+            m_writer.Put(last ? 1 : 0, 1);
+            m_writer.Put(2, 2);
+            m_writer.Put(litCount - 257, 5);
+            m_writer.Put(distCount - 1, 5);
+            m_writer.Put(codeLenCount - 4, 4);
+            for (uint32_t i = 0; i < codeLenCount; ++i)
+                m_writer.Put(codeLenLengths[CODELEN_ORDER[i]], 3);
+
+            static const uint8_t RUN_EXTRA_BITS[3] = { 2, 3, 7 };
+            for (uint32_t i = 0; i < runCount; ++i)
+            {
+                const Run& run = runs[i];
+                m_writer.Put(codeLenCodes[run.symbol], codeLenLengths[run.symbol]);
+                if (run.symbol >= 16)
+                    m_writer.Put(run.extra, RUN_EXTRA_BITS[run.symbol - 16]);
+            }
+
+            // Data
+            for (const Token& token : m_tokens)
+            {
+                if (!token.distance)
+                {
+                    m_writer.Put(litCodes[token.length], litLengths[token.length]);
+                    continue;
+                }
+
+                const uint32_t lengthCode = m_tables.lengthCode[token.length];
+                m_writer.Put(litCodes[257 + lengthCode], litLengths[257 + lengthCode]);
+                m_writer.Put(token.length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+                const uint32_t distCode = m_tables.DistCode(token.distance);
+                m_writer.Put(distCodes[distCode], distLengths[distCode]);
+                m_writer.Put(token.distance - DIST_BASE[distCode], DIST_EXTRA[distCode]);
+            }
+            m_writer.Put(litCodes[END_OF_BLOCK], litLengths[END_OF_BLOCK]);
+
+            m_tokens.clear();
+            ResetFrequencies();
+        }
+
+        const uint8_t*       m_data;
+        size_t               m_base;        // oldest byte that can be referenced
+        size_t               m_start;
+        size_t               m_end;
+        LevelParams          m_params;
+        const CodeTables&    m_tables;
+        BitWriter            m_writer;
+        std::vector<int32_t> m_head;        // positions relative to m_base
+        std::vector<int32_t> m_prev;
+        std::vector<Token>   m_tokens;
+        uint32_t             m_litFreq[LITLEN_CODES];
+        uint32_t             m_distFreq[DIST_CODES];
+    };
+}
+
+void DeflateCompress(const uint8_t* data, size_t start, size_t end, DeflateLevel level, bool last,
+                     std::vector<uint8_t>& out)
+{
+    Compressor compressor(data, start, end, level, out);
+    compressor.Run(last);
+}
+
+void DeflateZlibHeader(DeflateLevel level, uint8_t header[2])
+{
+    // CMF: deflate with a 32 KiB window; FLG: level hint plus check bits
+    static const uint8_t FLG[] = { 0x01, 0x5e, 0x9c, 0xda };
+    header[0] = 0x78;
+    header[1] = FLG[static_cast<int>(level)];
+}
+
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size)
+{
+    const uint32_t MOD = 65521;
+    const size_t CHUNK = 5552;      // largest run before the sums can overflow
+
+    uint32_t a = adler & 0xffff, b = adler >> 16;
+    while (size > 0)
+    {
+        const size_t n = std::min(size, CHUNK);
+        for (size_t i = 0; i < n; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= MOD;
+        b %= MOD;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+    const uint32_t MOD = 65521;
+    const uint32_t rem = uint32_t(size2 % MOD);
+
+    uint32_t a = adler1 & 0xffff;
+    uint32_t b = uint32_t((uint64_t(rem) * a) % MOD);
+    a += (adler2 & 0xffff) + MOD - 1;
+    b += (adler1 >> 16) + (adler2 >> 16) + MOD - rem;
+    if (a >= MOD) a -= MOD;
+    if (a >= MOD) a -= MOD;
+    if (b >= 2 * MOD) b -= 2 * MOD;
+    if (b >= MOD) b -= MOD;
+    return (b << 16) | a;
+}
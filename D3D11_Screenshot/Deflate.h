@@ -0,0 +1,50 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: Deflate.h
+//
+// Deflate (RFC 1951) compressor for the PNG encoder: hash-chain LZ77 with
+// dynamic Huffman blocks. A stream can be produced in independent pieces, one
+// per thread: each piece may use the 32 KiB in front of it as a dictionary
+// and, unless it is the last one, ends with a sync flush (an empty stored
+// block), so the pieces simply concatenate into one valid stream.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+enum class DeflateLevel
+{
+    Fastest,        // single hash probe, greedy
+    Fast,           // short chains, greedy
+    Default,        // lazy matching
+    Smallest,       // long chains, lazy matching
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Compresses data[start, end) and appends the blocks to `out`. Up to 32 KiB in front
+// of `start` serve as dictionary. `last` ends the stream; otherwise the piece ends
+// byte-aligned with a sync flush.
+void DeflateCompress(const uint8_t* data, size_t start, size_t end, DeflateLevel level, bool last,
+                     std::vector<uint8_t>& out);
+
+// zlib stream header for `level` (deflate, 32 KiB window, no dictionary)
+void DeflateZlibHeader(DeflateLevel level, uint8_t header[2]);
+
+// Adler-32 as used by the zlib trailer; start with adler = 1
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size);
+
+// Adler-32 of two pieces joined, given the checksum and size of the second
+uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2);
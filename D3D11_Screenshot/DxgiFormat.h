@@ -0,0 +1,417 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: DxgiFormat.h
+//
+// Compile-time metadata for every DXGI_FORMAT: memory layout, bits per pixel,
+// bytes per element, channel order, component type, the typeless family, the
+// typed format to use for a typeless one, and the sRGB counterpart. Formats
+// are plain numbers so the table works without Direct3D headers; DXGI_FORMAT
+// values convert implicitly.
+//
+// Everything is constexpr. When the format is known at compile time, the
+// DxgiFormatTraits template gives constants, and pitch and size are folded
+// into the code that uses them.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+// How rows of a surface are laid out, which decides its pitch and size
+enum class DxgiLayout : uint8_t
+{
+    None,           // unknown or opaque; no CPU layout
+    Linear,         // whole pixels, bitsPerPixel each
+    Block4x4,       // BC: bytesPerElement per 4x4 block
+    Packed422,      // bytesPerElement per horizontal pair of pixels
+    Planar420,      // luma plane, then a half-height chroma plane
+    Planar411,      // NV11: quarter-width chroma, sized as Direct3D does
+    Planar422,      // P208
+    Planar440,      // V208
+    Planar444,      // V408
+};
+
+enum class DxgiChannels : uint8_t
+{
+    None,
+    R,
+    RG,
+    RGB,
+    RGBA,
+    BGR,
+    BGRA,
+    BGRX,
+    ABGR,
+    A,
+    DepthStencil,
+    Yuv,
+    Palette,
+};
+
+enum class DxgiComponent : uint8_t
+{
+    None,
+    Typeless,
+    Unorm,
+    UnormSrgb,
+    Snorm,
+    Uint,
+    Sint,
+    Float,
+    Other,          // depth/stencil, shared exponent, XR bias, video and palette formats
+};
+
+struct DxgiFormatInfo
+{
+    uint16_t      format;
+    DxgiLayout    layout;
+    uint8_t       bitsPerPixel;     // average, as the surface size implies; 0 if unknown
+    uint8_t       bytesPerElement;  // pixel, block, pixel pair or luma element, per layout
+    DxgiChannels  channels;
+    DxgiComponent component;
+    uint16_t      typeless;         // the TYPELESS member of the format's family, 0 if none
+    uint16_t      typed;            // for TYPELESS formats, the UNORM or FLOAT member to view it as
+    uint16_t      srgbPair;         // UNORM <-> UNORM_SRGB counterpart, 0 if none
+};
+
+struct DxgiSurfaceSize
+{
+    uint64_t rowBytes;
+    uint64_t rowCount;
+    uint64_t totalBytes;
+};
+
+//-----------------------------------------------------------------------------
+// Format table
+//-----------------------------------------------------------------------------
+
+// Indexed by DXGI_FORMAT from UNKNOWN to B4G4R4A4_UNORM
+constexpr DxgiFormatInfo DXGI_FORMAT_INFO[] =
+{
+    //  format  layout           bpp bpe channels                    component            typeless typed sRGB
+        {   0, DxgiLayout::None,       0,  0, DxgiChannels::None,         DxgiComponent::None,        0,   0,   0 },   // UNKNOWN
+        {   1, DxgiLayout::Linear,   128, 16, DxgiChannels::RGBA,         DxgiComponent::Typeless,    1,   2,   0 },   // R32G32B32A32_TYPELESS
+        {   2, DxgiLayout::Linear,   128, 16, DxgiChannels::RGBA,         DxgiComponent::Float,       1,   0,   0 },   // R32G32B32A32_FLOAT
+        {   3, DxgiLayout::Linear,   128, 16, DxgiChannels::RGBA,         DxgiComponent::Uint,        1,   0,   0 },   // R32G32B32A32_UINT
+        {   4, DxgiLayout::Linear,   128, 16, DxgiChannels::RGBA,         DxgiComponent::Sint,        1,   0,   0 },   // R32G32B32A32_SINT
+        {   5, DxgiLayout::Linear,    96, 12, DxgiChannels::RGB,          DxgiComponent::Typeless,    5,   6,   0 },   // R32G32B32_TYPELESS
+        {   6, DxgiLayout::Linear,    96, 12, DxgiChannels::RGB,          DxgiComponent::Float,       5,   0,   0 },   // R32G32B32_FLOAT
+        {   7, DxgiLayout::Linear,    96, 12, DxgiChannels::RGB,          DxgiComponent::Uint,        5,   0,   0 },   // R32G32B32_UINT
+        {   8, DxgiLayout::Linear,    96, 12, DxgiChannels::RGB,          DxgiComponent::Sint,        5,   0,   0 },   // R32G32B32_SINT
+        {   9, DxgiLayout::Linear,    64,  8, DxgiChannels::RGBA,         DxgiComponent::Typeless,    9,  11,   0 },   // R16G16B16A16_TYPELESS
+        {  10, DxgiLayout::Linear,    64,  8, DxgiChannels::RGBA,         DxgiComponent::Float,       9,   0,   0 },   // R16G16B16A16_FLOAT
+        {  11, DxgiLayout::Linear,    64,  8, DxgiChannels::RGBA,         DxgiComponent::Unorm,       9,   0,   0 },   // R16G16B16A16_UNORM
+        {  12, DxgiLayout::Linear,    64,  8, DxgiChannels::RGBA,         DxgiComponent::Uint,        9,   0,   0 },   // R16G16B16A16_UINT
+        {  13, DxgiLayout::Linear,    64,  8, DxgiChannels::RGBA,         DxgiComponent::Snorm,       9,   0,   0 },   // R16G16B16A16_SNORM
+        {  14, DxgiLayout::Linear,    64,  8, DxgiChannels::RGBA,         DxgiComponent::Sint,        9,   0,   0 },   // R16G16B16A16_SINT
+        {  15, DxgiLayout::Linear,    64,  8, DxgiChannels::RG,           DxgiComponent::Typeless,   15,  16,   0 },   // R32G32_TYPELESS
+        {  16, DxgiLayout::Linear,    64,  8, DxgiChannels::RG,           DxgiComponent::Float,      15,   0,   0 },   // R32G32_FLOAT
+        {  17, DxgiLayout::Linear,    64,  8, DxgiChannels::RG,           DxgiComponent::Uint,       15,   0,   0 },   // R32G32_UINT
+        {  18, DxgiLayout::Linear,    64,  8, DxgiChannels::RG,           DxgiComponent::Sint,       15,   0,   0 },   // R32G32_SINT
+        {  19, DxgiLayout::Linear,    64,  8, DxgiChannels::DepthStencil, DxgiComponent::Typeless,   19,   0,   0 },   // R32G8X24_TYPELESS
+        {  20, DxgiLayout::Linear,    64,  8, DxgiChannels::DepthStencil, DxgiComponent::Other,      19,   0,   0 },   // D32_FLOAT_S8X24_UINT
+        {  21, DxgiLayout::Linear,    64,  8, DxgiChannels::DepthStencil, DxgiComponent::Other,      19,   0,   0 },   // R32_FLOAT_X8X24_TYPELESS
+        {  22, DxgiLayout::Linear,    64,  8, DxgiChannels::DepthStencil, DxgiComponent::Other,      19,   0,   0 },   // X32_TYPELESS_G8X24_UINT
+        {  23, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Typeless,   23,  24,   0 },   // R10G10B10A2_TYPELESS
+        {  24, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Unorm,      23,   0,   0 },   // R10G10B10A2_UNORM
+        {  25, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Uint,       23,   0,   0 },   // R10G10B10A2_UINT
+        {  26, DxgiLayout::Linear,    32,  4, DxgiChannels::RGB,          DxgiComponent::Float,       0,   0,   0 },   // R11G11B10_FLOAT
+        {  27, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Typeless,   27,  28,   0 },   // R8G8B8A8_TYPELESS
+        {  28, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Unorm,      27,   0,  29 },   // R8G8B8A8_UNORM
+        {  29, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::UnormSrgb,  27,   0,  28 },   // R8G8B8A8_UNORM_SRGB
+        {  30, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Uint,       27,   0,   0 },   // R8G8B8A8_UINT
+        {  31, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Snorm,      27,   0,   0 },   // R8G8B8A8_SNORM
+        {  32, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Sint,       27,   0,   0 },   // R8G8B8A8_SINT
+        {  33, DxgiLayout::Linear,    32,  4, DxgiChannels::RG,           DxgiComponent::Typeless,   33,  35,   0 },   // R16G16_TYPELESS
+        {  34, DxgiLayout::Linear,    32,  4, DxgiChannels::RG,           DxgiComponent::Float,      33,   0,   0 },   // R16G16_FLOAT
+        {  35, DxgiLayout::Linear,    32,  4, DxgiChannels::RG,           DxgiComponent::Unorm,      33,   0,   0 },   // R16G16_UNORM
+        {  36, DxgiLayout::Linear,    32,  4, DxgiChannels::RG,           DxgiComponent::Uint,       33,   0,   0 },   // R16G16_UINT
+        {  37, DxgiLayout::Linear,    32,  4, DxgiChannels::RG,           DxgiComponent::Snorm,      33,   0,   0 },   // R16G16_SNORM
+        {  38, DxgiLayout::Linear,    32,  4, DxgiChannels::RG,           DxgiComponent::Sint,       33,   0,   0 },   // R16G16_SINT
+        {  39, DxgiLayout::Linear,    32,  4, DxgiChannels::R,            DxgiComponent::Typeless,   39,  41,   0 },   // R32_TYPELESS
+        {  40, DxgiLayout::Linear,    32,  4, DxgiChannels::DepthStencil, DxgiComponent::Float,      39,   0,   0 },   // D32_FLOAT
+        {  41, DxgiLayout::Linear,    32,  4, DxgiChannels::R,            DxgiComponent::Float,      39,   0,   0 },   // R32_FLOAT
+        {  42, DxgiLayout::Linear,    32,  4, DxgiChannels::R,            DxgiComponent::Uint,       39,   0,   0 },   // R32_UINT
+        {  43, DxgiLayout::Linear,    32,  4, DxgiChannels::R,            DxgiComponent::Sint,       39,   0,   0 },   // R32_SINT
+        {  44, DxgiLayout::Linear,    32,  4, DxgiChannels::DepthStencil, DxgiComponent::Typeless,   44,   0,   0 },   // R24G8_TYPELESS
+        {  45, DxgiLayout::Linear,    32,  4, DxgiChannels::DepthStencil, DxgiComponent::Other,      44,   0,   0 },   // D24_UNORM_S8_UINT
+        {  46, DxgiLayout::Linear,    32,  4, DxgiChannels::DepthStencil, DxgiComponent::Other,      44,   0,   0 },   // R24_UNORM_X8_TYPELESS
+        {  47, DxgiLayout::Linear,    32,  4, DxgiChannels::DepthStencil, DxgiComponent::Other,      44,   0,   0 },   // X24_TYPELESS_G8_UINT
+        {  48, DxgiLayout::Linear,    16,  2, DxgiChannels::RG,           DxgiComponent::Typeless,   48,  49,   0 },   // R8G8_TYPELESS
+        {  49, DxgiLayout::Linear,    16,  2, DxgiChannels::RG,           DxgiComponent::Unorm,      48,   0,   0 },   // R8G8_UNORM
+        {  50, DxgiLayout::Linear,    16,  2, DxgiChannels::RG,           DxgiComponent::Uint,       48,   0,   0 },   // R8G8_UINT
+        {  51, DxgiLayout::Linear,    16,  2, DxgiChannels::RG,           DxgiComponent::Snorm,      48,   0,   0 },   // R8G8_SNORM
+        {  52, DxgiLayout::Linear,    16,  2, DxgiChannels::RG,           DxgiComponent::Sint,       48,   0,   0 },   // R8G8_SINT
+        {  53, DxgiLayout::Linear,    16,  2, DxgiChannels::R,            DxgiComponent::Typeless,   53,  56,   0 },   // R16_TYPELESS
+        {  54, DxgiLayout::Linear,    16,  2, DxgiChannels::R,            DxgiComponent::Float,      53,   0,   0 },   // R16_FLOAT
+        {  55, DxgiLayout::Linear,    16,  2, DxgiChannels::DepthStencil, DxgiComponent::Unorm,      53,   0,   0 },   // D16_UNORM
+        {  56, DxgiLayout::Linear,    16,  2, DxgiChannels::R,            DxgiComponent::Unorm,      53,   0,   0 },   // R16_UNORM
+        {  57, DxgiLayout::Linear,    16,  2, DxgiChannels::R,            DxgiComponent::Uint,       53,   0,   0 },   // R16_UINT
+        {  58, DxgiLayout::Linear,    16,  2, DxgiChannels::R,            DxgiComponent::Snorm,      53,   0,   0 },   // R16_SNORM
+        {  59, DxgiLayout::Linear,    16,  2, DxgiChannels::R,            DxgiComponent::Sint,       53,   0,   0 },   // R16_SINT
+        {  60, DxgiLayout::Linear,     8,  1, DxgiChannels::R,            DxgiComponent::Typeless,   60,  61,   0 },   // R8_TYPELESS
+        {  61, DxgiLayout::Linear,     8,  1, DxgiChannels::R,            DxgiComponent::Unorm,      60,   0,   0 },   // R8_UNORM
+        {  62, DxgiLayout::Linear,     8,  1, DxgiChannels::R,            DxgiComponent::Uint,       60,   0,   0 },   // R8_UINT
+        {  63, DxgiLayout::Linear,     8,  1, DxgiChannels::R,            DxgiComponent::Snorm,      60,   0,   0 },   // R8_SNORM
+        {  64, DxgiLayout::Linear,     8,  1, DxgiChannels::R,            DxgiComponent::Sint,       60,   0,   0 },   // R8_SINT
+        {  65, DxgiLayout::Linear,     8,  1, DxgiChannels::A,            DxgiComponent::Unorm,       0,   0,   0 },   // A8_UNORM
+        {  66, DxgiLayout::Linear,     1,  0, DxgiChannels::R,            DxgiComponent::Unorm,       0,   0,   0 },   // R1_UNORM
+        {  67, DxgiLayout::Linear,    32,  4, DxgiChannels::RGB,          DxgiComponent::Other,       0,   0,   0 },   // R9G9B9E5_SHAREDEXP
+        {  68, DxgiLayout::Packed422,  32,  4, DxgiChannels::RGB,          DxgiComponent::Unorm,       0,   0,   0 },   // R8G8_B8G8_UNORM
+        {  69, DxgiLayout::Packed422,  32,  4, DxgiChannels::RGB,          DxgiComponent::Unorm,       0,   0,   0 },   // G8R8_G8B8_UNORM
+        {  70, DxgiLayout::Block4x4,   4,  8, DxgiChannels::RGBA,         DxgiComponent::Typeless,   70,  71,   0 },   // BC1_TYPELESS
+        {  71, DxgiLayout::Block4x4,   4,  8, DxgiChannels::RGBA,         DxgiComponent::Unorm,      70,   0,  72 },   // BC1_UNORM
+        {  72, DxgiLayout::Block4x4,   4,  8, DxgiChannels::RGBA,         DxgiComponent::UnormSrgb,  70,   0,  71 },   // BC1_UNORM_SRGB
+        {  73, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::Typeless,   73,  74,   0 },   // BC2_TYPELESS
+        {  74, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::Unorm,      73,   0,  75 },   // BC2_UNORM
+        {  75, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::UnormSrgb,  73,   0,  74 },   // BC2_UNORM_SRGB
+        {  76, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::Typeless,   76,  77,   0 },   // BC3_TYPELESS
+        {  77, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::Unorm,      76,   0,  78 },   // BC3_UNORM
+        {  78, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::UnormSrgb,  76,   0,  77 },   // BC3_UNORM_SRGB
+        {  79, DxgiLayout::Block4x4,   4,  8, DxgiChannels::R,            DxgiComponent::Typeless,   79,  80,   0 },   // BC4_TYPELESS
+        {  80, DxgiLayout::Block4x4,   4,  8, DxgiChannels::R,            DxgiComponent::Unorm,      79,   0,   0 },   // BC4_UNORM
+        {  81, DxgiLayout::Block4x4,   4,  8, DxgiChannels::R,            DxgiComponent::Snorm,      79,   0,   0 },   // BC4_SNORM
+        {  82, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RG,           DxgiComponent::Typeless,   82,  83,   0 },   // BC5_TYPELESS
+        {  83, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RG,           DxgiComponent::Unorm,      82,   0,   0 },   // BC5_UNORM
+        {  84, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RG,           DxgiComponent::Snorm,      82,   0,   0 },   // BC5_SNORM
+        {  85, DxgiLayout::Linear,    16,  2, DxgiChannels::BGR,          DxgiComponent::Unorm,       0,   0,   0 },   // B5G6R5_UNORM
+        {  86, DxgiLayout::Linear,    16,  2, DxgiChannels::BGRA,         DxgiComponent::Unorm,       0,   0,   0 },   // B5G5R5A1_UNORM
+        {  87, DxgiLayout::Linear,    32,  4, DxgiChannels::BGRA,         DxgiComponent::Unorm,      90,   0,  91 },   // B8G8R8A8_UNORM
+        {  88, DxgiLayout::Linear,    32,  4, DxgiChannels::BGRX,         DxgiComponent::Unorm,      92,   0,  93 },   // B8G8R8X8_UNORM
+        {  89, DxgiLayout::Linear,    32,  4, DxgiChannels::RGBA,         DxgiComponent::Other,       0,   0,   0 },   // R10G10B10_XR_BIAS_A2_UNORM
+        {  90, DxgiLayout::Linear,    32,  4, DxgiChannels::BGRA,         DxgiComponent::Typeless,   90,  87,   0 },   // B8G8R8A8_TYPELESS
+        {  91, DxgiLayout::Linear,    32,  4, DxgiChannels::BGRA,         DxgiComponent::UnormSrgb,  90,   0,  87 },   // B8G8R8A8_UNORM_SRGB
+        {  92, DxgiLayout::Linear,    32,  4, DxgiChannels::BGRX,         DxgiComponent::Typeless,   92,  88,   0 },   // B8G8R8X8_TYPELESS
+        {  93, DxgiLayout::Linear,    32,  4, DxgiChannels::BGRX,         DxgiComponent::UnormSrgb,  92,   0,  88 },   // B8G8R8X8_UNORM_SRGB
+        {  94, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGB,          DxgiComponent::Typeless,   94,   0,   0 },   // BC6H_TYPELESS
+        {  95, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGB,          DxgiComponent::Float,      94,   0,   0 },   // BC6H_UF16
+        {  96, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGB,          DxgiComponent::Float,      94,   0,   0 },   // BC6H_SF16
+        {  97, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::Typeless,   97,  98,   0 },   // BC7_TYPELESS
+        {  98, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::Unorm,      97,   0,  99 },   // BC7_UNORM
+        {  99, DxgiLayout::Block4x4,   8, 16, DxgiChannels::RGBA,         DxgiComponent::UnormSrgb,  97,   0,  98 },   // BC7_UNORM_SRGB
+        { 100, DxgiLayout::Linear,    32,  4, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // AYUV
+        { 101, DxgiLayout::Linear,    32,  4, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // Y410
+        { 102, DxgiLayout::Linear,    64,  8, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // Y416
+        { 103, DxgiLayout::Planar420,  12,  2, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // NV12
+        { 104, DxgiLayout::Planar420,  24,  4, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // P010
+        { 105, DxgiLayout::Planar420,  24,  4, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // P016
+        { 106, DxgiLayout::Planar420,  12,  2, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // 420_OPAQUE
+        { 107, DxgiLayout::Packed422,  32,  4, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // YUY2
+        { 108, DxgiLayout::Packed422,  64,  8, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // Y210
+        { 109, DxgiLayout::Packed422,  64,  8, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // Y216
+        { 110, DxgiLayout::Planar411,  12,  4, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // NV11
+        { 111, DxgiLayout::Linear,     8,  1, DxgiChannels::Palette,      DxgiComponent::Other,       0,   0,   0 },   // AI44
+        { 112, DxgiLayout::Linear,     8,  1, DxgiChannels::Palette,      DxgiComponent::Other,       0,   0,   0 },   // IA44
+        { 113, DxgiLayout::Linear,     8,  1, DxgiChannels::Palette,      DxgiComponent::Other,       0,   0,   0 },   // P8
+        { 114, DxgiLayout::Linear,    16,  2, DxgiChannels::Palette,      DxgiComponent::Other,       0,   0,   0 },   // A8P8
+        { 115, DxgiLayout::Linear,    16,  2, DxgiChannels::BGRA,         DxgiComponent::Unorm,       0,   0,   0 },   // B4G4R4A4_UNORM
+};
+
+// The formats added after the contiguous range
+constexpr DxgiFormatInfo DXGI_FORMAT_INFO_EXTRA[] =
+{
+        { 130, DxgiLayout::Planar422,  16,  2, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // P208
+        { 131, DxgiLayout::Planar440,  16,  1, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // V208
+        { 132, DxgiLayout::Planar444,  24,  1, DxgiChannels::Yuv,          DxgiComponent::Other,       0,   0,   0 },   // V408
+        { 189, DxgiLayout::None,       0,  0, DxgiChannels::None,         DxgiComponent::Other,       0,   0,   0 },   // SAMPLER_FEEDBACK_MIN_MIP_OPAQUE
+        { 190, DxgiLayout::None,       0,  0, DxgiChannels::None,         DxgiComponent::Other,       0,   0,   0 },   // SAMPLER_FEEDBACK_MIP_REGION_USED_OPAQUE
+        { 191, DxgiLayout::Linear,    16,  2, DxgiChannels::ABGR,         DxgiComponent::Unorm,       0,   0,   0 },   // A4B4G4R4_UNORM
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Unknown formats get the UNKNOWN entry
+constexpr DxgiFormatInfo GetDxgiFormatInfo(uint32_t format)
+{
+    if (format < sizeof(DXGI_FORMAT_INFO) / sizeof(DXGI_FORMAT_INFO[0]))
+        return DXGI_FORMAT_INFO[format];
+
+    for (const DxgiFormatInfo& info : DXGI_FORMAT_INFO_EXTRA)
+    {
+        if (info.format == format)
+            return info;
+    }
+    return DXGI_FORMAT_INFO[0];
+}
+
+constexpr bool IsDxgiCompressed(uint32_t format)
+{
+    return GetDxgiFormatInfo(format).layout == DxgiLayout::Block4x4;
+}
+
+constexpr bool IsDxgiSrgb(uint32_t format)
+{
+    return GetDxgiFormatInfo(format).component == DxgiComponent::UnormSrgb;
+}
+
+// The format to view a TYPELESS one as, assuming UNORM or FLOAT; other formats unchanged
+constexpr uint32_t DxgiTypedFormat(uint32_t format)
+{
+    return GetDxgiFormatInfo(format).typed ? GetDxgiFormatInfo(format).typed : format;
+}
+
+// The UNORM_SRGB counterpart, or the format itself if it has none
+constexpr uint32_t DxgiSrgbFormat(uint32_t format)
+{
+    return GetDxgiFormatInfo(format).component == DxgiComponent::Unorm && GetDxgiFormatInfo(format).srgbPair
+        ? GetDxgiFormatInfo(format).srgbPair : format;
+}
+
+// The UNORM counterpart of an sRGB format, or the format itself
+constexpr uint32_t DxgiLinearFormat(uint32_t format)
+{
+    return IsDxgiSrgb(format) ? GetDxgiFormatInfo(format).srgbPair : format;
+}
+
+// Pitch, row count and size of one subresource, the way Direct3D lays it out for
+// Map and initial data; all zero for formats without a CPU layout
+constexpr DxgiSurfaceSize GetDxgiSurfaceSize(const DxgiFormatInfo& info, uint64_t width, uint64_t height)
+{
+    DxgiSurfaceSize size = { 0, 0, 0 };
+    switch (info.layout)
+    {
+    case DxgiLayout::Linear:
+        size.rowBytes = (width * info.bitsPerPixel + 7) / 8;
+        size.rowCount = height;
+        break;
+
+    case DxgiLayout::Block4x4:
+        size.rowBytes = (width + 3) / 4 * info.bytesPerElement;
+        size.rowCount = (height + 3) / 4;
+        break;
+
+    case DxgiLayout::Packed422:
+        size.rowBytes = ((width + 1) >> 1) * info.bytesPerElement;
+        size.rowCount = height;
+        break;
+
+    case DxgiLayout::Planar420:
+        // The chroma plane can end halfway through a row
+        size.rowBytes = ((width + 1) >> 1) * info.bytesPerElement;
+        size.rowCount = height + ((height + 1) >> 1);
+        size.totalBytes = size.rowBytes * height + ((size.rowBytes * height + 1) >> 1);
+        return size;
+
+    case DxgiLayout::Planar411:
+        // Direct3D's simplifying assumption, larger than the 4:1:1 data
+        size.rowBytes = ((width + 3) >> 2) * info.bytesPerElement;
+        size.rowCount = height * 2;
+        break;
+
+    case DxgiLayout::Planar422:
+        size.rowBytes = ((width + 1) >> 1) * info.bytesPerElement;
+        size.rowCount = height * 2;
+        break;
+
+    case DxgiLayout::Planar440:
+        size.rowBytes = width * info.bytesPerElement;
+        size.rowCount = height + ((height + 1) >> 1) * 2;
+        break;
+
+    case DxgiLayout::Planar444:
+        size.rowBytes = width * info.bytesPerElement;
+        size.rowCount = height + (height >> 1) * 4;
+        break;
+
+    case DxgiLayout::None:
+        return size;
+    }
+    size.totalBytes = size.rowBytes * size.rowCount;
+    return size;
+}
+
+constexpr DxgiSurfaceSize GetDxgiSurfaceSize(uint32_t format, uint64_t width, uint64_t height)
+{
+    return GetDxgiSurfaceSize(GetDxgiFormatInfo(format), width, height);
+}
+
+//-----------------------------------------------------------------------------
+// Compile-time traits
+//-----------------------------------------------------------------------------
+
+// For code written for one format, e.g. DxgiFormatTraits<DXGI_FORMAT_B8G8R8A8_UNORM>::bytesPerPixel
+template <uint32_t Format>
+struct DxgiFormatTraits
+{
+    static constexpr DxgiLayout    layout = GetDxgiFormatInfo(Format).layout;
+    static constexpr DxgiChannels  channels = GetDxgiFormatInfo(Format).channels;
+    static constexpr DxgiComponent component = GetDxgiFormatInfo(Format).component;
+    static constexpr uint32_t      bitsPerPixel = GetDxgiFormatInfo(Format).bitsPerPixel;
+    static constexpr uint32_t      bytesPerPixel = layout == DxgiLayout::Linear ? bitsPerPixel / 8 : 0;
+    static constexpr bool          compressed = layout == DxgiLayout::Block4x4;
+    static constexpr bool          srgb = component == DxgiComponent::UnormSrgb;
+
+    static_assert(layout != DxgiLayout::None, "DXGI format without a CPU layout");
+
+    static constexpr uint64_t RowBytes(uint64_t width) { return GetDxgiSurfaceSize(GetDxgiFormatInfo(Format), width, 1).rowBytes; }
+    static constexpr uint64_t SurfaceBytes(uint64_t width, uint64_t height) { return GetDxgiSurfaceSize(GetDxgiFormatInfo(Format), width, height).totalBytes; }
+};
+
+template <uint32_t Format> constexpr DxgiLayout    DxgiFormatTraits<Format>::layout;
+template <uint32_t Format> constexpr DxgiChannels  DxgiFormatTraits<Format>::channels;
+template <uint32_t Format> constexpr DxgiComponent DxgiFormatTraits<Format>::component;
+template <uint32_t Format> constexpr uint32_t      DxgiFormatTraits<Format>::bitsPerPixel;
+template <uint32_t Format> constexpr uint32_t      DxgiFormatTraits<Format>::bytesPerPixel;
+template <uint32_t Format> constexpr bool          DxgiFormatTraits<Format>::compressed;
+template <uint32_t Format> constexpr bool          DxgiFormatTraits<Format>::srgb;
+
+//-----------------------------------------------------------------------------
+// Table checks
+//-----------------------------------------------------------------------------
+namespace DxgiFormatChecks
+{
+    // Every entry sits at its own value, pairs point at each other, and a family
+    // shares its typeless member's size
+    constexpr bool IsConsistent()
+    {
+        for (uint32_t i = 0; i < sizeof(DXGI_FORMAT_INFO) / sizeof(DXGI_FORMAT_INFO[0]); ++i)
+        {
+            const DxgiFormatInfo info = DXGI_FORMAT_INFO[i];
+            if (info.format != i)
+                return false;
+            if (info.srgbPair && GetDxgiFormatInfo(info.srgbPair).srgbPair != i)
+                return false;
+            if (info.typeless && (GetDxgiFormatInfo(info.typeless).bitsPerPixel != info.bitsPerPixel ||
+                                  GetDxgiFormatInfo(info.typeless).typeless != info.typeless))
+                return false;
+            if (info.typed && (info.component != DxgiComponent::Typeless ||
+                               GetDxgiFormatInfo(info.typed).typeless != i))
+                return false;
+            if (info.layout == DxgiLayout::Linear && info.bitsPerPixel >= 8 && info.bytesPerElement * 8 != info.bitsPerPixel)
+                return false;
+        }
+        for (const DxgiFormatInfo& info : DXGI_FORMAT_INFO_EXTRA)
+        {
+            if (info.format < sizeof(DXGI_FORMAT_INFO) / sizeof(DXGI_FORMAT_INFO[0]))
+                return false;
+        }
+        return true;
+    }
+
+    static_assert(IsConsistent(), "DXGI format table is inconsistent");
+
+    // Spot checks against ScreenGrab11's original BitsPerPixel, GetSurfaceInfo and EnsureNotTypeless
+    static_assert(DxgiFormatTraits<2>::bitsPerPixel == 128, "R32G32B32A32_FLOAT");
+    static_assert(DxgiFormatTraits<87>::bytesPerPixel == 4, "B8G8R8A8_UNORM");
+    static_assert(DxgiFormatTraits<87>::RowBytes(1921) == 7684, "B8G8R8A8_UNORM pitch");
+    static_assert(GetDxgiFormatInfo(66).bitsPerPixel == 1 && DxgiFormatTraits<66>::RowBytes(9) == 2, "R1_UNORM");
+    static_assert(DxgiFormatTraits<71>::RowBytes(5) == 16 && DxgiFormatTraits<71>::SurfaceBytes(1, 1) == 8, "BC1_UNORM");
+    static_assert(DxgiFormatTraits<98>::SurfaceBytes(1920, 1080) == 480 * 270 * 16, "BC7_UNORM");
+    static_assert(GetDxgiSurfaceSize(71, 0, 0).totalBytes == 0, "empty BC surface");
+    static_assert(DxgiFormatTraits<107>::RowBytes(3) == 8, "YUY2");
+    static_assert(GetDxgiSurfaceSize(103, 5, 3).totalBytes == 6 * 3 + 9 && GetDxgiSurfaceSize(103, 5, 3).rowCount == 5, "NV12");
+    static_assert(GetDxgiSurfaceSize(110, 5, 3).rowBytes == 8 && GetDxgiSurfaceSize(110, 5, 3).rowCount == 6, "NV11");
+    static_assert(GetDxgiFormatInfo(116).layout == DxgiLayout::None && GetDxgiFormatInfo(1000).format == 0, "unknown formats");
+    static_assert(DxgiTypedFormat(27) == 28 && DxgiTypedFormat(53) == 56 && DxgiTypedFormat(94) == 94, "typeless views");
+    static_assert(DxgiTypedFormat(19) == 19 && DxgiTypedFormat(87) == 87, "typed formats");
+    static_assert(DxgiSrgbFormat(87) == 91 && DxgiLinearFormat(99) == 98 && DxgiSrgbFormat(2) == 2, "sRGB pairs");
+}
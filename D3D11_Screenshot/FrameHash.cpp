@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// File: FrameHash.cpp
+//
+// Band-parallel 64-bit frame hash.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "FrameHash.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const size_t BAND_BYTES = 256 * 1024;   // hashed bytes per band
+
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+    const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+
+    inline uint64_t Rotl(uint64_t v, int bits)
+    {
+        return (v << bits) | (v >> (64 - bits));
+    }
+
+    inline uint64_t Read64(const uint8_t* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t Round(uint64_t acc, uint64_t input)
+    {
+        return Rotl(acc + input * PRIME2, 31) * PRIME1;
+    }
+
+    inline uint64_t Merge(uint64_t hash, uint64_t value)
+    {
+        return (hash ^ Round(0, value)) * PRIME1 + PRIME4;
+    }
+
+    inline uint64_t Avalanche(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        return h ^ (h >> 32);
+    }
+
+    // One band: each lane takes every fourth word of a row, the ragged end of the row
+    // goes into the first lanes with its length mixed in
+    uint64_t HashRows(const uint8_t* rows, ptrdiff_t pitch, size_t rowBytes, uint32_t count)
+    {
+        uint64_t v0 = PRIME1 + PRIME2;
+        uint64_t v1 = PRIME2;
+        uint64_t v2 = 0;
+        uint64_t v3 = 0 - PRIME1;
+
+        for (uint32_t y = 0; y < count; ++y)
+        {
+            const uint8_t* row = rows + ptrdiff_t(y) * pitch;
+            size_t i = 0;
+            for (; i + 32 <= rowBytes; i += 32)
+            {
+                v0 = Round(v0, Read64(row + i));
+                v1 = Round(v1, Read64(row + i + 8));
+                v2 = Round(v2, Read64(row + i + 16));
+                v3 = Round(v3, Read64(row + i + 24));
+            }
+            for (; i + 8 <= rowBytes; i += 8)
+                v0 = Round(v0, Read64(row + i));
+            if (i < rowBytes)
+            {
+                uint64_t last = 0;
+                memcpy(&last, row + i, rowBytes - i);
+                v1 = Round(v1, last ^ ((rowBytes - i) * PRIME3));
+            }
+        }
+
+        uint64_t h = Rotl(v0, 1) + Rotl(v1, 7) + Rotl(v2, 12) + Rotl(v3, 18);
+        h = Merge(h, v0);
+        h = Merge(h, v1);
+        h = Merge(h, v2);
+        return Merge(h, v3);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// HashFrame
+//-----------------------------------------------------------------------------
+uint64_t HashFrame(const uint8_t* pixels, ptrdiff_t pitch, size_t rowBytes, uint32_t height, ThreadPool* pool)
+{
+    uint64_t hash = Merge(Merge(PRIME4, rowBytes), height);
+    if (!pixels || rowBytes == 0 || height == 0)
+        return Avalanche(hash);
+
+    const uint32_t bandRows = uint32_t(std::min<size_t>(height, std::max<size_t>(1, BAND_BYTES / rowBytes)));
+    std::vector<uint64_t> bands((height + bandRows - 1) / bandRows);
+
+    auto hashBand = [&](size_t band)
+    {
+        const uint32_t firstRow = uint32_t(band * bandRows);
+        const uint32_t rows = std::min(bandRows, height - firstRow);
+        bands[band] = HashRows(pixels + ptrdiff_t(firstRow) * pitch, pitch, rowBytes, rows);
+    };
+
+    if (pool && bands.size() > 1)
+        pool->ParallelFor(bands.size(), hashBand);
+    else
+        for (size_t i = 0; i < bands.size(); ++i)
+            hashBand(i);
+
+    for (uint64_t band : bands)
+        hash = Merge(hash, band);
+    return Avalanche(hash);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: FrameHash.h
+//
+// 64-bit content hash of a frame, for spotting screenshots that are
+// byte-identical to one already saved. Only the pixel bytes of each row
+// count, not the padding a mapped texture adds, so the same picture hashes the
+// same from a staging texture and from a tightly packed copy. Bands of rows
+// are hashed independently (on a thread pool if given) and then combined;
+// the bands depend only on the frame size, so the result does too.
+//
+// The hash is fast rather than cryptographic: four independent
+// multiply-rotate lanes over 8-byte words, several GB/s per core.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Hashes `height` rows of `rowBytes` bytes each, `pitch` bytes apart (negative for
+// bottom-up). Frames of different row sizes or heights never share a hash by design.
+uint64_t HashFrame(const uint8_t* pixels, ptrdiff_t pitch, size_t rowBytes, uint32_t height, ThreadPool* pool = nullptr);
@@ -0,0 +1,634 @@
+//-----------------------------------------------------------------------------
+// File: ImageMetrics.cpp
+//
+// PSNR, largest difference, SSIM and MS-SSIM of an image against a reference.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "ImageMetrics.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define METRICS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const uint32_t WINDOW = 11;             // SSIM window, centred on the pixel it is for
+    const uint32_t RADIUS = WINDOW / 2;
+    const uint32_t BAND_ROWS = 64;          // rows measured by one task without tiles
+    const uint32_t MAX_SCALES = 5;
+
+    const float C1 = (0.01f * 255.0f) * (0.01f * 255.0f);
+    const float C2 = (0.03f * 255.0f) * (0.03f * 255.0f);
+
+    // Wang et al., "Multi-scale structural similarity for image quality assessment", 2003
+    const double MS_SSIM_WEIGHTS[MAX_SCALES] = { 0.0448, 0.2856, 0.3001, 0.2363, 0.1333 };
+
+    // Normalised Gaussian, sigma 1.5
+    struct GaussianWindow
+    {
+        float weights[WINDOW];
+
+        GaussianWindow()
+        {
+            double sum = 0.0, w[WINDOW];
+            for (uint32_t k = 0; k < WINDOW; ++k)
+            {
+                const double d = double(k) - RADIUS;
+                w[k] = std::exp(-d * d / (2.0 * 1.5 * 1.5));
+                sum += w[k];
+            }
+            for (uint32_t k = 0; k < WINDOW; ++k)
+                weights[k] = float(w[k] / sum);
+        }
+    };
+
+    const float* Gaussian()
+    {
+        static const GaussianWindow window;
+        return window.weights;
+    }
+
+    double Psnr(double mse)
+    {
+        return mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+    }
+
+    //-------------------------------------------------------------------------
+    // Kernels. The AVX2 versions below do the same float operations in the
+    // same order, so both give the same bits.
+    //-------------------------------------------------------------------------
+    struct DiffSum
+    {
+        uint64_t squares;
+        uint32_t maxDiff;
+    };
+
+    // Differences over `pixels` pixels, the alpha byte left out unless `alpha`
+    typedef void (*DiffRowFn)(const uint8_t* a, const uint8_t* b, uint32_t pixels, bool alpha, DiffSum& sum);
+
+    // BT.601 luma of `pixels` pixels; red is byte 0 or 2
+    typedef void (*LumaRowFn)(const uint8_t* pixels, uint32_t count, uint32_t red, float* luma);
+
+    // Window sums along a row of luma: mean x, mean y, x², y² and xy, each outWidth floats
+    // one after the other at `out`
+    typedef void (*HorizontalFn)(const float* x, const float* y, uint32_t outWidth, const float* window, float* out);
+
+    // Window sums down WINDOW rows of HorizontalFn output, then SSIM and its contrast-structure part
+    typedef void (*VerticalFn)(const float* const* rows, uint32_t outWidth, const float* window, float* ssim, float* cs);
+
+    struct Kernels
+    {
+        DiffRowFn    diff;
+        LumaRowFn    luma;
+        HorizontalFn horizontal;
+        VerticalFn   vertical;
+    };
+
+    void DiffRowScalar(const uint8_t* a, const uint8_t* b, uint32_t pixels, bool alpha, DiffSum& sum)
+    {
+        const uint32_t channels = alpha ? 4 : 3;
+        uint64_t squares = 0;
+        uint32_t maxDiff = sum.maxDiff;
+        for (uint32_t i = 0; i < pixels; ++i, a += 4, b += 4)
+        {
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+                const uint32_t d = uint32_t(std::abs(int(a[c]) - int(b[c])));
+                squares += d * d;
+                maxDiff = std::max(maxDiff, d);
+            }
+        }
+        sum.squares += squares;
+        sum.maxDiff = maxDiff;
+    }
+
+    void LumaRowScalar(const uint8_t* pixels, uint32_t count, uint32_t red, float* luma)
+    {
+        const uint32_t blue = 2 - red;
+        for (uint32_t x = 0; x < count; ++x, pixels += 4)
+            luma[x] = 0.299f * float(pixels[red]) + 0.587f * float(pixels[1]) + 0.114f * float(pixels[blue]);
+    }
+
+    void HorizontalScalar(const float* x, const float* y, uint32_t outWidth, const float* window, float* out)
+    {
+        for (uint32_t i = 0; i < outWidth; ++i)
+        {
+            float mx = 0.0f, my = 0.0f, xx = 0.0f, yy = 0.0f, xy = 0.0f;
+            for (uint32_t k = 0; k < WINDOW; ++k)
+            {
+                const float w = window[k], vx = x[i + k], vy = y[i + k];
+                mx += w * vx;
+                my += w * vy;
+                xx += w * (vx * vx);
+                yy += w * (vy * vy);
+                xy += w * (vx * vy);
+            }
+            out[i] = mx;
+            out[outWidth + i] = my;
+            out[2 * outWidth + i] = xx;
+            out[3 * outWidth + i] = yy;
+            out[4 * outWidth + i] = xy;
+        }
+    }
+
+    inline void SsimValue(float mx, float my, float xx, float yy, float xy, float& ssim, float& cs)
+    {
+        const float mxy = mx * my, mx2 = mx * mx, my2 = my * my;
+        const float sx = xx - mx2, sy = yy - my2, sxy = xy - mxy;
+        cs = (2.0f * sxy + C2) / (sx + sy + C2);
+        ssim = (2.0f * mxy + C1) / (mx2 + my2 + C1) * cs;
+    }
+
+    void VerticalScalar(const float* const* rows, uint32_t outWidth, const float* window, float* ssim, float* cs)
+    {
+        for (uint32_t i = 0; i < outWidth; ++i)
+        {
+            float mx = 0.0f, my = 0.0f, xx = 0.0f, yy = 0.0f, xy = 0.0f;
+            for (uint32_t k = 0; k < WINDOW; ++k)
+            {
+                const float w = window[k];
+                const float* row = rows[k] + i;
+                mx += w * row[0];
+                my += w * row[outWidth];
+                xx += w * row[2 * outWidth];
+                yy += w * row[3 * outWidth];
+                xy += w * row[4 * outWidth];
+            }
+            SsimValue(mx, my, xx, yy, xy, ssim[i], cs[i]);
+        }
+    }
+}
+
+#ifdef METRICS_X86
+
+//-----------------------------------------------------------------------------
+// AVX2
+//-----------------------------------------------------------------------------
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace
+{
+    void DiffRowAvx2(const uint8_t* a, const uint8_t* b, uint32_t pixels, bool alpha, DiffSum& sum)
+    {
+        const __m256i mask = _mm256_set1_epi32(alpha ? -1 : 0x00ffffff);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i maxDiff = zero;
+        uint32_t i = 0;
+
+        // Eight pixels at a time; the 32-bit sums take 4096 rounds of at most 2 * 2 * 255²
+        while (i + 8 <= pixels)
+        {
+            __m256i squares = zero;
+            for (uint32_t round = 0; round < 4096 && i + 8 <= pixels; ++round, i += 8)
+            {
+                const __m256i va = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i * 4)), mask);
+                const __m256i vb = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i * 4)), mask);
+                const __m256i d = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+                maxDiff = _mm256_max_epu8(maxDiff, d);
+                const __m256i lo = _mm256_unpacklo_epi8(d, zero), hi = _mm256_unpackhi_epi8(d, zero);
+                squares = _mm256_add_epi32(squares, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+            }
+            const __m256i wide = _mm256_add_epi64(_mm256_unpacklo_epi32(squares, zero), _mm256_unpackhi_epi32(squares, zero));
+            alignas(32) uint64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), wide);
+            sum.squares += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+
+        alignas(32) uint8_t bytes[32];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(bytes), maxDiff);
+        for (uint8_t d : bytes)
+            sum.maxDiff = std::max(sum.maxDiff, uint32_t(d));
+
+        if (i < pixels)
+            DiffRowScalar(a + i * 4, b + i * 4, pixels - i, alpha, sum);
+    }
+
+    void LumaRowAvx2(const uint8_t* pixels, uint32_t count, uint32_t red, float* luma)
+    {
+        const __m256i byte = _mm256_set1_epi32(0xff);
+        const __m256 kr = _mm256_set1_ps(0.299f), kg = _mm256_set1_ps(0.587f), kb = _mm256_set1_ps(0.114f);
+        const int redShift = int(red) * 8, blueShift = 16 - redShift;
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + x * 4));
+            const __m256 r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(p, _mm_cvtsi32_si128(redShift)), byte));
+            const __m256 g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, 8), byte));
+            const __m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(p, _mm_cvtsi32_si128(blueShift)), byte));
+            _mm256_storeu_ps(luma + x, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(kr, r), _mm256_mul_ps(kg, g)), _mm256_mul_ps(kb, b)));
+        }
+        LumaRowScalar(pixels + x * 4, count - x, red, luma + x);
+    }
+
+    void HorizontalAvx2(const float* x, const float* y, uint32_t outWidth, const float* window, float* out)
+    {
+        uint32_t i = 0;
+        for (; i + 8 <= outWidth; i += 8)
+        {
+            __m256 mx = _mm256_setzero_ps(), my = mx, xx = mx, yy = mx, xy = mx;
+            for (uint32_t k = 0; k < WINDOW; ++k)
+            {
+                const __m256 w = _mm256_set1_ps(window[k]);
+                const __m256 vx = _mm256_loadu_ps(x + i + k), vy = _mm256_loadu_ps(y + i + k);
+                mx = _mm256_add_ps(mx, _mm256_mul_ps(w, vx));
+                my = _mm256_add_ps(my, _mm256_mul_ps(w, vy));
+                xx = _mm256_add_ps(xx, _mm256_mul_ps(w, _mm256_mul_ps(vx, vx)));
+                yy = _mm256_add_ps(yy, _mm256_mul_ps(w, _mm256_mul_ps(vy, vy)));
+                xy = _mm256_add_ps(xy, _mm256_mul_ps(w, _mm256_mul_ps(vx, vy)));
+            }
+            _mm256_storeu_ps(out + i, mx);
+            _mm256_storeu_ps(out + outWidth + i, my);
+            _mm256_storeu_ps(out + 2 * outWidth + i, xx);
+            _mm256_storeu_ps(out + 3 * outWidth + i, yy);
+            _mm256_storeu_ps(out + 4 * outWidth + i, xy);
+        }
+
+        // The last few columns
+        if (i < outWidth)
+        {
+            float tail[5 * 8];
+            HorizontalScalar(x + i, y + i, outWidth - i, window, tail);
+            for (uint32_t plane = 0; plane < 5; ++plane)
+                memcpy(out + plane * outWidth + i, tail + plane * (outWidth - i), (outWidth - i) * sizeof(float));
+        }
+    }
+
+    void VerticalAvx2(const float* const* rows, uint32_t outWidth, const float* window, float* ssim, float* cs)
+    {
+        const __m256 c1 = _mm256_set1_ps(C1), c2 = _mm256_set1_ps(C2), two = _mm256_set1_ps(2.0f);
+        uint32_t i = 0;
+        for (; i + 8 <= outWidth; i += 8)
+        {
+            __m256 mx = _mm256_setzero_ps(), my = mx, xx = mx, yy = mx, xy = mx;
+            for (uint32_t k = 0; k < WINDOW; ++k)
+            {
+                const __m256 w = _mm256_set1_ps(window[k]);
+                const float* row = rows[k] + i;
+                mx = _mm256_add_ps(mx, _mm256_mul_ps(w, _mm256_loadu_ps(row)));
+                my = _mm256_add_ps(my, _mm256_mul_ps(w, _mm256_loadu_ps(row + outWidth)));
+                xx = _mm256_add_ps(xx, _mm256_mul_ps(w, _mm256_loadu_ps(row + 2 * outWidth)));
+                yy = _mm256_add_ps(yy, _mm256_mul_ps(w, _mm256_loadu_ps(row + 3 * outWidth)));
+                xy = _mm256_add_ps(xy, _mm256_mul_ps(w, _mm256_loadu_ps(row + 4 * outWidth)));
+            }
+
+            // SsimValue
+            const __m256 mxy = _mm256_mul_ps(mx, my), mx2 = _mm256_mul_ps(mx, mx), my2 = _mm256_mul_ps(my, my);
+            const __m256 sx = _mm256_sub_ps(xx, mx2), sy = _mm256_sub_ps(yy, my2), sxy = _mm256_sub_ps(xy, mxy);
+            const __m256 vcs = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(two, sxy), c2), _mm256_add_ps(_mm256_add_ps(sx, sy), c2));
+            const __m256 l = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(two, mxy), c1), _mm256_add_ps(_mm256_add_ps(mx2, my2), c1));
+            _mm256_storeu_ps(cs + i, vcs);
+            _mm256_storeu_ps(ssim + i, _mm256_mul_ps(l, vcs));
+        }
+
+        for (; i < outWidth; ++i)
+        {
+            float mx = 0.0f, my = 0.0f, xx = 0.0f, yy = 0.0f, xy = 0.0f;
+            for (uint32_t k = 0; k < WINDOW; ++k)
+            {
+                const float w = window[k];
+                const float* row = rows[k] + i;
+                mx += w * row[0];
+                my += w * row[outWidth];
+                xx += w * row[2 * outWidth];
+                yy += w * row[3 * outWidth];
+                xy += w * row[4 * outWidth];
+            }
+            SsimValue(mx, my, xx, yy, xy, ssim[i], cs[i]);
+        }
+    }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif // METRICS_X86
+
+namespace
+{
+    //-------------------------------------------------------------------------
+    // Bands of rows: one tile row each with tiles, BAND_ROWS otherwise
+    //-------------------------------------------------------------------------
+    struct Layout
+    {
+        uint32_t width, height;
+        uint32_t bandRows;
+        uint32_t bands;
+        uint32_t tileWidth;     // the whole width without tiles
+        uint32_t tileColumns;
+    };
+
+    Layout MakeLayout(uint32_t width, uint32_t height, uint32_t tileSize)
+    {
+        Layout layout;
+        layout.width = width;
+        layout.height = height;
+        layout.bandRows = tileSize ? tileSize : BAND_ROWS;
+        layout.bands = (height + layout.bandRows - 1) / layout.bandRows;
+        layout.tileWidth = tileSize ? tileSize : width;
+        layout.tileColumns = (width + layout.tileWidth - 1) / layout.tileWidth;
+        return layout;
+    }
+
+    void ForEachBand(ThreadPool* pool, size_t bands, const std::function<void(size_t)>& body)
+    {
+        if (pool && bands > 1)
+            pool->ParallelFor(bands, body);
+        else
+            for (size_t band = 0; band < bands; ++band)
+                body(band);
+    }
+
+    struct Plane
+    {
+        std::vector<float> pixels;  // width per row
+        uint32_t width;
+        uint32_t height;
+    };
+
+    // 2x2 averages, an odd last row or column dropped
+    void Downsample(const Plane& from, Plane& to, ThreadPool* pool)
+    {
+        to.width = from.width / 2;
+        to.height = from.height / 2;
+        to.pixels.resize(size_t(to.width) * to.height);
+        ForEachBand(pool, (to.height + BAND_ROWS - 1) / BAND_ROWS, [&](size_t band)
+        {
+            const uint32_t end = std::min(to.height, uint32_t(band + 1) * BAND_ROWS);
+            for (uint32_t y = uint32_t(band) * BAND_ROWS; y < end; ++y)
+            {
+                const float* top = &from.pixels[size_t(y) * 2 * from.width];
+                const float* bottom = top + from.width;
+                float* out = &to.pixels[size_t(y) * to.width];
+                for (uint32_t x = 0; x < to.width; ++x)
+                    out[x] = (top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1]) * 0.25f;
+            }
+        });
+    }
+
+    struct ScaleResult
+    {
+        double ssim;
+        double cs;
+    };
+
+    // Mean SSIM and contrast-structure over one scale, and the SSIM sums and window counts
+    // per tile if `tileSums` is given; false if no window fits
+    bool MeasureScale(const Plane& x, const Plane& y, const Layout& layout, const Kernels& kernels, ThreadPool* pool,
+                      ScaleResult& result, std::vector<double>* tileSums, std::vector<uint64_t>* tileCounts)
+    {
+        const uint32_t width = x.width, height = x.height;
+        if (width < WINDOW || height < WINDOW)
+            return false;
+
+        const uint32_t outWidth = width - 2 * RADIUS;
+        const float* window = Gaussian();
+        const bool tiled = tileSums != nullptr;
+        const uint32_t bandRows = tiled ? layout.bandRows : BAND_ROWS;
+        const uint32_t bands = (height + bandRows - 1) / bandRows;
+        const uint32_t tileColumns = tiled ? layout.tileColumns : 1;
+        const uint32_t tileWidth = tiled ? layout.tileWidth : width;
+
+        struct Band
+        {
+            double ssim, cs;
+            std::vector<double> tileSsim;
+            std::vector<uint64_t> tileCount;
+        };
+        std::vector<Band> results(bands);
+
+        ForEachBand(pool, bands, [&](size_t b)
+        {
+            Band& band = results[b];
+            band.ssim = band.cs = 0.0;
+            band.tileSsim.assign(tileColumns, 0.0);
+            band.tileCount.assign(tileColumns, 0);
+
+            // Windows centred in the band's rows
+            const uint32_t first = std::max(uint32_t(b) * bandRows, RADIUS);
+            const uint32_t last = std::min(uint32_t(b + 1) * bandRows, height - RADIUS);
+            if (first >= last)
+                return;
+
+            // The filtered input rows go round WINDOW slots
+            std::vector<float> ring(size_t(WINDOW) * 5 * outWidth);
+            std::vector<float> ssim(outWidth), cs(outWidth);
+            auto filterRow = [&](uint32_t row)
+            {
+                kernels.horizontal(&x.pixels[size_t(row) * width], &y.pixels[size_t(row) * width], outWidth, window,
+                                   &ring[size_t(row % WINDOW) * 5 * outWidth]);
+            };
+            for (uint32_t row = first - RADIUS; row < first + RADIUS; ++row)
+                filterRow(row);
+
+            const float* rows[WINDOW];
+            for (uint32_t centre = first; centre < last; ++centre)
+            {
+                filterRow(centre + RADIUS);
+                for (uint32_t k = 0; k < WINDOW; ++k)
+                    rows[k] = &ring[size_t((centre - RADIUS + k) % WINDOW) * 5 * outWidth];
+                kernels.vertical(rows, outWidth, window, ssim.data(), cs.data());
+
+                // Window i is centred on column i + RADIUS
+                for (uint32_t column = 0; column < tileColumns; ++column)
+                {
+                    const uint32_t begin = std::max(column * tileWidth, RADIUS);
+                    const uint32_t end = std::min((column + 1) * tileWidth, width - RADIUS);
+                    if (begin >= end)
+                        continue;
+                    double sum = 0.0;
+                    for (uint32_t i = begin - RADIUS; i < end - RADIUS; ++i)
+                    {
+                        sum += ssim[i];
+                        band.cs += cs[i];
+                    }
+                    band.tileSsim[column] += sum;
+                    band.tileCount[column] += end - begin;
+                    band.ssim += sum;
+                }
+            }
+        });
+
+        double ssim = 0.0, cs = 0.0;
+        for (uint32_t b = 0; b < bands; ++b)
+        {
+            ssim += results[b].ssim;
+            cs += results[b].cs;
+            if (tiled)
+            {
+                for (uint32_t column = 0; column < tileColumns; ++column)
+                {
+                    (*tileSums)[size_t(b) * tileColumns + column] = results[b].tileSsim[column];
+                    (*tileCounts)[size_t(b) * tileColumns + column] = results[b].tileCount[column];
+                }
+            }
+        }
+        const double windows = double(outWidth) * (height - 2 * RADIUS);
+        result.ssim = ssim / windows;
+        result.cs = cs / windows;
+        return true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// MeasureImages
+//-----------------------------------------------------------------------------
+bool MeasureImages(const uint8_t* a, ptrdiff_t pitchA, const uint8_t* b, ptrdiff_t pitchB,
+                   uint32_t width, uint32_t height, const ImageMetricsOptions& options, ImageQuality& quality,
+                   std::vector<TileQuality>* tiles, ThreadPool* pool, PixelSimd simd)
+{
+    if (tiles)
+        tiles->clear();
+    if (!a || !b || width == 0 || height == 0)
+        return false;
+
+    Kernels kernels = { DiffRowScalar, LumaRowScalar, HorizontalScalar, VerticalScalar };
+#ifdef METRICS_X86
+    if (SupportedPixelSimd() == PixelSimd::Avx2 && (simd == PixelSimd::Best || simd == PixelSimd::Avx2))
+        kernels = { DiffRowAvx2, LumaRowAvx2, HorizontalAvx2, VerticalAvx2 };
+#else
+    (void)simd;
+#endif
+
+    const uint32_t tileSize = tiles ? options.tileSize : 0;
+    const Layout layout = MakeLayout(width, height, tileSize);
+    const uint32_t tileCount = layout.bands * layout.tileColumns;
+    const uint32_t channels = options.alpha ? 4 : 3;
+
+    // Differences per band and tile column, and the luma planes for SSIM, in one pass
+    std::vector<DiffSum> diffs(size_t(layout.bands) * layout.tileColumns, DiffSum{ 0, 0 });
+    Plane lumaA, lumaB;
+    if (options.ssim)
+    {
+        lumaA.width = lumaB.width = width;
+        lumaA.height = lumaB.height = height;
+        lumaA.pixels.resize(size_t(width) * height);
+        lumaB.pixels.resize(size_t(width) * height);
+    }
+    const uint32_t red = options.bgra ? 2 : 0;
+
+    ForEachBand(pool, layout.bands, [&](size_t band)
+    {
+        const uint32_t end = std::min(height, uint32_t(band + 1) * layout.bandRows);
+        for (uint32_t y = uint32_t(band) * layout.bandRows; y < end; ++y)
+        {
+            const uint8_t* rowA = a + ptrdiff_t(y) * pitchA;
+            const uint8_t* rowB = b + ptrdiff_t(y) * pitchB;
+            for (uint32_t column = 0; column < layout.tileColumns; ++column)
+            {
+                const uint32_t x = column * layout.tileWidth;
+                kernels.diff(rowA + size_t(x) * 4, rowB + size_t(x) * 4, std::min(layout.tileWidth, width - x), options.alpha,
+                             diffs[band * layout.tileColumns + column]);
+            }
+
+            if (options.ssim)
+            {
+                kernels.luma(rowA, width, red, &lumaA.pixels[size_t(y) * width]);
+                kernels.luma(rowB, width, red, &lumaB.pixels[size_t(y) * width]);
+            }
+        }
+    });
+
+    uint64_t squares = 0;
+    uint32_t maxDiff = 0;
+    for (const DiffSum& diff : diffs)
+    {
+        squares += diff.squares;
+        maxDiff = std::max(maxDiff, diff.maxDiff);
+    }
+    quality.mse = double(squares) / (double(width) * height * channels);
+    quality.psnr = Psnr(quality.mse);
+    quality.maxAbsDiff = maxDiff;
+    quality.ssim = quality.msSsim = std::numeric_limits<double>::quiet_NaN();
+
+    std::vector<double> tileSums;
+    std::vector<uint64_t> tileCounts;
+    if (options.ssim)
+    {
+        if (tileSize)
+        {
+            tileSums.resize(tileCount);
+            tileCounts.resize(tileCount);
+        }
+
+        // Scale 0 is plain SSIM; every scale after it halves the planes
+        ScaleResult scales[MAX_SCALES];
+        uint32_t scaleCount = 0;
+        Plane smallA, smallB;
+        const Plane* x = &lumaA;
+        const Plane* y = &lumaB;
+        while (scaleCount < MAX_SCALES &&
+               MeasureScale(*x, *y, layout, kernels, pool, scales[scaleCount],
+                            scaleCount == 0 && tileSize ? &tileSums : nullptr,
+                            scaleCount == 0 && tileSize ? &tileCounts : nullptr))
+        {
+            if (++scaleCount == MAX_SCALES)
+                break;
+            Plane halfA, halfB;
+            Downsample(*x, halfA, pool);
+            Downsample(*y, halfB, pool);
+            smallA = std::move(halfA);
+            smallB = std::move(halfB);
+            x = &smallA;
+            y = &smallB;
+        }
+
+        if (scaleCount > 0)
+        {
+            quality.ssim = scales[0].ssim;
+
+            double weights = 0.0;
+            for (uint32_t s = 0; s < scaleCount; ++s)
+                weights += MS_SSIM_WEIGHTS[s];
+            double msSsim = 1.0;
+            for (uint32_t s = 0; s < scaleCount; ++s)
+            {
+                const double value = s + 1 < scaleCount ? scales[s].cs : scales[s].ssim;
+                msSsim *= std::pow(std::max(value, 0.0), MS_SSIM_WEIGHTS[s] / weights);
+            }
+            quality.msSsim = msSsim;
+        }
+    }
+
+    if (tileSize)
+    {
+        tiles->resize(tileCount);
+        for (uint32_t row = 0; row < layout.bands; ++row)
+        {
+            for (uint32_t column = 0; column < layout.tileColumns; ++column)
+            {
+                const size_t index = size_t(row) * layout.tileColumns + column;
+                TileQuality& tile = (*tiles)[index];
+                tile.x = column * tileSize;
+                tile.y = row * tileSize;
+                tile.width = std::min(tileSize, width - tile.x);
+                tile.height = std::min(tileSize, height - tile.y);
+                tile.psnr = Psnr(double(diffs[index].squares) / (double(tile.width) * tile.height * channels));
+                tile.maxAbsDiff = diffs[index].maxDiff;
+                tile.ssim = !tileCounts.empty() && tileCounts[index] ? tileSums[index] / tileCounts[index]
+                                                                     : std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: ImageMetrics.h
+//
+// Quality of one 8-bit BGRA or RGBA image against a reference, for checking
+// what lossy encoders, scalers and block compressors cost: PSNR and largest
+// absolute difference over the colour channels (alpha optional), SSIM and
+// 5-scale MS-SSIM over BT.601 luma, optionally per tile as well.
+//
+// SSIM follows Wang et al.: an 11x11 Gaussian window with sigma 1.5,
+// C1 = (0.01 * 255)^2 and C2 = (0.03 * 255)^2, averaged over every position
+// where the window fits inside the image. MS-SSIM averages 2x2 blocks
+// between scales and weights them as in the paper; scales too small for
+// the window are left out and the remaining weights rescaled. A tile gets
+// the SSIM of the windows centred in it.
+//
+// The image is measured in bands of rows on a thread pool, and the band
+// results are added up in order, so the numbers don't depend on the thread
+// count. The differences and the SSIM filters have a scalar version and an
+// AVX2 one picked at run time (see PixelConvert.h), which compute the same
+// float operations in the same order and give exactly the same results.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "PixelConvert.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+struct ImageMetricsOptions
+{
+    bool     bgra;          // pixels are B, G, R, A; otherwise R, G, B, A
+    bool     alpha;         // alpha counts towards PSNR and the largest difference
+    bool     ssim;          // SSIM and MS-SSIM as well, several times the work of PSNR
+    uint32_t tileSize;      // results per tileSize square too, 0 for none
+};
+
+struct ImageQuality
+{
+    double   mse;           // per channel sample
+    double   psnr;          // dB; infinite for identical images
+    uint32_t maxAbsDiff;    // largest difference in any measured channel
+    double   ssim;          // 1 for identical images; NaN if not measured or no window fits
+    double   msSsim;        // NaN if not measured or no window fits
+};
+
+struct TileQuality
+{
+    uint32_t x, y, width, height;
+    double   psnr;
+    uint32_t maxAbsDiff;
+    double   ssim;          // NaN if no window is centred in the tile
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Measures top-down image `b` against reference `a` (negative pitches for bottom-up).
+// Tiles are listed row by row if `tiles` is given and options.tileSize isn't 0. `simd`
+// caps the kernels used, so benchmarks can compare them.
+bool MeasureImages(const uint8_t* a, ptrdiff_t pitchA, const uint8_t* b, ptrdiff_t pitchB,
+                   uint32_t width, uint32_t height, const ImageMetricsOptions& options, ImageQuality& quality,
+                   std::vector<TileQuality>* tiles = nullptr, ThreadPool* pool = nullptr,
+                   PixelSimd simd = PixelSimd::Best);
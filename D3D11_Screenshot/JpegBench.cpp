@@ -0,0 +1,202 @@
+//-----------------------------------------------------------------------------
+// File: JpegBench.cpp
+//
+// Headless benchmark for JpegEncoder, not part of the application build.
+// Encodes a synthetic desktop-like frame at several qualities with the scalar
+// and AVX2 kernels, on one thread and on the pool, checks that every variant
+// writes the same bytes and that stb_image decodes them, and reports speed,
+// size, PSNR and SSIM against the source. Either one falling below the floor
+// set for its quality fails the bench. The fast PNG level is listed for scale.
+//
+//   g++ -std=c++14 -O2 -I. JpegBench.cpp JpegEncoder.cpp ImageMetrics.cpp PixelConvert.cpp PngEncoder.cpp
+//       Deflate.cpp Thumbnails.cpp ../D3D11_ScreenCapture/ThreadPool.cpp -pthread -o jpegbench
+//   ./jpegbench [width] [height] [runs] [out.jpg]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "JpegEncoder.h"
+#include "ImageMetrics.h"
+#include "PngEncoder.h"
+#include "BenchImage.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_JPEG
+#include "../D3D11_Image/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Lowest PSNR and SSIM each quality may decode to; the synthetic desktop scores about
+    // a decibel and a few thousandths of SSIM above these
+    struct QualityFloor
+    {
+        uint32_t quality;
+        double   psnr;
+        double   ssim;
+    };
+    const QualityFloor FLOORS[] =
+    {
+        { 50, 23.5, 0.935 },
+        { 75, 27.0, 0.965 },
+        { 90, 30.0, 0.988 },
+        { 95, 31.0, 0.995 },
+    };
+
+    // Quality of the decoded image against the source; false if it doesn't decode
+    bool DecodedQuality(const std::vector<uint8_t>& jpeg, const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height,
+                        ThreadPool* pool, ImageQuality& quality)
+    {
+        int w = 0, h = 0, channels = 0;
+        stbi_uc* pixels = stbi_load_from_memory(jpeg.data(), int(jpeg.size()), &w, &h, &channels, 4);
+        if (!pixels)
+        {
+            printf("  stb_image: %s\n", stbi_failure_reason());
+            return false;
+        }
+
+        // stb_image gives R, G, B, A; the source is B, G, R, A
+        const bool sized = uint32_t(w) == width && uint32_t(h) == height && channels == 3;
+        for (size_t i = 0; sized && i < size_t(width) * height; ++i)
+            std::swap(pixels[i * 4], pixels[i * 4 + 2]);
+
+        const ImageMetricsOptions options = { true, false, true, 0 };
+        const bool measured = sized && MeasureImages(bgra.data(), ptrdiff_t(width) * 4, pixels, ptrdiff_t(width) * 4,
+                                                     width, height, options, quality, nullptr, pool);
+        stbi_image_free(pixels);
+        return measured;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t width = argc > 1 ? uint32_t(atoi(argv[1])) : 3840;
+    const uint32_t height = argc > 2 ? uint32_t(atoi(argv[2])) : 2160;
+    const int runs = argc > 3 ? std::max(1, atoi(argv[3])) : 3;
+    const char* outPath = argc > 4 ? argv[4] : nullptr;
+
+    if (width < 64 || height < 64)
+    {
+        printf("the test frame needs at least 64x64 pixels\n");
+        return 1;
+    }
+
+    const std::vector<uint8_t> bgra = MakeDesktop(width, height);
+    const double megapixels = double(width) * height / 1e6;
+    ThreadPool pool;
+    printf("%ux%u, %u threads, %s kernels available, best of %d\n\n", width, height, pool.Size(),
+           SupportedPixelSimd() == PixelSimd::Avx2 ? "AVX2" : "scalar", runs);
+    printf("%-22s %10s %10s %9s %8s %9s %8s\n", "encoder", "ms", "MPix/s", "KiB", "bpp", "PSNR dB", "SSIM");
+
+    bool allOk = true;
+    auto report = [&](const char* name, double ms, size_t bytes, const ImageQuality* quality, const char* failure)
+    {
+        printf("%-22s %10.1f %10.1f %9zu %8.3f ", name, ms, megapixels / (ms / 1000.0), bytes / 1024, bytes * 8.0 / (megapixels * 1e6));
+        if (quality)
+            printf("%9.2f %8.5f", quality->psnr, quality->ssim);
+        else
+            printf("%9s %8s", "-", "-");
+        printf(failure ? " %s\n" : "\n", failure);
+        allOk = allOk && !failure;
+    };
+
+    struct Variant
+    {
+        const char* name;
+        PixelSimd   simd;
+        bool        threaded;
+    };
+    static const Variant VARIANTS[] =
+    {
+        { "scalar 1t", PixelSimd::Scalar, false },
+        { "best 1t",   PixelSimd::Best,   false },
+        { "best mt",   PixelSimd::Best,   true },
+    };
+
+    std::vector<uint8_t> jpeg, reference;
+    for (const QualityFloor& floor : FLOORS)
+    {
+        const uint32_t quality = floor.quality;
+        ImageQuality decoded = {};
+        for (const Variant& variant : VARIANTS)
+        {
+            double best = 1e30;
+            for (int run = 0; run < runs; ++run)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                EncodeJpeg(bgra.data(), ptrdiff_t(width) * 4, width, height, quality, jpeg, variant.threaded ? &pool : nullptr,
+                           variant.simd);
+                best = std::min(best, MillisecondsSince(start));
+            }
+
+            // Every kernel and thread count has to give the same file, so one is measured
+            const char* failure = nullptr;
+            if (variant.simd == PixelSimd::Scalar)
+            {
+                reference = jpeg;
+                if (!DecodedQuality(jpeg, bgra, width, height, &pool, decoded))
+                    failure = "UNDECODABLE";
+                else if (decoded.psnr < floor.psnr || decoded.ssim < floor.ssim)
+                    failure = "BELOW FLOOR";
+            }
+            else if (jpeg != reference)
+            {
+                failure = "MISMATCH";
+            }
+            const std::string name = "jpeg q" + std::to_string(quality) + " " + variant.name;
+            report(name.c_str(), best, jpeg.size(), &decoded, failure);
+        }
+    }
+
+    // Bottom-up input through a negative pitch gives the same file as the flipped image
+    {
+        std::vector<uint8_t> flipped(bgra.size());
+        for (uint32_t y = 0; y < height; ++y)
+            memcpy(&flipped[size_t(height - 1 - y) * width * 4], &bgra[size_t(y) * width * 4], size_t(width) * 4);
+        EncodeJpeg(flipped.data(), ptrdiff_t(width) * 4, width, height, 90, reference, &pool);
+        EncodeJpeg(&bgra[size_t(height - 1) * width * 4], -ptrdiff_t(width) * 4, width, height, 90, jpeg, &pool);
+        if (jpeg != reference)
+        {
+            printf("jpeg bottom-up input: MISMATCH\n");
+            allOk = false;
+        }
+    }
+
+    std::vector<uint8_t> png;
+    const PngOptions pngOptions = { DeflateLevel::Fast, false, 0 };
+    double best = 1e30;
+    for (int run = 0; run < runs; ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        EncodePng(bgra.data(), ptrdiff_t(width) * 4, width, height, pngOptions, png, &pool);
+        best = std::min(best, MillisecondsSince(start));
+    }
+    report("png fast mt", best, png.size(), nullptr, nullptr);
+
+    if (outPath)
+    {
+        EncodeJpeg(bgra.data(), ptrdiff_t(width) * 4, width, height, 90, jpeg, &pool);
+        if (FILE* file = fopen(outPath, "wb"))
+        {
+            fwrite(jpeg.data(), 1, jpeg.size(), file);
+            fclose(file);
+        }
+    }
+
+    return allOk ? 0 : 1;
+}
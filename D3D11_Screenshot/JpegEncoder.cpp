@@ -0,0 +1,692 @@
+//-----------------------------------------------------------------------------
+// File: JpegEncoder.cpp
+//
+// Baseline JPEG: YCbCr 4:2:0, AAN float DCT, Annex K tables, one restart
+// interval per MCU row.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "JpegEncoder.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define JPEG_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const uint32_t MCU_SIZE = 16;
+    const uint32_t MAX_DIMENSION = 65535;
+
+    // Six blocks of at most 16 + 11 bits for DC and 63 * (16 + 10) for AC, every byte stuffed
+    const size_t MAX_MCU_BYTES = 6 * (27 + 63 * 26) / 8 * 2 + 16;
+
+    // Natural (row-major) position of the k-th coefficient in zigzag order
+    const uint8_t ZIGZAG[64] =
+    {
+         0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+    };
+
+    // Annex K.1, natural order
+    const uint8_t LUMA_QUANT[64] =
+    {
+        16,  11,  10,  16,  24,  40,  51,  61,
+        12,  12,  14,  19,  26,  58,  60,  55,
+        14,  13,  16,  24,  40,  57,  69,  56,
+        14,  17,  22,  29,  51,  87,  80,  62,
+        18,  22,  37,  56,  68, 109, 103,  77,
+        24,  35,  55,  64,  81, 104, 113,  92,
+        49,  64,  78,  87, 103, 121, 120, 101,
+        72,  92,  95,  98, 112, 100, 103,  99,
+    };
+
+    const uint8_t CHROMA_QUANT[64] =
+    {
+        17,  18,  24,  47,  99,  99,  99,  99,
+        18,  21,  26,  66,  99,  99,  99,  99,
+        24,  26,  56,  99,  99,  99,  99,  99,
+        47,  66,  99,  99,  99,  99,  99,  99,
+        99,  99,  99,  99,  99,  99,  99,  99,
+        99,  99,  99,  99,  99,  99,  99,  99,
+        99,  99,  99,  99,  99,  99,  99,  99,
+        99,  99,  99,  99,  99,  99,  99,  99,
+    };
+
+    // Annex K.3: number of codes of each length 1-16, then the symbols in code order
+    const uint8_t DC_LUMA_COUNTS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+    const uint8_t DC_CHROMA_COUNTS[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+    const uint8_t DC_SYMBOLS[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+    const uint8_t AC_LUMA_COUNTS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+    const uint8_t AC_LUMA_SYMBOLS[162] =
+    {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa,
+    };
+
+    const uint8_t AC_CHROMA_COUNTS[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+    const uint8_t AC_CHROMA_SYMBOLS[162] =
+    {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa,
+    };
+
+    // The AAN DCT leaves every output scaled by these, one factor per direction
+    const double AAN_SCALE[8] = { 1.0, 1.387039845, 1.306562965, 1.175875602, 1.0, 0.785694958, 0.541196100, 0.275899379 };
+
+    // Full-range BT.601 as JFIF defines it; the level shift of Y is folded in and Cb and
+    // Cr are left centred on 0, which is the same thing for chroma
+    const float Y_R  = 0.299f,     Y_G  = 0.587f,     Y_B  = 0.114f;
+    const float CB_R = -0.168736f, CB_G = -0.331264f, CB_B = 0.5f;
+    const float CR_R = 0.5f,       CR_G = -0.418688f, CR_B = -0.081312f;
+
+    // Two source rows of `pixels` BGRA pixels (a multiple of 16) to two rows of Y and one
+    // of each chroma channel at half the width
+    typedef void (*ConvertFn)(const uint8_t* row0, const uint8_t* row1, uint32_t pixels,
+                              float* y0, float* y1, float* cb, float* cr);
+
+    // Forward DCT of the 8x8 block at `src` (`stride` floats apart), quantized. The
+    // coefficients come out transposed, horizontal frequency major, and `divisors` are
+    // laid out the same way.
+    typedef void (*DctFn)(const float* src, ptrdiff_t stride, const float* divisors, int16_t* coefs);
+
+    struct HuffmanCode
+    {
+        uint16_t code;
+        uint16_t length;
+    };
+
+    struct HuffmanTable
+    {
+        const uint8_t* counts;
+        const uint8_t* symbols;
+        size_t         symbolCount;
+        HuffmanCode    codes[256];
+
+        HuffmanTable(const uint8_t* counts, const uint8_t* symbols, size_t symbolCount) :
+            counts(counts), symbols(symbols), symbolCount(symbolCount), codes()
+        {
+            // Canonical codes, Annex C
+            uint32_t code = 0;
+            size_t k = 0;
+            for (uint32_t length = 1; length <= 16; ++length)
+            {
+                for (uint32_t i = 0; i < counts[length - 1]; ++i, ++k)
+                    codes[symbols[k]] = HuffmanCode{ uint16_t(code++), uint16_t(length) };
+                code <<= 1;
+            }
+        }
+    };
+
+    // Tables that don't depend on the quality
+    struct StaticTables
+    {
+        HuffmanTable dc[2];
+        HuffmanTable ac[2];
+        uint8_t      order[64];         // zigzag order into the transposed layout of DctFn
+        uint8_t      bitLength[2048];   // magnitude category of 0-2047
+
+        StaticTables() :
+            dc{ { DC_LUMA_COUNTS, DC_SYMBOLS, sizeof(DC_SYMBOLS) }, { DC_CHROMA_COUNTS, DC_SYMBOLS, sizeof(DC_SYMBOLS) } },
+            ac{ { AC_LUMA_COUNTS, AC_LUMA_SYMBOLS, sizeof(AC_LUMA_SYMBOLS) }, { AC_CHROMA_COUNTS, AC_CHROMA_SYMBOLS, sizeof(AC_CHROMA_SYMBOLS) } }
+        {
+            for (int k = 0; k < 64; ++k)
+                order[k] = uint8_t(ZIGZAG[k] % 8 * 8 + ZIGZAG[k] / 8);
+
+            bitLength[0] = 0;
+            for (uint32_t v = 1; v < 2048; ++v)
+                bitLength[v] = uint8_t(bitLength[v / 2] + 1);
+        }
+    };
+
+    const StaticTables& GetStaticTables()
+    {
+        static const StaticTables tables;
+        return tables;
+    }
+
+    // libjpeg's quality scaling of the Annex K tables
+    void ScaleQuantTable(const uint8_t* base, uint32_t quality, uint8_t* table)
+    {
+        quality = std::min(100u, std::max(1u, quality));
+        const uint32_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+        for (int i = 0; i < 64; ++i)
+            table[i] = uint8_t(std::min(255u, std::max(1u, (base[i] * scale + 50) / 100)));
+    }
+
+    //-------------------------------------------------------------------------
+    // Bits of one restart interval
+    //-------------------------------------------------------------------------
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : m_out(out), m_size(0), m_bits(0), m_count(0) {}
+
+        // Makes room for `bytes` more, stuffing included; Put doesn't check
+        void Reserve(size_t bytes)
+        {
+            if (m_out.size() < m_size + bytes)
+                m_out.resize(std::max(m_out.size() * 2, m_size + bytes));
+        }
+
+        // Up to 16 bits at a time
+        void Put(uint32_t code, uint32_t length)
+        {
+            m_bits = (m_bits << length) | code;
+            m_count += length;
+            if (m_count >= 32)
+            {
+                m_count -= 32;
+                const uint32_t word = uint32_t(m_bits >> m_count);
+                if (((~word - 0x01010101) & word & 0x80808080) == 0)
+                {
+                    // No 0xff byte: the common case
+                    m_out[m_size] = uint8_t(word >> 24);
+                    m_out[m_size + 1] = uint8_t(word >> 16);
+                    m_out[m_size + 2] = uint8_t(word >> 8);
+                    m_out[m_size + 3] = uint8_t(word);
+                    m_size += 4;
+                }
+                else
+                {
+                    for (int shift = 24; shift >= 0; shift -= 8)
+                        PutByte(uint8_t(word >> shift));
+                }
+            }
+        }
+
+        // Pads the last byte with ones, as the specification asks before a marker, and
+        // trims the buffer to what was written
+        void Flush()
+        {
+            Put((1u << (7 - (m_count + 7) % 8)) - 1, 7 - (m_count + 7) % 8);
+            for (; m_count >= 8; m_count -= 8)
+                PutByte(uint8_t(m_bits >> (m_count - 8)));
+            m_out.resize(m_size);
+        }
+
+    private:
+        void PutByte(uint8_t byte)
+        {
+            m_out[m_size++] = byte;
+            if (byte == 0xff)
+                m_out[m_size++] = 0;    // stuffed so it can't be read as a marker
+        }
+
+        std::vector<uint8_t>& m_out;
+        size_t m_size;
+        uint64_t m_bits;
+        uint32_t m_count;
+    };
+
+    // Huffman codes one quantized block, DC as a difference to the previous block's
+    void EncodeBlock(BitWriter& bits, const int16_t* coefs, int& dcPred, const HuffmanTable& dc, const HuffmanTable& ac,
+                     const StaticTables& tables)
+    {
+        const int dcValue = std::min(1023, std::max(-1024, int(coefs[0])));
+        const int diff = dcValue - dcPred;
+        dcPred = dcValue;
+
+        uint32_t magnitude = uint32_t(diff < 0 ? -diff : diff);
+        uint32_t category = tables.bitLength[magnitude];
+        bits.Put(dc.codes[category].code, dc.codes[category].length);
+        if (category > 0)
+            bits.Put(uint32_t(diff < 0 ? diff - 1 : diff) & ((1u << category) - 1), category);
+
+        uint32_t run = 0;
+        for (int k = 1; k < 64; ++k)
+        {
+            int value = coefs[tables.order[k]];
+            if (value == 0)
+            {
+                ++run;
+                continue;
+            }
+            value = std::min(1023, std::max(-1023, value));
+
+            for (; run >= 16; run -= 16)
+                bits.Put(ac.codes[0xf0].code, ac.codes[0xf0].length);
+
+            magnitude = uint32_t(value < 0 ? -value : value);
+            category = tables.bitLength[magnitude];
+            const HuffmanCode& code = ac.codes[run << 4 | category];
+            bits.Put(code.code, code.length);
+            bits.Put(uint32_t(value < 0 ? value - 1 : value) & ((1u << category) - 1), category);
+            run = 0;
+        }
+
+        if (run > 0)
+            bits.Put(ac.codes[0x00].code, ac.codes[0x00].length);   // end of block
+    }
+
+    //-------------------------------------------------------------------------
+    // Scalar kernels
+    //-------------------------------------------------------------------------
+    void ConvertScalar(const uint8_t* row0, const uint8_t* row1, uint32_t pixels,
+                       float* y0, float* y1, float* cb, float* cr)
+    {
+        for (uint32_t x = 0; x < pixels; x += 2)
+        {
+            const uint8_t* a = row0 + size_t(x) * 4;
+            const uint8_t* b = row1 + size_t(x) * 4;
+            for (int i = 0; i < 2; ++i)
+            {
+                y0[x + i] = float(a[i * 4 + 2]) * Y_R + float(a[i * 4 + 1]) * Y_G + float(a[i * 4]) * Y_B - 128.0f;
+                y1[x + i] = float(b[i * 4 + 2]) * Y_R + float(b[i * 4 + 1]) * Y_G + float(b[i * 4]) * Y_B - 128.0f;
+            }
+
+            // The vector kernel adds the rows first and then neighbouring pixels
+            const float red = ((float(a[2]) + float(b[2])) + (float(a[6]) + float(b[6]))) * 0.25f;
+            const float green = ((float(a[1]) + float(b[1])) + (float(a[5]) + float(b[5]))) * 0.25f;
+            const float blue = ((float(a[0]) + float(b[0])) + (float(a[4]) + float(b[4]))) * 0.25f;
+            cb[x / 2] = red * CB_R + green * CB_G + blue * CB_B;
+            cr[x / 2] = red * CR_R + green * CR_G + blue * CR_B;
+        }
+    }
+
+    // One-dimensional AAN DCT (jfdctflt.c) on d[0], d[step], ... d[7 * step]
+    inline void Dct8(float* d, int step)
+    {
+        const float tmp0 = d[0] + d[7 * step], tmp7 = d[0] - d[7 * step];
+        const float tmp1 = d[step] + d[6 * step], tmp6 = d[step] - d[6 * step];
+        const float tmp2 = d[2 * step] + d[5 * step], tmp5 = d[2 * step] - d[5 * step];
+        const float tmp3 = d[3 * step] + d[4 * step], tmp4 = d[3 * step] - d[4 * step];
+
+        // Even part
+        float tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+        float tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+        d[0] = tmp10 + tmp11;
+        d[4 * step] = tmp10 - tmp11;
+        const float z1 = (tmp12 + tmp13) * 0.707106781f;
+        d[2 * step] = tmp13 + z1;
+        d[6 * step] = tmp13 - z1;
+
+        // Odd part
+        tmp10 = tmp4 + tmp5;
+        tmp11 = tmp5 + tmp6;
+        tmp12 = tmp6 + tmp7;
+        const float z5 = (tmp10 - tmp12) * 0.382683433f;
+        const float z2 = tmp10 * 0.541196100f + z5;
+        const float z4 = tmp12 * 1.306562965f + z5;
+        const float z3 = tmp11 * 0.707106781f;
+        const float z11 = tmp7 + z3, z13 = tmp7 - z3;
+        d[5 * step] = z13 + z2;
+        d[3 * step] = z13 - z2;
+        d[step] = z11 + z4;
+        d[7 * step] = z11 - z4;
+    }
+
+    void DctScalar(const float* src, ptrdiff_t stride, const float* divisors, int16_t* coefs)
+    {
+        // Columns first, then rows, stored transposed: the order the vector kernel works in
+        float block[64];
+        for (int y = 0; y < 8; ++y)
+            memcpy(block + y * 8, src + y * stride, 8 * sizeof(float));
+        for (int x = 0; x < 8; ++x)
+            Dct8(block + x, 8);
+        for (int v = 0; v < 8; ++v)
+        {
+            Dct8(block + v * 8, 1);
+            for (int u = 0; u < 8; ++u)
+            {
+                const long value = std::lrint(block[v * 8 + u] * divisors[u * 8 + v]);
+                coefs[u * 8 + v] = int16_t(std::min(32767L, std::max(-32768L, value)));
+            }
+        }
+    }
+}
+
+#ifdef JPEG_X86
+
+//-----------------------------------------------------------------------------
+// AVX2
+//-----------------------------------------------------------------------------
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace
+{
+    // Y of eight pixels, and their colour channels as floats
+    inline __m256 LumaAvx2(__m256i px, __m256& r, __m256& g, __m256& b)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        b = _mm256_cvtepi32_ps(_mm256_and_si256(px, mask));
+        g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask));
+        r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask));
+        const __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(Y_R)), _mm256_mul_ps(g, _mm256_set1_ps(Y_G))),
+                                       _mm256_mul_ps(b, _mm256_set1_ps(Y_B)));
+        return _mm256_sub_ps(y, _mm256_set1_ps(128.0f));
+    }
+
+    // Sums of horizontal pairs of 16 values in `lo` and `hi`, in order
+    inline __m256 PairSumsAvx2(__m256 lo, __m256 hi)
+    {
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_hadd_ps(lo, hi)), 0xd8));
+    }
+
+    inline __m256 Dot3Avx2(__m256 r, __m256 g, __m256 b, float cr, float cg, float cb)
+    {
+        return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(cr)), _mm256_mul_ps(g, _mm256_set1_ps(cg))),
+                             _mm256_mul_ps(b, _mm256_set1_ps(cb)));
+    }
+
+    void ConvertAvx2(const uint8_t* row0, const uint8_t* row1, uint32_t pixels,
+                     float* y0, float* y1, float* cb, float* cr)
+    {
+        for (uint32_t x = 0; x < pixels; x += 16)
+        {
+            __m256 r[4], g[4], b[4];    // row 0 then row 1, each as two sets of eight pixels
+            for (int half = 0; half < 2; ++half)
+            {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + size_t(x + half * 8) * 4));
+                const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + size_t(x + half * 8) * 4));
+                _mm256_storeu_ps(y0 + x + half * 8, LumaAvx2(a, r[half], g[half], b[half]));
+                _mm256_storeu_ps(y1 + x + half * 8, LumaAvx2(c, r[half + 2], g[half + 2], b[half + 2]));
+            }
+
+            const __m256 quarter = _mm256_set1_ps(0.25f);
+            const __m256 red = _mm256_mul_ps(PairSumsAvx2(_mm256_add_ps(r[0], r[2]), _mm256_add_ps(r[1], r[3])), quarter);
+            const __m256 green = _mm256_mul_ps(PairSumsAvx2(_mm256_add_ps(g[0], g[2]), _mm256_add_ps(g[1], g[3])), quarter);
+            const __m256 blue = _mm256_mul_ps(PairSumsAvx2(_mm256_add_ps(b[0], b[2]), _mm256_add_ps(b[1], b[3])), quarter);
+            _mm256_storeu_ps(cb + x / 2, Dot3Avx2(red, green, blue, CB_R, CB_G, CB_B));
+            _mm256_storeu_ps(cr + x / 2, Dot3Avx2(red, green, blue, CR_R, CR_G, CR_B));
+        }
+    }
+
+    inline void TransposeAvx2(__m256* r)
+    {
+        const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+        const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+        r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+        r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+        r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+        r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+        r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+        r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+        r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+        r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+    }
+
+    // Dct8 on eight columns at once
+    inline void Dct8Avx2(__m256* d)
+    {
+        const __m256 tmp0 = _mm256_add_ps(d[0], d[7]), tmp7 = _mm256_sub_ps(d[0], d[7]);
+        const __m256 tmp1 = _mm256_add_ps(d[1], d[6]), tmp6 = _mm256_sub_ps(d[1], d[6]);
+        const __m256 tmp2 = _mm256_add_ps(d[2], d[5]), tmp5 = _mm256_sub_ps(d[2], d[5]);
+        const __m256 tmp3 = _mm256_add_ps(d[3], d[4]), tmp4 = _mm256_sub_ps(d[3], d[4]);
+
+        __m256 tmp10 = _mm256_add_ps(tmp0, tmp3), tmp13 = _mm256_sub_ps(tmp0, tmp3);
+        __m256 tmp11 = _mm256_add_ps(tmp1, tmp2), tmp12 = _mm256_sub_ps(tmp1, tmp2);
+        d[0] = _mm256_add_ps(tmp10, tmp11);
+        d[4] = _mm256_sub_ps(tmp10, tmp11);
+        const __m256 z1 = _mm256_mul_ps(_mm256_add_ps(tmp12, tmp13), _mm256_set1_ps(0.707106781f));
+        d[2] = _mm256_add_ps(tmp13, z1);
+        d[6] = _mm256_sub_ps(tmp13, z1);
+
+        tmp10 = _mm256_add_ps(tmp4, tmp5);
+        tmp11 = _mm256_add_ps(tmp5, tmp6);
+        tmp12 = _mm256_add_ps(tmp6, tmp7);
+        const __m256 z5 = _mm256_mul_ps(_mm256_sub_ps(tmp10, tmp12), _mm256_set1_ps(0.382683433f));
+        const __m256 z2 = _mm256_add_ps(_mm256_mul_ps(tmp10, _mm256_set1_ps(0.541196100f)), z5);
+        const __m256 z4 = _mm256_add_ps(_mm256_mul_ps(tmp12, _mm256_set1_ps(1.306562965f)), z5);
+        const __m256 z3 = _mm256_mul_ps(tmp11, _mm256_set1_ps(0.707106781f));
+        const __m256 z11 = _mm256_add_ps(tmp7, z3), z13 = _mm256_sub_ps(tmp7, z3);
+        d[5] = _mm256_add_ps(z13, z2);
+        d[3] = _mm256_sub_ps(z13, z2);
+        d[1] = _mm256_add_ps(z11, z4);
+        d[7] = _mm256_sub_ps(z11, z4);
+    }
+
+    void DctAvx2(const float* src, ptrdiff_t stride, const float* divisors, int16_t* coefs)
+    {
+        __m256 d[8];
+        for (int y = 0; y < 8; ++y)
+            d[y] = _mm256_loadu_ps(src + y * stride);
+        Dct8Avx2(d);
+        TransposeAvx2(d);
+        Dct8Avx2(d);
+
+        // d[u] holds vertical frequencies 0-7 of horizontal frequency u
+        for (int u = 0; u < 8; u += 2)
+        {
+            const __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(d[u], _mm256_loadu_ps(divisors + u * 8)));
+            const __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(d[u + 1], _mm256_loadu_ps(divisors + u * 8 + 8)));
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(coefs + u * 8), packed);
+        }
+    }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif // JPEG_X86
+
+namespace
+{
+    //-------------------------------------------------------------------------
+    // Encoder state shared by the MCU rows
+    //-------------------------------------------------------------------------
+    struct JpegImage
+    {
+        const uint8_t*      bgra;
+        ptrdiff_t           pitch;
+        uint32_t            width;
+        uint32_t            height;
+        uint32_t            mcusPerRow;
+        uint8_t             quant[2][64];       // natural order
+        float               divisors[2][64];    // transposed, AAN scaling included
+        ConvertFn           convert;
+        DctFn               dct;
+        const StaticTables* tables;
+
+        // Converts, transforms and codes MCU row `mcuRow` as a restart interval of its own
+        void EncodeRow(uint32_t mcuRow, std::vector<uint8_t>& out) const
+        {
+            const uint32_t paddedWidth = mcusPerRow * MCU_SIZE;
+            std::vector<float> planes(size_t(paddedWidth) * MCU_SIZE * 3 / 2);
+            float* luma = planes.data();
+            float* cb = luma + size_t(paddedWidth) * MCU_SIZE;
+            float* cr = cb + size_t(paddedWidth / 2) * (MCU_SIZE / 2);
+
+            // Rows past the bottom repeat the last one, columns past the right edge the last pixel
+            std::vector<uint8_t> padded[2];
+            const uint8_t* rows[2];
+            for (uint32_t pair = 0; pair < MCU_SIZE / 2; ++pair)
+            {
+                for (int i = 0; i < 2; ++i)
+                {
+                    const uint32_t y = std::min(height - 1, mcuRow * MCU_SIZE + pair * 2 + i);
+                    rows[i] = bgra + ptrdiff_t(y) * pitch;
+                    if (paddedWidth != width)
+                    {
+                        padded[i].resize(size_t(paddedWidth) * 4);
+                        memcpy(padded[i].data(), rows[i], size_t(width) * 4);
+                        for (uint32_t x = width; x < paddedWidth; ++x)
+                            memcpy(&padded[i][size_t(x) * 4], rows[i] + size_t(width - 1) * 4, 4);
+                        rows[i] = padded[i].data();
+                    }
+                }
+                convert(rows[0], rows[1], paddedWidth, luma + size_t(pair * 2) * paddedWidth,
+                        luma + size_t(pair * 2 + 1) * paddedWidth, cb + size_t(pair) * (paddedWidth / 2),
+                        cr + size_t(pair) * (paddedWidth / 2));
+            }
+
+            out.clear();
+            BitWriter bits(out);
+            int dcPred[3] = { 0, 0, 0 };
+            int16_t coefs[64];
+            for (uint32_t mcu = 0; mcu < mcusPerRow; ++mcu)
+            {
+                bits.Reserve(MAX_MCU_BYTES);
+                for (uint32_t block = 0; block < 4; ++block)
+                {
+                    const float* src = luma + size_t(block / 2 * 8) * paddedWidth + mcu * MCU_SIZE + block % 2 * 8;
+                    dct(src, paddedWidth, divisors[0], coefs);
+                    EncodeBlock(bits, coefs, dcPred[0], tables->dc[0], tables->ac[0], *tables);
+                }
+                dct(cb + mcu * 8, paddedWidth / 2, divisors[1], coefs);
+                EncodeBlock(bits, coefs, dcPred[1], tables->dc[1], tables->ac[1], *tables);
+                dct(cr + mcu * 8, paddedWidth / 2, divisors[1], coefs);
+                EncodeBlock(bits, coefs, dcPred[2], tables->dc[1], tables->ac[1], *tables);
+            }
+            bits.Flush();
+        }
+    };
+
+    void AppendMarker(std::vector<uint8_t>& jpeg, uint8_t marker, uint32_t length)
+    {
+        const uint8_t header[4] = { 0xff, marker, uint8_t(length >> 8), uint8_t(length) };
+        jpeg.insert(jpeg.end(), header, header + (length ? 4 : 2));
+    }
+
+    void AppendHuffmanTable(std::vector<uint8_t>& jpeg, uint8_t tableClass, const HuffmanTable& table)
+    {
+        jpeg.push_back(tableClass);
+        jpeg.insert(jpeg.end(), table.counts, table.counts + 16);
+        jpeg.insert(jpeg.end(), table.symbols, table.symbols + table.symbolCount);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// EncodeJpeg
+//-----------------------------------------------------------------------------
+bool EncodeJpeg(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, uint32_t quality,
+                std::vector<uint8_t>& jpeg, ThreadPool* pool, PixelSimd simd)
+{
+    if (!bgra || width == 0 || height == 0 || width > MAX_DIMENSION || height > MAX_DIMENSION)
+        return false;
+
+    JpegImage image;
+    image.bgra = bgra;
+    image.pitch = pitch;
+    image.width = width;
+    image.height = height;
+    image.mcusPerRow = (width + MCU_SIZE - 1) / MCU_SIZE;
+    image.tables = &GetStaticTables();
+    image.convert = ConvertScalar;
+    image.dct = DctScalar;
+#ifdef JPEG_X86
+    const PixelSimd supported = SupportedPixelSimd();
+    if (supported == PixelSimd::Avx2 && (simd == PixelSimd::Best || simd == PixelSimd::Avx2))
+    {
+        image.convert = ConvertAvx2;
+        image.dct = DctAvx2;
+    }
+#else
+    (void)simd;
+#endif
+
+    ScaleQuantTable(LUMA_QUANT, quality, image.quant[0]);
+    ScaleQuantTable(CHROMA_QUANT, quality, image.quant[1]);
+    for (int t = 0; t < 2; ++t)
+    {
+        for (int v = 0; v < 8; ++v)
+            for (int u = 0; u < 8; ++u)
+                image.divisors[t][u * 8 + v] = float(1.0 / (image.quant[t][v * 8 + u] * AAN_SCALE[v] * AAN_SCALE[u] * 8.0));
+    }
+
+    // MCU rows are independent restart intervals
+    const uint32_t mcuRows = (height + MCU_SIZE - 1) / MCU_SIZE;
+    std::vector<std::vector<uint8_t>> rows(mcuRows);
+    auto encodeRow = [&](size_t row) { image.EncodeRow(uint32_t(row), rows[row]); };
+    if (pool && mcuRows > 1)
+        pool->ParallelFor(mcuRows, encodeRow);
+    else
+        for (size_t row = 0; row < mcuRows; ++row)
+            encodeRow(row);
+
+    // Headers
+    jpeg.clear();
+    AppendMarker(jpeg, 0xd8, 0);                                        // SOI
+
+    static const uint8_t JFIF[14] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+    AppendMarker(jpeg, 0xe0, 2 + sizeof(JFIF));                         // APP0
+    jpeg.insert(jpeg.end(), JFIF, JFIF + sizeof(JFIF));
+
+    AppendMarker(jpeg, 0xdb, 2 + 2 * 65);                               // DQT
+    for (int t = 0; t < 2; ++t)
+    {
+        jpeg.push_back(uint8_t(t));
+        for (int k = 0; k < 64; ++k)
+            jpeg.push_back(image.quant[t][ZIGZAG[k]]);
+    }
+
+    const uint8_t frame[15] = { 8, uint8_t(height >> 8), uint8_t(height), uint8_t(width >> 8), uint8_t(width), 3,
+                                1, 0x22, 0,     // Y, 2x2 samples per MCU
+                                2, 0x11, 1,     // Cb
+                                3, 0x11, 1 };   // Cr
+    AppendMarker(jpeg, 0xc0, 2 + sizeof(frame));                        // SOF0
+    jpeg.insert(jpeg.end(), frame, frame + sizeof(frame));
+
+    const StaticTables& tables = *image.tables;
+    AppendMarker(jpeg, 0xc4, uint32_t(2 + 4 * 17 + 2 * sizeof(DC_SYMBOLS) + sizeof(AC_LUMA_SYMBOLS) + sizeof(AC_CHROMA_SYMBOLS)));
+    AppendHuffmanTable(jpeg, 0x00, tables.dc[0]);                       // DHT
+    AppendHuffmanTable(jpeg, 0x10, tables.ac[0]);
+    AppendHuffmanTable(jpeg, 0x01, tables.dc[1]);
+    AppendHuffmanTable(jpeg, 0x11, tables.ac[1]);
+
+    AppendMarker(jpeg, 0xdd, 4);                                        // DRI
+    jpeg.push_back(uint8_t(image.mcusPerRow >> 8));
+    jpeg.push_back(uint8_t(image.mcusPerRow));
+
+    static const uint8_t SCAN[10] = { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+    AppendMarker(jpeg, 0xda, 2 + sizeof(SCAN));                         // SOS
+    jpeg.insert(jpeg.end(), SCAN, SCAN + sizeof(SCAN));
+
+    // The rows, RST0-RST7 in turn between them
+    size_t total = jpeg.size() + 2;
+    for (const std::vector<uint8_t>& row : rows)
+        total += row.size() + 2;
+    jpeg.reserve(total);
+    for (uint32_t row = 0; row < mcuRows; ++row)
+    {
+        jpeg.insert(jpeg.end(), rows[row].begin(), rows[row].end());
+        if (row + 1 < mcuRows)
+            AppendMarker(jpeg, uint8_t(0xd0 + row % 8), 0);
+    }
+    AppendMarker(jpeg, 0xd9, 0);                                        // EOI
+    return true;
+}
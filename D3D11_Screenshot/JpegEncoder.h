@@ -0,0 +1,43 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: JpegEncoder.h
+//
+// Baseline JPEG encoder for lossy screenshots, independent of WIC. BGRA goes
+// to YCbCr 4:2:0 in the same pass that feeds the forward DCT, and the
+// coefficients are quantized and Huffman coded with the standard tables of
+// the specification's Annex K, so there is no statistics pass.
+//
+// Every row of 16x16 macroblocks (MCUs) is a restart interval: the DC
+// predictors start again at zero and the coded row ends on a byte boundary.
+// The rows are converted, transformed and coded independently on a thread
+// pool and then joined with RSTn markers in between, so the file is the same
+// whatever the thread count.
+//
+// Colour conversion, DCT and quantization have a scalar version and an AVX2
+// one picked at run time (see PixelConvert.h); both compute the same float
+// operations in the same order and give exactly the same file.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "PixelConvert.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Encodes a top-down BGRA image (negative pitch for bottom-up) into `jpeg`, reusing its
+// capacity. `quality` runs from 1 to 100 and scales the Annex K quantization tables the
+// way libjpeg does; alpha is ignored. MCU rows are spread over `pool` if given. `simd`
+// caps the kernels used, so benchmarks can compare them.
+bool EncodeJpeg(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, uint32_t quality,
+                std::vector<uint8_t>& jpeg, ThreadPool* pool = nullptr, PixelSimd simd = PixelSimd::Best);
@@ -10,6 +10,7 @@
 //-----------------------------------------------------------------------------
 #include <string>
 #include <memory>
+#include <cwchar>
 
 #include "MainWindow.h"
 
@@ -102,6 +103,7 @@ HRESULT MainWindow::Run( std::shared_ptr<Renderer> renderer )
 
     // The render loop is controlled here.
     HRESULT hr_coInit = CoInitialize(nullptr);
+    ULONGLONG lastStatsTime = 0;
     MSG  msg = {};
     while (WM_QUIT != msg.message)
     {
@@ -120,6 +122,19 @@ HRESULT MainWindow::Run( std::shared_ptr<Renderer> renderer )
                   // Draw and present the frame to the screen.
                   renderer->DrawFrame();
               }
+
+              // Show the screenshot queue in the title bar once a second
+              ULONGLONG now = GetTickCount64();
+              if (now - lastStatsTime >= 1000)
+              {
+                  lastStatsTime = now;
+                  ScreenshotStats stats = renderer->GetScreenshotStats();
+                  wchar_t title[192];
+                  swprintf_s(title, L"Screenshot - queue %u/%u (peak %u), saved %llu, duplicates %llu, dropped %llu, failed %llu, encode %.1f ms",
+                      stats.queueDepth, stats.queueCapacity, stats.peakQueueDepth, stats.saved, stats.duplicates, stats.dropped, stats.failed,
+                      stats.avgEncodeMs);
+                  SetWindowTextW(m_hWnd, title);
+              }
         }
     }
 
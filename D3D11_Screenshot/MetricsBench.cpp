@@ -0,0 +1,200 @@
+//-----------------------------------------------------------------------------
+// File: MetricsBench.cpp
+//
+// Headless benchmark for ImageMetrics, not part of the application build.
+// A short sequence of synthetic desktop frames is compared with copies that
+// were blurred, noised, banded or left alone. Each pair is measured with the
+// scalar and AVX2 kernels, on one thread and on the pool, with and without
+// SSIM and tiles. The bench checks that every variant gives the same numbers,
+// that identical frames score infinite PSNR and an SSIM of 1, and that the
+// worse copies score lower. It reports frames per second for each variant.
+//
+//   g++ -std=c++14 -O2 -I. MetricsBench.cpp ImageMetrics.cpp PixelConvert.cpp
+//       ../D3D11_ScreenCapture/ThreadPool.cpp -pthread -o metricsbench
+//   ./metricsbench [frames] [width] [height]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "ImageMetrics.h"
+#include "BenchImage.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+    double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // 3x3 box blur of the colour channels, roughly what a soft scaler does
+    std::vector<uint8_t> Blur(const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> out = bgra;
+        for (uint32_t y = 1; y + 1 < height; ++y)
+            for (uint32_t x = 1; x + 1 < width; ++x)
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    uint32_t sum = 0;
+                    for (int dy = -1; dy <= 1; ++dy)
+                        for (int dx = -1; dx <= 1; ++dx)
+                            sum += bgra[((size_t(y) + dy) * width + x + dx) * 4 + c];
+                    out[(size_t(y) * width + x) * 4 + c] = uint8_t((sum + 4) / 9);
+                }
+        return out;
+    }
+
+    std::vector<uint8_t> Noise(const std::vector<uint8_t>& bgra, int amplitude, uint32_t seed)
+    {
+        std::vector<uint8_t> out = bgra;
+        std::mt19937 rng(seed);
+        for (size_t i = 0; i < out.size(); ++i)
+            if (i % 4 != 3)
+                out[i] = uint8_t(std::min(255, std::max(0, int(out[i]) + int(rng() % (2 * amplitude + 1)) - amplitude)));
+        return out;
+    }
+
+    // Colour channels cut to 5 bits, like a 16-bit surface
+    std::vector<uint8_t> Band(const std::vector<uint8_t>& bgra)
+    {
+        std::vector<uint8_t> out = bgra;
+        for (size_t i = 0; i < out.size(); ++i)
+            if (i % 4 != 3)
+                out[i] = uint8_t((out[i] & 0xf8) | (out[i] >> 5));
+        return out;
+    }
+
+    bool Same(double a, double b)
+    {
+        return a == b || (std::isnan(a) && std::isnan(b));
+    }
+
+    bool Same(const ImageQuality& a, const ImageQuality& b)
+    {
+        return Same(a.mse, b.mse) && Same(a.psnr, b.psnr) && a.maxAbsDiff == b.maxAbsDiff && Same(a.ssim, b.ssim) &&
+               Same(a.msSsim, b.msSsim);
+    }
+
+    bool Same(const std::vector<TileQuality>& a, const std::vector<TileQuality>& b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+            if (!Same(a[i].psnr, b[i].psnr) || a[i].maxAbsDiff != b[i].maxAbsDiff || !Same(a[i].ssim, b[i].ssim))
+                return false;
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? uint32_t(atoi(argv[1])) : 8;
+    const uint32_t width = argc > 2 ? uint32_t(atoi(argv[2])) : 3840;
+    const uint32_t height = argc > 3 ? uint32_t(atoi(argv[3])) : 2160;
+
+    if (frames == 0 || width < 64 || height < 64)
+    {
+        printf("needs at least one frame of 64x64\n");
+        return 1;
+    }
+
+    // Reference frames and their copies: identical, banded, noisy, blurred; in that order
+    // they should score worse and worse
+    const std::vector<uint8_t> desktop = MakeDesktop(width, height);
+    std::vector<std::vector<uint8_t>> references, copies;
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        std::vector<uint8_t> reference = desktop;
+        std::rotate(reference.begin(), reference.begin() + size_t(f) * 4 * 37, reference.end());
+        switch (f % 4)
+        {
+        case 0: copies.push_back(reference); break;
+        case 1: copies.push_back(Band(reference)); break;
+        case 2: copies.push_back(Noise(reference, 12, f)); break;
+        default: copies.push_back(Blur(reference, width, height)); break;
+        }
+        references.push_back(std::move(reference));
+    }
+
+    ThreadPool pool;
+    printf("%u frames of %ux%u, %u threads, %s kernels available\n\n", frames, width, height, pool.Size(),
+           SupportedPixelSimd() == PixelSimd::Avx2 ? "AVX2" : "scalar");
+
+    struct Variant
+    {
+        const char* name;
+        PixelSimd   simd;
+        bool        threaded;
+        bool        ssim;
+        uint32_t    tileSize;
+    };
+    static const Variant VARIANTS[] =
+    {
+        { "psnr scalar 1t",      PixelSimd::Scalar, false, false, 0 },
+        { "psnr best 1t",        PixelSimd::Best,   false, false, 0 },
+        { "psnr best mt",        PixelSimd::Best,   true,  false, 0 },
+        { "ssim scalar 1t",      PixelSimd::Scalar, false, true,  0 },
+        { "ssim best 1t",        PixelSimd::Best,   false, true,  0 },
+        { "ssim best mt",        PixelSimd::Best,   true,  true,  0 },
+        { "ssim tiles scalar",   PixelSimd::Scalar, false, true,  64 },
+        { "ssim tiles best mt",  PixelSimd::Best,   true,  true,  64 },
+    };
+
+    printf("%-20s %10s %10s\n", "metrics", "frames/s", "ms/frame");
+    bool allOk = true;
+    std::vector<ImageQuality> expected[2];
+    std::vector<std::vector<TileQuality>> expectedTiles;
+    for (const Variant& variant : VARIANTS)
+    {
+        const ImageMetricsOptions options = { true, false, variant.ssim, variant.tileSize };
+        std::vector<ImageQuality> results(frames);
+        std::vector<std::vector<TileQuality>> tiles(frames);
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            allOk = MeasureImages(references[f].data(), ptrdiff_t(width) * 4, copies[f].data(), ptrdiff_t(width) * 4,
+                                  width, height, options, results[f], variant.tileSize ? &tiles[f] : nullptr,
+                                  variant.threaded ? &pool : nullptr, variant.simd) && allOk;
+        }
+        const double seconds = SecondsSince(start);
+
+        // Every kernel, thread count and tiling has to give the same numbers
+        bool same = true;
+        std::vector<ImageQuality>& reference = expected[variant.ssim ? 1 : 0];
+        if (reference.empty())
+            reference = results;
+        if (variant.tileSize && expectedTiles.empty())
+            expectedTiles = tiles;
+        for (uint32_t f = 0; f < frames; ++f)
+            same = same && Same(results[f], reference[f]) && (!variant.tileSize || Same(tiles[f], expectedTiles[f]));
+        printf("%-20s %10.2f %10.1f %s\n", variant.name, frames / seconds, seconds * 1000.0 / frames, same ? "" : "MISMATCH");
+        allOk = allOk && same;
+    }
+
+    printf("\n%-8s %10s %10s %8s %10s %10s\n", "copy", "mse", "PSNR dB", "max", "SSIM", "MS-SSIM");
+    static const char* const COPIES[] = { "same", "banded", "noisy", "blurred" };
+    for (uint32_t f = 0; f < std::min(frames, 4u); ++f)
+    {
+        const ImageQuality& q = expected[1][f];
+        printf("%-8s %10.3f %10.2f %8u %10.5f %10.5f\n", COPIES[f], q.mse, q.psnr, q.maxAbsDiff, q.ssim, q.msSsim);
+    }
+
+    // Sanity: identical frames are perfect, and the copies get worse in order
+    const std::vector<ImageQuality>& q = expected[1];
+    bool sane = std::isinf(q[0].psnr) && q[0].ssim == 1.0 && q[0].msSsim == 1.0 && q[0].maxAbsDiff == 0;
+    for (uint32_t f = 1; f < std::min(frames, 4u); ++f)
+        sane = sane && q[f].ssim < q[f - 1].ssim && q[f].psnr < q[f - 1].psnr;
+    if (!sane)
+        printf("\nmetrics don't order the copies as expected\n");
+    return allOk && sane ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+//-----------------------------------------------------------------------------
+// File: PixelBench.cpp
+//
+// Headless benchmark for PixelConvert, not part of the application build.
+// Packs a synthetic desktop-like frame into every format, then times
+// unpacking it back to BGRA and packing it again with the scalar, SSE4.1 and
+// AVX2 kernels, and checks that every level produces the same bytes.
+//
+//   g++ -std=c++14 -O2 -I. PixelBench.cpp PixelConvert.cpp -o pixelbench
+//   ./pixelbench [width] [height] [runs]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "PixelConvert.h"
+#include "BenchImage.h"
+#include "DxgiFormat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    template <typename Convert>
+    double BestOf(int runs, Convert convert)
+    {
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            convert();
+            best = std::min(best, MillisecondsSince(start));
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t width = argc > 1 ? uint32_t(atoi(argv[1])) : 3840;
+    const uint32_t height = argc > 2 ? uint32_t(atoi(argv[2])) : 2160;
+    const int runs = argc > 3 ? std::max(1, atoi(argv[3])) : 5;
+
+    if (width < 64 || height < 64)
+    {
+        printf("the test frame needs at least 64x64 pixels\n");
+        return 1;
+    }
+
+    static const struct { uint32_t format; const char* name; } FORMATS[] =
+    {
+        { 28, "R8G8B8A8_UNORM" },
+        { 87, "B8G8R8A8_UNORM" },
+        { 88, "B8G8R8X8_UNORM" },
+        { 24, "R10G10B10A2_UNORM" },
+        { 26, "R11G11B10_FLOAT" },
+        { 11, "R16G16B16A16_UNORM" },
+        { 10, "R16G16B16A16_FLOAT" },
+        { 2,  "R32G32B32A32_FLOAT" },
+        { 85, "B5G6R5_UNORM" },
+        { 86, "B5G5R5A1_UNORM" },
+        { 61, "R8_UNORM" },
+        { 49, "R8G8_UNORM" },
+    };
+    static const char* LEVEL_NAMES[] = { "scalar", "sse4", "avx2" };
+
+    const std::vector<uint8_t> frame = MakeDesktop(width, height);
+    const double megapixels = double(width) * height / 1e6;
+    const ptrdiff_t pitch8 = ptrdiff_t(width) * 4;
+    const int levels = static_cast<int>(SupportedPixelSimd()) + 1;
+
+    printf("%ux%u, best of %d, up to %s\n\n", width, height, runs, LEVEL_NAMES[levels - 1]);
+    printf("%-20s %-7s %11s %11s %s\n", "format", "level", "unpack MP/s", "pack MP/s", "check");
+
+    bool allOk = true;
+    std::vector<uint8_t> unpacked(frame.size()), reference;
+    for (const auto& format : FORMATS)
+    {
+        const ptrdiff_t pitch = ptrdiff_t(GetDxgiSurfaceSize(format.format, width, 1).rowBytes);
+        std::vector<uint8_t> packed(size_t(pitch) * height), repacked(packed.size()), packedReference;
+        PackPixels(format.format, frame.data(), pitch8, packed.data(), pitch, width, height, true, PixelSimd::Scalar);
+
+        for (int level = 0; level < levels; ++level)
+        {
+            const PixelSimd simd = static_cast<PixelSimd>(level);
+            const double unpackMs = BestOf(runs, [&] {
+                UnpackPixels(format.format, packed.data(), pitch, unpacked.data(), pitch8, width, height, true, simd);
+            });
+            const double packMs = BestOf(runs, [&] {
+                PackPixels(format.format, frame.data(), pitch8, repacked.data(), pitch, width, height, true, simd);
+            });
+
+            if (level == 0)
+            {
+                reference = unpacked;
+                packedReference = repacked;
+            }
+            const bool ok = unpacked == reference && repacked == packedReference;
+            allOk = allOk && ok;
+
+            printf("%-20s %-7s %11.0f %11.0f %s\n", level ? "" : format.name, LEVEL_NAMES[level],
+                   megapixels / (unpackMs / 1000.0), megapixels / (packMs / 1000.0), ok ? "ok" : "MISMATCH");
+        }
+    }
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,1296 @@
+//-----------------------------------------------------------------------------
+// File: PixelConvert.cpp
+//
+// Row kernels for every format and instruction set, and the dispatch between
+// them.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "PixelConvert.h"
+#include "DxgiFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+    const uint32_t FORMAT_R32G32B32A32_FLOAT = 2;
+    const uint32_t FORMAT_R16G16B16A16_FLOAT = 10;
+    const uint32_t FORMAT_R16G16B16A16_UNORM = 11;
+    const uint32_t FORMAT_R10G10B10A2_UNORM  = 24;
+    const uint32_t FORMAT_R11G11B10_FLOAT    = 26;
+    const uint32_t FORMAT_R8G8B8A8_UNORM     = 28;
+    const uint32_t FORMAT_R8G8_UNORM         = 49;
+    const uint32_t FORMAT_R8_UNORM           = 61;
+    const uint32_t FORMAT_B5G6R5_UNORM       = 85;
+    const uint32_t FORMAT_B5G5R5A1_UNORM     = 86;
+    const uint32_t FORMAT_B8G8R8A8_UNORM     = 87;
+    const uint32_t FORMAT_B8G8R8X8_UNORM     = 88;
+
+    // One row of `count` pixels; `bgra` is the order of the 8-bit side
+    using RowFn = void (*)(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra);
+
+    inline uint16_t Load16(const uint8_t* p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+    inline uint32_t Load32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+    inline float LoadFloat(const uint8_t* p) { float v; memcpy(&v, p, sizeof(v)); return v; }
+    inline void Store16(uint8_t* p, uint32_t v) { const uint16_t s = uint16_t(v); memcpy(p, &s, sizeof(s)); }
+    inline void Store32(uint8_t* p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+    inline void StoreFloat(uint8_t* p, float v) { memcpy(p, &v, sizeof(v)); }
+
+    inline void PutPixel(uint8_t* p, uint32_t r, uint32_t g, uint32_t b, uint32_t a, bool bgra)
+    {
+        p[0] = uint8_t(bgra ? b : r);
+        p[1] = uint8_t(g);
+        p[2] = uint8_t(bgra ? r : b);
+        p[3] = uint8_t(a);
+    }
+
+    inline void GetPixel(const uint8_t* p, bool bgra, uint32_t& r, uint32_t& g, uint32_t& b, uint32_t& a)
+    {
+        r = p[bgra ? 2 : 0];
+        g = p[1];
+        b = p[bgra ? 0 : 2];
+        a = p[3];
+    }
+
+    // Rounded to the nearest step. The multiply-add-shift forms are exact over their whole
+    // input range and fit the lane widths the vector kernels use them in.
+    inline uint32_t Unorm5To8(uint32_t v)  { return (v * 527 + 23) >> 6; }
+    inline uint32_t Unorm6To8(uint32_t v)  { return (v * 259 + 33) >> 6; }
+    inline uint32_t Unorm10To8(uint32_t v) { return (v * 1021 + 2041) >> 12; }
+    inline uint32_t Unorm16To8(uint32_t v) { return (v * 255 + 32895) >> 16; }
+    inline uint32_t Unorm8To10(uint32_t v) { return (v * 1027 + 129) >> 8; }
+
+    // v * max / 255 for max up to 255
+    inline uint32_t Unorm8ToN(uint32_t v, uint32_t max)
+    {
+        const uint32_t t = v * max + 128;
+        return (t + (t >> 8)) >> 8;
+    }
+
+    // NaN goes to 0; the vector kernels get the same from max and min with 0 and 1 second
+    inline uint32_t FloatToUnorm8(float f)
+    {
+        f = f > 0.0f ? f : 0.0f;
+        f = f < 1.0f ? f : 1.0f;
+        return uint32_t(std::lrint(f * 255.0f));
+    }
+
+    // Half floats and the 11- and 10-bit channels of R11G11B10 share a 5-bit exponent with
+    // bias 15. With the exponent moved to bit 23 of a float, scaling by 2^112 rebiases it,
+    // denormals included. Infinity becomes a large number and clamps to 255; NaN and
+    // anything with a sign bit above it go to 0.
+    const uint32_t SMALL_FLOAT_INFINITY = 31u << 23;
+    const uint32_t SMALL_FLOAT_REBIAS = 0x77800000;    // 2^112
+
+    inline uint32_t SmallFloatToUnorm8(uint32_t positioned)
+    {
+        if (positioned > SMALL_FLOAT_INFINITY)
+            return 0;
+
+        float f, scale;
+        memcpy(&f, &positioned, sizeof(f));
+        memcpy(&scale, &SMALL_FLOAT_REBIAS, sizeof(scale));
+        return FloatToUnorm8(f * scale);
+    }
+
+    // Rounds a float in [0, 1] to the nearest value with `mantissaBits`, ties to even. Every
+    // v / 255 is a normal number in these formats.
+    uint32_t ToSmallFloat(float f, int mantissaBits)
+    {
+        if (f == 0.0f)
+            return 0;
+
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        const int shift = 23 - mantissaBits;
+        const uint32_t exponent = (bits >> 23) - 127 + 15;
+        const uint32_t mantissa = bits & 0x7fffff;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t half = 1u << (shift - 1);
+
+        uint32_t value = (exponent << mantissaBits) | (mantissa >> shift);
+        if (rest > half || (rest == half && (value & 1)))
+            ++value;    // a carry into the exponent is still the right number
+        return value;
+    }
+
+    // 8-bit values to the float formats; small enough to look up
+    struct FloatTables
+    {
+        uint16_t half[256];
+        uint16_t float11[256];
+        uint16_t float10[256];
+
+        FloatTables()
+        {
+            for (uint32_t v = 0; v < 256; ++v)
+            {
+                const float f = float(v) / 255.0f;
+                half[v] = uint16_t(ToSmallFloat(f, 10));
+                float11[v] = uint16_t(ToSmallFloat(f, 6));
+                float10[v] = uint16_t(ToSmallFloat(f, 5));
+            }
+        }
+    };
+
+    const FloatTables& Tables()
+    {
+        static const FloatTables tables;
+        return tables;
+    }
+
+    //-------------------------------------------------------------------------
+    // Scalar reference
+    //-------------------------------------------------------------------------
+
+    // The 32-bit 8-bit formats only differ in channel order, which makes packing and
+    // unpacking the same operation
+    void Swizzle8Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool swap, bool opaque)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 4)
+        {
+            const uint8_t c0 = src[0], c1 = src[1], c2 = src[2], c3 = src[3];
+            dst[0] = swap ? c2 : c0;
+            dst[1] = c1;
+            dst[2] = swap ? c0 : c2;
+            dst[3] = opaque ? 255 : c3;
+        }
+    }
+
+    void Rgba8Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Scalar(src, dst, count, bgra, false); }
+    void Bgra8Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Scalar(src, dst, count, !bgra, false); }
+    void Bgrx8Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Scalar(src, dst, count, !bgra, true); }
+
+    void Unpack1010102Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 4)
+        {
+            const uint32_t v = Load32(src);
+            PutPixel(dst, Unorm10To8(v & 0x3ff), Unorm10To8((v >> 10) & 0x3ff), Unorm10To8((v >> 20) & 0x3ff),
+                     (v >> 30) * 85, bgra);
+        }
+    }
+
+    void Pack1010102Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 4)
+        {
+            uint32_t r, g, b, a;
+            GetPixel(src, bgra, r, g, b, a);
+            Store32(dst, Unorm8To10(r) | (Unorm8To10(g) << 10) | (Unorm8To10(b) << 20) | (Unorm8ToN(a, 3) << 30));
+        }
+    }
+
+    void Unpack111110Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 4)
+        {
+            const uint32_t v = Load32(src);
+            PutPixel(dst, SmallFloatToUnorm8((v << 17) & 0x0ffe0000), SmallFloatToUnorm8((v << 6) & 0x0ffe0000),
+                     SmallFloatToUnorm8((v >> 4) & 0x0ffc0000), 255, bgra);
+        }
+    }
+
+    void Pack111110Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const FloatTables& tables = Tables();
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 4)
+        {
+            uint32_t r, g, b, a;
+            GetPixel(src, bgra, r, g, b, a);
+            Store32(dst, uint32_t(tables.float11[r]) | (uint32_t(tables.float11[g]) << 11) | (uint32_t(tables.float10[b]) << 22));
+        }
+    }
+
+    void UnpackRgba16Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 8, dst += 4)
+        {
+            PutPixel(dst, Unorm16To8(Load16(src)), Unorm16To8(Load16(src + 2)), Unorm16To8(Load16(src + 4)),
+                     Unorm16To8(Load16(src + 6)), bgra);
+        }
+    }
+
+    void PackRgba16Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 8)
+        {
+            uint32_t r, g, b, a;
+            GetPixel(src, bgra, r, g, b, a);
+            Store16(dst, r * 257);
+            Store16(dst + 2, g * 257);
+            Store16(dst + 4, b * 257);
+            Store16(dst + 6, a * 257);
+        }
+    }
+
+    void UnpackRgba16FScalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 8, dst += 4)
+        {
+            PutPixel(dst, SmallFloatToUnorm8(uint32_t(Load16(src)) << 13), SmallFloatToUnorm8(uint32_t(Load16(src + 2)) << 13),
+                     SmallFloatToUnorm8(uint32_t(Load16(src + 4)) << 13), SmallFloatToUnorm8(uint32_t(Load16(src + 6)) << 13),
+                     bgra);
+        }
+    }
+
+    void PackRgba16FScalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const FloatTables& tables = Tables();
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 8)
+        {
+            uint32_t r, g, b, a;
+            GetPixel(src, bgra, r, g, b, a);
+            Store16(dst, tables.half[r]);
+            Store16(dst + 2, tables.half[g]);
+            Store16(dst + 4, tables.half[b]);
+            Store16(dst + 6, tables.half[a]);
+        }
+    }
+
+    void UnpackRgba32FScalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 16, dst += 4)
+        {
+            PutPixel(dst, FloatToUnorm8(LoadFloat(src)), FloatToUnorm8(LoadFloat(src + 4)), FloatToUnorm8(LoadFloat(src + 8)),
+                     FloatToUnorm8(LoadFloat(src + 12)), bgra);
+        }
+    }
+
+    void PackRgba32FScalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 16)
+        {
+            uint32_t r, g, b, a;
+            GetPixel(src, bgra, r, g, b, a);
+            StoreFloat(dst, float(r) / 255.0f);
+            StoreFloat(dst + 4, float(g) / 255.0f);
+            StoreFloat(dst + 8, float(b) / 255.0f);
+            StoreFloat(dst + 12, float(a) / 255.0f);
+        }
+    }
+
+    void Unpack565Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 2, dst += 4)
+        {
+            const uint32_t v = Load16(src);
+            PutPixel(dst, Unorm5To8(v >> 11), Unorm6To8((v >> 5) & 63), Unorm5To8(v & 31), 255, bgra);
+        }
+    }
+
+    void Pack565Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 2)
+        {
+            uint32_t r, g, b, a;
+            GetPixel(src, bgra, r, g, b, a);
+            Store16(dst, Unorm8ToN(b, 31) | (Unorm8ToN(g, 63) << 5) | (Unorm8ToN(r, 31) << 11));
+        }
+    }
+
+    void Unpack5551Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 2, dst += 4)
+        {
+            const uint32_t v = Load16(src);
+            PutPixel(dst, Unorm5To8((v >> 10) & 31), Unorm5To8((v >> 5) & 31), Unorm5To8(v & 31), (v >> 15) * 255, bgra);
+        }
+    }
+
+    void Pack5551Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 2)
+        {
+            uint32_t r, g, b, a;
+            GetPixel(src, bgra, r, g, b, a);
+            Store16(dst, Unorm8ToN(b, 31) | (Unorm8ToN(g, 31) << 5) | (Unorm8ToN(r, 31) << 10) | ((a >> 7) << 15));
+        }
+    }
+
+    void UnpackR8Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, ++src, dst += 4)
+            PutPixel(dst, src[0], 0, 0, 255, bgra);
+    }
+
+    void PackR8Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, ++dst)
+            dst[0] = src[bgra ? 2 : 0];
+    }
+
+    void UnpackR8G8Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 2, dst += 4)
+            PutPixel(dst, src[0], src[1], 0, 255, bgra);
+    }
+
+    void PackR8G8Scalar(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        for (uint32_t x = 0; x < count; ++x, src += 4, dst += 2)
+        {
+            dst[0] = src[bgra ? 2 : 0];
+            dst[1] = src[1];
+        }
+    }
+}
+
+#ifdef PIXEL_X86
+
+//-----------------------------------------------------------------------------
+// SSE4.1
+//-----------------------------------------------------------------------------
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+namespace
+{
+    inline __m128i SwapRedBlue(__m128i v)
+    {
+        return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15));
+    }
+
+    // Channels in 32-bit lanes, one pixel each
+    inline void Store4Sse4(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a, bool bgra)
+    {
+        const __m128i first = bgra ? b : r;
+        const __m128i third = bgra ? r : b;
+        const __m128i v = _mm_or_si128(_mm_or_si128(first, _mm_slli_epi32(g, 8)),
+                                       _mm_or_si128(_mm_slli_epi32(third, 16), _mm_slli_epi32(a, 24)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+    }
+
+    // Channels in 16-bit lanes, eight pixels
+    inline void Store8Sse4(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a, bool bgra)
+    {
+        const __m128i first = _mm_or_si128(bgra ? b : r, _mm_slli_epi16(g, 8));
+        const __m128i second = _mm_or_si128(bgra ? r : b, _mm_slli_epi16(a, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(first, second));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(first, second));
+    }
+
+    inline void Load4Sse4(const uint8_t* src, bool bgra, __m128i& r, __m128i& g, __m128i& b, __m128i& a)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i first = _mm_and_si128(v, mask);
+        const __m128i third = _mm_and_si128(_mm_srli_epi32(v, 16), mask);
+        r = bgra ? third : first;
+        g = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+        b = bgra ? first : third;
+        a = _mm_srli_epi32(v, 24);
+    }
+
+    inline void Load8Sse4(const uint8_t* src, bool bgra, __m128i& r, __m128i& g, __m128i& b, __m128i& a)
+    {
+        __m128i r0, g0, b0, a0, r1, g1, b1, a1;
+        Load4Sse4(src, bgra, r0, g0, b0, a0);
+        Load4Sse4(src + 16, bgra, r1, g1, b1, a1);
+        r = _mm_packs_epi32(r0, r1);
+        g = _mm_packs_epi32(g0, g1);
+        b = _mm_packs_epi32(b0, b1);
+        a = _mm_packs_epi32(a0, a1);
+    }
+
+    // Four pixels of four 32-bit channels each to 8-bit pixels in the same order
+    inline __m128i Narrow4Sse4(__m128i p0, __m128i p1, __m128i p2, __m128i p3)
+    {
+        return _mm_packus_epi16(_mm_packus_epi32(p0, p1), _mm_packus_epi32(p2, p3));
+    }
+
+    inline __m128i FloatToUnorm8Sse4(__m128 f)
+    {
+        f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        return _mm_cvtps_epi32(_mm_mul_ps(f, _mm_set1_ps(255.0f)));
+    }
+
+    inline __m128i SmallFloatToUnorm8Sse4(__m128i positioned)
+    {
+        const __m128 f = _mm_mul_ps(_mm_castsi128_ps(positioned), _mm_castsi128_ps(_mm_set1_epi32(int(SMALL_FLOAT_REBIAS))));
+        const __m128i invalid = _mm_cmpgt_epi32(positioned, _mm_set1_epi32(int(SMALL_FLOAT_INFINITY)));
+        return _mm_andnot_si128(invalid, FloatToUnorm8Sse4(f));
+    }
+
+    inline __m128i Unorm10To8Sse4(__m128i v)
+    {
+        return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(v, _mm_set1_epi32(1021)), _mm_set1_epi32(2041)), 12);
+    }
+
+    inline __m128i Unorm16To8Sse4(__m128i v)
+    {
+        return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(v, _mm_set1_epi32(255)), _mm_set1_epi32(32895)), 16);
+    }
+
+    // 16-bit lanes
+    inline __m128i Unorm5To8Sse4(__m128i v)
+    {
+        return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+    }
+
+    inline __m128i Unorm6To8Sse4(__m128i v)
+    {
+        return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16(259)), _mm_set1_epi16(33)), 6);
+    }
+
+    inline __m128i Unorm8ToNSse4(__m128i v, int16_t max)
+    {
+        const __m128i t = _mm_add_epi16(_mm_mullo_epi16(v, _mm_set1_epi16(max)), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    void Swizzle8Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool swap, bool opaque)
+    {
+        const __m128i alpha = _mm_set1_epi32(opaque ? int(0xff000000) : 0);
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            if (swap)
+                v = SwapRedBlue(v);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_or_si128(v, alpha));
+        }
+        Swizzle8Scalar(src + x * 4, dst + x * 4, count - x, swap, opaque);
+    }
+
+    void Rgba8Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Sse4(src, dst, count, bgra, false); }
+    void Bgra8Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Sse4(src, dst, count, !bgra, false); }
+    void Bgrx8Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Sse4(src, dst, count, !bgra, true); }
+
+    void Unpack1010102Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i mask = _mm_set1_epi32(0x3ff);
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            Store4Sse4(dst + x * 4, Unorm10To8Sse4(_mm_and_si128(v, mask)),
+                       Unorm10To8Sse4(_mm_and_si128(_mm_srli_epi32(v, 10), mask)),
+                       Unorm10To8Sse4(_mm_and_si128(_mm_srli_epi32(v, 20), mask)),
+                       _mm_mullo_epi32(_mm_srli_epi32(v, 30), _mm_set1_epi32(85)), bgra);
+        }
+        Unpack1010102Scalar(src + x * 4, dst + x * 4, count - x, bgra);
+    }
+
+    void Pack1010102Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i scale = _mm_set1_epi32(1027);
+        const __m128i round = _mm_set1_epi32(129);
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i r, g, b, a;
+            Load4Sse4(src + x * 4, bgra, r, g, b, a);
+            r = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(r, scale), round), 8);
+            g = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(g, scale), round), 8);
+            b = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(b, scale), round), 8);
+            a = Unorm8ToNSse4(a, 3);    // fits the low half of each lane
+            const __m128i v = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 10)),
+                                           _mm_or_si128(_mm_slli_epi32(b, 20), _mm_slli_epi32(a, 30)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), v);
+        }
+        Pack1010102Scalar(src + x * 4, dst + x * 4, count - x, bgra);
+    }
+
+    void Unpack111110Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i mask11 = _mm_set1_epi32(0x0ffe0000);
+        const __m128i mask10 = _mm_set1_epi32(0x0ffc0000);
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            Store4Sse4(dst + x * 4, SmallFloatToUnorm8Sse4(_mm_and_si128(_mm_slli_epi32(v, 17), mask11)),
+                       SmallFloatToUnorm8Sse4(_mm_and_si128(_mm_slli_epi32(v, 6), mask11)),
+                       SmallFloatToUnorm8Sse4(_mm_and_si128(_mm_srli_epi32(v, 4), mask10)),
+                       _mm_set1_epi32(255), bgra);
+        }
+        Unpack111110Scalar(src + x * 4, dst + x * 4, count - x, bgra);
+    }
+
+    void UnpackRgba16Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8));
+            const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8 + 16));
+            __m128i v = Narrow4Sse4(Unorm16To8Sse4(_mm_unpacklo_epi16(v0, zero)), Unorm16To8Sse4(_mm_unpackhi_epi16(v0, zero)),
+                                    Unorm16To8Sse4(_mm_unpacklo_epi16(v1, zero)), Unorm16To8Sse4(_mm_unpackhi_epi16(v1, zero)));
+            if (bgra)
+                v = SwapRedBlue(v);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), v);
+        }
+        UnpackRgba16Scalar(src + x * 8, dst + x * 4, count - x, bgra);
+    }
+
+    void PackRgba16Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            if (bgra)
+                v = SwapRedBlue(v);
+
+            // A byte next to itself is that byte times 257
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 8), _mm_unpacklo_epi8(v, v));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 8 + 16), _mm_unpackhi_epi8(v, v));
+        }
+        PackRgba16Scalar(src + x * 4, dst + x * 8, count - x, bgra);
+    }
+
+    void UnpackRgba16FSse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8));
+            const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8 + 16));
+            __m128i v = Narrow4Sse4(SmallFloatToUnorm8Sse4(_mm_slli_epi32(_mm_unpacklo_epi16(v0, zero), 13)),
+                                    SmallFloatToUnorm8Sse4(_mm_slli_epi32(_mm_unpackhi_epi16(v0, zero), 13)),
+                                    SmallFloatToUnorm8Sse4(_mm_slli_epi32(_mm_unpacklo_epi16(v1, zero), 13)),
+                                    SmallFloatToUnorm8Sse4(_mm_slli_epi32(_mm_unpackhi_epi16(v1, zero), 13)));
+            if (bgra)
+                v = SwapRedBlue(v);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), v);
+        }
+        UnpackRgba16FScalar(src + x * 8, dst + x * 4, count - x, bgra);
+    }
+
+    void UnpackRgba32FSse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            const float* p = reinterpret_cast<const float*>(src + x * 16);
+            __m128i v = Narrow4Sse4(FloatToUnorm8Sse4(_mm_loadu_ps(p)), FloatToUnorm8Sse4(_mm_loadu_ps(p + 4)),
+                                    FloatToUnorm8Sse4(_mm_loadu_ps(p + 8)), FloatToUnorm8Sse4(_mm_loadu_ps(p + 12)));
+            if (bgra)
+                v = SwapRedBlue(v);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), v);
+        }
+        UnpackRgba32FScalar(src + x * 16, dst + x * 4, count - x, bgra);
+    }
+
+    void PackRgba32FSse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128 scale = _mm_set1_ps(255.0f);
+        uint32_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            if (bgra)
+                v = SwapRedBlue(v);
+
+            float* p = reinterpret_cast<float*>(dst + x * 16);
+            _mm_storeu_ps(p, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), scale));
+            _mm_storeu_ps(p + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4))), scale));
+            _mm_storeu_ps(p + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8))), scale));
+            _mm_storeu_ps(p + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12))), scale));
+        }
+        PackRgba32FScalar(src + x * 4, dst + x * 16, count - x, bgra);
+    }
+
+    void Unpack565Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i mask5 = _mm_set1_epi16(31);
+        const __m128i mask6 = _mm_set1_epi16(63);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+            Store8Sse4(dst + x * 4, Unorm5To8Sse4(_mm_srli_epi16(v, 11)), Unorm6To8Sse4(_mm_and_si128(_mm_srli_epi16(v, 5), mask6)),
+                       Unorm5To8Sse4(_mm_and_si128(v, mask5)), _mm_set1_epi16(255), bgra);
+        }
+        Unpack565Scalar(src + x * 2, dst + x * 4, count - x, bgra);
+    }
+
+    void Pack565Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m128i r, g, b, a;
+            Load8Sse4(src + x * 4, bgra, r, g, b, a);
+            const __m128i v = _mm_or_si128(_mm_or_si128(Unorm8ToNSse4(b, 31), _mm_slli_epi16(Unorm8ToNSse4(g, 63), 5)),
+                                           _mm_slli_epi16(Unorm8ToNSse4(r, 31), 11));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2), v);
+        }
+        Pack565Scalar(src + x * 4, dst + x * 2, count - x, bgra);
+    }
+
+    void Unpack5551Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i mask5 = _mm_set1_epi16(31);
+        const __m128i mask8 = _mm_set1_epi16(255);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+            Store8Sse4(dst + x * 4, Unorm5To8Sse4(_mm_and_si128(_mm_srli_epi16(v, 10), mask5)),
+                       Unorm5To8Sse4(_mm_and_si128(_mm_srli_epi16(v, 5), mask5)), Unorm5To8Sse4(_mm_and_si128(v, mask5)),
+                       _mm_and_si128(_mm_srai_epi16(v, 15), mask8), bgra);
+        }
+        Unpack5551Scalar(src + x * 2, dst + x * 4, count - x, bgra);
+    }
+
+    void Pack5551Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m128i r, g, b, a;
+            Load8Sse4(src + x * 4, bgra, r, g, b, a);
+            const __m128i v = _mm_or_si128(_mm_or_si128(Unorm8ToNSse4(b, 31), _mm_slli_epi16(Unorm8ToNSse4(g, 31), 5)),
+                                           _mm_or_si128(_mm_slli_epi16(Unorm8ToNSse4(r, 31), 10), _mm_slli_epi16(_mm_srli_epi16(a, 7), 15)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2), v);
+        }
+        Pack5551Scalar(src + x * 4, dst + x * 2, count - x, bgra);
+    }
+
+    void UnpackR8Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alpha = _mm_set1_epi16(255);
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+            Store8Sse4(dst + x * 4, _mm_unpacklo_epi8(v, zero), zero, zero, alpha, bgra);
+            Store8Sse4(dst + x * 4 + 32, _mm_unpackhi_epi8(v, zero), zero, zero, alpha, bgra);
+        }
+        UnpackR8Scalar(src + x, dst + x * 4, count - x, bgra);
+    }
+
+    void PackR8Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const int shift = bgra ? 16 : 0;
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            __m128i c[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4 + i * 16));
+                c[i] = _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(shift)), mask);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), Narrow4Sse4(c[0], c[1], c[2], c[3]));
+        }
+        PackR8Scalar(src + x * 4, dst + x, count - x, bgra);
+    }
+
+    void UnpackR8G8Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i mask = _mm_set1_epi16(255);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+            Store8Sse4(dst + x * 4, _mm_and_si128(v, mask), _mm_srli_epi16(v, 8), _mm_setzero_si128(), mask, bgra);
+        }
+        UnpackR8G8Scalar(src + x * 2, dst + x * 4, count - x, bgra);
+    }
+
+    void PackR8G8Sse4(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m128i r, g, b, a;
+            Load8Sse4(src + x * 4, bgra, r, g, b, a);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2), _mm_or_si128(r, _mm_slli_epi16(g, 8)));
+        }
+        PackR8G8Scalar(src + x * 4, dst + x * 2, count - x, bgra);
+    }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+//-----------------------------------------------------------------------------
+// AVX2
+//-----------------------------------------------------------------------------
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,f16c"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,f16c")
+#endif
+
+namespace
+{
+    inline __m256i SwapRedBlueAvx2(__m256i v)
+    {
+        return _mm256_shuffle_epi8(v, _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                                       2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15));
+    }
+
+    inline __m128i LoadLow64(const uint8_t* p)
+    {
+        return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    }
+
+    // Channels in 32-bit lanes, one pixel each
+    inline void Store8Avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a, bool bgra)
+    {
+        const __m256i first = bgra ? b : r;
+        const __m256i third = bgra ? r : b;
+        const __m256i v = _mm256_or_si256(_mm256_or_si256(first, _mm256_slli_epi32(g, 8)),
+                                          _mm256_or_si256(_mm256_slli_epi32(third, 16), _mm256_slli_epi32(a, 24)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v);
+    }
+
+    // Channels in 16-bit lanes, sixteen pixels. The unpacks work within each 128-bit half,
+    // so the halves are put back in order before storing.
+    inline void Store16Avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a, bool bgra)
+    {
+        const __m256i first = _mm256_or_si256(bgra ? b : r, _mm256_slli_epi16(g, 8));
+        const __m256i second = _mm256_or_si256(bgra ? r : b, _mm256_slli_epi16(a, 8));
+        const __m256i lo = _mm256_unpacklo_epi16(first, second);
+        const __m256i hi = _mm256_unpackhi_epi16(first, second);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    inline void Load8Avx2(const uint8_t* src, bool bgra, __m256i& r, __m256i& g, __m256i& b, __m256i& a)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        const __m256i first = _mm256_and_si256(v, mask);
+        const __m256i third = _mm256_and_si256(_mm256_srli_epi32(v, 16), mask);
+        r = bgra ? third : first;
+        g = _mm256_and_si256(_mm256_srli_epi32(v, 8), mask);
+        b = bgra ? first : third;
+        a = _mm256_srli_epi32(v, 24);
+    }
+
+    inline void Load16Avx2(const uint8_t* src, bool bgra, __m256i& r, __m256i& g, __m256i& b, __m256i& a)
+    {
+        __m256i r0, g0, b0, a0, r1, g1, b1, a1;
+        Load8Avx2(src, bgra, r0, g0, b0, a0);
+        Load8Avx2(src + 32, bgra, r1, g1, b1, a1);
+        r = _mm256_permute4x64_epi64(_mm256_packs_epi32(r0, r1), _MM_SHUFFLE(3, 1, 2, 0));
+        g = _mm256_permute4x64_epi64(_mm256_packs_epi32(g0, g1), _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm256_permute4x64_epi64(_mm256_packs_epi32(b0, b1), _MM_SHUFFLE(3, 1, 2, 0));
+        a = _mm256_permute4x64_epi64(_mm256_packs_epi32(a0, a1), _MM_SHUFFLE(3, 1, 2, 0));
+    }
+
+    // Eight pixels of four 32-bit channels, two per register, to 8-bit pixels in order
+    inline __m256i Narrow8Avx2(__m256i p01, __m256i p23, __m256i p45, __m256i p67)
+    {
+        const __m256i v = _mm256_packus_epi16(_mm256_packus_epi32(p01, p23), _mm256_packus_epi32(p45, p67));
+        return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    }
+
+    inline __m256i FloatToUnorm8Avx2(__m256 f)
+    {
+        f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        return _mm256_cvtps_epi32(_mm256_mul_ps(f, _mm256_set1_ps(255.0f)));
+    }
+
+    inline __m256i SmallFloatToUnorm8Avx2(__m256i positioned)
+    {
+        const __m256 f = _mm256_mul_ps(_mm256_castsi256_ps(positioned), _mm256_castsi256_ps(_mm256_set1_epi32(int(SMALL_FLOAT_REBIAS))));
+        const __m256i invalid = _mm256_cmpgt_epi32(positioned, _mm256_set1_epi32(int(SMALL_FLOAT_INFINITY)));
+        return _mm256_andnot_si256(invalid, FloatToUnorm8Avx2(f));
+    }
+
+    inline __m256i Unorm10To8Avx2(__m256i v)
+    {
+        return _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(v, _mm256_set1_epi32(1021)), _mm256_set1_epi32(2041)), 12);
+    }
+
+    inline __m256i Unorm16To8Avx2(__m256i v)
+    {
+        return _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(v, _mm256_set1_epi32(255)), _mm256_set1_epi32(32895)), 16);
+    }
+
+    inline __m256i Unorm5To8Avx2(__m256i v)
+    {
+        return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(v, _mm256_set1_epi16(527)), _mm256_set1_epi16(23)), 6);
+    }
+
+    inline __m256i Unorm6To8Avx2(__m256i v)
+    {
+        return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(v, _mm256_set1_epi16(259)), _mm256_set1_epi16(33)), 6);
+    }
+
+    inline __m256i Unorm8ToNAvx2(__m256i v, int16_t max)
+    {
+        const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(v, _mm256_set1_epi16(max)), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    void Swizzle8Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool swap, bool opaque)
+    {
+        const __m256i alpha = _mm256_set1_epi32(opaque ? int(0xff000000) : 0);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+            if (swap)
+                v = SwapRedBlueAvx2(v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), _mm256_or_si256(v, alpha));
+        }
+        Swizzle8Scalar(src + x * 4, dst + x * 4, count - x, swap, opaque);
+    }
+
+    void Rgba8Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Avx2(src, dst, count, bgra, false); }
+    void Bgra8Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Avx2(src, dst, count, !bgra, false); }
+    void Bgrx8Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra) { Swizzle8Avx2(src, dst, count, !bgra, true); }
+
+    void Unpack1010102Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m256i mask = _mm256_set1_epi32(0x3ff);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+            Store8Avx2(dst + x * 4, Unorm10To8Avx2(_mm256_and_si256(v, mask)),
+                       Unorm10To8Avx2(_mm256_and_si256(_mm256_srli_epi32(v, 10), mask)),
+                       Unorm10To8Avx2(_mm256_and_si256(_mm256_srli_epi32(v, 20), mask)),
+                       _mm256_mullo_epi32(_mm256_srli_epi32(v, 30), _mm256_set1_epi32(85)), bgra);
+        }
+        Unpack1010102Scalar(src + x * 4, dst + x * 4, count - x, bgra);
+    }
+
+    void Pack1010102Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m256i scale = _mm256_set1_epi32(1027);
+        const __m256i round = _mm256_set1_epi32(129);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i r, g, b, a;
+            Load8Avx2(src + x * 4, bgra, r, g, b, a);
+            r = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, scale), round), 8);
+            g = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(g, scale), round), 8);
+            b = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(b, scale), round), 8);
+            a = Unorm8ToNAvx2(a, 3);
+            const __m256i v = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 10)),
+                                              _mm256_or_si256(_mm256_slli_epi32(b, 20), _mm256_slli_epi32(a, 30)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), v);
+        }
+        Pack1010102Scalar(src + x * 4, dst + x * 4, count - x, bgra);
+    }
+
+    void Unpack111110Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m256i mask11 = _mm256_set1_epi32(0x0ffe0000);
+        const __m256i mask10 = _mm256_set1_epi32(0x0ffc0000);
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+            Store8Avx2(dst + x * 4, SmallFloatToUnorm8Avx2(_mm256_and_si256(_mm256_slli_epi32(v, 17), mask11)),
+                       SmallFloatToUnorm8Avx2(_mm256_and_si256(_mm256_slli_epi32(v, 6), mask11)),
+                       SmallFloatToUnorm8Avx2(_mm256_and_si256(_mm256_srli_epi32(v, 4), mask10)),
+                       _mm256_set1_epi32(255), bgra);
+        }
+        Unpack111110Scalar(src + x * 4, dst + x * 4, count - x, bgra);
+    }
+
+    void UnpackRgba16Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i p[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8 + i * 16));
+                p[i] = Unorm16To8Avx2(_mm256_cvtepu16_epi32(v));
+            }
+            __m256i v = Narrow8Avx2(p[0], p[1], p[2], p[3]);
+            if (bgra)
+                v = SwapRedBlueAvx2(v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), v);
+        }
+        UnpackRgba16Scalar(src + x * 8, dst + x * 4, count - x, bgra);
+    }
+
+    void PackRgba16Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+            if (bgra)
+                v = SwapRedBlueAvx2(v);
+            const __m256i lo = _mm256_unpacklo_epi8(v, v);
+            const __m256i hi = _mm256_unpackhi_epi8(v, v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 8), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 8 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+        PackRgba16Scalar(src + x * 4, dst + x * 8, count - x, bgra);
+    }
+
+    void UnpackRgba16FAvx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i p[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8 + i * 16));
+                p[i] = FloatToUnorm8Avx2(_mm256_cvtph_ps(v));
+            }
+            __m256i v = Narrow8Avx2(p[0], p[1], p[2], p[3]);
+            if (bgra)
+                v = SwapRedBlueAvx2(v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), v);
+        }
+        UnpackRgba16FScalar(src + x * 8, dst + x * 4, count - x, bgra);
+    }
+
+    void PackRgba16FAvx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        uint32_t x = 0;
+        for (; x + 2 <= count; x += 2)
+        {
+            __m128i v = LoadLow64(src + x * 4);
+            if (bgra)
+                v = _mm_shuffle_epi8(v, swap);
+            const __m256 f = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)), scale);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 8), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+        }
+        PackRgba16FScalar(src + x * 4, dst + x * 8, count - x, bgra);
+    }
+
+    void UnpackRgba32FAvx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            const float* p = reinterpret_cast<const float*>(src + x * 16);
+            __m256i v = Narrow8Avx2(FloatToUnorm8Avx2(_mm256_loadu_ps(p)), FloatToUnorm8Avx2(_mm256_loadu_ps(p + 8)),
+                                    FloatToUnorm8Avx2(_mm256_loadu_ps(p + 16)), FloatToUnorm8Avx2(_mm256_loadu_ps(p + 24)));
+            if (bgra)
+                v = SwapRedBlueAvx2(v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), v);
+        }
+        UnpackRgba32FScalar(src + x * 16, dst + x * 4, count - x, bgra);
+    }
+
+    void PackRgba32FAvx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        uint32_t x = 0;
+        for (; x + 2 <= count; x += 2)
+        {
+            __m128i v = LoadLow64(src + x * 4);
+            if (bgra)
+                v = _mm_shuffle_epi8(v, swap);
+            _mm256_storeu_ps(reinterpret_cast<float*>(dst + x * 16), _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)), scale));
+        }
+        PackRgba32FScalar(src + x * 4, dst + x * 16, count - x, bgra);
+    }
+
+    void Unpack565Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m256i mask5 = _mm256_set1_epi16(31);
+        const __m256i mask6 = _mm256_set1_epi16(63);
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2));
+            Store16Avx2(dst + x * 4, Unorm5To8Avx2(_mm256_srli_epi16(v, 11)),
+                        Unorm6To8Avx2(_mm256_and_si256(_mm256_srli_epi16(v, 5), mask6)),
+                        Unorm5To8Avx2(_mm256_and_si256(v, mask5)), _mm256_set1_epi16(255), bgra);
+        }
+        Unpack565Scalar(src + x * 2, dst + x * 4, count - x, bgra);
+    }
+
+    void Pack565Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            __m256i r, g, b, a;
+            Load16Avx2(src + x * 4, bgra, r, g, b, a);
+            const __m256i v = _mm256_or_si256(_mm256_or_si256(Unorm8ToNAvx2(b, 31), _mm256_slli_epi16(Unorm8ToNAvx2(g, 63), 5)),
+                                              _mm256_slli_epi16(Unorm8ToNAvx2(r, 31), 11));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 2), v);
+        }
+        Pack565Scalar(src + x * 4, dst + x * 2, count - x, bgra);
+    }
+
+    void Unpack5551Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m256i mask5 = _mm256_set1_epi16(31);
+        const __m256i mask8 = _mm256_set1_epi16(255);
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2));
+            Store16Avx2(dst + x * 4, Unorm5To8Avx2(_mm256_and_si256(_mm256_srli_epi16(v, 10), mask5)),
+                        Unorm5To8Avx2(_mm256_and_si256(_mm256_srli_epi16(v, 5), mask5)),
+                        Unorm5To8Avx2(_mm256_and_si256(v, mask5)), _mm256_and_si256(_mm256_srai_epi16(v, 15), mask8), bgra);
+        }
+        Unpack5551Scalar(src + x * 2, dst + x * 4, count - x, bgra);
+    }
+
+    void Pack5551Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            __m256i r, g, b, a;
+            Load16Avx2(src + x * 4, bgra, r, g, b, a);
+            const __m256i v = _mm256_or_si256(_mm256_or_si256(Unorm8ToNAvx2(b, 31), _mm256_slli_epi16(Unorm8ToNAvx2(g, 31), 5)),
+                                              _mm256_or_si256(_mm256_slli_epi16(Unorm8ToNAvx2(r, 31), 10),
+                                                              _mm256_slli_epi16(_mm256_srli_epi16(a, 7), 15)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 2), v);
+        }
+        Pack5551Scalar(src + x * 4, dst + x * 2, count - x, bgra);
+    }
+
+    void UnpackR8Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i alpha = _mm256_set1_epi16(255);
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+            Store16Avx2(dst + x * 4, _mm256_cvtepu8_epi16(v), zero, zero, alpha, bgra);
+        }
+        UnpackR8Scalar(src + x, dst + x * 4, count - x, bgra);
+    }
+
+    void PackR8Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            __m256i r, g, b, a;
+            Load16Avx2(src + x * 4, bgra, r, g, b, a);
+            const __m128i v = _mm_packus_epi16(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), v);
+        }
+        PackR8Scalar(src + x * 4, dst + x, count - x, bgra);
+    }
+
+    void UnpackR8G8Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        const __m256i mask = _mm256_set1_epi16(255);
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2));
+            Store16Avx2(dst + x * 4, _mm256_and_si256(v, mask), _mm256_srli_epi16(v, 8), _mm256_setzero_si256(), mask, bgra);
+        }
+        UnpackR8G8Scalar(src + x * 2, dst + x * 4, count - x, bgra);
+    }
+
+    void PackR8G8Avx2(const uint8_t* src, uint8_t* dst, uint32_t count, bool bgra)
+    {
+        uint32_t x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            __m256i r, g, b, a;
+            Load16Avx2(src + x * 4, bgra, r, g, b, a);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 2), _mm256_or_si256(r, _mm256_slli_epi16(g, 8)));
+        }
+        PackR8G8Scalar(src + x * 4, dst + x * 2, count - x, bgra);
+    }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif // PIXEL_X86
+
+//-----------------------------------------------------------------------------
+// Dispatch
+//-----------------------------------------------------------------------------
+namespace
+{
+    struct FormatKernels
+    {
+        uint32_t format;
+        RowFn    unpack[3];     // scalar, SSE4, AVX2; null where a level has nothing faster
+        RowFn    pack[3];
+    };
+
+#ifdef PIXEL_X86
+#define PIXEL_KERNELS(scalar, sse4, avx2) { scalar, sse4, avx2 }
+#else
+#define PIXEL_KERNELS(scalar, sse4, avx2) { scalar, nullptr, nullptr }
+#endif
+
+    // The float formats pack through a 256-entry table per channel, which the vector
+    // kernels can't beat except for F16C's half conversion
+    const FormatKernels FORMAT_KERNELS[] =
+    {
+        { FORMAT_R8G8B8A8_UNORM,     PIXEL_KERNELS(Rgba8Scalar, Rgba8Sse4, Rgba8Avx2),
+                                     PIXEL_KERNELS(Rgba8Scalar, Rgba8Sse4, Rgba8Avx2) },
+        { FORMAT_B8G8R8A8_UNORM,     PIXEL_KERNELS(Bgra8Scalar, Bgra8Sse4, Bgra8Avx2),
+                                     PIXEL_KERNELS(Bgra8Scalar, Bgra8Sse4, Bgra8Avx2) },
+        { FORMAT_B8G8R8X8_UNORM,     PIXEL_KERNELS(Bgrx8Scalar, Bgrx8Sse4, Bgrx8Avx2),
+                                     PIXEL_KERNELS(Bgrx8Scalar, Bgrx8Sse4, Bgrx8Avx2) },
+        { FORMAT_R10G10B10A2_UNORM,  PIXEL_KERNELS(Unpack1010102Scalar, Unpack1010102Sse4, Unpack1010102Avx2),
+                                     PIXEL_KERNELS(Pack1010102Scalar, Pack1010102Sse4, Pack1010102Avx2) },
+        { FORMAT_R11G11B10_FLOAT,    PIXEL_KERNELS(Unpack111110Scalar, Unpack111110Sse4, Unpack111110Avx2),
+                                     PIXEL_KERNELS(Pack111110Scalar, nullptr, nullptr) },
+        { FORMAT_R16G16B16A16_UNORM, PIXEL_KERNELS(UnpackRgba16Scalar, UnpackRgba16Sse4, UnpackRgba16Avx2),
+                                     PIXEL_KERNELS(PackRgba16Scalar, PackRgba16Sse4, PackRgba16Avx2) },
+        { FORMAT_R16G16B16A16_FLOAT, PIXEL_KERNELS(UnpackRgba16FScalar, UnpackRgba16FSse4, UnpackRgba16FAvx2),
+                                     PIXEL_KERNELS(PackRgba16FScalar, nullptr, PackRgba16FAvx2) },
+        { FORMAT_R32G32B32A32_FLOAT, PIXEL_KERNELS(UnpackRgba32FScalar, UnpackRgba32FSse4, UnpackRgba32FAvx2),
+                                     PIXEL_KERNELS(PackRgba32FScalar, PackRgba32FSse4, PackRgba32FAvx2) },
+        { FORMAT_B5G6R5_UNORM,       PIXEL_KERNELS(Unpack565Scalar, Unpack565Sse4, Unpack565Avx2),
+                                     PIXEL_KERNELS(Pack565Scalar, Pack565Sse4, Pack565Avx2) },
+        { FORMAT_B5G5R5A1_UNORM,     PIXEL_KERNELS(Unpack5551Scalar, Unpack5551Sse4, Unpack5551Avx2),
+                                     PIXEL_KERNELS(Pack5551Scalar, Pack5551Sse4, Pack5551Avx2) },
+        { FORMAT_R8_UNORM,           PIXEL_KERNELS(UnpackR8Scalar, UnpackR8Sse4, UnpackR8Avx2),
+                                     PIXEL_KERNELS(PackR8Scalar, PackR8Sse4, PackR8Avx2) },
+        { FORMAT_R8G8_UNORM,         PIXEL_KERNELS(UnpackR8G8Scalar, UnpackR8G8Sse4, UnpackR8G8Avx2),
+                                     PIXEL_KERNELS(PackR8G8Scalar, PackR8G8Sse4, PackR8G8Avx2) },
+    };
+
+#undef PIXEL_KERNELS
+
+    const FormatKernels* FindKernels(uint32_t dxgiFormat)
+    {
+        const uint32_t format = DxgiLinearFormat(dxgiFormat);
+        for (const FormatKernels& kernels : FORMAT_KERNELS)
+        {
+            if (kernels.format == format)
+                return &kernels;
+        }
+        return nullptr;
+    }
+
+    PixelSimd DetectSimd()
+    {
+#ifdef PIXEL_X86
+        uint32_t leaf1[4] = {}, leaf7[4] = {};
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+        __cpuid(info, 1);
+        memcpy(leaf1, info, sizeof(leaf1));
+        if (maxLeaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            memcpy(leaf7, info, sizeof(leaf7));
+        }
+#else
+        const unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+        __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+        if (maxLeaf >= 7)
+            __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+#endif
+        const uint32_t ecx = leaf1[2];
+        const bool ssse3 = (ecx & (1u << 9)) != 0;
+        const bool sse41 = (ecx & (1u << 19)) != 0;
+        const bool osxsave = (ecx & (1u << 27)) != 0;
+        const bool avx = (ecx & (1u << 28)) != 0;
+        const bool f16c = (ecx & (1u << 29)) != 0;
+        const bool avx2 = (leaf7[1] & (1u << 5)) != 0;
+
+        // The OS has to save the YMM registers too
+        bool ymmState = false;
+        if (osxsave)
+        {
+#ifdef _MSC_VER
+            ymmState = (_xgetbv(0) & 6) == 6;
+#else
+            uint32_t lo, hi;
+            __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            ymmState = (lo & 6) == 6;
+#endif
+        }
+
+        if (avx && avx2 && f16c && ymmState && sse41 && ssse3)
+            return PixelSimd::Avx2;
+        if (sse41 && ssse3)
+            return PixelSimd::Sse4;
+#endif
+        return PixelSimd::Scalar;
+    }
+
+    RowFn PickKernel(const RowFn (&kernels)[3], PixelSimd simd)
+    {
+        const int supported = static_cast<int>(SupportedPixelSimd());
+        int level = simd == PixelSimd::Best ? supported : std::min(static_cast<int>(simd), supported);
+        while (level > 0 && !kernels[level])
+            --level;
+        return kernels[level];
+    }
+
+    bool ConvertRows(const RowFn (&kernels)[3], const uint8_t* src, ptrdiff_t srcPitch,
+                     uint8_t* dst, ptrdiff_t dstPitch, uint32_t width, uint32_t height, bool bgra, PixelSimd simd)
+    {
+        if (!src || !dst || width == 0 || height == 0)
+            return false;
+
+        const RowFn row = PickKernel(kernels, simd);
+        for (uint32_t y = 0; y < height; ++y)
+            row(src + ptrdiff_t(y) * srcPitch, dst + ptrdiff_t(y) * dstPitch, width, bgra);
+        return true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+//-----------------------------------------------------------------------------
+PixelSimd SupportedPixelSimd()
+{
+    static const PixelSimd supported = DetectSimd();
+    return supported;
+}
+
+bool IsPixelConvertible(uint32_t dxgiFormat)
+{
+    return FindKernels(dxgiFormat) != nullptr;
+}
+
+bool UnpackPixels(uint32_t dxgiFormat, const uint8_t* src, ptrdiff_t srcPitch,
+                  uint8_t* dst, ptrdiff_t dstPitch, uint32_t width, uint32_t height, bool bgra, PixelSimd simd)
+{
+    const FormatKernels* kernels = FindKernels(dxgiFormat);
+    return kernels && ConvertRows(kernels->unpack, src, srcPitch, dst, dstPitch, width, height, bgra, simd);
+}
+
+bool PackPixels(uint32_t dxgiFormat, const uint8_t* src, ptrdiff_t srcPitch,
+                uint8_t* dst, ptrdiff_t dstPitch, uint32_t width, uint32_t height, bool bgra, PixelSimd simd)
+{
+    const FormatKernels* kernels = FindKernels(dxgiFormat);
+    return kernels && ConvertRows(kernels->pack, src, srcPitch, dst, dstPitch, width, height, bgra, simd);
+}
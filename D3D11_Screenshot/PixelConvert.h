@@ -0,0 +1,58 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: PixelConvert.h
+//
+// Portable conversion between common DXGI formats and 8-bit RGBA or BGRA,
+// in both directions, for the places that would otherwise hand the pixels to
+// an IWICFormatConverter. Every format has a scalar reference and SSE4.1 and
+// AVX2 kernels, picked at run time from what the CPU supports; all three
+// produce exactly the same bytes.
+//
+// Values are scaled and rounded to the nearest step, never gamma corrected:
+// UNORM channels are rescaled, float channels are clamped to [0, 1]. Missing
+// channels read as 0 and a missing alpha as opaque, as a shader would see
+// them. sRGB formats are handled as their UNORM counterpart.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+enum class PixelSimd
+{
+    Scalar,
+    Sse4,           // SSE4.1 and SSSE3
+    Avx2,           // AVX2 and F16C
+    Best,           // whatever the CPU supports
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// The fastest kernels this CPU can run
+PixelSimd SupportedPixelSimd();
+
+// R8G8B8A8, B8G8R8A8, B8G8R8X8, R10G10B10A2, R11G11B10_FLOAT, R16G16B16A16 UNORM and
+// FLOAT, R32G32B32A32_FLOAT, B5G6R5, B5G5R5A1, R8 and R8G8, plus the sRGB variants
+bool IsPixelConvertible(uint32_t dxgiFormat);
+
+// Expands a top-down image in `dxgiFormat` (negative pitches for bottom-up) into 8-bit
+// pixels, B, G, R, A if `bgra` is set and R, G, B, A otherwise. `simd` caps the kernels
+// used, so benchmarks can compare them; it can't go beyond what the CPU supports.
+bool UnpackPixels(uint32_t dxgiFormat, const uint8_t* src, ptrdiff_t srcPitch,
+                  uint8_t* dst, ptrdiff_t dstPitch, uint32_t width, uint32_t height, bool bgra,
+                  PixelSimd simd = PixelSimd::Best);
+
+// The other way around: 8-bit RGBA or BGRA pixels into `dxgiFormat`
+bool PackPixels(uint32_t dxgiFormat, const uint8_t* src, ptrdiff_t srcPitch,
+                uint8_t* dst, ptrdiff_t dstPitch, uint32_t width, uint32_t height, bool bgra,
+                PixelSimd simd = PixelSimd::Best);
@@ -0,0 +1,432 @@
+//-----------------------------------------------------------------------------
+// File: PngBench.cpp
+//
+// Headless benchmark for PngEncoder, not part of the application build. Encodes
+// a synthetic desktop-like frame at every level, checks that stb_image decodes
+// each file to exactly the source pixels, and compares time and size with a
+// classic single-threaded zlib PNG writer (adaptive filters, compress2).
+// The burst formats are measured against a plain memcpy of the frame, reading
+// from a padded pitch the way they read a mapped staging texture.
+//
+//   g++ -std=c++14 -O2 -I. PngBench.cpp PngEncoder.cpp Deflate.cpp Thumbnails.cpp QoiEncoder.cpp
+//       RawImage.cpp ../D3D11_ScreenCapture/ThreadPool.cpp -lz -pthread -o pngbench
+//   ./pngbench [width] [height] [runs] [out.png]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "PngEncoder.h"
+#include "QoiEncoder.h"
+#include "RawImage.h"
+#include "BenchImage.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include "../D3D11_Image/stb_image.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Single-threaded reference: minimum-sum-of-absolute-differences filters, one zlib stream
+    bool ZlibPng(const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height, int level, std::vector<uint8_t>& png)
+    {
+        const size_t rowBytes = size_t(width) * 3;
+        std::vector<uint8_t> filtered((rowBytes + 1) * height), prev(rowBytes, 0), cur(rowBytes), trial(rowBytes), best(rowBytes);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const uint8_t* p = &bgra[(size_t(y) * width + x) * 4];
+                cur[x * 3] = p[2];
+                cur[x * 3 + 1] = p[1];
+                cur[x * 3 + 2] = p[0];
+            }
+
+            uint64_t bestScore = UINT64_MAX;
+            uint8_t bestFilter = 0;
+            for (uint8_t filter = 0; filter < 5; ++filter)
+            {
+                uint64_t score = 0;
+                for (size_t i = 0; i < rowBytes; ++i)
+                {
+                    const int a = i >= 3 ? cur[i - 3] : 0, b = prev[i], c = i >= 3 ? prev[i - 3] : 0;
+                    int predicted = 0;
+                    switch (filter)
+                    {
+                    case 1: predicted = a; break;
+                    case 2: predicted = b; break;
+                    case 3: predicted = (a + b) / 2; break;
+                    case 4:
+                    {
+                        const int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+                        predicted = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                        break;
+                    }
+                    }
+                    trial[i] = uint8_t(cur[i] - predicted);
+                    score += trial[i] < 128 ? trial[i] : 256 - trial[i];
+                }
+                if (score < bestScore)
+                {
+                    bestScore = score;
+                    bestFilter = filter;
+                    best.swap(trial);
+                }
+            }
+
+            uint8_t* line = &filtered[y * (rowBytes + 1)];
+            line[0] = bestFilter;
+            memcpy(line + 1, best.data(), rowBytes);
+            prev.swap(cur);
+        }
+
+        uLongf size = compressBound(uLong(filtered.size()));
+        std::vector<uint8_t> idat(size);
+        if (compress2(idat.data(), &size, filtered.data(), uLong(filtered.size()), level) != Z_OK)
+            return false;
+        idat.resize(size);
+
+        auto chunk = [&](const char* type, const uint8_t* data, uint32_t bytes)
+        {
+            const uint8_t length[4] = { uint8_t(bytes >> 24), uint8_t(bytes >> 16), uint8_t(bytes >> 8), uint8_t(bytes) };
+            png.insert(png.end(), length, length + 4);
+            png.insert(png.end(), type, type + 4);
+            png.insert(png.end(), data, data + bytes);
+            uLong crc = crc32(crc32(0, reinterpret_cast<const Bytef*>(type), 4), data, bytes);
+            const uint8_t tail[4] = { uint8_t(crc >> 24), uint8_t(crc >> 16), uint8_t(crc >> 8), uint8_t(crc) };
+            png.insert(png.end(), tail, tail + 4);
+        };
+
+        static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        png.assign(SIGNATURE, SIGNATURE + 8);
+        const uint8_t ihdr[13] = { uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+                                   uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+                                   8, 2, 0, 0, 0 };
+        chunk("IHDR", ihdr, 13);
+        chunk("IDAT", idat.data(), uint32_t(idat.size()));
+        chunk("IEND", nullptr, 0);
+        return true;
+    }
+
+    // Decodes with stb_image and compares against the source
+    bool Matches(const std::vector<uint8_t>& png, const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height, bool alpha,
+                 bool flipped = false)
+    {
+        int w = 0, h = 0, channels = 0;
+        const int want = alpha ? 4 : 3;
+        stbi_uc* pixels = stbi_load_from_memory(png.data(), int(png.size()), &w, &h, &channels, want);
+        if (!pixels)
+        {
+            printf("  stb_image: %s\n", stbi_failure_reason());
+            return false;
+        }
+
+        bool same = uint32_t(w) == width && uint32_t(h) == height && channels == want;
+        for (size_t i = 0; same && i < size_t(width) * height; ++i)
+        {
+            const size_t y = i / width, x = i % width;
+            const uint8_t* s = &bgra[((flipped ? height - 1 - y : y) * width + x) * 4];
+            const uint8_t* d = &pixels[i * want];
+            same = d[0] == s[2] && d[1] == s[1] && d[2] == s[0] && (!alpha || d[3] == s[3]);
+        }
+        stbi_image_free(pixels);
+        return same;
+    }
+
+    // Straightforward QOI decoder, independent of the encoder's structure
+    bool QoiMatches(const std::vector<uint8_t>& qoi, const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height, bool alpha)
+    {
+        auto be32 = [&](size_t at) { return uint32_t(qoi[at]) << 24 | uint32_t(qoi[at + 1]) << 16 | uint32_t(qoi[at + 2]) << 8 | qoi[at + 3]; };
+        if (qoi.size() < 22 || memcmp(qoi.data(), "qoif", 4) != 0 || be32(4) != width || be32(8) != height ||
+            qoi[12] != (alpha ? 4 : 3) || memcmp(&qoi[qoi.size() - 8], "\0\0\0\0\0\0\0\1", 8) != 0)
+            return false;
+
+        uint8_t index[64][4] = {};
+        uint8_t px[4] = { 0, 0, 0, 255 };   // r, g, b, a
+        size_t at = 14;
+        const size_t end = qoi.size() - 8;
+        uint32_t run = 0;
+        for (size_t i = 0; i < size_t(width) * height; ++i)
+        {
+            if (run > 0)
+            {
+                --run;
+            }
+            else
+            {
+                if (at >= end)
+                    return false;
+                const uint8_t op = qoi[at++];
+                if (op == 0xfe || op == 0xff)
+                {
+                    const size_t channels = op == 0xff ? 4 : 3;
+                    if (at + channels > end)
+                        return false;
+                    memcpy(px, &qoi[at], channels);
+                    at += channels;
+                }
+                else if ((op & 0xc0) == 0x00)
+                {
+                    memcpy(px, index[op], 4);
+                }
+                else if ((op & 0xc0) == 0x40)
+                {
+                    px[0] = uint8_t(px[0] + ((op >> 4) & 3) - 2);
+                    px[1] = uint8_t(px[1] + ((op >> 2) & 3) - 2);
+                    px[2] = uint8_t(px[2] + (op & 3) - 2);
+                }
+                else if ((op & 0xc0) == 0x80)
+                {
+                    if (at >= end)
+                        return false;
+                    const int dg = (op & 0x3f) - 32;
+                    const uint8_t next = qoi[at++];
+                    px[0] = uint8_t(px[0] + dg - 8 + (next >> 4));
+                    px[1] = uint8_t(px[1] + dg);
+                    px[2] = uint8_t(px[2] + dg - 8 + (next & 15));
+                }
+                else
+                {
+                    run = op & 0x3f;
+                }
+                memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) & 63], px, 4);
+            }
+
+            const uint8_t* s = &bgra[i * 4];
+            if (px[0] != s[2] || px[1] != s[1] || px[2] != s[0] || px[3] != (alpha ? s[3] : 255))
+                return false;
+        }
+        return run == 0 && at == end;
+    }
+
+    // Every preview must decode to the 4x4 averages of the level above it, worked out here per pixel
+    bool PreviewsMatch(const std::vector<uint8_t>& png, const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height,
+                       uint32_t levels)
+    {
+        std::vector<PngPreview> previews;
+        if (FindPngPreviews(png.data(), png.size(), previews) > png.size() || previews.size() != levels)
+            return false;
+
+        std::vector<uint8_t> level = bgra;
+        uint32_t levelWidth = width;
+        for (uint32_t i = 0; i < levels; ++i)
+        {
+            const uint32_t w = width >> (2 * (i + 1)), h = height >> (2 * (i + 1));
+            std::vector<uint8_t> next(size_t(w) * h * 4);
+            for (size_t p = 0; p < next.size(); ++p)
+            {
+                const size_t x = p / 4 % w, y = p / 4 / w, c = p % 4;
+                uint32_t sum = 8;
+                for (size_t dy = 0; dy < 4; ++dy)
+                    for (size_t dx = 0; dx < 4; ++dx)
+                        sum += level[((y * 4 + dy) * levelWidth + x * 4 + dx) * 4 + c];
+                next[p] = uint8_t(sum >> 4);
+            }
+
+            const PngPreview& preview = previews[levels - 1 - i];
+            const std::vector<uint8_t> file(preview.png, preview.png + preview.size);
+            if (preview.scale != 4u << (2 * i) || preview.width != w || preview.height != h || !Matches(file, next, w, h, false))
+                return false;
+            level.swap(next);
+            levelWidth = w;
+        }
+
+        // A gallery asking for 200 pixels across gets the smallest preview that wide, or the largest
+        const PngPreview* pick = PickPngPreview(previews, 200, 1);
+        const PngPreview* want = &previews.back();
+        for (const PngPreview& preview : previews)
+            if (preview.width >= 200 && preview.width < want->width)
+                want = &preview;
+        return pick == want;
+    }
+
+    bool RawMatches(const char* path, const std::vector<uint8_t>& bgra, uint32_t width, uint32_t height, uint32_t pitch)
+    {
+        std::vector<uint8_t> file;
+        if (FILE* f = fopen(path, "rb"))
+        {
+            uint8_t buffer[65536];
+            size_t got;
+            while ((got = fread(buffer, 1, sizeof(buffer), f)) > 0)
+                file.insert(file.end(), buffer, buffer + got);
+            fclose(f);
+        }
+
+        RAWIMAGE_HEADER header;
+        if (file.size() < sizeof(header))
+            return false;
+        memcpy(&header, file.data(), sizeof(header));
+        if (header.magic != RAWIMAGE_MAGIC || header.width != width || header.height != height || header.rowPitch != pitch ||
+            file.size() != sizeof(header) + header.dataSize)
+            return false;
+
+        for (uint32_t y = 0; y < height; ++y)
+            if (memcmp(&file[sizeof(header) + size_t(y) * pitch], &bgra[size_t(y) * width * 4], size_t(width) * 4) != 0)
+                return false;
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t width = argc > 1 ? uint32_t(atoi(argv[1])) : 3840;
+    const uint32_t height = argc > 2 ? uint32_t(atoi(argv[2])) : 2160;
+    const int runs = argc > 3 ? std::max(1, atoi(argv[3])) : 3;
+    const char* outPath = argc > 4 ? argv[4] : nullptr;
+
+    if (width < 64 || height < 64)
+    {
+        printf("the test frame needs at least 64x64 pixels\n");
+        return 1;
+    }
+
+    const std::vector<uint8_t> bgra = MakeDesktop(width, height);
+    const double megapixels = double(width) * height / 1e6;
+    ThreadPool pool;
+    printf("%ux%u, %u threads, best of %d\n\n", width, height, pool.Size(), runs);
+    printf("%-22s %10s %10s %9s %s\n", "encoder", "ms", "MPix/s", "KiB", "decode");
+
+    bool allOk = true;
+    auto report = [&](const char* name, double ms, const std::vector<uint8_t>& png, bool ok)
+    {
+        printf("%-22s %10.1f %10.1f %9zu %s\n", name, ms, megapixels / (ms / 1000.0), png.size() / 1024, ok ? "exact" : "MISMATCH");
+        allOk = allOk && ok;
+    };
+
+    static const char* LEVEL_NAMES[] = { "fastest", "fast", "default", "smallest" };
+    std::vector<uint8_t> png;
+    for (int level = 0; level < 4; ++level)
+    {
+        for (int threaded = 1; threaded >= 0; --threaded)
+        {
+            const PngOptions options = { static_cast<DeflateLevel>(level), false, 0 };
+            double best = 1e30;
+            for (int run = 0; run < runs; ++run)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                EncodePng(bgra.data(), ptrdiff_t(width) * 4, width, height, options, png, threaded ? &pool : nullptr);
+                best = std::min(best, MillisecondsSince(start));
+            }
+            const std::string name = std::string("png ") + LEVEL_NAMES[level] + (threaded ? " mt" : " 1t");
+            report(name.c_str(), best, png, Matches(png, bgra, width, height, false));
+        }
+    }
+
+    // RGBA output, and bottom-up input through a negative pitch
+    for (int bottomUp = 0; bottomUp < 2; ++bottomUp)
+    {
+        const PngOptions options = { DeflateLevel::Default, bottomUp == 0, 0 };
+        const uint8_t* first = bottomUp ? &bgra[size_t(height - 1) * width * 4] : bgra.data();
+        const ptrdiff_t pitch = bottomUp ? -ptrdiff_t(width) * 4 : ptrdiff_t(width) * 4;
+
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            EncodePng(first, pitch, width, height, options, png, &pool);
+            best = std::min(best, MillisecondsSince(start));
+        }
+        report(bottomUp ? "png default flip mt" : "png default rgba mt", best, png,
+               Matches(png, bgra, width, height, options.alpha, bottomUp != 0));
+    }
+
+    // Preview pyramid on top of the default level
+    {
+        const PngOptions options = { DeflateLevel::Default, false, 3 };
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            EncodePng(bgra.data(), ptrdiff_t(width) * 4, width, height, options, png, &pool);
+            best = std::min(best, MillisecondsSince(start));
+        }
+        report("png previews mt", best, png,
+               Matches(png, bgra, width, height, false) && PreviewsMatch(png, bgra, width, height, options.previews));
+    }
+
+    for (int level : { 1, 6, 9 })
+    {
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            ZlibPng(bgra, width, height, level, png);
+            best = std::min(best, MillisecondsSince(start));
+        }
+        const std::string name = "zlib level " + std::to_string(level);
+        report(name.c_str(), best, png, Matches(png, bgra, width, height, false));
+    }
+
+    // Burst formats read straight from a mapped texture, so give the rows some padding
+    const uint32_t mappedPitch = width * 4 + 256;
+    std::vector<uint8_t> mapped(size_t(mappedPitch) * height);
+    for (uint32_t y = 0; y < height; ++y)
+        memcpy(&mapped[size_t(y) * mappedPitch], &bgra[size_t(y) * width * 4], size_t(width) * 4);
+
+    std::vector<uint8_t> copy(bgra.size());
+    double best = 1e30;
+    for (int run = 0; run < runs; ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t y = 0; y < height; ++y)
+            memcpy(&copy[size_t(y) * width * 4], &mapped[size_t(y) * mappedPitch], size_t(width) * 4);
+        best = std::min(best, MillisecondsSince(start));
+    }
+    report("memcpy", best, copy, copy == bgra);
+
+    std::vector<uint8_t> qoi;
+    for (int alpha = 0; alpha < 2; ++alpha)
+    {
+        best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            EncodeQoi(mapped.data(), mappedPitch, width, height, alpha != 0, qoi);
+            best = std::min(best, MillisecondsSince(start));
+        }
+        report(alpha ? "qoi rgba" : "qoi", best, qoi, QoiMatches(qoi, bgra, width, height, alpha != 0));
+    }
+
+    const std::string rawPath = std::string(outPath ? outPath : "pngbench") + ".raw";
+    best = 1e30;
+    bool written = true;
+    for (int run = 0; run < runs; ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        written = WriteRawImage(rawPath.c_str(), mapped.data(), mappedPitch, width, height, false) && written;
+        best = std::min(best, MillisecondsSince(start));
+    }
+    std::vector<uint8_t> rawSize(sizeof(RAWIMAGE_HEADER) + size_t(mappedPitch) * (height - 1) + size_t(width) * 4);
+    report("raw write", best, rawSize, written && RawMatches(rawPath.c_str(), bgra, width, height, mappedPitch));
+    remove(rawPath.c_str());
+
+    if (outPath)
+    {
+        const PngOptions options = { DeflateLevel::Default, false, 0 };
+        EncodePng(bgra.data(), ptrdiff_t(width) * 4, width, height, options, png, &pool);
+        if (FILE* file = fopen(outPath, "wb"))
+        {
+            fwrite(png.data(), 1, png.size(), file);
+            fclose(file);
+        }
+    }
+
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,493 @@
+//-----------------------------------------------------------------------------
+// File: PngEncoder.cpp
+//
+// Row filtering, band compression and chunk layout for PNG output.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "PngEncoder.h"
+#include "Thumbnails.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define PNG_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const size_t BAND_BYTES = 512 * 1024;   // filtered bytes per band / IDAT chunk
+
+    enum PngFilter : uint8_t
+    {
+        FILTER_NONE  = 0,
+        FILTER_SUB   = 1,
+        FILTER_UP    = 2,
+        FILTER_AVG   = 3,
+        FILTER_PAETH = 4,
+    };
+
+    //-------------------------------------------------------------------------
+    // CRC-32, slicing by 8
+    //-------------------------------------------------------------------------
+    struct CrcTables
+    {
+        uint32_t table[8][256];
+
+        CrcTables()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                table[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (int slice = 1; slice < 8; ++slice)
+                    table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xff];
+            }
+        }
+    };
+
+    void PutBE32(uint8_t* p, uint32_t value)
+    {
+        p[0] = uint8_t(value >> 24);
+        p[1] = uint8_t(value >> 16);
+        p[2] = uint8_t(value >> 8);
+        p[3] = uint8_t(value);
+    }
+
+    uint32_t GetBE32(const uint8_t* p)
+    {
+        return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+    }
+
+    const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    // Private, ancillary and unsafe to copy: an editor that changes the pixels drops it
+    const char PREVIEW_CHUNK[4] = { 'p', 'r', 'V', 'W' };
+
+    // Appends a chunk with its length, type and CRC
+    void AppendChunk(std::vector<uint8_t>& png, const char* type, const uint8_t* data, uint32_t size)
+    {
+        uint8_t header[8];
+        PutBE32(header, size);
+        memcpy(header + 4, type, 4);
+        png.insert(png.end(), header, header + 8);
+        png.insert(png.end(), data, data + size);
+
+        uint8_t crc[4];
+        PutBE32(crc, Crc32(Crc32(0, header + 4, 4), data, size));
+        png.insert(png.end(), crc, crc + 4);
+    }
+
+    //-------------------------------------------------------------------------
+    // Filters
+    //-------------------------------------------------------------------------
+
+    // Rows are scored by the sum of their bytes taken as signed magnitudes, the
+    // usual heuristic: small residuals compress best
+    inline uint32_t Score(uint8_t value)
+    {
+        return value < 128 ? value : 256u - value;
+    }
+
+    inline uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c)
+    {
+        const int p = int(a) + int(b) - int(c);
+        const int pa = abs(p - int(a)), pb = abs(p - int(b)), pc = abs(p - int(c));
+        if (pa <= pb && pa <= pc)
+            return a;
+        return pb <= pc ? b : c;
+    }
+
+    template <int FILTER>
+    inline uint8_t Predict(uint8_t a, uint8_t b, uint8_t c)
+    {
+        switch (FILTER)
+        {
+        case FILTER_SUB:   return a;
+        case FILTER_UP:    return b;
+        case FILTER_AVG:   return uint8_t((uint32_t(a) + b) >> 1);
+        case FILTER_PAETH: return Paeth(a, b, c);
+        default:           return 0;
+        }
+    }
+
+#ifdef PNG_SSE2
+    inline __m128i Abs16(__m128i x)
+    {
+        return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+    }
+
+    // Paeth predictor on eight 16-bit lanes
+    inline __m128i Paeth16(__m128i a, __m128i b, __m128i c)
+    {
+        const __m128i pa = Abs16(_mm_sub_epi16(b, c));
+        const __m128i pb = Abs16(_mm_sub_epi16(a, c));
+        const __m128i pc = Abs16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+
+        const __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+        const __m128i useC = _mm_cmpgt_epi16(pb, pc);
+        const __m128i bc = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+        return _mm_or_si128(_mm_and_si128(notA, bc), _mm_andnot_si128(notA, a));
+    }
+
+    template <int FILTER>
+    inline __m128i Predict16(__m128i a, __m128i b, __m128i c)
+    {
+        switch (FILTER)
+        {
+        case FILTER_SUB:
+            return a;
+        case FILTER_UP:
+            return b;
+        case FILTER_AVG:
+            // pavgb rounds up; undo that where a + b is odd
+            return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+        case FILTER_PAETH:
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i lo = Paeth16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+            const __m128i hi = Paeth16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+            return _mm_packus_epi16(lo, hi);
+        }
+        default:
+            return _mm_setzero_si128();
+        }
+    }
+#endif
+
+    // Filters one row of `bytes` bytes into `out` and returns its score. `prev` is the
+    // unfiltered row above (zeros for the first row).
+    template <int FILTER>
+    uint64_t FilterRow(const uint8_t* cur, const uint8_t* prev, size_t bytes, size_t bpp, uint8_t* out)
+    {
+        uint64_t score = 0;
+        size_t i = 0;
+        for (; i < bpp && i < bytes; ++i)
+        {
+            out[i] = uint8_t(cur[i] - Predict<FILTER>(0, prev[i], 0));
+            score += Score(out[i]);
+        }
+
+#ifdef PNG_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sum = zero;
+        for (; i + 16 <= bytes; i += 16)
+        {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i - bpp));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i - bpp));
+            const __m128i v = _mm_sub_epi8(x, Predict16<FILTER>(a, b, c));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+
+            // |signed byte| is min(v, -v) taken unsigned
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_min_epu8(v, _mm_sub_epi8(zero, v)), zero));
+        }
+        score += uint32_t(_mm_cvtsi128_si32(sum)) + uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#endif
+
+        for (; i < bytes; ++i)
+        {
+            out[i] = uint8_t(cur[i] - Predict<FILTER>(cur[i - bpp], prev[i], prev[i - bpp]));
+            score += Score(out[i]);
+        }
+        return score;
+    }
+
+    typedef uint64_t (*FilterFunction)(const uint8_t*, const uint8_t*, size_t, size_t, uint8_t*);
+
+    const FilterFunction FILTERS[5] =
+    {
+        FilterRow<FILTER_NONE>, FilterRow<FILTER_SUB>, FilterRow<FILTER_UP>, FilterRow<FILTER_AVG>, FilterRow<FILTER_PAETH>,
+    };
+
+    void ConvertRow(const uint8_t* bgra, uint32_t width, bool alpha, uint8_t* out)
+    {
+        if (alpha)
+        {
+            for (uint32_t x = 0; x < width; ++x, bgra += 4, out += 4)
+            {
+                out[0] = bgra[2];
+                out[1] = bgra[1];
+                out[2] = bgra[0];
+                out[3] = bgra[3];
+            }
+        }
+        else
+        {
+            for (uint32_t x = 0; x < width; ++x, bgra += 4, out += 3)
+            {
+                out[0] = bgra[2];
+                out[1] = bgra[1];
+                out[2] = bgra[0];
+            }
+        }
+    }
+
+    struct Band
+    {
+        uint32_t             firstRow;
+        uint32_t             rows;
+        std::vector<uint8_t> chunk;     // complete IDAT chunk
+        uint32_t             adler;
+    };
+}
+
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    static const CrcTables tables;
+    const auto& t = tables.table;
+
+    crc = ~crc;
+    while (size >= 8)
+    {
+        const uint32_t lo = crc ^ (uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24);
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0)
+        crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+bool EncodePng(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, const PngOptions& options,
+               std::vector<uint8_t>& png, ThreadPool* pool)
+{
+    if (!bgra || width == 0 || height == 0 || width > 0x7fffffff || height > 0x7fffffff)
+        return false;
+
+    const size_t bpp = options.alpha ? 4 : 3;
+    const size_t lineBytes = size_t(width) * bpp + 1;
+    if (lineBytes / bpp < width || SIZE_MAX / lineBytes < height)
+        return false;
+
+    std::unique_ptr<uint8_t[]> filtered(new (std::nothrow) uint8_t[lineBytes * height]);
+    if (!filtered)
+        return false;
+
+    const uint32_t bandRows = uint32_t(std::max<size_t>(1, BAND_BYTES / lineBytes));
+    std::vector<Band> bands((height + bandRows - 1) / bandRows);
+    for (size_t i = 0; i < bands.size(); ++i)
+    {
+        bands[i].firstRow = uint32_t(i * bandRows);
+        bands[i].rows = std::min(bandRows, height - bands[i].firstRow);
+    }
+
+    auto forEachBand = [&](const std::function<void(size_t)>& body)
+    {
+        if (pool)
+            pool->ParallelFor(bands.size(), body);
+        else
+            for (size_t i = 0; i < bands.size(); ++i)
+                body(i);
+    };
+
+    // The fastest level only weighs the two filters that matter most for screen content
+    static const uint8_t ALL_FILTERS[] = { FILTER_NONE, FILTER_SUB, FILTER_UP, FILTER_AVG, FILTER_PAETH };
+    static const uint8_t QUICK_FILTERS[] = { FILTER_SUB, FILTER_UP };
+    const bool quick = options.level == DeflateLevel::Fastest;
+    const uint8_t* candidates = quick ? QUICK_FILTERS : ALL_FILTERS;
+    const size_t candidateCount = quick ? sizeof(QUICK_FILTERS) : sizeof(ALL_FILTERS);
+
+    // Filter
+    std::atomic<bool> ok(true);
+    forEachBand([&](size_t index)
+    {
+        const Band& band = bands[index];
+        const size_t rowBytes = lineBytes - 1;
+
+        std::vector<uint8_t> rows(2 * rowBytes), scratch(2 * rowBytes);
+        uint8_t* cur = rows.data();
+        uint8_t* prev = rows.data() + rowBytes;
+        uint8_t* trial = scratch.data();
+        uint8_t* best = scratch.data() + rowBytes;
+
+        if (band.firstRow > 0)
+            ConvertRow(bgra + ptrdiff_t(band.firstRow - 1) * pitch, width, options.alpha, prev);
+        else
+            memset(prev, 0, rowBytes);
+
+        for (uint32_t y = band.firstRow; y < band.firstRow + band.rows; ++y)
+        {
+            ConvertRow(bgra + ptrdiff_t(y) * pitch, width, options.alpha, cur);
+
+            uint8_t bestFilter = candidates[0];
+            uint64_t bestScore = FILTERS[bestFilter](cur, prev, rowBytes, bpp, best);
+            for (size_t i = 1; i < candidateCount; ++i)
+            {
+                const uint64_t score = FILTERS[candidates[i]](cur, prev, rowBytes, bpp, trial);
+                if (score < bestScore)
+                {
+                    bestScore = score;
+                    bestFilter = candidates[i];
+                    std::swap(trial, best);
+                }
+            }
+
+            uint8_t* line = filtered.get() + size_t(y) * lineBytes;
+            line[0] = bestFilter;
+            memcpy(line + 1, best, rowBytes);
+            std::swap(cur, prev);
+        }
+    });
+
+    // Compress; each band sees the end of the previous one as its dictionary
+    forEachBand([&](size_t index)
+    {
+        Band& band = bands[index];
+        const size_t start = size_t(band.firstRow) * lineBytes;
+        const size_t end = start + size_t(band.rows) * lineBytes;
+
+        band.chunk.clear();
+        band.chunk.reserve((end - start) / 4 + 64);
+        band.chunk.resize(8);
+        memcpy(band.chunk.data() + 4, "IDAT", 4);
+        if (index == 0)
+        {
+            uint8_t header[2];
+            DeflateZlibHeader(options.level, header);
+            band.chunk.insert(band.chunk.end(), header, header + 2);
+        }
+        DeflateCompress(filtered.get(), start, end, options.level, index + 1 == bands.size(), band.chunk);
+
+        const size_t size = band.chunk.size() - 8;
+        if (size > 0x7fffffff)
+        {
+            ok = false;
+            return;
+        }
+        PutBE32(band.chunk.data(), uint32_t(size));
+
+        uint8_t crc[4];
+        PutBE32(crc, Crc32(0, band.chunk.data() + 4, size + 4));
+        band.chunk.insert(band.chunk.end(), crc, crc + 4);
+
+        band.adler = Adler32(1, filtered.get() + start, end - start);
+    });
+
+    if (!ok)
+        return false;
+
+    // Previews, smallest first: 4-byte scale, then the preview's own PNG
+    std::vector<std::vector<uint8_t>> previews;
+    if (options.previews > 0)
+    {
+        std::vector<Thumbnail> thumbnails;
+        BuildThumbnails(bgra, pitch, width, height, options.previews, thumbnails, pool);
+
+        const PngOptions previewOptions = { DeflateLevel::Default, options.alpha, 0 };
+        for (auto thumb = thumbnails.rbegin(); thumb != thumbnails.rend(); ++thumb)
+        {
+            std::vector<uint8_t> preview(4);
+            PutBE32(preview.data(), thumb->scale);
+            std::vector<uint8_t> small;
+            if (!EncodePng(thumb->pixels.data(), ptrdiff_t(thumb->width) * 4, thumb->width, thumb->height, previewOptions, small))
+                return false;
+            preview.insert(preview.end(), small.begin(), small.end());
+            previews.push_back(std::move(preview));
+        }
+    }
+
+    // Assemble
+    png.assign(SIGNATURE, SIGNATURE + 8);
+
+    uint8_t ihdr[13];
+    PutBE32(ihdr, width);
+    PutBE32(ihdr + 4, height);
+    ihdr[8] = 8;                            // bit depth
+    ihdr[9] = options.alpha ? 6 : 2;        // RGBA : RGB
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;     // deflate, adaptive filtering, no interlace
+    AppendChunk(png, "IHDR", ihdr, sizeof(ihdr));
+
+    for (const std::vector<uint8_t>& preview : previews)
+        AppendChunk(png, PREVIEW_CHUNK, preview.data(), uint32_t(preview.size()));
+
+    uint32_t adler = 1;
+    for (const Band& band : bands)
+    {
+        png.insert(png.end(), band.chunk.begin(), band.chunk.end());
+        adler = Adler32Combine(adler, band.adler, size_t(band.rows) * lineBytes);
+    }
+
+    // The zlib trailer needs every band, so it gets a small IDAT of its own
+    uint8_t trailer[4];
+    PutBE32(trailer, adler);
+    AppendChunk(png, "IDAT", trailer, sizeof(trailer));
+    AppendChunk(png, "IEND", nullptr, 0);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Previews
+//-----------------------------------------------------------------------------
+size_t FindPngPreviews(const uint8_t* png, size_t size, std::vector<PngPreview>& previews)
+{
+    previews.clear();
+    if (!png || size < 8 || memcmp(png, SIGNATURE, 8) != 0)
+        return 0;
+
+    // Chunk by chunk up to the image data; a preview chunk that fails its CRC is skipped
+    size_t offset = 8;
+    for (;;)
+    {
+        if (size - offset < 8)
+            return offset + 8;
+
+        const uint32_t length = GetBE32(png + offset);
+        const uint8_t* type = png + offset + 4;
+        if (length > 0x7fffffff)
+            return 0;
+        if (memcmp(type, "IDAT", 4) == 0 || memcmp(type, "IEND", 4) == 0)
+            return offset;
+
+        const size_t end = offset + 12 + length;
+        if (end > size)
+            return end;
+
+        const uint8_t* data = type + 4;
+        if (memcmp(type, PREVIEW_CHUNK, 4) == 0 && length >= 4 + 8 + 25 &&
+            Crc32(0, type, length + 4) == GetBE32(data + length) &&
+            memcmp(data + 4, SIGNATURE, 8) == 0 && memcmp(data + 4 + 12, "IHDR", 4) == 0)
+        {
+            PngPreview preview;
+            preview.scale = GetBE32(data);
+            preview.width = GetBE32(data + 4 + 16);
+            preview.height = GetBE32(data + 4 + 20);
+            preview.png = data + 4;
+            preview.size = length - 4;
+            previews.push_back(preview);
+        }
+        offset = end;
+    }
+}
+
+const PngPreview* PickPngPreview(const std::vector<PngPreview>& previews, uint32_t width, uint32_t height)
+{
+    const PngPreview* best = nullptr;
+    for (const PngPreview& preview : previews)
+    {
+        const bool enough = preview.width >= width && preview.height >= height;
+        const bool bestEnough = best && best->width >= width && best->height >= height;
+        if (!best || (enough && (!bestEnough || preview.width < best->width)) || (!enough && !bestEnough && preview.width > best->width))
+            best = &preview;
+    }
+    return best;
+}
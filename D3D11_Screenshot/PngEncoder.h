@@ -0,0 +1,70 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: PngEncoder.h
+//
+// Portable PNG encoder for screenshots. The image is cut into bands of rows;
+// every band is filtered and deflated on its own thread and becomes one IDAT
+// chunk, so encoding scales with the cores of the machine while the output
+// stays a single standard zlib stream (see Deflate.h). Band boundaries don't
+// depend on the thread count, so the same image always gives the same file.
+//
+// A screenshot can carry its own preview pyramid (see Thumbnails.h): every
+// level is a small PNG of its own inside a private "prVW" chunk, smallest
+// first and in front of the image data. A gallery reads the start of the file
+// up to the first IDAT and never touches the full-size image; decoders that
+// don't know the chunk skip it.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "Deflate.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+struct PngOptions
+{
+    DeflateLevel level;
+    bool         alpha;     // write RGBA; otherwise the alpha channel is dropped and RGB is written
+    uint32_t     previews;  // preview levels to embed, 0 for none
+};
+
+// A preview found in a PNG, pointing into the file's bytes
+struct PngPreview
+{
+    uint32_t       width;
+    uint32_t       height;
+    uint32_t       scale;       // the image is `scale` times larger each way
+    const uint8_t* png;         // a complete PNG file
+    size_t         size;
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Encodes a top-down BGRA image (negative pitch for bottom-up) into `png`. Bands are
+// compressed on `pool` if given, otherwise on the calling thread.
+bool EncodePng(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, const PngOptions& options,
+               std::vector<uint8_t>& png, ThreadPool* pool = nullptr);
+
+// Collects the previews of a PNG, smallest first. `size` may cover only the start of the
+// file: returns how many bytes the previews take, so a result larger than `size` means
+// "read that much and call again". Returns 0 if the data isn't a PNG.
+size_t FindPngPreviews(const uint8_t* png, size_t size, std::vector<PngPreview>& previews);
+
+// The smallest preview at least `width` x `height`, or the largest one; null if there are none
+const PngPreview* PickPngPreview(const std::vector<PngPreview>& previews, uint32_t width, uint32_t height);
+
+// CRC-32 as used by PNG chunks; start with crc = 0
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size);
@@ -0,0 +1,155 @@
+//-----------------------------------------------------------------------------
+// File: QoiEncoder.cpp
+//
+// QOI chunk encoding straight from BGRA rows.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "QoiEncoder.h"
+
+#include <cstring>
+
+namespace
+{
+    const uint8_t QOI_OP_INDEX = 0x00;
+    const uint8_t QOI_OP_DIFF  = 0x40;
+    const uint8_t QOI_OP_LUMA  = 0x80;
+    const uint8_t QOI_OP_RUN   = 0xc0;
+    const uint8_t QOI_OP_RGB   = 0xfe;
+    const uint8_t QOI_OP_RGBA  = 0xff;
+
+    const uint32_t QOI_MAX_RUN = 62;
+    const size_t   QOI_HEADER_SIZE = 14;
+    const uint8_t  QOI_END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+    // Pixels stay in the little-endian BGRA word they were loaded as
+    inline uint32_t Blue(uint32_t px)  { return px & 0xff; }
+    inline uint32_t Green(uint32_t px) { return (px >> 8) & 0xff; }
+    inline uint32_t Red(uint32_t px)   { return (px >> 16) & 0xff; }
+    inline uint32_t Alpha(uint32_t px) { return px >> 24; }
+
+    inline uint32_t IndexOf(uint32_t px)
+    {
+        return (Red(px) * 3 + Green(px) * 5 + Blue(px) * 7 + Alpha(px) * 11) & 63;
+    }
+
+    inline uint8_t* PutBE32(uint8_t* p, uint32_t value)
+    {
+        p[0] = uint8_t(value >> 24);
+        p[1] = uint8_t(value >> 16);
+        p[2] = uint8_t(value >> 8);
+        p[3] = uint8_t(value);
+        return p + 4;
+    }
+}
+
+size_t QoiEncodeBound(uint32_t width, uint32_t height, bool alpha)
+{
+    // Worst case is a literal tag plus the channels for every pixel
+    return size_t(width) * height * (alpha ? 5 : 4) + QOI_HEADER_SIZE + sizeof(QOI_END_MARKER);
+}
+
+bool EncodeQoi(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, bool alpha,
+               std::vector<uint8_t>& qoi)
+{
+    if (!bgra || width == 0 || height == 0 || uint64_t(width) * height >= 400000000u)
+        return false;   // the limit the format specification sets for decoders
+
+    qoi.resize(QoiEncodeBound(width, height, alpha));
+    uint8_t* out = qoi.data();
+
+    memcpy(out, "qoif", 4);
+    out = PutBE32(out + 4, width);
+    out = PutBE32(out, height);
+    *out++ = alpha ? 4 : 3;
+    *out++ = 0;     // sRGB with linear alpha
+
+    const uint32_t alphaMask = alpha ? 0 : 0xff000000u;
+    uint32_t index[64] = {};
+    uint32_t prev = 0xff000000u;
+    uint32_t run = 0;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = bgra + ptrdiff_t(y) * pitch;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t px;
+            memcpy(&px, row + size_t(x) * 4, 4);
+            px |= alphaMask;
+
+            if (px == prev)
+            {
+                if (++run == QOI_MAX_RUN)
+                {
+                    *out++ = uint8_t(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                *out++ = uint8_t(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            const uint32_t slot = IndexOf(px);
+            if (index[slot] == px)
+            {
+                *out++ = uint8_t(QOI_OP_INDEX | slot);
+            }
+            else
+            {
+                index[slot] = px;
+                if (Alpha(px) == Alpha(prev))
+                {
+                    const int dr = int8_t(Red(px) - Red(prev));
+                    const int dg = int8_t(Green(px) - Green(prev));
+                    const int db = int8_t(Blue(px) - Blue(prev));
+                    const int drdg = dr - dg;
+                    const int dbdg = db - dg;
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        *out++ = uint8_t(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    }
+                    else if (drdg >= -8 && drdg <= 7 && dg >= -32 && dg <= 31 && dbdg >= -8 && dbdg <= 7)
+                    {
+                        *out++ = uint8_t(QOI_OP_LUMA | (dg + 32));
+                        *out++ = uint8_t((drdg + 8) << 4 | (dbdg + 8));
+                    }
+                    else
+                    {
+                        out[0] = QOI_OP_RGB;
+                        out[1] = uint8_t(Red(px));
+                        out[2] = uint8_t(Green(px));
+                        out[3] = uint8_t(Blue(px));
+                        out += 4;
+                    }
+                }
+                else
+                {
+                    out[0] = QOI_OP_RGBA;
+                    out[1] = uint8_t(Red(px));
+                    out[2] = uint8_t(Green(px));
+                    out[3] = uint8_t(Blue(px));
+                    out[4] = uint8_t(Alpha(px));
+                    out += 5;
+                }
+            }
+            prev = px;
+        }
+    }
+
+    if (run > 0)
+        *out++ = uint8_t(QOI_OP_RUN | (run - 1));
+
+    memcpy(out, QOI_END_MARKER, sizeof(QOI_END_MARKER));
+    out += sizeof(QOI_END_MARKER);
+    qoi.resize(size_t(out - qoi.data()));
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: QoiEncoder.h
+//
+// Single-pass lossless encoder for the QOI image format (qoiformat.org).
+// Every pixel becomes a run, a reference into a 64-entry table of recently
+// seen colours, a small difference to the previous pixel or the literal
+// colour, so encoding costs one pass over the frame with no search at all.
+// Meant for bursts of screenshots where even a fast PNG is too slow.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Largest QOI file for an image of this size
+size_t QoiEncodeBound(uint32_t width, uint32_t height, bool alpha);
+
+// Encodes a top-down BGRA image (negative pitch for bottom-up) into `qoi`, reusing its
+// capacity. Without `alpha` the alpha channel is dropped and a 3-channel file is written.
+bool EncodeQoi(const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, bool alpha,
+               std::vector<uint8_t>& qoi);
@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// File: RawImage.cpp
+//
+// Header plus mapped rows in a single write.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "RawImage.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    bool WriteAll(HANDLE file, const uint8_t* data, uint64_t size)
+    {
+        while (size > 0)
+        {
+            const DWORD chunk = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+            DWORD written = 0;
+            if (!WriteFile(file, data, chunk, &written, nullptr) || written == 0)
+                return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+#else
+    bool WriteAll(int fd, iovec* parts, int count)
+    {
+        // writev may stop anywhere, even inside the header
+        while (count > 0)
+        {
+            const ssize_t written = writev(fd, parts, count);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+
+            size_t left = size_t(written);
+            while (count > 0 && left >= parts->iov_len)
+            {
+                left -= parts->iov_len;
+                ++parts;
+                --count;
+            }
+            if (count > 0)
+            {
+                parts->iov_base = static_cast<uint8_t*>(parts->iov_base) + left;
+                parts->iov_len -= left;
+            }
+        }
+        return true;
+    }
+#endif
+}
+
+#ifdef _WIN32
+bool WriteRawImage(const wchar_t* path, const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, bool alpha)
+#else
+bool WriteRawImage(const char* path, const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, bool alpha)
+#endif
+{
+    const uint64_t rowPitch = pitch < 0 ? uint64_t(-pitch) : uint64_t(pitch);
+    if (!path || !bgra || width == 0 || height == 0 || rowPitch < uint64_t(width) * 4 || rowPitch > UINT32_MAX)
+        return false;
+
+    // Store the rows in address order, whichever way up the image is
+    const uint8_t* first = pitch < 0 ? bgra + pitch * ptrdiff_t(height - 1) : bgra;
+
+    RAWIMAGE_HEADER header = {};
+    header.magic = RAWIMAGE_MAGIC;
+    header.version = RAWIMAGE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.rowPitch = static_cast<uint32_t>(rowPitch);
+    header.flags = (pitch < 0 ? RAWIMAGE_FLAG_BOTTOM_UP : 0) | (alpha ? RAWIMAGE_FLAG_ALPHA : 0);
+    header.dataSize = rowPitch * (height - 1) + uint64_t(width) * 4;
+
+#ifdef _WIN32
+    // WriteFileGather only takes page-aligned unbuffered I/O, which the mapped rows are not,
+    // so the header goes in a separate call on the same handle
+    HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    bool ok = WriteAll(file, reinterpret_cast<const uint8_t*>(&header), sizeof(header)) &&
+              WriteAll(file, first, header.dataSize);
+    ok = CloseHandle(file) != FALSE && ok;
+    if (!ok)
+        DeleteFileW(path);
+#else
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    iovec parts[2];
+    parts[0].iov_base = &header;
+    parts[0].iov_len = sizeof(header);
+    parts[1].iov_base = const_cast<uint8_t*>(first);
+    parts[1].iov_len = size_t(header.dataSize);
+
+    bool ok = WriteAll(fd, parts, 2);
+    ok = close(fd) == 0 && ok;
+    if (!ok)
+        unlink(path);
+#endif
+    return ok;
+}
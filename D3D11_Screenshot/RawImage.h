@@ -0,0 +1,55 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: RawImage.h
+//
+// Uncompressed screenshot file: a 32-byte header followed by the BGRA rows
+// exactly as they sit in the mapped staging texture, row pitch included.
+// Header and pixels go out in one gather write, so saving costs little more
+// than the copy the kernel makes into the page cache. Row y of the image
+// starts at sizeof(RAWIMAGE_HEADER) + y * rowPitch.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+#define RAWIMAGE_MAGIC   0x49525254 // "TRRI"
+#define RAWIMAGE_VERSION 1
+
+#define RAWIMAGE_FLAG_BOTTOM_UP 0x00000001 // rows are stored last row first
+#define RAWIMAGE_FLAG_ALPHA     0x00000002 // the alpha channel carries data
+
+#pragma pack(push,1)
+
+struct RAWIMAGE_HEADER
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowPitch;     // bytes per row, 32-bit BGRA pixels
+    uint32_t flags;
+    uint64_t dataSize;     // rowPitch * (height - 1) + width * 4
+};
+
+#pragma pack(pop)
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Writes a top-down BGRA image (negative pitch for bottom-up) to `path`. The last
+// row is cut at the image width so nothing is read past the end of the mapping.
+#ifdef _WIN32
+bool WriteRawImage(const wchar_t* path, const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, bool alpha);
+#else
+bool WriteRawImage(const char* path, const uint8_t* bgra, ptrdiff_t pitch, uint32_t width, uint32_t height, bool alpha);
+#endif
@@ -0,0 +1,363 @@
+//-----------------------------------------------------------------------------
+// File: ReadbackBench.cpp
+//
+// Headless test and benchmark for ReadbackCache, not part of the application
+// build. A fake ReadbackDevice hands out counted textures and fences whose
+// completion the test controls. The test checks that a released slot is
+// reused, that the ring grows only while captures overlap, that the fifth
+// description evicts the least recently used idle ring, that a full ring makes
+// Acquire fail without creating anything, that multisampled rings share one
+// resolve target, that Wait blocks until the fence is completed from another
+// thread, and that nothing leaks. It then times capture cycles through the
+// cache, optionally with a GPU latency before each fence completes.
+//
+//   g++ -std=c++14 -O2 ReadbackBench.cpp ReadbackCache.cpp -pthread -o readbackbench
+//   ./readbackbench [cycles] [gpu latency us]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "ReadbackCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct FakeTexture
+    {
+        ReadbackKey key;
+        bool        resolve;
+    };
+
+    struct FakeFence
+    {
+        std::atomic<bool>     done;
+        std::atomic<uint32_t> signals;
+    };
+
+    // Counts every object it creates. Fences complete on Signal unless `manualFences`
+    // is set, then the test completes them with Complete().
+    class FakeDevice : public ReadbackDevice
+    {
+    public:
+        bool     manualFences = false;
+        bool     failStaging = false;
+        uint32_t createdStaging = 0, createdResolve = 0, createdFences = 0;
+        uint32_t liveTextures = 0, liveFences = 0, flushes = 0;
+
+        Texture CreateStaging(const ReadbackKey& key) override
+        {
+            if (failStaging)
+                return nullptr;
+            ++createdStaging;
+            ++liveTextures;
+            return new FakeTexture{ key, false };
+        }
+
+        Texture CreateResolveTarget(const ReadbackKey& key) override
+        {
+            ++createdResolve;
+            ++liveTextures;
+            return new FakeTexture{ key, true };
+        }
+
+        void ReleaseTexture(Texture texture) override
+        {
+            --liveTextures;
+            delete static_cast<FakeTexture*>(texture);
+        }
+
+        Fence CreateFence() override
+        {
+            ++createdFences;
+            ++liveFences;
+            FakeFence* fence = new FakeFence();
+            fence->done = true;
+            fence->signals = 0;
+            return fence;
+        }
+
+        void ReleaseFence(Fence fence) override
+        {
+            --liveFences;
+            delete static_cast<FakeFence*>(fence);
+        }
+
+        void Signal(Fence fence) override
+        {
+            FakeFence* f = static_cast<FakeFence*>(fence);
+            ++f->signals;
+            f->done = !manualFences;
+        }
+
+        bool IsSignaled(Fence fence, bool flush) override
+        {
+            flushes += flush ? 1 : 0;
+            return static_cast<FakeFence*>(fence)->done;
+        }
+
+        static void Complete(Fence fence) { static_cast<FakeFence*>(fence)->done = true; }
+    };
+
+    ReadbackKey Key(uint32_t width, uint32_t sampleCount = 1)
+    {
+        return ReadbackKey{ width, 1080, 1, 1, 87 /* DXGI_FORMAT_B8G8R8A8_UNORM */, sampleCount, 0 };
+    }
+
+    // One capture: acquire, copy, fence, wait, map, release
+    bool Capture(ReadbackCache& cache, const ReadbackKey& key, ReadbackDevice::Texture* staging = nullptr)
+    {
+        ReadbackSlot* slot = cache.Acquire(key);
+        if (!slot)
+            return false;
+        cache.Submit(slot);
+        cache.Wait(slot);
+        if (staging)
+            *staging = slot->staging;
+        cache.Release(slot);
+        return true;
+    }
+
+    bool Check(const char* name, bool ok)
+    {
+        printf("%-40s %s\n", name, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    //-------------------------------------------------------------------------
+    // Checks
+    //-------------------------------------------------------------------------
+
+    bool CheckReuse()
+    {
+        FakeDevice device;
+        ReadbackDevice::Texture first = nullptr, second = nullptr;
+        {
+            ReadbackCache cache(device);
+            bool ok = Capture(cache, Key(1920), &first) && Capture(cache, Key(1920), &second);
+            const ReadbackStats stats = cache.Stats();
+            ok = ok && first == second && stats.hits == 1 && stats.misses == 1 && device.createdStaging == 1 &&
+                 device.createdFences == 1 && stats.ready == 2 && stats.waits == 0;
+            if (!ok)
+                return Check("released slot is reused", false);
+        }
+        return Check("released slot is reused", device.liveTextures == 0 && device.liveFences == 0);
+    }
+
+    bool CheckGrowthAndFullRing()
+    {
+        FakeDevice device;
+        bool ok;
+        {
+            ReadbackCache cache(device, 3);
+
+            // Three overlapping captures grow the ring to three, the fourth finds it full
+            ReadbackSlot* a = cache.Acquire(Key(1920));
+            ReadbackSlot* b = cache.Acquire(Key(1920));
+            ReadbackSlot* c = cache.Acquire(Key(1920));
+            ReadbackSlot* d = cache.Acquire(Key(1920));
+            if (!a || !b || !c)
+                return Check("ring grows while captures overlap", false);
+            ok = !d && a->staging != b->staging && b->staging != c->staging && a->staging != c->staging &&
+                 device.createdStaging == 3 && cache.Stats().ringFull == 1 && cache.Stats().misses == 3;
+            ok = Check("ring grows while captures overlap", ok) && ok;
+
+            // The full ring creates nothing; the caller falls back to a one-off texture
+            const uint32_t created = device.createdStaging;
+            d = cache.Acquire(Key(1920));
+            bool full = !d && device.createdStaging == created && cache.Stats().ringFull == 2;
+
+            // Once one is released it comes back, without a new texture
+            ReadbackDevice::Texture freed = b->staging;
+            cache.Submit(b);
+            cache.Wait(b);
+            cache.Release(b);
+            d = cache.Acquire(Key(1920));
+            full = full && d && d->staging == freed && device.createdStaging == created && cache.Stats().hits == 1;
+            ok = Check("full ring fails without creating", full) && ok;
+
+            // Sequential captures after that stay on the existing textures
+            cache.Release(a);
+            cache.Release(c);
+            cache.Release(d);
+            for (int i = 0; i < 10; ++i)
+                ok = Capture(cache, Key(1920)) && ok;
+            ok = Check("no growth without overlap", device.createdStaging == created) && ok;
+        }
+        return ok && device.liveTextures == 0 && device.liveFences == 0;
+    }
+
+    bool CheckEviction()
+    {
+        FakeDevice device;
+        bool ok;
+        {
+            ReadbackCache cache(device, 3, 4);
+            ReadbackDevice::Texture first = nullptr, again = nullptr;
+            ok = Capture(cache, Key(640), &first) && Capture(cache, Key(800)) && Capture(cache, Key(1024)) &&
+                 Capture(cache, Key(1280));
+            ok = ok && device.liveTextures == 4 && cache.Stats().evictions == 0;
+
+            // 640 is touched again, so 800 is the least recently used when a fifth size arrives
+            ok = ok && Capture(cache, Key(640), &again) && again == first;
+            ok = ok && Capture(cache, Key(1920)) && cache.Stats().evictions == 1 && device.liveTextures == 4;
+            const uint64_t misses = cache.Stats().misses;
+            ok = ok && Capture(cache, Key(640)) && cache.Stats().misses == misses;          // still cached
+            ok = ok && Capture(cache, Key(800)) && cache.Stats().misses == misses + 1;      // evicted, made again
+            ok = ok && cache.Stats().evictions == 2;                                        // 1024 made room
+            ok = Check("LRU eviction after four descriptions", ok) && ok;
+
+            // Rings in use are never evicted; the cache goes over the limit instead
+            ReadbackSlot* held[4] = { cache.Acquire(Key(640)), cache.Acquire(Key(800)), cache.Acquire(Key(1280)),
+                                      cache.Acquire(Key(1920)) };
+            const uint64_t evictions = cache.Stats().evictions;
+            ReadbackSlot* extra = cache.Acquire(Key(2560));
+            bool busy = extra && cache.Stats().evictions == evictions;
+            for (ReadbackSlot* slot : held)
+            {
+                busy = busy && slot;
+                if (slot)
+                    cache.Release(slot);
+            }
+            if (extra)
+                cache.Release(extra);
+            ok = Check("busy rings are kept over the limit", busy) && ok;
+
+            cache.Clear();
+            ok = Check("Clear releases idle rings", device.liveTextures == 0 && device.liveFences == 0) && ok;
+        }
+        return ok;
+    }
+
+    bool CheckResolve()
+    {
+        FakeDevice device;
+        bool ok;
+        {
+            ReadbackCache cache(device, 3);
+            ReadbackSlot* a = cache.Acquire(Key(1920, 4));
+            ReadbackSlot* b = cache.Acquire(Key(1920, 4));
+            ReadbackSlot* single = cache.Acquire(Key(1920, 1));
+            ok = a && b && single && a->resolve && a->resolve == b->resolve && !single->resolve && device.createdResolve == 1;
+            if (a)
+                cache.Release(a);
+            if (b)
+                cache.Release(b);
+            if (single)
+                cache.Release(single);
+
+            // A failed creation leaves the slot free for the next try
+            device.failStaging = true;
+            ok = ok && !cache.Acquire(Key(3840)) && cache.Stats().misses == 4;
+            device.failStaging = false;
+            ok = ok && Capture(cache, Key(3840));
+        }
+        return Check("resolve target shared per ring", ok && device.liveTextures == 0 && device.liveFences == 0);
+    }
+
+    bool CheckWait()
+    {
+        FakeDevice device;
+        device.manualFences = true;
+        bool ok;
+        {
+            ReadbackCache cache(device);
+            ReadbackSlot* slot = cache.Acquire(Key(1920));
+            if (!slot)
+                return Check("Wait blocks until the fence completes", false);
+
+            // Not ready before the copy is fenced, then not until the GPU gets there
+            ok = cache.IsReady(slot);
+            cache.Submit(slot);
+            ok = ok && !cache.IsReady(slot);
+
+            const ReadbackDevice::Fence fence = slot->fence;
+            std::atomic<bool> completed(false);
+            std::thread gpu([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                completed = true;
+                FakeDevice::Complete(fence);
+            });
+            const auto start = std::chrono::steady_clock::now();
+            const uint32_t flushes = device.flushes;
+            cache.Wait(slot);
+            const double waited = MillisecondsSince(start);
+            ok = ok && completed && cache.IsReady(slot) && waited >= 40.0 && device.flushes == flushes + 1;
+            gpu.join();
+
+            const ReadbackStats stats = cache.Stats();
+            ok = ok && stats.waits == 1 && stats.ready == 0 && stats.maxWaitMs >= 40.0 && stats.totalWaitMs >= stats.maxWaitMs;
+            cache.Release(slot);
+
+            // A fence that is already done counts as ready and doesn't poll
+            slot = cache.Acquire(Key(1920));
+            ok = ok && slot;
+            if (slot)
+            {
+                cache.Submit(slot);
+                FakeDevice::Complete(slot->fence);
+                cache.Wait(slot);
+                ok = ok && cache.Stats().ready == 1 && cache.Stats().waits == 1;
+                cache.Release(slot);
+            }
+        }
+        return Check("Wait blocks until the fence completes", ok && device.liveTextures == 0 && device.liveFences == 0);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int cycles = argc > 1 ? std::max(1, atoi(argv[1])) : 200000;
+    const int latencyUs = argc > 2 ? atoi(argv[2]) : 0;
+
+    bool allOk = CheckReuse();
+    allOk = CheckGrowthAndFullRing() && allOk;
+    allOk = CheckEviction() && allOk;
+    allOk = CheckResolve() && allOk;
+    allOk = CheckWait() && allOk;
+
+    // Capture cycles through the cache, every fence completed `latencyUs` after the copy
+    // by a simulated GPU
+    FakeDevice device;
+    device.manualFences = latencyUs > 0;
+    double cachedMs = 0.0;
+    {
+        ReadbackCache cache(device);
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < cycles; ++i)
+        {
+            ReadbackSlot* slot = cache.Acquire(Key(1920));
+            cache.Submit(slot);
+            if (latencyUs > 0)
+            {
+                std::thread([fence = slot->fence, latencyUs]() {
+                    std::this_thread::sleep_for(std::chrono::microseconds(latencyUs));
+                    FakeDevice::Complete(fence);
+                }).detach();
+            }
+            cache.Wait(slot);
+            cache.Release(slot);
+        }
+        cachedMs = MillisecondsSince(start);
+        const ReadbackStats stats = cache.Stats();
+        printf("\n%d captures: %.3f us each, %llu hits, %llu misses, %llu waits, %.3f ms mean wait, %.3f ms max\n",
+               cycles, cachedMs * 1000.0 / cycles,
+               (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.waits,
+               stats.waits ? stats.totalWaitMs / stats.waits : 0.0, stats.maxWaitMs);
+    }
+
+    allOk = Check("nothing leaked", device.liveTextures == 0 && device.liveFences == 0) && allOk;
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+//-----------------------------------------------------------------------------
+// File: ReadbackCache.cpp
+//
+// Staging texture rings for GPU readback.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "ReadbackCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+bool ReadbackKey::operator==(const ReadbackKey& other) const
+{
+    return width == other.width && height == other.height && mipLevels == other.mipLevels &&
+           arraySize == other.arraySize && format == other.format && sampleCount == other.sampleCount &&
+           miscFlags == other.miscFlags;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+ReadbackCache::ReadbackCache(ReadbackDevice& device, uint32_t ringSize, uint32_t maxKeys) :
+    m_device(device), m_ringSize(std::max(ringSize, 1u)), m_maxKeys(std::max(maxKeys, 1u)),
+    m_useCounter(0), m_stats{}
+{
+}
+
+ReadbackCache::~ReadbackCache()
+{
+    for (auto& ring : m_rings)
+    {
+        assert(!InUse(*ring));
+        ReleaseRing(*ring);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Slots
+//-----------------------------------------------------------------------------
+ReadbackSlot* ReadbackCache::Acquire(const ReadbackKey& key)
+{
+    auto it = std::find_if(m_rings.begin(), m_rings.end(),
+                           [&](const std::unique_ptr<Ring>& ring) { return ring->key == key; });
+    if (it == m_rings.end())
+    {
+        while (m_rings.size() >= m_maxKeys)
+        {
+            const size_t count = m_rings.size();
+            Evict();
+            if (m_rings.size() == count)
+                break;      // everything is in use; go over the limit rather than fail
+        }
+
+        std::unique_ptr<Ring> ring(new Ring());
+        ring->key = key;
+        ring->slots.resize(m_ringSize, ReadbackSlot{});
+        ring->resolve = nullptr;
+        m_rings.push_back(std::move(ring));
+        it = m_rings.end() - 1;
+    }
+
+    Ring& ring = **it;
+    ring.lastUse = ++m_useCounter;
+
+    // Reuse a slot that already has its textures; only grow the ring when they are all in use
+    ReadbackSlot* slot = nullptr;
+    for (auto& candidate : ring.slots)
+    {
+        if (!candidate.busy && (!slot || (candidate.staging && !slot->staging)))
+            slot = &candidate;
+    }
+
+    if (!slot)
+    {
+        ++m_stats.ringFull;
+        return nullptr;
+    }
+
+    if (key.sampleCount > 1 && !ring.resolve)
+    {
+        ring.resolve = m_device.CreateResolveTarget(key);
+        if (!ring.resolve)
+            return nullptr;
+    }
+
+    if (slot->staging)
+    {
+        ++m_stats.hits;
+    }
+    else
+    {
+        ++m_stats.misses;
+        slot->staging = m_device.CreateStaging(key);
+        if (!slot->staging)
+            return nullptr;
+        slot->fence = m_device.CreateFence();
+    }
+
+    slot->resolve = ring.resolve;
+    slot->busy = true;
+    slot->submitted = false;
+    return slot;
+}
+
+void ReadbackCache::Submit(ReadbackSlot* slot)
+{
+    assert(slot && slot->busy);
+    if (slot->fence)
+        m_device.Signal(slot->fence);
+    slot->submitted = true;
+}
+
+bool ReadbackCache::IsReady(ReadbackSlot* slot)
+{
+    assert(slot && slot->busy);
+    return !slot->submitted || !slot->fence || m_device.IsSignaled(slot->fence, false);
+}
+
+void ReadbackCache::Wait(ReadbackSlot* slot)
+{
+    assert(slot && slot->busy);
+    if (!slot->submitted || !slot->fence || m_device.IsSignaled(slot->fence, true))
+    {
+        ++m_stats.ready;
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    while (!m_device.IsSignaled(slot->fence, false))
+        std::this_thread::yield();
+
+    const double waitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    ++m_stats.waits;
+    m_stats.totalWaitMs += waitMs;
+    m_stats.maxWaitMs = std::max(m_stats.maxWaitMs, waitMs);
+}
+
+void ReadbackCache::Release(ReadbackSlot* slot)
+{
+    assert(slot && slot->busy);
+    slot->busy = false;
+    slot->submitted = false;
+}
+
+//-----------------------------------------------------------------------------
+// Rings
+//-----------------------------------------------------------------------------
+void ReadbackCache::Clear()
+{
+    auto idle = std::stable_partition(m_rings.begin(), m_rings.end(),
+                                      [this](const std::unique_ptr<Ring>& ring) { return InUse(*ring); });
+    for (auto it = idle; it != m_rings.end(); ++it)
+        ReleaseRing(**it);
+    m_rings.erase(idle, m_rings.end());
+}
+
+bool ReadbackCache::InUse(const Ring& ring) const
+{
+    return std::any_of(ring.slots.begin(), ring.slots.end(), [](const ReadbackSlot& slot) { return slot.busy; });
+}
+
+void ReadbackCache::ReleaseRing(Ring& ring)
+{
+    for (auto& slot : ring.slots)
+    {
+        if (slot.staging)
+            m_device.ReleaseTexture(slot.staging);
+        if (slot.fence)
+            m_device.ReleaseFence(slot.fence);
+        slot = ReadbackSlot{};
+    }
+    if (ring.resolve)
+        m_device.ReleaseTexture(ring.resolve);
+    ring.resolve = nullptr;
+}
+
+// Drops the least recently used ring that isn't in use, if any
+void ReadbackCache::Evict()
+{
+    auto victim = m_rings.end();
+    for (auto it = m_rings.begin(); it != m_rings.end(); ++it)
+    {
+        if (!InUse(**it) && (victim == m_rings.end() || (*it)->lastUse < (*victim)->lastUse))
+            victim = it;
+    }
+
+    if (victim == m_rings.end())
+        return;
+
+    ReleaseRing(**victim);
+    m_rings.erase(victim);
+    ++m_stats.evictions;
+}
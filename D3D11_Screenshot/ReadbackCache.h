@@ -0,0 +1,141 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: ReadbackCache.h
+//
+// Keeps staging textures for GPU readback alive between captures. Textures
+// are grouped by description; each description gets a small ring of staging
+// textures, grown only as far as captures overlap, each with a fence that is
+// signalled after the copy into it, so the CPU only maps a texture once the
+// GPU is done with it. Multisampled sources additionally share one cached
+// resolve target per description.
+//
+// Everything API-specific goes through ReadbackDevice, so the cache itself has
+// no Direct3D dependency and can be driven by a fake device.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+// Everything that makes two staging textures interchangeable
+struct ReadbackKey
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t arraySize;
+    uint32_t format;
+    uint32_t sampleCount;       // of the source; staging textures are always single-sampled
+    uint32_t miscFlags;
+
+    bool operator==(const ReadbackKey& other) const;
+    bool operator!=(const ReadbackKey& other) const { return !(*this == other); }
+};
+
+class ReadbackDevice
+{
+public:
+    typedef void* Texture;
+    typedef void* Fence;
+
+    virtual ~ReadbackDevice() {}
+
+    // Both return nullptr on failure
+    virtual Texture CreateStaging(const ReadbackKey& key) = 0;          // CPU-readable, single-sampled
+    virtual Texture CreateResolveTarget(const ReadbackKey& key) = 0;    // GPU-only, single-sampled
+    virtual void    ReleaseTexture(Texture texture) = 0;
+
+    virtual Fence   CreateFence() = 0;
+    virtual void    ReleaseFence(Fence fence) = 0;
+    // Marks the end of everything submitted so far
+    virtual void    Signal(Fence fence) = 0;
+    // True once the GPU has passed the signal, or if it never will (device lost);
+    // `flush` kicks off pending work instead of only peeking
+    virtual bool    IsSignaled(Fence fence, bool flush) = 0;
+};
+
+struct ReadbackSlot
+{
+    ReadbackDevice::Texture staging;
+    ReadbackDevice::Texture resolve;    // shared by the ring; nullptr for single-sampled sources
+    ReadbackDevice::Fence   fence;      // nullptr if the device has none; Map then waits by itself
+    bool                    busy;       // between Acquire and Release
+    bool                    submitted;  // the copy has been fenced
+};
+
+struct ReadbackStats
+{
+    uint64_t hits;          // an existing staging texture was reused
+    uint64_t misses;        // a staging texture had to be created
+    uint64_t evictions;     // rings released to make room for a new description
+    uint64_t ringFull;      // Acquire found every slot of the ring in use
+    uint64_t ready;         // Wait found the copy already complete
+    uint64_t waits;         // Wait had to poll the fence
+    double   totalWaitMs;
+    double   maxWaitMs;
+};
+
+//-----------------------------------------------------------------------------
+// Class declarations
+//-----------------------------------------------------------------------------
+
+// Not thread-safe; callers serialise access together with the device context
+class ReadbackCache
+{
+public:
+    ReadbackCache(ReadbackDevice& device, uint32_t ringSize = 3, uint32_t maxKeys = 4);
+    ~ReadbackCache();
+
+    ReadbackCache(const ReadbackCache&) = delete;
+    ReadbackCache& operator=(const ReadbackCache&) = delete;
+
+    // A free slot for `key`, creating its textures on first use; nullptr if every slot
+    // of the ring is still in use or creation failed
+    ReadbackSlot* Acquire(const ReadbackKey& key);
+
+    // Call once the copy into `slot->staging` has been issued
+    void Submit(ReadbackSlot* slot);
+
+    // Whether `slot->staging` can be mapped without stalling
+    bool IsReady(ReadbackSlot* slot);
+
+    // Blocks until IsReady, flushing once and then yielding between polls
+    void Wait(ReadbackSlot* slot);
+
+    // Hands the slot back once the caller has unmapped the staging texture
+    void Release(ReadbackSlot* slot);
+
+    // Releases the textures of every ring that isn't in use
+    void Clear();
+
+    ReadbackStats Stats() const { return m_stats; }
+
+private:
+    struct Ring
+    {
+        ReadbackKey               key;
+        std::vector<ReadbackSlot> slots;    // never resized, so slot pointers stay valid
+        ReadbackDevice::Texture   resolve;
+        uint64_t                  lastUse;
+    };
+
+    bool InUse(const Ring& ring) const;
+    void ReleaseRing(Ring& ring);
+    void Evict();
+
+    ReadbackDevice&                    m_device;
+    uint32_t                           m_ringSize;
+    uint32_t                           m_maxKeys;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    uint64_t                           m_useCounter;
+    ReadbackStats                      m_stats;
+};
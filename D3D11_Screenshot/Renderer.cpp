@@ -8,6 +8,8 @@
 #include <wincodec.h>
 #include <string>
 #include <ctime>
+#include <algorithm>
+#include <thread>
 #include "ScreenGrab11.h"
 
 #include "PixelShader.h"
@@ -31,7 +33,7 @@ typedef struct _VERTEX
 //-----------------------------------------------------------------------------
 // Constructor
 //-----------------------------------------------------------------------------
-Renderer::Renderer() : m_prevTime(0), m_numberInSecond(1)
+Renderer::Renderer() : m_prevTime(0), m_numberInSecond(1), m_screenshotFormat(ScreenshotFormat::Png)
 {
 }
 
@@ -140,6 +142,16 @@ HRESULT Renderer::InitD3D(HWND hWnd)
     // Create shared texture
     CreateSharedSurf();
 
+    // Start the background screenshot writer; if it can't handle the desktop format,
+    // SaveToPng falls back to saving on the render thread. Repeats of an unchanged
+    // desktop are hard-linked to the earlier screenshot instead of encoded again.
+    D3D11_TEXTURE2D_DESC FrameDesc;
+    m_sharedSurf->GetDesc(&FrameDesc);
+    const UINT Workers = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+    m_screenshots.SetDedup(ScreenshotDedup::HardLink, L"./screenshots/duplicates.log");
+    m_screenshots.Start(m_device.Get(), m_context.Get(), FrameDesc, Workers, Workers + 2, ScreenshotDropPolicy::DropOldest,
+                        DeflateLevel::Fast);
+
     // Create render target view
     MakeRTV();
     assert(SUCCEEDED(hr));
@@ -340,7 +352,20 @@ void Renderer::SaveToPng()
         m_numberInSecond = 1;
         m_prevTime = currentTime;
     }
-    std::wstring fileName = L"./screenshots/SCREENSHOT_" + std::to_wstring(currentTime) + L"_" + std::to_wstring(m_numberInSecond) + L".PNG";
+    std::wstring fileName = L"./screenshots/SCREENSHOT_" + std::to_wstring(currentTime) + L"_" + std::to_wstring(m_numberInSecond);
+
+    // Hand the frame to the workers; a full queue drops a frame instead of stalling presentation
+    if (m_screenshots.IsRunning())
+    {
+        // A burst goes to one container named after its first frame
+        static const wchar_t* const Extensions[] = { L".PNG", L".QOI", L".RAW", L".JPG", L".BURST" };
+        fileName += Extensions[static_cast<int>(m_screenshotFormat)];
+        m_screenshots.Enqueue(m_sharedSurf.Get(), fileName, m_screenshotFormat);
+        return;
+    }
+
+    // The fallback only writes PNG
+    fileName += L".PNG";
 
     HRESULT hr = SaveWICTextureToFile(m_context.Get(), m_sharedSurf.Get(), GUID_ContainerFormatPng, fileName.c_str());
     assert(SUCCEEDED(hr));
@@ -420,4 +445,7 @@ Renderer::~Renderer()
     // ComPtr will clean up references for us. But be careful to release
     // references to anything you don't need whenever you call Flush or Trim.
     // As always, clean up your system (CPU) memory resources before exit.
+
+    // The capture cache holds references to the device
+    ClearCaptureCache();
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <dxgi1_2.h>
 #include <wrl.h>
 
+#include "ScreenshotService.h"
+
 //-----------------------------------------------------------------------------
 // Class declarations
 //-----------------------------------------------------------------------------
@@ -21,7 +23,9 @@ public:
     HRESULT InitD3D(HWND hWnd);
     bool GetFrame();
     void SaveToPng();
+    void SetScreenshotFormat(ScreenshotFormat format) { m_screenshotFormat = format; }
     void DrawFrame();
+    ScreenshotStats GetScreenshotStats() const { return m_screenshots.GetStats(); }
 
 private:
     void CreateSharedSurf();
@@ -47,4 +51,8 @@ private:
     Microsoft::WRL::ComPtr <IDXGIResource>            m_deskResource;
     time_t m_prevTime;
     UINT8 m_numberInSecond;
+    ScreenshotFormat m_screenshotFormat;
+
+    // Declared last so the workers stop before the device goes away
+    ScreenshotService m_screenshots;
 };
\ No newline at end of file
@@ -17,17 +17,29 @@
 
 // Does not capture 1D textures or 3D textures (volume maps)
 
-// Does not capture mipmap chains, only the top-most texture level is saved
+// DDS files get the full mip chain and every array item or cubemap face; WIC files
+// only get the top-most level of the first image in the array
 
-// For 2D array textures and cubemaps, it captures only the first image in the array
+// DDS files are streamed from the mapped staging texture, see DdsWriter.h
+
+// Integer formats that WIC would have to convert to 8-bit RGB or RGBA are converted
+// with PixelConvert instead, see PixelConvert.h
+
+// Staging textures (and resolve targets for MSAA sources) are kept per texture
+// description and reused by later captures, see ReadbackCache.h
 
 #include "ScreenGrab11.h"
+#include "DdsWriter.h"
+#include "DxgiFormat.h"
+#include "PixelConvert.h"
+#include "ReadbackCache.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstring>
 #include <memory>
+#include <mutex>
 #include <new>
 #include <tuple>
 
@@ -53,160 +65,8 @@
 
 using Microsoft::WRL::ComPtr;
 
-//--------------------------------------------------------------------------------------
-// Macros
-//--------------------------------------------------------------------------------------
-#ifndef MAKEFOURCC
-#define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
-                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
-                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
-#endif /* defined(MAKEFOURCC) */
-
-//--------------------------------------------------------------------------------------
-// DDS file structure definitions
-//
-// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
-//--------------------------------------------------------------------------------------
 namespace
 {
-#pragma pack(push,1)
-
-#define DDS_MAGIC 0x20534444 // "DDS "
-
-    struct DDS_PIXELFORMAT
-    {
-        uint32_t    size;
-        uint32_t    flags;
-        uint32_t    fourCC;
-        uint32_t    RGBBitCount;
-        uint32_t    RBitMask;
-        uint32_t    GBitMask;
-        uint32_t    BBitMask;
-        uint32_t    ABitMask;
-    };
-
-#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
-#define DDS_RGB         0x00000040  // DDPF_RGB
-#define DDS_RGBA        0x00000041  // DDPF_RGB | DDPF_ALPHAPIXELS
-#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
-#define DDS_LUMINANCEA  0x00020001  // DDPF_LUMINANCE | DDPF_ALPHAPIXELS
-#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
-#define DDS_BUMPDUDV    0x00080000  // DDPF_BUMPDUDV
-
-#define DDS_HEADER_FLAGS_TEXTURE        0x00001007  // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
-#define DDS_HEADER_FLAGS_MIPMAP         0x00020000  // DDSD_MIPMAPCOUNT
-#define DDS_HEADER_FLAGS_PITCH          0x00000008  // DDSD_PITCH
-#define DDS_HEADER_FLAGS_LINEARSIZE     0x00080000  // DDSD_LINEARSIZE
-
-#define DDS_SURFACE_FLAGS_TEXTURE 0x00001000 // DDSCAPS_TEXTURE
-
-    struct DDS_HEADER
-    {
-        uint32_t        size;
-        uint32_t        flags;
-        uint32_t        height;
-        uint32_t        width;
-        uint32_t        pitchOrLinearSize;
-        uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
-        uint32_t        mipMapCount;
-        uint32_t        reserved1[11];
-        DDS_PIXELFORMAT ddspf;
-        uint32_t        caps;
-        uint32_t        caps2;
-        uint32_t        caps3;
-        uint32_t        caps4;
-        uint32_t        reserved2;
-    };
-
-    struct DDS_HEADER_DXT10
-    {
-        DXGI_FORMAT     dxgiFormat;
-        uint32_t        resourceDimension;
-        uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
-        uint32_t        arraySize;
-        uint32_t        reserved;
-    };
-
-#pragma pack(pop)
-
-    const DDS_PIXELFORMAT DDSPF_DXT1 =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('D','X','T','1'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_DXT3 =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('D','X','T','3'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_DXT5 =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('D','X','T','5'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_BC4_UNORM =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('B','C','4','U'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_BC4_SNORM =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('B','C','4','S'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_BC5_UNORM =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('B','C','5','U'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_BC5_SNORM =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('B','C','5','S'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_R8G8_B8G8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('R','G','B','G'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_G8R8_G8B8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('G','R','G','B'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_YUY2 =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('Y','U','Y','2'), 0, 0, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_A8R8G8B8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_RGBA, 0, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 };
-
-    const DDS_PIXELFORMAT DDSPF_X8R8G8B8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_RGB,  0, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_A8B8G8R8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_RGBA, 0, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 };
-
-    const DDS_PIXELFORMAT DDSPF_G16R16 =
-    { sizeof(DDS_PIXELFORMAT), DDS_RGB,  0, 32, 0x0000ffff, 0xffff0000, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_R5G6B5 =
-    { sizeof(DDS_PIXELFORMAT), DDS_RGB, 0, 16, 0xf800, 0x07e0, 0x001f, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_A1R5G5B5 =
-    { sizeof(DDS_PIXELFORMAT), DDS_RGBA, 0, 16, 0x7c00, 0x03e0, 0x001f, 0x8000 };
-
-    const DDS_PIXELFORMAT DDSPF_A4R4G4B4 =
-    { sizeof(DDS_PIXELFORMAT), DDS_RGBA, 0, 16, 0x0f00, 0x00f0, 0x000f, 0xf000 };
-
-    const DDS_PIXELFORMAT DDSPF_L8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_LUMINANCE, 0,  8, 0xff, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_L16 =
-    { sizeof(DDS_PIXELFORMAT), DDS_LUMINANCE, 0, 16, 0xffff, 0, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_A8L8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_LUMINANCEA, 0, 16, 0x00ff, 0, 0, 0xff00 };
-
-    const DDS_PIXELFORMAT DDSPF_A8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_ALPHA, 0, 8, 0, 0, 0, 0xff };
-
-    const DDS_PIXELFORMAT DDSPF_V8U8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_BUMPDUDV, 0, 16, 0x00ff, 0xff00, 0, 0 };
-
-    const DDS_PIXELFORMAT DDSPF_Q8W8V8U8 =
-    { sizeof(DDS_PIXELFORMAT), DDS_BUMPDUDV, 0, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 };
-
-    const DDS_PIXELFORMAT DDSPF_V16U16 =
-    { sizeof(DDS_PIXELFORMAT), DDS_BUMPDUDV, 0, 32, 0x0000ffff, 0xffff0000, 0, 0 };
-
-    // DXGI_FORMAT_R10G10B10A2_UNORM should be written using DX10 extension to avoid D3DX 10:10:10:2 reversal issue
-
-    // This indicates the DDS_HEADER_DXT10 extension is present (the format is in dxgiFormat)
-    const DDS_PIXELFORMAT DDSPF_DX10 =
-    { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, MAKEFOURCC('D','X','1','0'), 0, 0, 0, 0, 0 };
-
     //-----------------------------------------------------------------------------
     struct handle_closer { void operator()(HANDLE h) noexcept { if (h) CloseHandle(h); } };
 
@@ -267,366 +127,239 @@ namespace
     };
 
     //--------------------------------------------------------------------------------------
-    // Return the BPP for a particular format
+    // Get surface information for a particular format, see DxgiFormat.h
     //--------------------------------------------------------------------------------------
-    size_t BitsPerPixel(_In_ DXGI_FORMAT fmt) noexcept
+    HRESULT GetSurfaceInfo(
+        _In_ size_t width,
+        _In_ size_t height,
+        _In_ DXGI_FORMAT fmt,
+        _Out_opt_ size_t* outNumBytes,
+        _Out_opt_ size_t* outRowBytes,
+        _Out_opt_ size_t* outNumRows) noexcept
     {
-        switch (fmt)
-        {
-        case DXGI_FORMAT_R32G32B32A32_TYPELESS:
-        case DXGI_FORMAT_R32G32B32A32_FLOAT:
-        case DXGI_FORMAT_R32G32B32A32_UINT:
-        case DXGI_FORMAT_R32G32B32A32_SINT:
-            return 128;
-
-        case DXGI_FORMAT_R32G32B32_TYPELESS:
-        case DXGI_FORMAT_R32G32B32_FLOAT:
-        case DXGI_FORMAT_R32G32B32_UINT:
-        case DXGI_FORMAT_R32G32B32_SINT:
-            return 96;
+        const DxgiSurfaceSize size = GetDxgiSurfaceSize(fmt, width, height);
+        if (GetDxgiFormatInfo(fmt).layout == DxgiLayout::None)
+            return E_INVALIDARG;
 
-        case DXGI_FORMAT_R16G16B16A16_TYPELESS:
-        case DXGI_FORMAT_R16G16B16A16_FLOAT:
-        case DXGI_FORMAT_R16G16B16A16_UNORM:
-        case DXGI_FORMAT_R16G16B16A16_UINT:
-        case DXGI_FORMAT_R16G16B16A16_SNORM:
-        case DXGI_FORMAT_R16G16B16A16_SINT:
-        case DXGI_FORMAT_R32G32_TYPELESS:
-        case DXGI_FORMAT_R32G32_FLOAT:
-        case DXGI_FORMAT_R32G32_UINT:
-        case DXGI_FORMAT_R32G32_SINT:
-        case DXGI_FORMAT_R32G8X24_TYPELESS:
-        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
-        case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
-        case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
-        case DXGI_FORMAT_Y416:
-        case DXGI_FORMAT_Y210:
-        case DXGI_FORMAT_Y216:
-            return 64;
-
-        case DXGI_FORMAT_R10G10B10A2_TYPELESS:
-        case DXGI_FORMAT_R10G10B10A2_UNORM:
-        case DXGI_FORMAT_R10G10B10A2_UINT:
-        case DXGI_FORMAT_R11G11B10_FLOAT:
-        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
-        case DXGI_FORMAT_R8G8B8A8_UNORM:
-        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-        case DXGI_FORMAT_R8G8B8A8_UINT:
-        case DXGI_FORMAT_R8G8B8A8_SNORM:
-        case DXGI_FORMAT_R8G8B8A8_SINT:
-        case DXGI_FORMAT_R16G16_TYPELESS:
-        case DXGI_FORMAT_R16G16_FLOAT:
-        case DXGI_FORMAT_R16G16_UNORM:
-        case DXGI_FORMAT_R16G16_UINT:
-        case DXGI_FORMAT_R16G16_SNORM:
-        case DXGI_FORMAT_R16G16_SINT:
-        case DXGI_FORMAT_R32_TYPELESS:
-        case DXGI_FORMAT_D32_FLOAT:
-        case DXGI_FORMAT_R32_FLOAT:
-        case DXGI_FORMAT_R32_UINT:
-        case DXGI_FORMAT_R32_SINT:
-        case DXGI_FORMAT_R24G8_TYPELESS:
-        case DXGI_FORMAT_D24_UNORM_S8_UINT:
-        case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
-        case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
-        case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
-        case DXGI_FORMAT_R8G8_B8G8_UNORM:
-        case DXGI_FORMAT_G8R8_G8B8_UNORM:
-        case DXGI_FORMAT_B8G8R8A8_UNORM:
-        case DXGI_FORMAT_B8G8R8X8_UNORM:
-        case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
-        case DXGI_FORMAT_B8G8R8A8_TYPELESS:
-        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-        case DXGI_FORMAT_B8G8R8X8_TYPELESS:
-        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
-        case DXGI_FORMAT_AYUV:
-        case DXGI_FORMAT_Y410:
-        case DXGI_FORMAT_YUY2:
-            return 32;
-
-        case DXGI_FORMAT_P010:
-        case DXGI_FORMAT_P016:
-            return 24;
-
-        case DXGI_FORMAT_R8G8_TYPELESS:
-        case DXGI_FORMAT_R8G8_UNORM:
-        case DXGI_FORMAT_R8G8_UINT:
-        case DXGI_FORMAT_R8G8_SNORM:
-        case DXGI_FORMAT_R8G8_SINT:
-        case DXGI_FORMAT_R16_TYPELESS:
-        case DXGI_FORMAT_R16_FLOAT:
-        case DXGI_FORMAT_D16_UNORM:
-        case DXGI_FORMAT_R16_UNORM:
-        case DXGI_FORMAT_R16_UINT:
-        case DXGI_FORMAT_R16_SNORM:
-        case DXGI_FORMAT_R16_SINT:
-        case DXGI_FORMAT_B5G6R5_UNORM:
-        case DXGI_FORMAT_B5G5R5A1_UNORM:
-        case DXGI_FORMAT_A8P8:
-        case DXGI_FORMAT_B4G4R4A4_UNORM:
-            return 16;
-
-        case DXGI_FORMAT_NV12:
-        case DXGI_FORMAT_420_OPAQUE:
-        case DXGI_FORMAT_NV11:
-            return 12;
-
-        case DXGI_FORMAT_R8_TYPELESS:
-        case DXGI_FORMAT_R8_UNORM:
-        case DXGI_FORMAT_R8_UINT:
-        case DXGI_FORMAT_R8_SNORM:
-        case DXGI_FORMAT_R8_SINT:
-        case DXGI_FORMAT_A8_UNORM:
-        case DXGI_FORMAT_BC2_TYPELESS:
-        case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
-        case DXGI_FORMAT_BC3_TYPELESS:
-        case DXGI_FORMAT_BC3_UNORM:
-        case DXGI_FORMAT_BC3_UNORM_SRGB:
-        case DXGI_FORMAT_BC5_TYPELESS:
-        case DXGI_FORMAT_BC5_UNORM:
-        case DXGI_FORMAT_BC5_SNORM:
-        case DXGI_FORMAT_BC6H_TYPELESS:
-        case DXGI_FORMAT_BC6H_UF16:
-        case DXGI_FORMAT_BC6H_SF16:
-        case DXGI_FORMAT_BC7_TYPELESS:
-        case DXGI_FORMAT_BC7_UNORM:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-        case DXGI_FORMAT_AI44:
-        case DXGI_FORMAT_IA44:
-        case DXGI_FORMAT_P8:
-            return 8;
-
-        case DXGI_FORMAT_R1_UNORM:
-            return 1;
-
-        case DXGI_FORMAT_BC1_TYPELESS:
-        case DXGI_FORMAT_BC1_UNORM:
-        case DXGI_FORMAT_BC1_UNORM_SRGB:
-        case DXGI_FORMAT_BC4_TYPELESS:
-        case DXGI_FORMAT_BC4_UNORM:
-        case DXGI_FORMAT_BC4_SNORM:
-            return 4;
+#if defined(_M_IX86) || defined(_M_ARM) || defined(_M_HYBRID_X86_ARM64)
+        static_assert(sizeof(size_t) == 4, "Not a 32-bit platform!");
+        if (size.totalBytes > UINT32_MAX || size.rowBytes > UINT32_MAX || size.rowCount > UINT32_MAX)
+            return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+#else
+        static_assert(sizeof(size_t) == 8, "Not a 64-bit platform!");
+#endif
 
-        default:
-            return 0;
+        if (outNumBytes)
+        {
+            *outNumBytes = static_cast<size_t>(size.totalBytes);
         }
-    }
-
-
-    //--------------------------------------------------------------------------------------
-    // Determines if the format is block compressed
-    //--------------------------------------------------------------------------------------
-    bool IsCompressed(_In_ DXGI_FORMAT fmt) noexcept
-    {
-        switch (fmt)
+        if (outRowBytes)
         {
-        case DXGI_FORMAT_BC1_TYPELESS:
-        case DXGI_FORMAT_BC1_UNORM:
-        case DXGI_FORMAT_BC1_UNORM_SRGB:
-        case DXGI_FORMAT_BC2_TYPELESS:
-        case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
-        case DXGI_FORMAT_BC3_TYPELESS:
-        case DXGI_FORMAT_BC3_UNORM:
-        case DXGI_FORMAT_BC3_UNORM_SRGB:
-        case DXGI_FORMAT_BC4_TYPELESS:
-        case DXGI_FORMAT_BC4_UNORM:
-        case DXGI_FORMAT_BC4_SNORM:
-        case DXGI_FORMAT_BC5_TYPELESS:
-        case DXGI_FORMAT_BC5_UNORM:
-        case DXGI_FORMAT_BC5_SNORM:
-        case DXGI_FORMAT_BC6H_TYPELESS:
-        case DXGI_FORMAT_BC6H_UF16:
-        case DXGI_FORMAT_BC6H_SF16:
-        case DXGI_FORMAT_BC7_TYPELESS:
-        case DXGI_FORMAT_BC7_UNORM:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-            return true;
-
-        default:
-            return false;
+            *outRowBytes = static_cast<size_t>(size.rowBytes);
         }
+        if (outNumRows)
+        {
+            *outNumRows = static_cast<size_t>(size.rowCount);
+        }
+
+        return S_OK;
     }
 
 
     //--------------------------------------------------------------------------------------
-    // Get surface information for a particular format
+    // Staging textures reused across captures
     //--------------------------------------------------------------------------------------
-    HRESULT GetSurfaceInfo(
-        _In_ size_t width,
-        _In_ size_t height,
-        _In_ DXGI_FORMAT fmt,
-        _Out_opt_ size_t* outNumBytes,
-        _Out_opt_ size_t* outRowBytes,
-        _Out_opt_ size_t* outNumRows) noexcept
+    class D3D11ReadbackDevice : public ReadbackDevice
     {
-        uint64_t numBytes = 0;
-        uint64_t rowBytes = 0;
-        uint64_t numRows = 0;
-
-        bool bc = false;
-        bool packed = false;
-        bool planar = false;
-        size_t bpe = 0;
-        switch (fmt)
+    public:
+        explicit D3D11ReadbackDevice(_In_ ID3D11Device* device) noexcept : m_device(device)
         {
-        case DXGI_FORMAT_BC1_TYPELESS:
-        case DXGI_FORMAT_BC1_UNORM:
-        case DXGI_FORMAT_BC1_UNORM_SRGB:
-        case DXGI_FORMAT_BC4_TYPELESS:
-        case DXGI_FORMAT_BC4_UNORM:
-        case DXGI_FORMAT_BC4_SNORM:
-            bc = true;
-            bpe = 8;
-            break;
-
-        case DXGI_FORMAT_BC2_TYPELESS:
-        case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
-        case DXGI_FORMAT_BC3_TYPELESS:
-        case DXGI_FORMAT_BC3_UNORM:
-        case DXGI_FORMAT_BC3_UNORM_SRGB:
-        case DXGI_FORMAT_BC5_TYPELESS:
-        case DXGI_FORMAT_BC5_UNORM:
-        case DXGI_FORMAT_BC5_SNORM:
-        case DXGI_FORMAT_BC6H_TYPELESS:
-        case DXGI_FORMAT_BC6H_UF16:
-        case DXGI_FORMAT_BC6H_SF16:
-        case DXGI_FORMAT_BC7_TYPELESS:
-        case DXGI_FORMAT_BC7_UNORM:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-            bc = true;
-            bpe = 16;
-            break;
-
-        case DXGI_FORMAT_R8G8_B8G8_UNORM:
-        case DXGI_FORMAT_G8R8_G8B8_UNORM:
-        case DXGI_FORMAT_YUY2:
-            packed = true;
-            bpe = 4;
-            break;
+            device->GetImmediateContext(m_context.GetAddressOf());
+        }
 
-        case DXGI_FORMAT_Y210:
-        case DXGI_FORMAT_Y216:
-            packed = true;
-            bpe = 8;
-            break;
+        ID3D11Device* GetDevice() const noexcept { return m_device.Get(); }
 
-        case DXGI_FORMAT_NV12:
-        case DXGI_FORMAT_420_OPAQUE:
-            planar = true;
-            bpe = 2;
-            break;
+        Texture CreateStaging(const ReadbackKey& key) override
+        {
+            D3D11_TEXTURE2D_DESC desc = Describe(key);
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            desc.Usage = D3D11_USAGE_STAGING;
+            return Create(desc);
+        }
 
-        case DXGI_FORMAT_P010:
-        case DXGI_FORMAT_P016:
-            planar = true;
-            bpe = 4;
-            break;
+        Texture CreateResolveTarget(const ReadbackKey& key) override
+        {
+            D3D11_TEXTURE2D_DESC desc = Describe(key);
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            return Create(desc);
+        }
 
-        default:
-            break;
+        void ReleaseTexture(Texture texture) override
+        {
+            static_cast<ID3D11Texture2D*>(texture)->Release();
         }
 
-        if (bc)
+        // Event queries are the D3D11 fence: GetData succeeds once the GPU has passed End
+        Fence CreateFence() override
         {
-            uint64_t numBlocksWide = 0;
-            if (width > 0)
-            {
-                numBlocksWide = std::max<uint64_t>(1u, (uint64_t(width) + 3u) / 4u);
-            }
-            uint64_t numBlocksHigh = 0;
-            if (height > 0)
-            {
-                numBlocksHigh = std::max<uint64_t>(1u, (uint64_t(height) + 3u) / 4u);
-            }
-            rowBytes = numBlocksWide * bpe;
-            numRows = numBlocksHigh;
-            numBytes = rowBytes * numBlocksHigh;
+            D3D11_QUERY_DESC desc = { D3D11_QUERY_EVENT, 0 };
+            ComPtr<ID3D11Query> query;
+            if (FAILED(m_device->CreateQuery(&desc, query.GetAddressOf())))
+                return nullptr;
+            return query.Detach();
         }
-        else if (packed)
+
+        void ReleaseFence(Fence fence) override
         {
-            rowBytes = ((uint64_t(width) + 1u) >> 1) * bpe;
-            numRows = uint64_t(height);
-            numBytes = rowBytes * height;
+            static_cast<ID3D11Query*>(fence)->Release();
         }
-        else if (fmt == DXGI_FORMAT_NV11)
+
+        void Signal(Fence fence) override
         {
-            rowBytes = ((uint64_t(width) + 3u) >> 2) * 4u;
-            numRows = uint64_t(height) * 2u; // Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data
-            numBytes = rowBytes * numRows;
+            m_context->End(static_cast<ID3D11Query*>(fence));
         }
-        else if (planar)
+
+        bool IsSignaled(Fence fence, bool flush) override
         {
-            rowBytes = ((uint64_t(width) + 1u) >> 1) * bpe;
-            numBytes = (rowBytes * uint64_t(height)) + ((rowBytes * uint64_t(height) + 1u) >> 1);
-            numRows = height + ((uint64_t(height) + 1u) >> 1);
+            const HRESULT hr = m_context->GetData(static_cast<ID3D11Query*>(fence), nullptr, 0,
+                flush ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+            return hr != S_FALSE;   // errors are left for Map to report
         }
-        else
+
+    private:
+        static D3D11_TEXTURE2D_DESC Describe(const ReadbackKey& key) noexcept
         {
-            const size_t bpp = BitsPerPixel(fmt);
-            if (!bpp)
-                return E_INVALIDARG;
+            D3D11_TEXTURE2D_DESC desc = {};
+            desc.Width = key.width;
+            desc.Height = key.height;
+            desc.MipLevels = key.mipLevels;
+            desc.ArraySize = key.arraySize;
+            desc.Format = static_cast<DXGI_FORMAT>(key.format);
+            desc.SampleDesc.Count = 1;
+            desc.MiscFlags = key.miscFlags;
+            return desc;
+        }
 
-            rowBytes = (uint64_t(width) * bpp + 7u) / 8u; // round up to nearest byte
-            numRows = uint64_t(height);
-            numBytes = rowBytes * height;
+        Texture Create(const D3D11_TEXTURE2D_DESC& desc)
+        {
+            ComPtr<ID3D11Texture2D> texture;
+            if (FAILED(m_device->CreateTexture2D(&desc, nullptr, texture.GetAddressOf())))
+                return nullptr;
+            return texture.Detach();
         }
 
-#if defined(_M_IX86) || defined(_M_ARM) || defined(_M_HYBRID_X86_ARM64)
-        static_assert(sizeof(size_t) == 4, "Not a 32-bit platform!");
-        if (numBytes > UINT32_MAX || rowBytes > UINT32_MAX || numRows > UINT32_MAX)
-            return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
-#else
-        static_assert(sizeof(size_t) == 8, "Not a 64-bit platform!");
-#endif
+        ComPtr<ID3D11Device>        m_device;
+        ComPtr<ID3D11DeviceContext> m_context;
+    };
 
-        if (outNumBytes)
+    struct CaptureCache
+    {
+        explicit CaptureCache(_In_ ID3D11Device* device) : readbackDevice(device), cache(readbackDevice) {}
+
+        std::mutex          lock;
+        D3D11ReadbackDevice readbackDevice;
+        ReadbackCache       cache;
+    };
+
+    // One cache for the device that captured last; a new device replaces it
+    std::mutex g_captureCacheLock;
+    std::shared_ptr<CaptureCache> g_captureCache;
+
+    std::shared_ptr<CaptureCache> GetCaptureCache(_In_ ID3D11Device* device) noexcept
+    {
+        std::lock_guard<std::mutex> lock(g_captureCacheLock);
+        if (!g_captureCache || g_captureCache->readbackDevice.GetDevice() != device)
         {
-            *outNumBytes = static_cast<size_t>(numBytes);
+            try
+            {
+                g_captureCache = std::make_shared<CaptureCache>(device);
+            }
+            catch (...)
+            {
+                g_captureCache.reset();
+            }
         }
-        if (outRowBytes)
+        return g_captureCache;
+    }
+
+    // Holds a staging slot from CaptureTexture until the caller has unmapped it
+    class CaptureLease
+    {
+    public:
+        CaptureLease() noexcept : m_slot(nullptr) {}
+        ~CaptureLease()
         {
-            *outRowBytes = static_cast<size_t>(rowBytes);
+            if (m_slot)
+            {
+                std::lock_guard<std::mutex> lock(m_cache->lock);
+                m_cache->cache.Release(m_slot);
+            }
         }
-        if (outNumRows)
+
+        CaptureLease(const CaptureLease&) = delete;
+        CaptureLease& operator=(const CaptureLease&) = delete;
+
+        // Takes a slot for textures like `desc`; false if the cache can't provide one
+        bool Acquire(_In_ ID3D11DeviceContext* pContext, const D3D11_TEXTURE2D_DESC& desc) noexcept
         {
-            *outNumRows = static_cast<size_t>(numRows);
+            assert(!m_slot);
+
+            // Queries only track the immediate context
+            if (pContext->GetType() != D3D11_DEVICE_CONTEXT_IMMEDIATE)
+                return false;
+
+            ComPtr<ID3D11Device> d3dDevice;
+            pContext->GetDevice(d3dDevice.GetAddressOf());
+
+            m_cache = GetCaptureCache(d3dDevice.Get());
+            if (!m_cache)
+                return false;
+
+            ReadbackKey key = {};
+            key.width = desc.Width;
+            key.height = desc.Height;
+            key.mipLevels = desc.MipLevels;
+            key.arraySize = desc.ArraySize;
+            key.format = static_cast<uint32_t>(desc.Format);
+            key.sampleCount = desc.SampleDesc.Count;
+            key.miscFlags = desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+            std::lock_guard<std::mutex> lock(m_cache->lock);
+            try
+            {
+                m_slot = m_cache->cache.Acquire(key);
+            }
+            catch (...)
+            {
+                m_slot = nullptr;
+            }
+            return m_slot != nullptr;
         }
 
-        return S_OK;
-    }
+        ID3D11Texture2D* Staging() const noexcept { return static_cast<ID3D11Texture2D*>(m_slot->staging); }
+        ID3D11Texture2D* Resolve() const noexcept { return static_cast<ID3D11Texture2D*>(m_slot->resolve); }
 
+        // Fences the copy into the staging texture
+        void Submit() noexcept
+        {
+            std::lock_guard<std::mutex> lock(m_cache->lock);
+            m_cache->cache.Submit(m_slot);
+        }
 
-    //--------------------------------------------------------------------------------------
-    DXGI_FORMAT EnsureNotTypeless(DXGI_FORMAT fmt) noexcept
-    {
-        // Assumes UNORM or FLOAT; doesn't use UINT or SINT
-        switch (fmt)
+        // Returns once the copy is complete, so Map doesn't stall inside the driver
+        void Wait() noexcept
         {
-        case DXGI_FORMAT_R32G32B32A32_TYPELESS: return DXGI_FORMAT_R32G32B32A32_FLOAT;
-        case DXGI_FORMAT_R32G32B32_TYPELESS:    return DXGI_FORMAT_R32G32B32_FLOAT;
-        case DXGI_FORMAT_R16G16B16A16_TYPELESS: return DXGI_FORMAT_R16G16B16A16_UNORM;
-        case DXGI_FORMAT_R32G32_TYPELESS:       return DXGI_FORMAT_R32G32_FLOAT;
-        case DXGI_FORMAT_R10G10B10A2_TYPELESS:  return DXGI_FORMAT_R10G10B10A2_UNORM;
-        case DXGI_FORMAT_R8G8B8A8_TYPELESS:     return DXGI_FORMAT_R8G8B8A8_UNORM;
-        case DXGI_FORMAT_R16G16_TYPELESS:       return DXGI_FORMAT_R16G16_UNORM;
-        case DXGI_FORMAT_R32_TYPELESS:          return DXGI_FORMAT_R32_FLOAT;
-        case DXGI_FORMAT_R8G8_TYPELESS:         return DXGI_FORMAT_R8G8_UNORM;
-        case DXGI_FORMAT_R16_TYPELESS:          return DXGI_FORMAT_R16_UNORM;
-        case DXGI_FORMAT_R8_TYPELESS:           return DXGI_FORMAT_R8_UNORM;
-        case DXGI_FORMAT_BC1_TYPELESS:          return DXGI_FORMAT_BC1_UNORM;
-        case DXGI_FORMAT_BC2_TYPELESS:          return DXGI_FORMAT_BC2_UNORM;
-        case DXGI_FORMAT_BC3_TYPELESS:          return DXGI_FORMAT_BC3_UNORM;
-        case DXGI_FORMAT_BC4_TYPELESS:          return DXGI_FORMAT_BC4_UNORM;
-        case DXGI_FORMAT_BC5_TYPELESS:          return DXGI_FORMAT_BC5_UNORM;
-        case DXGI_FORMAT_B8G8R8A8_TYPELESS:     return DXGI_FORMAT_B8G8R8A8_UNORM;
-        case DXGI_FORMAT_B8G8R8X8_TYPELESS:     return DXGI_FORMAT_B8G8R8X8_UNORM;
-        case DXGI_FORMAT_BC7_TYPELESS:          return DXGI_FORMAT_BC7_UNORM;
-        default:                                return fmt;
+            if (m_slot)
+            {
+                std::lock_guard<std::mutex> lock(m_cache->lock);
+                m_cache->cache.Wait(m_slot);
+            }
         }
-    }
+
+    private:
+        std::shared_ptr<CaptureCache> m_cache;
+        ReadbackSlot*                 m_slot;
+    };
 
 
     //--------------------------------------------------------------------------------------
@@ -634,7 +367,8 @@ namespace
         _In_ ID3D11DeviceContext* pContext,
         _In_ ID3D11Resource* pSource,
         D3D11_TEXTURE2D_DESC& desc,
-        ComPtr<ID3D11Texture2D>& pStaging) noexcept
+        ComPtr<ID3D11Texture2D>& pStaging,
+        CaptureLease& lease) noexcept
     {
         if (!pContext || !pSource)
             return E_INVALIDARG;
@@ -660,17 +394,8 @@ namespace
         if (desc.SampleDesc.Count > 1)
         {
             // MSAA content must be resolved before being copied to a staging texture
-            desc.SampleDesc.Count = 1;
-            desc.SampleDesc.Quality = 0;
-
-            ComPtr<ID3D11Texture2D> pTemp;
-            hr = d3dDevice->CreateTexture2D(&desc, nullptr, pTemp.GetAddressOf());
-            if (FAILED(hr))
-                return hr;
-
-            assert(pTemp);
-
-            const DXGI_FORMAT fmt = EnsureNotTypeless(desc.Format);
+            // Assumes UNORM or FLOAT; doesn't use UINT or SINT
+            const auto fmt = static_cast<DXGI_FORMAT>(DxgiTypedFormat(desc.Format));
 
             UINT support = 0;
             hr = d3dDevice->CheckFormatSupport(fmt, &support);
@@ -680,6 +405,25 @@ namespace
             if (!(support & D3D11_FORMAT_SUPPORT_MULTISAMPLE_RESOLVE))
                 return E_FAIL;
 
+            const bool cached = lease.Acquire(pContext, desc);
+
+            desc.SampleDesc.Count = 1;
+            desc.SampleDesc.Quality = 0;
+
+            ComPtr<ID3D11Texture2D> pTemp;
+            if (cached)
+            {
+                pTemp = lease.Resolve();
+            }
+            else
+            {
+                hr = d3dDevice->CreateTexture2D(&desc, nullptr, pTemp.GetAddressOf());
+                if (FAILED(hr))
+                    return hr;
+            }
+
+            assert(pTemp);
+
             for (UINT item = 0; item < desc.ArraySize; ++item)
             {
                 for (UINT level = 0; level < desc.MipLevels; ++level)
@@ -694,13 +438,23 @@ namespace
             desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
             desc.Usage = D3D11_USAGE_STAGING;
 
-            hr = d3dDevice->CreateTexture2D(&desc, nullptr, pStaging.ReleaseAndGetAddressOf());
-            if (FAILED(hr))
-                return hr;
+            if (cached)
+            {
+                pStaging = lease.Staging();
+            }
+            else
+            {
+                hr = d3dDevice->CreateTexture2D(&desc, nullptr, pStaging.ReleaseAndGetAddressOf());
+                if (FAILED(hr))
+                    return hr;
+            }
 
             assert(pStaging);
 
             pContext->CopyResource(pStaging.Get(), pTemp.Get());
+
+            if (cached)
+                lease.Submit();
         }
         else if ((desc.Usage == D3D11_USAGE_STAGING) && (desc.CPUAccessFlags & D3D11_CPU_ACCESS_READ))
         {
@@ -709,19 +463,31 @@ namespace
         }
         else
         {
-            // Otherwise, create a staging texture from the non-MSAA source
+            // Otherwise, copy the non-MSAA source to a cached or new staging texture
+            const bool cached = lease.Acquire(pContext, desc);
+
             desc.BindFlags = 0;
             desc.MiscFlags &= D3D11_RESOURCE_MISC_TEXTURECUBE;
             desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
             desc.Usage = D3D11_USAGE_STAGING;
 
-            hr = d3dDevice->CreateTexture2D(&desc, nullptr, pStaging.ReleaseAndGetAddressOf());
-            if (FAILED(hr))
-                return hr;
+            if (cached)
+            {
+                pStaging = lease.Staging();
+            }
+            else
+            {
+                hr = d3dDevice->CreateTexture2D(&desc, nullptr, pStaging.ReleaseAndGetAddressOf());
+                if (FAILED(hr))
+                    return hr;
+            }
 
             assert(pStaging);
 
             pContext->CopyResource(pStaging.Get(), pSource);
+
+            if (cached)
+                lease.Submit();
         }
 
         return S_OK;
@@ -783,6 +549,85 @@ namespace
 
         return factory;
     }
+
+    //--------------------------------------------------------------------------------------
+    // Conversions to the 8-bit WIC formats done with PixelConvert instead of
+    // IWICFormatConverter. Float sources are left to WIC, which also takes them from
+    // linear to sRGB on the way to 8 bits.
+    //--------------------------------------------------------------------------------------
+    bool GetPixelConvertTarget(DXGI_FORMAT format, REFGUID targetGuid, bool& bgra, UINT& bytesPerPixel) noexcept
+    {
+        if (!IsPixelConvertible(format) || GetDxgiFormatInfo(format).component == DxgiComponent::Float)
+            return false;
+
+        if (memcmp(&targetGuid, &GUID_WICPixelFormat32bppRGBA, sizeof(GUID)) == 0)
+        {
+            bgra = false;
+            bytesPerPixel = 4;
+        }
+        else if (memcmp(&targetGuid, &GUID_WICPixelFormat32bppBGRA, sizeof(GUID)) == 0 ||
+                 memcmp(&targetGuid, &GUID_WICPixelFormat32bppBGR, sizeof(GUID)) == 0)
+        {
+            bgra = true;
+            bytesPerPixel = 4;
+        }
+        else if (memcmp(&targetGuid, &GUID_WICPixelFormat24bppBGR, sizeof(GUID)) == 0)
+        {
+            bgra = true;
+            bytesPerPixel = 3;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    // Converts a strip of rows at a time and appends it to the frame, so no full-size copy
+    // of the image is made
+    HRESULT WriteConvertedPixels(
+        _In_ IWICBitmapFrameEncode* frame,
+        const D3D11_TEXTURE2D_DESC& desc,
+        const D3D11_MAPPED_SUBRESOURCE& mapped,
+        bool bgra,
+        UINT bytesPerPixel) noexcept
+    {
+        constexpr size_t STRIP_BYTES = 256 * 1024;
+
+        const size_t unpackedRowBytes = size_t(desc.Width) * 4;
+        const UINT stride = desc.Width * bytesPerPixel;
+        const UINT stripRows = std::min(desc.Height, std::max(1u, static_cast<UINT>(STRIP_BYTES / unpackedRowBytes)));
+
+        std::unique_ptr<uint8_t[]> strip(new (std::nothrow) uint8_t[unpackedRowBytes * stripRows]);
+        if (!strip)
+            return E_OUTOFMEMORY;
+
+        for (UINT y = 0; y < desc.Height; y += stripRows)
+        {
+            const UINT rows = std::min(stripRows, desc.Height - y);
+            const uint8_t* src = static_cast<const uint8_t*>(mapped.pData) + size_t(y) * mapped.RowPitch;
+            if (!UnpackPixels(desc.Format, src, mapped.RowPitch, strip.get(), ptrdiff_t(unpackedRowBytes), desc.Width, rows, bgra))
+                return E_UNEXPECTED;
+
+            if (bytesPerPixel == 3)
+            {
+                // Dropping alpha in place only ever moves bytes towards the start
+                uint8_t* out = strip.get();
+                const uint8_t* in = strip.get();
+                for (size_t pixel = 0; pixel < size_t(desc.Width) * rows; ++pixel, in += 4, out += 3)
+                {
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = in[2];
+                }
+            }
+
+            const HRESULT hr = frame->WritePixels(rows, stride, stride * rows, strip.get());
+            if (FAILED(hr))
+                return hr;
+        }
+        return S_OK;
+    }
 } // anonymous namespace
 
 
@@ -797,8 +642,9 @@ HRESULT DirectX::SaveDDSTextureToFile(
         return E_INVALIDARG;
 
     D3D11_TEXTURE2D_DESC desc = {};
+    CaptureLease lease;
     ComPtr<ID3D11Texture2D> pStaging;
-    HRESULT hr = CaptureTexture(pContext, pSource, desc, pStaging);
+    HRESULT hr = CaptureTexture(pContext, pSource, desc, pStaging, lease);
     if (FAILED(hr))
         return hr;
 
@@ -815,59 +661,45 @@ HRESULT DirectX::SaveDDSTextureToFile(
 
     auto_delete_file delonfail(hFile.get());
 
-    // Setup header
-    constexpr size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
-    uint8_t fileHeader[MAX_HEADER_SIZE] = {};
-
-    *reinterpret_cast<uint32_t*>(&fileHeader[0]) = DDS_MAGIC;
-
-    auto header = reinterpret_cast<DDS_HEADER*>(&fileHeader[0] + sizeof(uint32_t));
-    size_t headerSize = sizeof(uint32_t) + sizeof(DDS_HEADER);
-    header->size = sizeof(DDS_HEADER);
-    header->flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP;
-    header->height = desc.Height;
-    header->width = desc.Width;
-    header->mipMapCount = 1;
-    header->caps = DDS_SURFACE_FLAGS_TEXTURE;
-
     // Try to use a legacy .DDS pixel format for better tools support, otherwise fallback to 'DX10' header extension
-    DDS_HEADER_DXT10* extHeader = nullptr;
+    DDS_PIXELFORMAT ddspf = {};
+    bool legacy = true;
     switch (desc.Format)
     {
-    case DXGI_FORMAT_R8G8B8A8_UNORM:        memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_A8B8G8R8, sizeof(DDS_PIXELFORMAT));    break;
-    case DXGI_FORMAT_R16G16_UNORM:          memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_G16R16, sizeof(DDS_PIXELFORMAT));      break;
-    case DXGI_FORMAT_R8G8_UNORM:            memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_A8L8, sizeof(DDS_PIXELFORMAT));        break;
-    case DXGI_FORMAT_R16_UNORM:             memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_L16, sizeof(DDS_PIXELFORMAT));         break;
-    case DXGI_FORMAT_R8_UNORM:              memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_L8, sizeof(DDS_PIXELFORMAT));          break;
-    case DXGI_FORMAT_A8_UNORM:              memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_A8, sizeof(DDS_PIXELFORMAT));          break;
-    case DXGI_FORMAT_R8G8_B8G8_UNORM:       memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_R8G8_B8G8, sizeof(DDS_PIXELFORMAT));   break;
-    case DXGI_FORMAT_G8R8_G8B8_UNORM:       memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_G8R8_G8B8, sizeof(DDS_PIXELFORMAT));   break;
-    case DXGI_FORMAT_BC1_UNORM:             memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_DXT1, sizeof(DDS_PIXELFORMAT));        break;
-    case DXGI_FORMAT_BC2_UNORM:             memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_DXT3, sizeof(DDS_PIXELFORMAT));        break;
-    case DXGI_FORMAT_BC3_UNORM:             memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_DXT5, sizeof(DDS_PIXELFORMAT));        break;
-    case DXGI_FORMAT_BC4_UNORM:             memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_BC4_UNORM, sizeof(DDS_PIXELFORMAT));   break;
-    case DXGI_FORMAT_BC4_SNORM:             memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_BC4_SNORM, sizeof(DDS_PIXELFORMAT));   break;
-    case DXGI_FORMAT_BC5_UNORM:             memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_BC5_UNORM, sizeof(DDS_PIXELFORMAT));   break;
-    case DXGI_FORMAT_BC5_SNORM:             memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_BC5_SNORM, sizeof(DDS_PIXELFORMAT));   break;
-    case DXGI_FORMAT_B5G6R5_UNORM:          memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_R5G6B5, sizeof(DDS_PIXELFORMAT));      break;
-    case DXGI_FORMAT_B5G5R5A1_UNORM:        memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_A1R5G5B5, sizeof(DDS_PIXELFORMAT));    break;
-    case DXGI_FORMAT_R8G8_SNORM:            memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_V8U8, sizeof(DDS_PIXELFORMAT));        break;
-    case DXGI_FORMAT_R8G8B8A8_SNORM:        memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_Q8W8V8U8, sizeof(DDS_PIXELFORMAT));    break;
-    case DXGI_FORMAT_R16G16_SNORM:          memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_V16U16, sizeof(DDS_PIXELFORMAT));      break;
-    case DXGI_FORMAT_B8G8R8A8_UNORM:        memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_A8R8G8B8, sizeof(DDS_PIXELFORMAT));    break; // DXGI 1.1
-    case DXGI_FORMAT_B8G8R8X8_UNORM:        memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_X8R8G8B8, sizeof(DDS_PIXELFORMAT));    break; // DXGI 1.1
-    case DXGI_FORMAT_YUY2:                  memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_YUY2, sizeof(DDS_PIXELFORMAT));        break; // DXGI 1.2
-    case DXGI_FORMAT_B4G4R4A4_UNORM:        memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_A4R4G4B4, sizeof(DDS_PIXELFORMAT));    break; // DXGI 1.2
+    case DXGI_FORMAT_R8G8B8A8_UNORM:        ddspf = DDSPF_A8B8G8R8;    break;
+    case DXGI_FORMAT_R16G16_UNORM:          ddspf = DDSPF_G16R16;      break;
+    case DXGI_FORMAT_R8G8_UNORM:            ddspf = DDSPF_A8L8;        break;
+    case DXGI_FORMAT_R16_UNORM:             ddspf = DDSPF_L16;         break;
+    case DXGI_FORMAT_R8_UNORM:              ddspf = DDSPF_L8;          break;
+    case DXGI_FORMAT_A8_UNORM:              ddspf = DDSPF_A8;          break;
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:       ddspf = DDSPF_R8G8_B8G8;   break;
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:       ddspf = DDSPF_G8R8_G8B8;   break;
+    case DXGI_FORMAT_BC1_UNORM:             ddspf = DDSPF_DXT1;        break;
+    case DXGI_FORMAT_BC2_UNORM:             ddspf = DDSPF_DXT3;        break;
+    case DXGI_FORMAT_BC3_UNORM:             ddspf = DDSPF_DXT5;        break;
+    case DXGI_FORMAT_BC4_UNORM:             ddspf = DDSPF_BC4_UNORM;   break;
+    case DXGI_FORMAT_BC4_SNORM:             ddspf = DDSPF_BC4_SNORM;   break;
+    case DXGI_FORMAT_BC5_UNORM:             ddspf = DDSPF_BC5_UNORM;   break;
+    case DXGI_FORMAT_BC5_SNORM:             ddspf = DDSPF_BC5_SNORM;   break;
+    case DXGI_FORMAT_B5G6R5_UNORM:          ddspf = DDSPF_R5G6B5;      break;
+    case DXGI_FORMAT_B5G5R5A1_UNORM:        ddspf = DDSPF_A1R5G5B5;    break;
+    case DXGI_FORMAT_R8G8_SNORM:            ddspf = DDSPF_V8U8;        break;
+    case DXGI_FORMAT_R8G8B8A8_SNORM:        ddspf = DDSPF_Q8W8V8U8;    break;
+    case DXGI_FORMAT_R16G16_SNORM:          ddspf = DDSPF_V16U16;      break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:        ddspf = DDSPF_A8R8G8B8;    break; // DXGI 1.1
+    case DXGI_FORMAT_B8G8R8X8_UNORM:        ddspf = DDSPF_X8R8G8B8;    break; // DXGI 1.1
+    case DXGI_FORMAT_YUY2:                  ddspf = DDSPF_YUY2;        break; // DXGI 1.2
+    case DXGI_FORMAT_B4G4R4A4_UNORM:        ddspf = DDSPF_A4R4G4B4;    break; // DXGI 1.2
 
         // Legacy D3DX formats using D3DFMT enum value as FourCC
-    case DXGI_FORMAT_R32G32B32A32_FLOAT:    header->ddspf.size = sizeof(DDS_PIXELFORMAT); header->ddspf.flags = DDS_FOURCC; header->ddspf.fourCC = 116; break; // D3DFMT_A32B32G32R32F
-    case DXGI_FORMAT_R16G16B16A16_FLOAT:    header->ddspf.size = sizeof(DDS_PIXELFORMAT); header->ddspf.flags = DDS_FOURCC; header->ddspf.fourCC = 113; break; // D3DFMT_A16B16G16R16F
-    case DXGI_FORMAT_R16G16B16A16_UNORM:    header->ddspf.size = sizeof(DDS_PIXELFORMAT); header->ddspf.flags = DDS_FOURCC; header->ddspf.fourCC = 36;  break; // D3DFMT_A16B16G16R16
-    case DXGI_FORMAT_R16G16B16A16_SNORM:    header->ddspf.size = sizeof(DDS_PIXELFORMAT); header->ddspf.flags = DDS_FOURCC; header->ddspf.fourCC = 110; break; // D3DFMT_Q16W16V16U16
-    case DXGI_FORMAT_R32G32_FLOAT:          header->ddspf.size = sizeof(DDS_PIXELFORMAT); header->ddspf.flags = DDS_FOURCC; header->ddspf.fourCC = 115; break; // D3DFMT_G32R32F
-    case DXGI_FORMAT_R16G16_FLOAT:          header->ddspf.size = sizeof(DDS_PIXELFORMAT); header->ddspf.flags = DDS_FOURCC; header->ddspf.fourCC = 112; break; // D3DFMT_G16R16F
-    case DXGI_FORMAT_R32_FLOAT:             header->ddspf.size = sizeof(DDS_PIXELFORMAT); header->ddspf.flags = DDS_FOURCC; header->ddspf.fourCC = 114; break; // D3DFMT_R32F
-    case DXGI_FORMAT_R16_FLOAT:             header->ddspf.size = sizeof(DDS_PIXELFORMAT); header->ddspf.flags = DDS_FOURCC; header->ddspf.fourCC = 111; break; // D3DFMT_R16F
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:    ddspf = { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, 116, 0, 0, 0, 0, 0 }; break; // D3DFMT_A32B32G32R32F
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:    ddspf = { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, 113, 0, 0, 0, 0, 0 }; break; // D3DFMT_A16B16G16R16F
+    case DXGI_FORMAT_R16G16B16A16_UNORM:    ddspf = { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, 36, 0, 0, 0, 0, 0 };  break; // D3DFMT_A16B16G16R16
+    case DXGI_FORMAT_R16G16B16A16_SNORM:    ddspf = { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, 110, 0, 0, 0, 0, 0 }; break; // D3DFMT_Q16W16V16U16
+    case DXGI_FORMAT_R32G32_FLOAT:          ddspf = { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, 115, 0, 0, 0, 0, 0 }; break; // D3DFMT_G32R32F
+    case DXGI_FORMAT_R16G16_FLOAT:          ddspf = { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, 112, 0, 0, 0, 0, 0 }; break; // D3DFMT_G16R16F
+    case DXGI_FORMAT_R32_FLOAT:             ddspf = { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, 114, 0, 0, 0, 0, 0 }; break; // D3DFMT_R32F
+    case DXGI_FORMAT_R16_FLOAT:             ddspf = { sizeof(DDS_PIXELFORMAT), DDS_FOURCC, 111, 0, 0, 0, 0, 0 }; break; // D3DFMT_R16F
 
     case DXGI_FORMAT_AI44:
     case DXGI_FORMAT_IA44:
@@ -876,13 +708,7 @@ HRESULT DirectX::SaveDDSTextureToFile(
         return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 
     default:
-        memcpy_s(&header->ddspf, sizeof(header->ddspf), &DDSPF_DX10, sizeof(DDS_PIXELFORMAT));
-
-        headerSize += sizeof(DDS_HEADER_DXT10);
-        extHeader = reinterpret_cast<DDS_HEADER_DXT10*>(fileHeader + sizeof(uint32_t) + sizeof(DDS_HEADER));
-        extHeader->dxgiFormat = desc.Format;
-        extHeader->resourceDimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
-        extHeader->arraySize = 1;
+        legacy = false;
         break;
     }
 
@@ -891,62 +717,97 @@ HRESULT DirectX::SaveDDSTextureToFile(
     if (FAILED(hr))
         return hr;
 
-    if (rowPitch > UINT32_MAX || slicePitch > UINT32_MAX)
+    DdsTextureDesc ddsDesc = {};
+    ddsDesc.width = desc.Width;
+    ddsDesc.height = desc.Height;
+    ddsDesc.mipLevels = desc.MipLevels;
+    ddsDesc.arraySize = desc.ArraySize;
+    ddsDesc.dxgiFormat = static_cast<uint32_t>(desc.Format);
+    ddsDesc.cubemap = (desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE) != 0;
+    ddsDesc.compressed = IsDxgiCompressed(desc.Format);
+    ddsDesc.rowBytes = rowPitch;
+    ddsDesc.rowCount = rowCount;
+    ddsDesc.legacyFormat = legacy ? &ddspf : nullptr;
+
+    uint8_t fileHeader[DDS_MAX_HEADER_SIZE];
+    const size_t headerSize = BuildDdsHeader(ddsDesc, fileHeader);
+    if (!headerSize)
         return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
 
-    if (IsCompressed(desc.Format))
+    // Rows go straight from each mapped subresource into the writer's buffers; the file
+    // write runs on the writer's thread while the next rows are copied
+    DWORD writeError = ERROR_SUCCESS;
+    HANDLE file = hFile.get();
+    std::unique_ptr<DdsStreamWriter> writer;
+    try
     {
-        header->flags |= DDS_HEADER_FLAGS_LINEARSIZE;
-        header->pitchOrLinearSize = static_cast<uint32_t>(slicePitch);
+        writer.reset(new DdsStreamWriter([file, &writeError](const uint8_t* data, size_t size)
+        {
+            DWORD bytesWritten;
+            if (!WriteFile(file, data, static_cast<DWORD>(size), &bytesWritten, nullptr))
+            {
+                writeError = GetLastError();
+                return false;
+            }
+            if (bytesWritten != size)
+            {
+                writeError = ERROR_WRITE_FAULT;
+                return false;
+            }
+            return true;
+        }));
     }
-    else
+    catch (...)
     {
-        header->flags |= DDS_HEADER_FLAGS_PITCH;
-        header->pitchOrLinearSize = static_cast<uint32_t>(rowPitch);
+        return E_OUTOFMEMORY;
     }
 
-    // Setup pixels
-    std::unique_ptr<uint8_t[]> pixels(new (std::nothrow) uint8_t[slicePitch]);
-    if (!pixels)
-        return E_OUTOFMEMORY;
+    auto streamFailed = [&writer, &writeError]() noexcept
+    {
+        writer->Finish();
+        return writeError != ERROR_SUCCESS ? HRESULT_FROM_WIN32(writeError) : E_FAIL;
+    };
 
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    hr = pContext->Map(pStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped);
-    if (FAILED(hr))
-        return hr;
+    if (!writer->Write(fileHeader, headerSize))
+        return streamFailed();
 
-    auto sptr = static_cast<const uint8_t*>(mapped.pData);
-    if (!sptr)
+    // The file and header setup above overlapped the copy; only now wait for it
+    lease.Wait();
+
+    for (UINT item = 0; item < desc.ArraySize; ++item)
     {
-        pContext->Unmap(pStaging.Get(), 0);
-        return E_POINTER;
-    }
+        for (UINT level = 0; level < desc.MipLevels; ++level)
+        {
+            hr = GetSurfaceInfo(std::max<size_t>(1u, desc.Width >> level), std::max<size_t>(1u, desc.Height >> level),
+                desc.Format, nullptr, &rowPitch, &rowCount);
+            if (FAILED(hr))
+                return hr;
 
-    uint8_t* dptr = pixels.get();
+            const UINT subresource = D3D11CalcSubresource(level, item, desc.MipLevels);
 
-    const size_t msize = std::min<size_t>(rowPitch, mapped.RowPitch);
-    for (size_t h = 0; h < rowCount; ++h)
-    {
-        memcpy_s(dptr, rowPitch, sptr, msize);
-        sptr += mapped.RowPitch;
-        dptr += rowPitch;
-    }
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            hr = pContext->Map(pStaging.Get(), subresource, D3D11_MAP_READ, 0, &mapped);
+            if (FAILED(hr))
+                return hr;
 
-    pContext->Unmap(pStaging.Get(), 0);
+            auto sptr = static_cast<const uint8_t*>(mapped.pData);
+            if (!sptr || mapped.RowPitch < rowPitch)
+            {
+                pContext->Unmap(pStaging.Get(), subresource);
+                return E_POINTER;
+            }
 
-    // Write header & pixels
-    DWORD bytesWritten;
-    if (!WriteFile(hFile.get(), fileHeader, static_cast<DWORD>(headerSize), &bytesWritten, nullptr))
-        return HRESULT_FROM_WIN32(GetLastError());
+            const bool written = writer->WriteRows(sptr, mapped.RowPitch, rowPitch, rowCount);
 
-    if (bytesWritten != headerSize)
-        return E_FAIL;
+            pContext->Unmap(pStaging.Get(), subresource);
 
-    if (!WriteFile(hFile.get(), pixels.get(), static_cast<DWORD>(slicePitch), &bytesWritten, nullptr))
-        return HRESULT_FROM_WIN32(GetLastError());
+            if (!written)
+                return streamFailed();
+        }
+    }
 
-    if (bytesWritten != slicePitch)
-        return E_FAIL;
+    if (!writer->Finish())
+        return streamFailed();
 
     delonfail.clear();
 
@@ -968,15 +829,16 @@ HRESULT DirectX::SaveWICTextureToFile(
         return E_INVALIDARG;
 
     D3D11_TEXTURE2D_DESC desc = {};
+    CaptureLease lease;
     ComPtr<ID3D11Texture2D> pStaging;
-    HRESULT hr = CaptureTexture(pContext, pSource, desc, pStaging);
+    HRESULT hr = CaptureTexture(pContext, pSource, desc, pStaging, lease);
     if (FAILED(hr))
         return hr;
 
-    // Determine source format's WIC equivalent
+    // Determine source format's WIC equivalent; sRGB formats share their UNORM counterpart's
     WICPixelFormatGUID pfGuid = {};
-    bool sRGB = forceSRGB;
-    switch (desc.Format)
+    const bool sRGB = forceSRGB || IsDxgiSrgb(desc.Format);
+    switch (static_cast<DXGI_FORMAT>(DxgiLinearFormat(desc.Format)))
     {
     case DXGI_FORMAT_R32G32B32A32_FLOAT:            pfGuid = GUID_WICPixelFormat128bppRGBAFloat; break;
     case DXGI_FORMAT_R16G16B16A16_FLOAT:            pfGuid = GUID_WICPixelFormat64bppRGBAHalf; break;
@@ -990,33 +852,9 @@ HRESULT DirectX::SaveWICTextureToFile(
     case DXGI_FORMAT_R16_UNORM:                     pfGuid = GUID_WICPixelFormat16bppGray; break;
     case DXGI_FORMAT_R8_UNORM:                      pfGuid = GUID_WICPixelFormat8bppGray; break;
     case DXGI_FORMAT_A8_UNORM:                      pfGuid = GUID_WICPixelFormat8bppAlpha; break;
-
-    case DXGI_FORMAT_R8G8B8A8_UNORM:
-        pfGuid = GUID_WICPixelFormat32bppRGBA;
-        break;
-
-    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-        pfGuid = GUID_WICPixelFormat32bppRGBA;
-        sRGB = true;
-        break;
-
-    case DXGI_FORMAT_B8G8R8A8_UNORM: // DXGI 1.1
-        pfGuid = GUID_WICPixelFormat32bppBGRA;
-        break;
-
-    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB: // DXGI 1.1
-        pfGuid = GUID_WICPixelFormat32bppBGRA;
-        sRGB = true;
-        break;
-
-    case DXGI_FORMAT_B8G8R8X8_UNORM: // DXGI 1.1
-        pfGuid = GUID_WICPixelFormat32bppBGR;
-        break;
-
-    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB: // DXGI 1.1
-        pfGuid = GUID_WICPixelFormat32bppBGR;
-        sRGB = true;
-        break;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:                pfGuid = GUID_WICPixelFormat32bppRGBA; break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:                pfGuid = GUID_WICPixelFormat32bppBGRA; break; // DXGI 1.1
+    case DXGI_FORMAT_B8G8R8X8_UNORM:                pfGuid = GUID_WICPixelFormat32bppBGR; break; // DXGI 1.1
 
     default:
         return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
@@ -1182,6 +1020,9 @@ HRESULT DirectX::SaveWICTextureToFile(
         }
     }
 
+    // The file and encoder setup above overlapped the copy; only now wait for it
+    lease.Wait();
+
     D3D11_MAPPED_SUBRESOURCE mapped;
     hr = pContext->Map(pStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped);
     if (FAILED(hr))
@@ -1194,7 +1035,14 @@ HRESULT DirectX::SaveWICTextureToFile(
         return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
     }
 
-    if (memcmp(&targetGuid, &pfGuid, sizeof(WICPixelFormatGUID)) != 0)
+    bool convertBgra = false;
+    UINT convertedBytesPerPixel = 0;
+    if (memcmp(&targetGuid, &pfGuid, sizeof(WICPixelFormatGUID)) != 0 &&
+        GetPixelConvertTarget(desc.Format, targetGuid, convertBgra, convertedBytesPerPixel))
+    {
+        hr = WriteConvertedPixels(frame.Get(), desc, mapped, convertBgra, convertedBytesPerPixel);
+    }
+    else if (memcmp(&targetGuid, &pfGuid, sizeof(WICPixelFormatGUID)) != 0)
     {
         // Conversion required to write
         ComPtr<IWICBitmap> source;
@@ -1258,4 +1106,11 @@ HRESULT DirectX::SaveWICTextureToFile(
     delonfail.clear();
 
     return S_OK;
-}
\ No newline at end of file
+}
+
+//--------------------------------------------------------------------------------------
+void DirectX::ClearCaptureCache() noexcept
+{
+    std::lock_guard<std::mutex> lock(g_captureCacheLock);
+    g_captureCache.reset();
+}
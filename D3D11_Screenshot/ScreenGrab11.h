@@ -43,4 +43,7 @@ namespace DirectX
         _In_opt_ const GUID* targetFormat = nullptr,
         _In_opt_ std::function<void __cdecl(IPropertyBag2*)> setCustomProps = nullptr,
         _In_ bool forceSRGB = false);
+
+    // Releases the staging textures kept between captures; call before releasing the device
+    void __cdecl ClearCaptureCache() noexcept;
 }
\ No newline at end of file
@@ -11,11 +11,13 @@
 #include "MainWindow.h"
 #include "Renderer.h"
 
+#include <cstring>
+
 //-----------------------------------------------------------------------------
 // Main function: Creates window, calls initialization functions, and hosts
 // the render loop.
 //-----------------------------------------------------------------------------
-INT WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
+INT WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR lpCmdLine, int)
 {
     HRESULT hr = S_OK;
 
@@ -36,6 +38,17 @@ INT WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
         if (FAILED(hr))
             return hr;
 
+        // "/qoi" or "/raw" trade file size for speed when taking bursts of screenshots,
+        // "/jpg" trades exactness for both, "/burst" puts them all in one delta-coded file
+        if (lpCmdLine && strstr(lpCmdLine, "/burst"))
+            renderer->SetScreenshotFormat(ScreenshotFormat::Burst);
+        else if (lpCmdLine && strstr(lpCmdLine, "/qoi"))
+            renderer->SetScreenshotFormat(ScreenshotFormat::Qoi);
+        else if (lpCmdLine && strstr(lpCmdLine, "/raw"))
+            renderer->SetScreenshotFormat(ScreenshotFormat::Raw);
+        else if (lpCmdLine && strstr(lpCmdLine, "/jpg"))
+            renderer->SetScreenshotFormat(ScreenshotFormat::Jpeg);
+
       //  if (renderer->GetFrame())
       //  {
             // Saving to png
@@ -0,0 +1,528 @@
+//-----------------------------------------------------------------------------
+// File: ScreenshotService.cpp
+//
+// Background readback, encoding and disk I/O for screenshots.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "ScreenshotService.h"
+#include "DxgiFormat.h"
+#include "FrameHash.h"
+
+#include <d3d11_4.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Start accepts the UNORM and UNORM_SRGB variants, which share a layout
+    using FrameFormat = DxgiFormatTraits<DXGI_FORMAT_B8G8R8A8_UNORM>;
+    static_assert(FrameFormat::bytesPerPixel == DxgiFormatTraits<DXGI_FORMAT_B8G8R8A8_UNORM_SRGB>::bytesPerPixel,
+                  "frame formats differ in size");
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+ScreenshotService::ScreenshotService() :
+    m_width(0), m_height(0), m_policy(ScreenshotDropPolicy::DropOldest), m_pngOptions{ DeflateLevel::Fast, false, 0 },
+    m_jpegQuality(90),
+    m_stopping(false), m_stats{}, m_totalEncodeMs(0.0), m_totalReadbackMs(0.0), m_dedup(ScreenshotDedup::Off),
+    m_burstTickets(0), m_burstTurn(0), m_burst(new BurstWriter()), m_log(INVALID_HANDLE_VALUE)
+{
+}
+
+ScreenshotService::~ScreenshotService()
+{
+    Stop();
+}
+
+void ScreenshotService::SetDedup(ScreenshotDedup mode, const std::wstring& logFileName)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_dedup = mode;
+    }
+
+    std::lock_guard<std::mutex> lock(m_logLock);
+    if (logFileName != m_logFileName && m_log != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_log);
+        m_log = INVALID_HANDLE_VALUE;
+    }
+    m_logFileName = logFileName;
+}
+
+//-----------------------------------------------------------------------------
+// Create the staging pool and start the workers
+//-----------------------------------------------------------------------------
+HRESULT ScreenshotService::Start(ID3D11Device* device, ID3D11DeviceContext* context, const D3D11_TEXTURE2D_DESC& frameDesc,
+                                 UINT workers, UINT queueCapacity, ScreenshotDropPolicy policy, DeflateLevel pngLevel)
+{
+    Stop();
+
+    if (!device || !context || workers == 0 || queueCapacity == 0)
+        return E_INVALIDARG;
+
+    if (frameDesc.Format != DXGI_FORMAT_B8G8R8A8_UNORM && frameDesc.Format != DXGI_FORMAT_B8G8R8A8_UNORM_SRGB)
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    if (frameDesc.SampleDesc.Count > 1)
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    // Workers map staging textures while the render thread keeps using the immediate context
+    ComPtr <ID3D11Multithread> Multithread;
+    HRESULT hr = context->QueryInterface(__uuidof(ID3D11Multithread), reinterpret_cast<void**>(Multithread.GetAddressOf()));
+    if (FAILED(hr))
+        return hr;
+    Multithread->SetMultithreadProtected(TRUE);
+
+    D3D11_TEXTURE2D_DESC desc = frameDesc;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.BindFlags = 0;
+    desc.MiscFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc.Usage = D3D11_USAGE_STAGING;
+
+    m_staging.resize(queueCapacity);
+    for (UINT i = 0; i < queueCapacity; ++i)
+    {
+        hr = device->CreateTexture2D(&desc, nullptr, m_staging[i].ReleaseAndGetAddressOf());
+        if (FAILED(hr))
+        {
+            m_staging.clear();
+            return hr;
+        }
+    }
+
+    m_context = context;
+    m_width = desc.Width;
+    m_height = desc.Height;
+    m_policy = policy;
+
+    // The desktop's alpha channel is meaningless, so store 24-bit RGB
+    m_pngOptions.level = pngLevel;
+    m_pngOptions.alpha = false;
+    m_pngOptions.previews = 3;      // 1/4, 1/16 and 1/64 of the screen for the gallery
+    if (!m_encodePool)
+        m_encodePool.reset(new ThreadPool());
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_freeStaging.clear();
+        for (UINT i = queueCapacity; i > 0; --i)
+            m_freeStaging.push_back(i - 1);
+        m_queue.clear();
+        m_recent.clear();
+        m_burstTickets = 0;
+        m_burstTurn = 0;
+        m_burstDone.clear();
+        m_stopping = false;
+        m_stats = ScreenshotStats{};
+        m_stats.queueCapacity = queueCapacity;
+        m_totalEncodeMs = 0.0;
+        m_totalReadbackMs = 0.0;
+    }
+
+    for (UINT i = 0; i < workers; ++i)
+        m_workers.emplace_back(&ScreenshotService::WorkerMain, this);
+
+    return S_OK;
+}
+
+//-----------------------------------------------------------------------------
+// Drain the queue and join the workers
+//-----------------------------------------------------------------------------
+void ScreenshotService::Stop()
+{
+    if (m_workers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+
+    m_staging.clear();
+    m_context.Reset();
+    m_burst->Close();
+
+    std::lock_guard<std::mutex> lock(m_logLock);
+    if (m_log != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_log);
+        m_log = INVALID_HANDLE_VALUE;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Render thread side: take a staging texture, record the copy, queue the job
+//-----------------------------------------------------------------------------
+bool ScreenshotService::Enqueue(ID3D11Texture2D* frame, const std::wstring& fileName, ScreenshotFormat format)
+{
+    if (!IsRunning() || !frame)
+        return false;
+
+    SYSTEMTIME captured;
+    GetLocalTime(&captured);
+
+    UINT staging = 0;
+    ScreenshotDedup dedup;
+    UINT64 droppedBurst = UINT64_MAX;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ++m_stats.enqueued;
+        // A repeated frame costs a burst only an empty record
+        dedup = format == ScreenshotFormat::Burst ? ScreenshotDedup::Off : m_dedup;
+
+        if (!m_freeStaging.empty())
+        {
+            staging = m_freeStaging.back();
+            m_freeStaging.pop_back();
+        }
+        else if (m_policy == ScreenshotDropPolicy::DropOldest && !m_queue.empty())
+        {
+            // Nobody has started on the oldest job yet, so its texture can be reused right away
+            staging = m_queue.front().staging;
+            if (m_queue.front().format == ScreenshotFormat::Burst)
+                droppedBurst = m_queue.front().burstTicket;
+            m_queue.pop_front();
+            ++m_stats.dropped;
+        }
+        else
+        {
+            ++m_stats.dropped;
+            return false;
+        }
+
+        m_stats.queueDepth = m_stats.queueCapacity - static_cast<UINT>(m_freeStaging.size());
+        m_stats.peakQueueDepth = std::max(m_stats.peakQueueDepth, m_stats.queueDepth);
+    }
+
+    if (droppedBurst != UINT64_MAX)
+        EndBurstTurn(droppedBurst);
+
+    // Only recorded here; the GPU performs the copy after the render thread moves on
+    m_context->CopyResource(m_staging[staging].Get(), frame);
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        const UINT64 ticket = format == ScreenshotFormat::Burst ? m_burstTickets++ : 0;
+        m_queue.push_back(Job{ staging, fileName, format, dedup, captured, ticket });
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+ScreenshotStats ScreenshotService::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_stats;
+}
+
+void ScreenshotService::ReleaseStaging(UINT staging)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_freeStaging.push_back(staging);
+    m_stats.queueDepth = m_stats.queueCapacity - static_cast<UINT>(m_freeStaging.size());
+}
+
+//-----------------------------------------------------------------------------
+// Worker thread: readback, encode, write
+//-----------------------------------------------------------------------------
+void ScreenshotService::WorkerMain()
+{
+    std::vector<BYTE> pixels;
+    std::vector<BYTE> encoded;
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty())
+                break;
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        HRESULT hr = Map(job.staging, mapped);
+        double readbackMs = 0.0;
+        double encodeMs = 0.0;
+        bool duplicate = false;
+
+        if (FAILED(hr))
+        {
+            ReleaseStaging(job.staging);
+            if (job.format == ScreenshotFormat::Burst)
+                EndBurstTurn(job.burstTicket);
+        }
+        else if (job.format == ScreenshotFormat::Png)
+        {
+            // PNG takes long enough that the texture is better handed back right away
+            const size_t rowBytes = size_t(FrameFormat::RowBytes(m_width));
+            pixels.resize(rowBytes * m_height);
+            const BYTE* src = static_cast<const BYTE*>(mapped.pData);
+            for (UINT y = 0; y < m_height; ++y)
+                memcpy(pixels.data() + y * rowBytes, src + size_t(y) * mapped.RowPitch, rowBytes);
+            m_context->Unmap(m_staging[job.staging].Get(), 0);
+            ReleaseStaging(job.staging);
+            readbackMs = MillisecondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            const uint64_t hash = job.dedup != ScreenshotDedup::Off
+                                ? HashFrame(pixels.data(), ptrdiff_t(rowBytes), rowBytes, m_height, m_encodePool.get()) : 0;
+            duplicate = job.dedup != ScreenshotDedup::Off && SaveDuplicate(job, hash);
+            if (!duplicate)
+            {
+                hr = SavePng(pixels, encoded, job.fileName);
+                if (SUCCEEDED(hr) && job.dedup != ScreenshotDedup::Off)
+                    RememberSaved(job, hash);
+            }
+            encodeMs = MillisecondsSince(start);
+        }
+        else
+        {
+            readbackMs = MillisecondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            const uint64_t hash = job.dedup != ScreenshotDedup::Off
+                                ? HashFrame(static_cast<const BYTE*>(mapped.pData), ptrdiff_t(mapped.RowPitch),
+                                            size_t(FrameFormat::RowBytes(m_width)), m_height, m_encodePool.get())
+                                : 0;
+            duplicate = job.dedup != ScreenshotDedup::Off && SaveDuplicate(job, hash);
+            if (!duplicate)
+            {
+                hr = SaveMapped(job, mapped, encoded);
+                if (SUCCEEDED(hr) && job.dedup != ScreenshotDedup::Off)
+                    RememberSaved(job, hash);
+            }
+            m_context->Unmap(m_staging[job.staging].Get(), 0);
+            ReleaseStaging(job.staging);
+            encodeMs = MillisecondsSince(start);
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (duplicate)
+        {
+            ++m_stats.duplicates;
+        }
+        else if (SUCCEEDED(hr))
+        {
+            ++m_stats.saved;
+            m_totalEncodeMs += encodeMs;
+            m_totalReadbackMs += readbackMs;
+            m_stats.lastEncodeMs = encodeMs;
+            m_stats.maxEncodeMs = std::max(m_stats.maxEncodeMs, encodeMs);
+            m_stats.avgEncodeMs = m_totalEncodeMs / m_stats.saved;
+            m_stats.avgReadbackMs = m_totalReadbackMs / m_stats.saved;
+        }
+        else
+        {
+            ++m_stats.failed;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Wait for the copy without stalling the context, then map the staging texture
+//-----------------------------------------------------------------------------
+HRESULT ScreenshotService::Map(UINT staging, D3D11_MAPPED_SUBRESOURCE& mapped)
+{
+    HRESULT hr;
+    while ((hr = m_context->Map(m_staging[staging].Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)) == DXGI_ERROR_WAS_STILL_DRAWING)
+        Sleep(1);
+    return hr;
+}
+
+//-----------------------------------------------------------------------------
+// Encode on the shared pool, then write the file
+//-----------------------------------------------------------------------------
+HRESULT ScreenshotService::SavePng(const std::vector<BYTE>& pixels, std::vector<BYTE>& png, const std::wstring& fileName)
+{
+    if (!EncodePng(pixels.data(), ptrdiff_t(FrameFormat::RowBytes(m_width)), m_width, m_height, m_pngOptions, png, m_encodePool.get()))
+        return E_OUTOFMEMORY;
+
+    return WriteFileData(png, fileName);
+}
+
+//-----------------------------------------------------------------------------
+// Burst formats: one pass over the mapped rows, no intermediate copy
+//-----------------------------------------------------------------------------
+HRESULT ScreenshotService::SaveMapped(const Job& job, const D3D11_MAPPED_SUBRESOURCE& mapped, std::vector<BYTE>& encoded)
+{
+    const BYTE* pixels = static_cast<const BYTE*>(mapped.pData);
+
+    if (job.format == ScreenshotFormat::Raw)
+    {
+        if (!WriteRawImage(job.fileName.c_str(), pixels, ptrdiff_t(mapped.RowPitch), m_width, m_height, m_pngOptions.alpha))
+            return E_FAIL;
+        return S_OK;
+    }
+
+    if (job.format == ScreenshotFormat::Burst)
+    {
+        // The copy is all that happens here, so frames wait for their turn only briefly.
+        // Timestamps are FILETIME ticks of the local capture time.
+        WaitBurstTurn(job.burstTicket);
+        FILETIME captured = {};
+        SystemTimeToFileTime(&job.captured, &captured);
+        const int64_t timestamp = int64_t(uint64_t(captured.dwHighDateTime) << 32 | captured.dwLowDateTime);
+        bool added = m_burst->IsOpen() || m_burst->Open(job.fileName.c_str(), m_width, m_height, m_encodePool.get());
+        added = added && m_burst->Add(pixels, ptrdiff_t(mapped.RowPitch), timestamp);
+        EndBurstTurn(job.burstTicket);
+        return added ? S_OK : E_FAIL;
+    }
+
+    if (job.format == ScreenshotFormat::Jpeg)
+    {
+        if (!EncodeJpeg(pixels, ptrdiff_t(mapped.RowPitch), m_width, m_height, m_jpegQuality, encoded, m_encodePool.get()))
+            return E_OUTOFMEMORY;
+        return WriteFileData(encoded, job.fileName);
+    }
+
+    if (!EncodeQoi(pixels, ptrdiff_t(mapped.RowPitch), m_width, m_height, m_pngOptions.alpha, encoded))
+        return E_OUTOFMEMORY;
+
+    return WriteFileData(encoded, job.fileName);
+}
+
+//-----------------------------------------------------------------------------
+// Burst frames are added in ticket order. A ticket is ended when its frame has
+// been added, failed to map or was dropped from the queue; those ended ahead of
+// their turn are remembered until the turn gets to them.
+//-----------------------------------------------------------------------------
+void ScreenshotService::WaitBurstTurn(UINT64 ticket)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_burstWake.wait(lock, [this, ticket] { return m_burstTurn == ticket; });
+}
+
+void ScreenshotService::EndBurstTurn(UINT64 ticket)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_burstDone.insert(ticket);
+        while (!m_burstDone.empty() && *m_burstDone.begin() == m_burstTurn)
+        {
+            m_burstDone.erase(m_burstDone.begin());
+            ++m_burstTurn;
+        }
+    }
+    m_burstWake.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+// Write an encoded file in one go
+//-----------------------------------------------------------------------------
+HRESULT ScreenshotService::WriteFileData(const std::vector<BYTE>& data, const std::wstring& fileName)
+{
+    HANDLE File = CreateFileW(fileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    DWORD Written = 0;
+    HRESULT hr = S_OK;
+    if (!WriteFile(File, data.data(), static_cast<DWORD>(data.size()), &Written, nullptr))
+        hr = HRESULT_FROM_WIN32(GetLastError());
+    else if (Written != data.size())
+        hr = E_FAIL;
+    CloseHandle(File);
+
+    // Don't leave a truncated file behind
+    if (FAILED(hr))
+        DeleteFileW(fileName.c_str());
+    return hr;
+}
+
+
+//-----------------------------------------------------------------------------
+// Duplicates: a frame whose hash matches a recently saved one in the same
+// format is linked to that file or skipped, instead of encoded again
+//-----------------------------------------------------------------------------
+bool ScreenshotService::SaveDuplicate(const Job& job, uint64_t hash)
+{
+    std::wstring reference;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (const SavedFrame& saved : m_recent)
+        {
+            if (saved.hash == hash && saved.format == job.format)
+            {
+                reference = saved.fileName;
+                break;
+            }
+        }
+    }
+    if (reference.empty())
+        return false;
+
+    // The earlier file may have been deleted, or the volume may not support links;
+    // then the frame is saved the normal way and becomes the new reference
+    if (job.dedup == ScreenshotDedup::HardLink && !CreateHardLinkW(job.fileName.c_str(), reference.c_str(), nullptr))
+        return false;
+
+    LogDuplicate(job, reference);
+    return true;
+}
+
+void ScreenshotService::RememberSaved(const Job& job, uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_recent.push_front(SavedFrame{ hash, job.format, job.fileName });
+    if (m_recent.size() > DEDUP_HISTORY)
+        m_recent.pop_back();
+}
+
+//-----------------------------------------------------------------------------
+// One UTF-8 line per duplicate: capture time, "link" or "skip", the frame's file
+// name and the file that holds its pixels, separated by tabs
+//-----------------------------------------------------------------------------
+void ScreenshotService::LogDuplicate(const Job& job, const std::wstring& reference)
+{
+    const SYSTEMTIME& t = job.captured;
+    wchar_t stamp[32];
+    swprintf_s(stamp, L"%04u-%02u-%02u %02u:%02u:%02u.%03u", t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond,
+               t.wMilliseconds);
+
+    std::wstring line = stamp;
+    line += job.dedup == ScreenshotDedup::HardLink ? L"\tlink\t" : L"\tskip\t";
+    line += job.fileName + L"\t" + reference + L"\r\n";
+
+    const int size = WideCharToMultiByte(CP_UTF8, 0, line.c_str(), int(line.size()), nullptr, 0, nullptr, nullptr);
+    if (size <= 0)
+        return;
+    std::string utf8(size_t(size), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, line.c_str(), int(line.size()), &utf8[0], size, nullptr, nullptr);
+
+    std::lock_guard<std::mutex> lock(m_logLock);
+    if (m_log == INVALID_HANDLE_VALUE && !m_logFileName.empty())
+    {
+        m_log = CreateFileW(m_logFileName.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+    }
+    if (m_log == INVALID_HANDLE_VALUE)
+        return;
+
+    DWORD Written = 0;
+    WriteFile(m_log, utf8.data(), static_cast<DWORD>(utf8.size()), &Written, nullptr);
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: ScreenshotService.h
+//
+// Saves screenshots off the render thread. The render thread only records a
+// GPU copy of the frame into a free staging texture and queues it; worker
+// threads wait for the copy, read it back, encode the PNG and write the file.
+// Each PNG is itself encoded in bands spread over a shared thread pool.
+// The burst formats (QOI, raw BGRA and lossy JPEG) skip the copy and are
+// written straight from the mapped staging texture, which is held only for
+// that single pass; JPEG spreads its rows of macroblocks over the pool too.
+// A burst copies the frame into one container file per session, whose own
+// background thread keeps only the tiles that changed (see BurstFile.h);
+// burst frames go in in the order they were taken, whichever worker maps them.
+// The staging pool bounds the queue: when every texture is taken, the drop
+// policy decides whether the new frame or the oldest waiting one is discarded.
+//
+// An idle desktop gives the same picture frame after frame, so before encoding
+// each frame is hashed and compared with the last few saved ones. A repeat is
+// hard-linked to the earlier file, or not written at all, and a line in the
+// duplicate log records when it was taken and which file holds its pixels.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <windows.h>
+#include <d3d11.h>
+#include <wrl.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BurstFile.h"
+#include "JpegEncoder.h"
+#include "PngEncoder.h"
+#include "QoiEncoder.h"
+#include "RawImage.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+enum class ScreenshotDropPolicy
+{
+    DropNewest,     // keep the backlog, skip frames that don't fit
+    DropOldest,     // keep the latest frames, discard the oldest waiting one
+};
+
+enum class ScreenshotFormat
+{
+    Png,            // small files, the slowest to encode
+    Qoi,            // lossless single pass, for bursts
+    Raw,            // uncompressed BGRA behind a RAWIMAGE_HEADER
+    Jpeg,           // lossy, a fraction of the size of PNG and several times faster
+    Burst,          // appended to one container per session, changed tiles only
+};
+
+enum class ScreenshotDedup
+{
+    Off,            // encode every frame
+    HardLink,       // a repeat becomes a hard link to the file it repeats
+    Skip,           // a repeat only gets a line in the duplicate log
+};
+
+struct ScreenshotStats
+{
+    UINT   queueDepth;          // frames waiting or being read back
+    UINT   queueCapacity;
+    UINT   peakQueueDepth;
+    UINT64 enqueued;
+    UINT64 saved;
+    UINT64 dropped;
+    UINT64 failed;
+    UINT64 duplicates;          // frames linked or skipped instead of encoded
+    double lastEncodeMs;        // encoding and file write
+    double avgEncodeMs;
+    double maxEncodeMs;
+    double avgReadbackMs;       // waiting for the GPU copy and mapping
+};
+
+//-----------------------------------------------------------------------------
+// Class declarations
+//-----------------------------------------------------------------------------
+
+class ScreenshotService
+{
+public:
+    ScreenshotService();
+    ~ScreenshotService();
+
+    // Creates `queueCapacity` staging textures for frames like `frameDesc` and starts the workers.
+    // Only 8-bit BGRA frames are supported. `pngLevel` trades encoding time for file size.
+    HRESULT Start(ID3D11Device* device, ID3D11DeviceContext* context, const D3D11_TEXTURE2D_DESC& frameDesc,
+                  UINT workers, UINT queueCapacity, ScreenshotDropPolicy policy, DeflateLevel pngLevel);
+
+    // Saves everything still queued and stops the workers
+    void Stop();
+
+    bool IsRunning() const { return !m_workers.empty(); }
+
+    // Duplicate detection, off until set; takes effect for frames enqueued afterwards. The log
+    // is appended to, and only created once there is a duplicate to record.
+    void SetDedup(ScreenshotDedup mode, const std::wstring& logFileName);
+
+    // Render thread: queues a copy of `frame` to be saved as `fileName` in `format`. Never
+    // waits for the GPU or the encoder; returns false if the frame was dropped.
+    bool Enqueue(ID3D11Texture2D* frame, const std::wstring& fileName, ScreenshotFormat format = ScreenshotFormat::Png);
+
+    ScreenshotStats GetStats() const;
+
+private:
+    struct Job
+    {
+        UINT             staging;       // index into m_staging
+        std::wstring     fileName;
+        ScreenshotFormat format;
+        ScreenshotDedup  dedup;
+        SYSTEMTIME       captured;      // local time, for the duplicate log
+        UINT64           burstTicket;   // order among burst frames
+    };
+
+    struct SavedFrame
+    {
+        uint64_t         hash;
+        ScreenshotFormat format;
+        std::wstring     fileName;
+    };
+
+    static const size_t DEDUP_HISTORY = 8;     // saved frames a new one is compared with
+
+    void    WorkerMain();
+    HRESULT Map(UINT staging, D3D11_MAPPED_SUBRESOURCE& mapped);
+    HRESULT SavePng(const std::vector<BYTE>& pixels, std::vector<BYTE>& png, const std::wstring& fileName);
+    HRESULT SaveMapped(const Job& job, const D3D11_MAPPED_SUBRESOURCE& mapped, std::vector<BYTE>& encoded);
+    static HRESULT WriteFileData(const std::vector<BYTE>& data, const std::wstring& fileName);
+    bool    SaveDuplicate(const Job& job, uint64_t hash);
+    void    RememberSaved(const Job& job, uint64_t hash);
+    void    LogDuplicate(const Job& job, const std::wstring& reference);
+    void    ReleaseStaging(UINT staging);
+    void    WaitBurstTurn(UINT64 ticket);
+    void    EndBurstTurn(UINT64 ticket);
+
+    Microsoft::WRL::ComPtr <ID3D11DeviceContext>           m_context;
+    std::vector<Microsoft::WRL::ComPtr <ID3D11Texture2D>>  m_staging;
+    UINT                                                   m_width;
+    UINT                                                   m_height;
+    ScreenshotDropPolicy                                   m_policy;
+    PngOptions                                             m_pngOptions;
+    UINT                                                   m_jpegQuality;
+    std::unique_ptr<ThreadPool>                            m_encodePool;
+
+    std::vector<std::thread>        m_workers;
+    mutable std::mutex              m_lock;         // guards everything below
+    std::condition_variable         m_wake;
+    std::vector<UINT>               m_freeStaging;
+    std::deque<Job>                 m_queue;
+    bool                            m_stopping;
+    ScreenshotStats                 m_stats;
+    double                          m_totalEncodeMs;
+    double                          m_totalReadbackMs;
+    ScreenshotDedup                 m_dedup;
+    std::deque<SavedFrame>          m_recent;       // newest first
+    UINT64                          m_burstTickets; // handed out by Enqueue
+    UINT64                          m_burstTurn;    // the ticket that may be added next
+    std::set<UINT64>                m_burstDone;    // tickets ended ahead of their turn
+    std::condition_variable         m_burstWake;
+
+    std::unique_ptr<BurstWriter>    m_burst;        // opened by the first burst frame, only used in turn
+
+    std::mutex                      m_logLock;      // guards the log, kept apart from the queue
+    std::wstring                    m_logFileName;
+    HANDLE                          m_log;
+};
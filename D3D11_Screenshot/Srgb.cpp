@@ -0,0 +1,226 @@
+//-----------------------------------------------------------------------------
+// File: Srgb.cpp
+//
+// sRGB tables, the polynomial encoder and its SSE2 rows.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "Srgb.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define SRGB_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Below this the curve is a straight line
+    const float LINEAR_LIMIT = 0.0031308f;
+    const float LINEAR_SLOPE = 12.92f * 255.0f;
+
+    // 255 * (1.055 * u^(5/3) - 0.055) for u = x^(1/4) in [0.2365, 1], fitted by least
+    // squares; the largest error is 0.0045 of a step
+    const float C0 = -15.7335104f;
+    const float C1 = 42.1628013f;
+    const float C2 = 317.210247f;
+    const float C3 = -142.522379f;
+    const float C4 = 70.1872729f;
+    const float C5 = -16.3072499f;
+
+    double ExactToLinear(double srgb)
+    {
+        return srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4);
+    }
+
+    struct Tables
+    {
+        float    linear[256];
+        uint16_t linear16[256];
+
+        Tables()
+        {
+            for (int v = 0; v < 256; ++v)
+            {
+                const double linearValue = ExactToLinear(v / 255.0);
+                linear[v] = float(linearValue);
+                linear16[v] = uint16_t(std::lround(linearValue * 65535.0));
+            }
+        }
+    };
+
+    const Tables& GetTables()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    // The vector rows do the same operations in the same order
+    inline float EncodeScaled(float x)
+    {
+        x = x > 0.0f ? x : 0.0f;
+        x = x < 1.0f ? x : 1.0f;
+
+        const float u = std::sqrt(std::sqrt(x));
+        const float curve = ((((C5 * u + C4) * u + C3) * u + C2) * u + C1) * u + C0;
+        return x < LINEAR_LIMIT ? x * LINEAR_SLOPE : curve;
+    }
+
+#ifdef SRGB_SSE2
+    // Four linear values to four sRGB values in the low byte of each 32-bit lane
+    inline __m128i Encode4(__m128 x)
+    {
+        x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+        const __m128 u = _mm_sqrt_ps(_mm_sqrt_ps(x));
+        __m128 curve = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(C5), u), _mm_set1_ps(C4));
+        curve = _mm_add_ps(_mm_mul_ps(curve, u), _mm_set1_ps(C3));
+        curve = _mm_add_ps(_mm_mul_ps(curve, u), _mm_set1_ps(C2));
+        curve = _mm_add_ps(_mm_mul_ps(curve, u), _mm_set1_ps(C1));
+        curve = _mm_add_ps(_mm_mul_ps(curve, u), _mm_set1_ps(C0));
+
+        const __m128 line = _mm_mul_ps(x, _mm_set1_ps(LINEAR_SLOPE));
+        const __m128 useLine = _mm_cmplt_ps(x, _mm_set1_ps(LINEAR_LIMIT));
+        const __m128 scaled = _mm_or_ps(_mm_and_ps(useLine, line), _mm_andnot_ps(useLine, curve));
+        return _mm_cvtps_epi32(scaled);
+    }
+
+    // Sixteen 32-bit lanes holding bytes to sixteen bytes
+    inline void StoreBytes16(uint8_t* dst, __m128i a, __m128i b, __m128i c, __m128i d)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+    }
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Single values
+//-----------------------------------------------------------------------------
+const float* SrgbToLinearTable()
+{
+    return GetTables().linear;
+}
+
+const uint16_t* SrgbToLinear16Table()
+{
+    return GetTables().linear16;
+}
+
+uint8_t LinearToSrgb(float linear)
+{
+    return uint8_t(std::lrint(EncodeScaled(linear)));
+}
+
+uint8_t LinearToSrgbExact(float linear)
+{
+    if (!(linear > 0.0f))
+        return 0;
+    if (linear >= 1.0f)
+        return 255;
+
+    const double x = linear;
+    const double srgb = x <= 0.0031308 ? x * 12.92 : 1.055 * std::pow(x, 1.0 / 2.4) - 0.055;
+    return uint8_t(std::floor(srgb * 255.0 + 0.5));
+}
+
+//-----------------------------------------------------------------------------
+// Rows
+//-----------------------------------------------------------------------------
+void SrgbToLinearRow(const uint8_t* src, float* dst, size_t count)
+{
+    const float* table = SrgbToLinearTable();
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = table[src[i]];
+}
+
+void SrgbToLinear16Row(const uint8_t* src, uint16_t* dst, size_t count)
+{
+    const uint16_t* table = SrgbToLinear16Table();
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = table[src[i]];
+}
+
+void LinearToSrgbRow(const float* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+#ifdef SRGB_SSE2
+    for (; i + 16 <= count; i += 16)
+    {
+        StoreBytes16(dst + i, Encode4(_mm_loadu_ps(src + i)), Encode4(_mm_loadu_ps(src + i + 4)),
+                     Encode4(_mm_loadu_ps(src + i + 8)), Encode4(_mm_loadu_ps(src + i + 12)));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = LinearToSrgb(src[i]);
+}
+
+void Linear16ToSrgbRow(const uint16_t* src, uint8_t* dst, size_t count)
+{
+    const float scale = 1.0f / 65535.0f;
+    size_t i = 0;
+#ifdef SRGB_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale4 = _mm_set1_ps(scale);
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        StoreBytes16(dst + i, Encode4(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v0, zero)), scale4)),
+                     Encode4(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v0, zero)), scale4)),
+                     Encode4(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v1, zero)), scale4)),
+                     Encode4(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v1, zero)), scale4)));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = LinearToSrgb(float(src[i]) * scale);
+}
+
+void SrgbToLinearRgba(const uint8_t* src, float* dst, size_t pixels)
+{
+    const float* table = SrgbToLinearTable();
+    for (size_t i = 0; i < pixels; ++i, src += 4, dst += 4)
+    {
+        dst[0] = table[src[0]];
+        dst[1] = table[src[1]];
+        dst[2] = table[src[2]];
+        dst[3] = float(src[3]) * (1.0f / 255.0f);
+    }
+}
+
+void LinearToSrgbRgba(const float* src, uint8_t* dst, size_t pixels)
+{
+    size_t i = 0;
+#ifdef SRGB_SSE2
+    // Alpha takes the colour path and is then replaced with its linear scaling
+    const __m128i alphaMask = _mm_set_epi32(-1, 0, 0, 0);
+    const __m128 alphaScale = _mm_set1_ps(255.0f);
+    for (; i + 4 <= pixels; i += 4)
+    {
+        __m128i p[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            const __m128 v = _mm_loadu_ps(src + (i + k) * 4);
+            const __m128 a = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            const __m128i alpha = _mm_cvtps_epi32(_mm_mul_ps(a, alphaScale));
+            p[k] = _mm_or_si128(_mm_andnot_si128(alphaMask, Encode4(v)), _mm_and_si128(alphaMask, alpha));
+        }
+        StoreBytes16(dst + i * 4, p[0], p[1], p[2], p[3]);
+    }
+#endif
+    for (; i < pixels; ++i)
+    {
+        const float* s = src + i * 4;
+        uint8_t* d = dst + i * 4;
+        d[0] = LinearToSrgb(s[0]);
+        d[1] = LinearToSrgb(s[1]);
+        d[2] = LinearToSrgb(s[2]);
+
+        float a = s[3] > 0.0f ? s[3] : 0.0f;
+        a = a < 1.0f ? a : 1.0f;
+        d[3] = uint8_t(std::lrint(a * 255.0f));
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: Srgb.h
+//
+// sRGB transfer function for CPU-side image processing: scaling, mipmapping
+// and blending have to happen on linear values, the way the GPU does them
+// when it reads and writes _SRGB formats. 8-bit sRGB goes to linear float or
+// 16-bit through a 256-entry table. The way back to 8 bits uses a polynomial
+// in the fourth root of the value, evaluated four pixels at a time with SSE2.
+// It is within 0.005 of a step of the exact curve, so every table entry
+// converts back to the 8-bit value it came from.
+//
+// Alpha is never gamma encoded; the RGBA functions scale it linearly.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// 256 linear values in [0, 1], indexed by the 8-bit sRGB value
+const float* SrgbToLinearTable();
+
+// The same as 16-bit UNORM
+const uint16_t* SrgbToLinear16Table();
+
+inline float SrgbToLinear(uint8_t srgb) { return SrgbToLinearTable()[srgb]; }
+inline uint16_t SrgbToLinear16(uint8_t srgb) { return SrgbToLinear16Table()[srgb]; }
+
+// The polynomial approximation, one value at a time; clamps to [0, 1] and maps NaN to 0
+uint8_t LinearToSrgb(float linear);
+
+// The exact curve, correctly rounded; slow, for checking the approximation
+uint8_t LinearToSrgbExact(float linear);
+
+// Rows of single values
+void SrgbToLinearRow(const uint8_t* src, float* dst, size_t count);
+void SrgbToLinear16Row(const uint8_t* src, uint16_t* dst, size_t count);
+void LinearToSrgbRow(const float* src, uint8_t* dst, size_t count);
+void Linear16ToSrgbRow(const uint16_t* src, uint8_t* dst, size_t count);
+
+// Rows of four-channel pixels with alpha last, R, G, B, A or B, G, R, A alike: the
+// colour channels are converted and alpha is scaled between 8 bits and [0, 1]
+void SrgbToLinearRgba(const uint8_t* src, float* dst, size_t pixels);
+void LinearToSrgbRgba(const float* src, uint8_t* dst, size_t pixels);
@@ -0,0 +1,157 @@
+//-----------------------------------------------------------------------------
+// File: SrgbBench.cpp
+//
+// Headless benchmark and check for Srgb, not part of the application build.
+// Verifies that all 256 sRGB values survive the trip to linear float and
+// 16-bit and back, that the vector rows match the scalar encoder, and how
+// often the approximation differs from the correctly rounded curve. Then
+// times the tables and the encoder against per-value pow.
+//
+//   g++ -std=c++14 -O2 -I. SrgbBench.cpp Srgb.cpp -o srgbbench
+//   ./srgbbench [values] [runs]
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "Srgb.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    template <typename Convert>
+    double BestOf(int runs, Convert convert)
+    {
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            convert();
+            best = std::min(best, MillisecondsSince(start));
+        }
+        return best;
+    }
+
+    // What the code looked like without the tables
+    float PowToLinear(uint8_t v)
+    {
+        const float srgb = v / 255.0f;
+        return srgb <= 0.04045f ? srgb / 12.92f : std::pow((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+
+    uint8_t PowToSrgb(float linear)
+    {
+        linear = std::min(std::max(linear, 0.0f), 1.0f);
+        const float srgb = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+        return uint8_t(srgb * 255.0f + 0.5f);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t count = argc > 1 ? size_t(std::max(16, atoi(argv[1]))) : size_t(1) << 24;
+    const int runs = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+
+    bool allOk = true;
+
+    // Round trips through both tables, one value at a time and as rows
+    std::vector<uint8_t> all(256), back(256);
+    std::vector<float> linear(256);
+    std::vector<uint16_t> linear16(256);
+    for (int v = 0; v < 256; ++v)
+        all[v] = uint8_t(v);
+
+    SrgbToLinearRow(all.data(), linear.data(), 256);
+    SrgbToLinear16Row(all.data(), linear16.data(), 256);
+    int roundTripErrors = 0;
+    for (int v = 0; v < 256; ++v)
+    {
+        roundTripErrors += LinearToSrgb(linear[v]) != v;
+        roundTripErrors += LinearToSrgbExact(linear[v]) != v;
+    }
+    LinearToSrgbRow(linear.data(), back.data(), 256);
+    for (int v = 0; v < 256; ++v)
+        roundTripErrors += back[v] != v;
+    Linear16ToSrgbRow(linear16.data(), back.data(), 256);
+    for (int v = 0; v < 256; ++v)
+        roundTripErrors += back[v] != v;
+    printf("round trip of 256 values: %s\n", roundTripErrors ? "FAILED" : "ok");
+    allOk = allOk && roundTripErrors == 0;
+
+    // Random linear values, NaN, infinities and out-of-range values included
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> values(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float u = unit(rng);
+        values[i] = (i % 4) == 0 ? u * u * u * u : u;   // more of the dark end
+    }
+    const float specials[] = { NAN, INFINITY, -INFINITY, -1.0f, 0.0f, -0.0f, 1.0f, 2.0f, 1e-30f, 0.0031308f };
+    std::copy(std::begin(specials), std::end(specials), values.begin());
+
+    std::vector<uint8_t> fast(count), exact(count);
+    LinearToSrgbRow(values.data(), fast.data(), count);
+    size_t rowMismatches = 0, inexact = 0, farOff = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        rowMismatches += fast[i] != LinearToSrgb(values[i]);
+        exact[i] = LinearToSrgbExact(values[i]);
+        inexact += fast[i] != exact[i];
+        farOff += std::abs(int(fast[i]) - int(exact[i])) > 1;
+    }
+    printf("rows vs scalar: %zu mismatches; vs exact: %.3f%% off by one, %zu further\n\n",
+           rowMismatches, 100.0 * double(inexact) / double(count), farOff);
+    allOk = allOk && rowMismatches == 0 && farOff == 0;
+
+    // Throughput
+    std::vector<uint8_t> bytes(count);
+    for (size_t i = 0; i < count; ++i)
+        bytes[i] = uint8_t(rng());
+    std::vector<float> floats(count);
+    std::vector<uint16_t> shorts(count);
+
+    const double mega = double(count) / 1e6;
+    printf("%-28s %10s\n", "", "M values/s");
+
+    double ms = BestOf(runs, [&] { for (size_t i = 0; i < count; ++i) floats[i] = PowToLinear(bytes[i]); });
+    printf("%-28s %10.0f\n", "sRGB -> float, pow", mega / (ms / 1000.0));
+    ms = BestOf(runs, [&] { SrgbToLinearRow(bytes.data(), floats.data(), count); });
+    printf("%-28s %10.0f\n", "sRGB -> float, table", mega / (ms / 1000.0));
+    ms = BestOf(runs, [&] { SrgbToLinear16Row(bytes.data(), shorts.data(), count); });
+    printf("%-28s %10.0f\n", "sRGB -> 16-bit, table", mega / (ms / 1000.0));
+
+    ms = BestOf(runs, [&] { for (size_t i = 0; i < count; ++i) fast[i] = PowToSrgb(values[i]); });
+    printf("%-28s %10.0f\n", "float -> sRGB, pow", mega / (ms / 1000.0));
+    ms = BestOf(runs, [&] { for (size_t i = 0; i < count; ++i) fast[i] = LinearToSrgb(values[i]); });
+    printf("%-28s %10.0f\n", "float -> sRGB, scalar", mega / (ms / 1000.0));
+    ms = BestOf(runs, [&] { LinearToSrgbRow(values.data(), fast.data(), count); });
+    printf("%-28s %10.0f\n", "float -> sRGB, rows", mega / (ms / 1000.0));
+    ms = BestOf(runs, [&] { Linear16ToSrgbRow(shorts.data(), fast.data(), count); });
+    printf("%-28s %10.0f\n", "16-bit -> sRGB, rows", mega / (ms / 1000.0));
+
+    ms = BestOf(runs, [&] { SrgbToLinearRgba(bytes.data(), floats.data(), count / 4); });
+    printf("%-28s %10.0f\n", "RGBA8 -> float RGBA", mega / (ms / 1000.0));
+    ms = BestOf(runs, [&] { LinearToSrgbRgba(floats.data(), fast.data(), count / 4); });
+    printf("%-28s %10.0f\n", "float RGBA -> RGBA8", mega / (ms / 1000.0));
+
+    // The RGBA pair has to give back what it started with, alpha included
+    const bool rgbaOk = std::equal(fast.begin(), fast.begin() + count / 4 * 4, bytes.begin());
+    printf("\nRGBA round trip: %s\n", rgbaOk ? "ok" : "FAILED");
+    allOk = allOk && rgbaOk;
+
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+// File: Thumbnails.cpp
+//
+// 4x4 box downsampling, SSE2 with a scalar fallback that gives the same bytes.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include "Thumbnails.h"
+#include "../D3D11_ScreenCapture/ThreadPool.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define THUMB_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const size_t BAND_PIXELS = 64 * 1024;   // source pixels per task of the first level
+
+    // One output row from the four source rows starting at `src`
+    void ShrinkRow(const uint8_t* src, ptrdiff_t pitch, uint32_t outWidth, uint8_t* dst)
+    {
+        uint32_t x = 0;
+#ifdef THUMB_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi16(8);
+        for (; x + 2 <= outWidth; x += 2)
+        {
+            // Two blocks: 8 source pixels of each of the four rows
+            __m128i first = zero, second = zero;
+            for (int r = 0; r < 4; ++r)
+            {
+                const uint8_t* row = src + r * pitch + size_t(x) * 16;
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 16));
+                first = _mm_add_epi16(first, _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero)));
+                second = _mm_add_epi16(second, _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero)));
+            }
+
+            // Each half now holds two pixels' worth; fold them and keep one block per half
+            first = _mm_add_epi16(first, _mm_srli_si128(first, 8));
+            second = _mm_add_epi16(second, _mm_srli_si128(second, 8));
+            __m128i sum = _mm_unpacklo_epi64(first, second);
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 4);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + size_t(x) * 4), _mm_packus_epi16(sum, sum));
+        }
+#endif
+        for (; x < outWidth; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                uint32_t sum = 8;
+                for (int r = 0; r < 4; ++r)
+                {
+                    const uint8_t* p = src + r * pitch + size_t(x) * 16 + c;
+                    sum += uint32_t(p[0]) + p[4] + p[8] + p[12];
+                }
+                dst[size_t(x) * 4 + c] = uint8_t(sum >> 4);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// BuildThumbnails
+//-----------------------------------------------------------------------------
+void BuildThumbnails(const uint8_t* pixels, ptrdiff_t pitch, uint32_t width, uint32_t height, uint32_t levels,
+                     std::vector<Thumbnail>& thumbnails, ThreadPool* pool)
+{
+    thumbnails.clear();
+    if (!pixels)
+        return;
+
+    const uint8_t* src = pixels;
+    ptrdiff_t srcPitch = pitch;
+    uint32_t scale = 1;
+    thumbnails.reserve(levels);
+    for (uint32_t level = 0; level < levels && width >= 4 && height >= 4; ++level)
+    {
+        thumbnails.emplace_back();
+        Thumbnail& thumb = thumbnails.back();
+        thumb.width = width / 4;
+        thumb.height = height / 4;
+        thumb.scale = scale *= 4;
+        thumb.pixels.resize(size_t(thumb.width) * thumb.height * 4);
+
+        const size_t dstPitch = size_t(thumb.width) * 4;
+        uint8_t* dst = thumb.pixels.data();
+        const uint32_t bandRows = uint32_t(std::max<size_t>(1, BAND_PIXELS / (size_t(width) * 4)));
+        const size_t bands = (thumb.height + bandRows - 1) / bandRows;
+        auto shrinkBand = [&](size_t band)
+        {
+            const uint32_t first = uint32_t(band) * bandRows;
+            const uint32_t last = std::min(thumb.height, first + bandRows);
+            for (uint32_t y = first; y < last; ++y)
+                ShrinkRow(src + ptrdiff_t(y) * 4 * srcPitch, srcPitch, thumb.width, dst + y * dstPitch);
+        };
+
+        if (pool && level == 0 && bands > 1)
+            pool->ParallelFor(bands, shrinkBand);
+        else
+            for (size_t band = 0; band < bands; ++band)
+                shrinkBand(band);
+
+        src = dst;
+        srcPitch = ptrdiff_t(dstPitch);
+        width = thumb.width;
+        height = thumb.height;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// File: Thumbnails.h
+//
+// Preview pyramid of a screenshot: each level a quarter of the width and
+// height of the one before, so a 3840x2160 frame gives 960x540, 240x135 and
+// 60x33. Every output pixel is the plain average of a 4x4 block, taken in one
+// SSE2 pass that reads each source row once; the first level is split into
+// bands of rows on a thread pool, the small ones aren't worth it. Averaging
+// happens on the stored sRGB values, which is what thumbnailers normally do
+// and plenty for picking a screenshot out of a gallery.
+//
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//-----------------------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------------------
+
+struct Thumbnail
+{
+    uint32_t             width;
+    uint32_t             height;
+    uint32_t             scale;     // 4, 16, 64, ... of the source size
+    std::vector<uint8_t> pixels;    // tightly packed, same channel order as the source
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+// Builds up to `levels` levels of a top-down four-channel image (negative pitch for
+// bottom-up), largest first. Stops early once a level would be less than a pixel;
+// the last 1-3 columns and rows that don't fill a block are left out.
+void BuildThumbnails(const uint8_t* pixels, ptrdiff_t pitch, uint32_t width, uint32_t height, uint32_t levels,
+                     std::vector<Thumbnail>& thumbnails, ThreadPool* pool = nullptr);